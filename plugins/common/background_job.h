@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Handle given to work running on a BackgroundJob thread. Long loops poll
+// Cancelled() and report how many input bytes they have consumed.
+class JobContext {
+public:
+    JobContext(uint64_t generation,
+               const std::atomic<uint64_t>* current_generation,
+               std::atomic<size_t>* progress)
+        : generation_(generation), current_generation_(current_generation), progress_(progress) {}
+
+    // True once the job was cancelled or superseded by a newer Start().
+    bool Cancelled() const {
+        return current_generation_->load(std::memory_order_relaxed) != generation_;
+    }
+
+    void ReportProgress(size_t bytes_done) {
+        progress_->store(bytes_done, std::memory_order_relaxed);
+    }
+
+private:
+    uint64_t generation_;
+    const std::atomic<uint64_t>* current_generation_;
+    std::atomic<size_t>* progress_;
+};
+
+// Runs one piece of work at a time off the UI thread. Starting a new job
+// supersedes the running one: the old worker sees Cancelled() and its result
+// is discarded, but the UI thread never waits for it to wind down. Finished
+// results are picked up with TakeResult() from the frame callback.
+template <typename Result>
+class BackgroundJob {
+public:
+    using Work = std::function<Result(JobContext&)>;
+
+    BackgroundJob() = default;
+    BackgroundJob(const BackgroundJob&) = delete;
+    BackgroundJob& operator=(const BackgroundJob&) = delete;
+
+    ~BackgroundJob() {
+        Cancel();
+        for (auto& run : runs_) {
+            run.thread.join();
+        }
+    }
+
+    void Start(size_t total_bytes, Work work) {
+        Cancel();
+        ReapFinished();
+
+        auto state = std::make_shared<RunState>();
+        state->generation = generation_.load();
+        state->total = total_bytes;
+        active_ = state;
+        std::thread thread([this, state, work = std::move(work)]() {
+            JobContext context(state->generation, &generation_, &state->progress);
+            Result result = work(context);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (generation_.load() == state->generation) {
+                    result_ = std::move(result);
+                }
+            }
+            state->finished.store(true);
+        });
+        runs_.push_back(Run{std::move(thread), std::move(state)});
+    }
+
+    // Abandons the running job, if any. Returns immediately.
+    void Cancel() {
+        generation_.fetch_add(1);
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_.reset();
+        active_.reset();
+    }
+
+    bool Running() const {
+        return active_ && !active_->finished.load();
+    }
+
+    size_t BytesDone() const {
+        return active_ ? active_->progress.load(std::memory_order_relaxed) : 0;
+    }
+
+    size_t BytesTotal() const {
+        return active_ ? active_->total : 0;
+    }
+
+    float Fraction() const {
+        size_t total = BytesTotal();
+        return total == 0 ? 0.0f : static_cast<float>(static_cast<double>(BytesDone()) / total);
+    }
+
+    // Returns the result of the most recent job once, after it finished.
+    std::optional<Result> TakeResult() {
+        std::optional<Result> taken;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            taken.swap(result_);
+        }
+        if (taken) {
+            active_.reset();
+            ReapFinished();
+        }
+        return taken;
+    }
+
+private:
+    struct RunState {
+        uint64_t generation = 0;
+        size_t total = 0;
+        std::atomic<size_t> progress{0};
+        std::atomic<bool> finished{false};
+    };
+
+    struct Run {
+        std::thread thread;
+        std::shared_ptr<RunState> state;
+    };
+
+    // Joins workers that have already returned; never blocks on a live one.
+    void ReapFinished() {
+        for (auto it = runs_.begin(); it != runs_.end();) {
+            if (it->state->finished.load()) {
+                it->thread.join();
+                it = runs_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::atomic<uint64_t> generation_{0};
+    std::mutex mutex_;
+    std::optional<Result> result_;
+    std::shared_ptr<RunState> active_;
+    std::vector<Run> runs_;
+};
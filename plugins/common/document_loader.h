@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "background_job.h"
+
+// Builds one parsed form of the input off the UI thread and keeps the
+// latest, tagged with the input revision it was built from, so the views
+// of a plugin share one build per revision instead of parsing again on
+// every click. `Document` provides:
+//
+//   using Source = ...;        // input handed to the build, with view()
+//   size_t revision;
+//   bool Build(Source source, std::string& error, JobContext& job);
+template <typename Document>
+class DocumentLoader {
+public:
+    using Source = typename Document::Source;
+
+    // True unless a document for `revision` is ready, being built, or
+    // already failed to build.
+    bool Needs(size_t revision) const {
+        if (Get(revision) || error_revision_ == revision) {
+            return false;
+        }
+        return !(Loading() && loading_revision_ == revision);
+    }
+
+    void Load(Source source, size_t revision) {
+        loading_revision_ = revision;
+        const size_t total = source.view().size();
+        build_job_.Start(total, [source = std::move(source), revision](JobContext& job) {
+            BuildOutput output;
+            output.revision = revision;
+            auto document = std::make_shared<Document>();
+            document->revision = revision;
+            if (document->Build(source, output.error, job)) {
+                output.document = std::move(document);
+            }
+            return output;
+        });
+    }
+
+    // Adopts a finished build. Call once per frame.
+    void Poll() {
+        auto built = build_job_.TakeResult();
+        if (!built) {
+            return;
+        }
+        loading_revision_ = kNoRevision;
+        if (built->document) {
+            document_ = std::move(built->document);
+            error_.clear();
+            error_revision_ = kNoRevision;
+        } else {
+            error_ = std::move(built->error);
+            error_revision_ = built->revision;
+        }
+    }
+
+    void Clear() {
+        build_job_.Cancel();
+        loading_revision_ = kNoRevision;
+        error_revision_ = kNoRevision;
+        document_.reset();
+        error_.clear();
+    }
+
+    // The ready document for `revision`, or null.
+    std::shared_ptr<const Document> Get(size_t revision) const {
+        return document_ && document_->revision == revision ? document_ : nullptr;
+    }
+
+    // The latest ready document, whatever its revision.
+    const std::shared_ptr<const Document>& latest() const {
+        return document_;
+    }
+
+    bool Loading() const {
+        return build_job_.Running();
+    }
+
+    float Fraction() const {
+        return build_job_.Fraction();
+    }
+
+    // Why the last build failed, or empty.
+    const std::string& error() const {
+        return error_;
+    }
+
+private:
+    struct BuildOutput {
+        std::shared_ptr<const Document> document;
+        size_t revision = 0;
+        std::string error;
+    };
+
+    static constexpr size_t kNoRevision = static_cast<size_t>(-1);
+
+    BackgroundJob<BuildOutput> build_job_;
+    size_t loading_revision_ = kNoRevision;
+    size_t error_revision_ = kNoRevision;
+    std::shared_ptr<const Document> document_;
+    std::string error_;
+};
@@ -0,0 +1,90 @@
+#include "file_io_panel.h"
+
+#include <imgui.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+namespace {
+
+double ToMegabytes(size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+bool FileIoPanel::CheckDestination(char* status_buf, size_t status_size) const {
+    if (!save_to_file || !file) {
+        return true;
+    }
+    std::error_code error;
+    if (!std::filesystem::equivalent(std::filesystem::path(save_path), file->path(), error)) {
+        return true;
+    }
+    std::snprintf(status_buf, status_size, "Refusing to write over the open input file %s.", save_path);
+    return false;
+}
+
+void RenderFileIoPanel(FileIoPanel& panel, char* status_buf, size_t status_size) {
+    ImGui::SetNextItemWidth(320.0f);
+    ImGui::InputTextWithHint("##OpenPath", "input file path", panel.open_path, sizeof(panel.open_path));
+    ImGui::SameLine();
+    if (ImGui::Button("Open file...")) {
+        auto file = std::make_shared<MappedFile>();
+        std::string error;
+        if (file->Open(panel.open_path, error)) {
+            CloseMappedFile(panel);
+            panel.file = std::move(file);
+            std::shared_ptr<const MappedFile> mapped = panel.file;
+            panel.index_job.Start(mapped->size(), [mapped, language = panel.language](JobContext& job) {
+                MappedFileIndex index;
+                index.lines.Build(mapped->view());
+                index.syntax.Build(language, mapped->view(), index.lines, &job);
+                return index;
+            });
+            std::snprintf(status_buf, status_size, "Mapped %s (%.1f MB).",
+                          panel.open_path, ToMegabytes(panel.file->size()));
+        } else {
+            std::snprintf(status_buf, status_size, "Open failed: %s", error.c_str());
+        }
+    }
+    if (panel.file) {
+        ImGui::SameLine();
+        if (ImGui::Button("Close file")) {
+            CloseMappedFile(panel);
+            std::snprintf(status_buf, status_size, "%s", "File closed.");
+        }
+    }
+
+    ImGui::Checkbox("Write output to file", &panel.save_to_file);
+    if (panel.save_to_file) {
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(320.0f);
+        ImGui::InputTextWithHint("##SavePath", "output file path", panel.save_path, sizeof(panel.save_path));
+    }
+}
+
+void CloseMappedFile(FileIoPanel& panel) {
+    panel.index_job.Cancel();
+    panel.viewer.Clear();
+    panel.file.reset();
+}
+
+void RenderMappedFileView(FileIoPanel& panel) {
+    if (!panel.file) {
+        return;
+    }
+    if (auto index = panel.index_job.TakeResult()) {
+        panel.viewer.SetText(SharedText::Map(panel.file), std::move(index->lines), std::move(index->syntax));
+    }
+    ImGui::TextWrapped("Reading %s (%.1f MB) from a read-only mapping. Close the file to edit text.",
+                       panel.file->path().string().c_str(), ToMegabytes(panel.file->size()));
+    ImGui::Separator();
+    if (panel.index_job.Running()) {
+        ImGui::TextDisabled("Indexing lines...");
+        return;
+    }
+    panel.viewer.Render("MappedView");
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "background_job.h"
+#include "line_index.h"
+#include "mapped_file.h"
+#include "syntax_highlight.h"
+#include "text_viewer.h"
+
+// "Open file..." / "Write output to file" controls shared by the formatter
+// plugins. An opened file is mapped read-only and fed to the formatter
+// directly instead of being copied into the editor buffer.
+struct MappedFileIndex {
+    LineIndex lines;
+    SyntaxIndex syntax;
+};
+
+struct FileIoPanel {
+    char open_path[512] = "";
+    char save_path[512] = "";
+    bool save_to_file = false;
+    // Highlighting for the mapped file view.
+    SyntaxLanguage language = SyntaxLanguage::Plain;
+    std::shared_ptr<MappedFile> file;
+    // Line and syntax index of the mapped file, built off the UI thread
+    // after Open.
+    BackgroundJob<MappedFileIndex> index_job;
+    TextViewer viewer;
+
+    bool HasFile() const {
+        return file != nullptr;
+    }
+
+    // Output path for the next job, or empty when output stays in memory.
+    std::string Destination() const {
+        return save_to_file ? std::string(save_path) : std::string();
+    }
+
+    // False, with a message in `status_buf`, when the output would go to
+    // the mapped input file: opening it for writing truncates the pages a
+    // job is still reading.
+    bool CheckDestination(char* status_buf, size_t status_size) const;
+
+    // Bytes the next job should read: the mapped file when one is open,
+    // otherwise a snapshot of `editor_text`.
+    SharedText Source(const std::string& editor_text) const {
+        return file ? SharedText::Map(file) : SharedText::Copy(editor_text);
+    }
+};
+
+// Draws the file row. Writes a message to `status_buf` when a file is
+// opened or closed.
+void RenderFileIoPanel(FileIoPanel& panel, char* status_buf, size_t status_size);
+
+// Drops the mapped file and its view.
+void CloseMappedFile(FileIoPanel& panel);
+
+// Read-only stand-in for the input editor while a file is mapped.
+void RenderMappedFileView(FileIoPanel& panel);
@@ -0,0 +1,31 @@
+#include "input_text.h"
+
+namespace {
+
+int InputTextResizeCallback(ImGuiInputTextCallbackData* data) {
+    if (data->EventFlag == ImGuiInputTextFlags_CallbackResize) {
+        auto* str = static_cast<std::string*>(data->UserData);
+        str->resize(static_cast<size_t>(data->BufTextLen));
+        data->Buf = const_cast<char*>(str->c_str());
+    }
+    return 0;
+}
+
+} // namespace
+
+bool InputTextMultilineString(const char* label,
+                              std::string* str,
+                              const ImVec2& size,
+                              ImGuiInputTextFlags flags) {
+    if (str->capacity() < str->size() + 1) {
+        str->reserve(str->size() + 1);
+    }
+    return ImGui::InputTextMultiline(
+        label,
+        const_cast<char*>(str->c_str()),
+        str->capacity() + 1,
+        size,
+        flags | ImGuiInputTextFlags_CallbackResize,
+        InputTextResizeCallback,
+        str);
+}
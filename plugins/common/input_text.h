@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+#include <imgui.h>
+
+// ImGui::InputTextMultiline editing a std::string in place: the string is
+// resized through the resize callback as the text grows, so there is no
+// fixed-size buffer to copy in and out each frame.
+bool InputTextMultilineString(const char* label,
+                              std::string* str,
+                              const ImVec2& size,
+                              ImGuiInputTextFlags flags = 0);
@@ -0,0 +1,37 @@
+#include "line_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+void LineIndex::Build(std::string_view text) {
+    starts_.clear();
+    starts_.push_back(0);
+    const char* data = text.data();
+    const char* end = data + text.size();
+    const char* p = data;
+    while ((p = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)))) != nullptr) {
+        ++p;
+        starts_.push_back(static_cast<size_t>(p - data));
+    }
+}
+
+void LineIndex::Clear() {
+    starts_.clear();
+}
+
+std::string_view LineIndex::Line(std::string_view text, size_t line) const {
+    const size_t begin = starts_[line];
+    size_t end = line + 1 < starts_.size() ? starts_[line + 1] - 1 : text.size();
+    if (end > begin && text[end - 1] == '\r') {
+        --end;
+    }
+    return text.substr(begin, end - begin);
+}
+
+size_t LineIndex::LineOfOffset(size_t offset) const {
+    if (starts_.empty()) {
+        return 0;
+    }
+    auto it = std::upper_bound(starts_.begin(), starts_.end(), offset);
+    return static_cast<size_t>(it - starts_.begin()) - 1;
+}
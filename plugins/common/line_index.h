@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Start offsets of every line in a text buffer. Built once per buffer so
+// viewers can address line N, or find the line holding a byte offset,
+// without scanning the text again.
+class LineIndex {
+public:
+    void Build(std::string_view text);
+    void Clear();
+
+    size_t line_count() const {
+        return starts_.size();
+    }
+
+    size_t LineStart(size_t line) const {
+        return starts_[line];
+    }
+
+    // Line `line` of `text` (the buffer the index was built from), without
+    // its line terminator.
+    std::string_view Line(std::string_view text, size_t line) const;
+
+    // Zero-based line containing byte `offset`.
+    size_t LineOfOffset(size_t offset) const;
+
+private:
+    std::vector<size_t> starts_;
+};
@@ -0,0 +1,15 @@
+#include "live_reformat.h"
+
+#include <imgui.h>
+
+void RenderLiveReformatControls(LiveReformat& live) {
+    if (ImGui::Checkbox("Live", &live.enabled) && live.enabled) {
+        live.pending = true;
+        live.last_edit_time = 0.0;
+    }
+    if (live.enabled) {
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::SliderInt("Delay (ms)", &live.delay_ms, 50, 2000);
+    }
+}
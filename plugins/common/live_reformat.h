@@ -0,0 +1,29 @@
+#pragma once
+
+// Debounce state for reformat-as-you-type. Edits arm the timer; Poll()
+// fires once the input has been quiet for `delay_ms`. Times are in seconds
+// as returned by ImGui::GetTime().
+struct LiveReformat {
+    bool enabled = false;
+    int delay_ms = 300;
+    bool pending = false;
+    double last_edit_time = 0.0;
+
+    void MarkEdited(double now) {
+        last_edit_time = now;
+        pending = enabled;
+    }
+
+    // True once per settled edit, on the frame the delay runs out.
+    bool Poll(double now) {
+        if (!enabled || !pending || (now - last_edit_time) * 1000.0 < delay_ms) {
+            return false;
+        }
+        pending = false;
+        return true;
+    }
+};
+
+// Draws the "Live" checkbox and delay slider. Turning live mode on arms an
+// immediate reformat of the current input.
+void RenderLiveReformatControls(LiveReformat& live);
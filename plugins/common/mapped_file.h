@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool Open(const std::filesystem::path& path, std::string& error);
+    void Close();
+
+    std::string_view view() const {
+        return std::string_view(data_, size_);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    const std::filesystem::path& path() const {
+        return path_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::filesystem::path path_;
+#if defined(_WIN32)
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+};
+
+// Immutable bytes handed to a background job: either a snapshot of an
+// editor buffer or a mapped file. Copies share the same owner, which stays
+// alive until the last job using it is done.
+class SharedText {
+public:
+    SharedText() = default;
+
+    static SharedText Copy(const std::string& text) {
+        auto owned = std::make_shared<const std::string>(text);
+        SharedText shared;
+        shared.view_ = *owned;
+        shared.owner_ = std::move(owned);
+        return shared;
+    }
+
+    static SharedText Own(std::string text) {
+        auto owned = std::make_shared<const std::string>(std::move(text));
+        SharedText shared;
+        shared.view_ = *owned;
+        shared.owner_ = std::move(owned);
+        return shared;
+    }
+
+    static SharedText Map(std::shared_ptr<const MappedFile> file) {
+        SharedText shared;
+        shared.view_ = file->view();
+        shared.owner_ = std::move(file);
+        return shared;
+    }
+
+    std::string_view view() const {
+        return view_;
+    }
+
+private:
+    std::shared_ptr<const void> owner_;
+    std::string_view view_;
+};
@@ -0,0 +1,75 @@
+#include "output_sink.h"
+
+namespace {
+
+constexpr size_t kFileSinkBufferSize = 1024 * 1024;
+constexpr size_t kHexSinkBufferSize = 64 * 1024;
+constexpr size_t kHexBytesPerLine = 32;
+constexpr size_t kDiscardSinkBufferSize = 64 * 1024;
+
+} // namespace
+
+FileSink::FileSink() : OutputSink(&storage_, kFileSinkBufferSize) {
+    storage_.reserve(kFileSinkBufferSize + 4096);
+}
+
+FileSink::~FileSink() {
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+bool FileSink::Open(const std::filesystem::path& path, std::string& error) {
+#if defined(_WIN32)
+    file_ = _wfopen(path.c_str(), L"wb");
+#else
+    file_ = std::fopen(path.c_str(), "wb");
+#endif
+    if (!file_) {
+        error = "cannot open " + path.string() + " for writing";
+        return false;
+    }
+    return true;
+}
+
+void FileSink::Flush() {
+    if (!failed_ && file_ && !storage_.empty()) {
+        if (std::fwrite(storage_.data(), 1, storage_.size(), file_) != storage_.size()) {
+            failed_ = true;
+        }
+        bytes_written_ += storage_.size();
+    }
+    storage_.clear();
+}
+
+bool FileSink::Finish() {
+    Flush();
+    if (file_) {
+        if (std::fclose(file_) != 0) {
+            failed_ = true;
+        }
+        file_ = nullptr;
+    }
+    return !failed_;
+}
+
+HexSink::HexSink(std::string& target) : OutputSink(&storage_, kHexSinkBufferSize), target_(target) {
+    storage_.reserve(kHexSinkBufferSize + 4096);
+}
+
+void HexSink::Flush() {
+    static constexpr char kHex[] = "0123456789abcdef";
+    target_.reserve(target_.size() + storage_.size() * 3);
+    for (const char c : storage_) {
+        const auto byte = static_cast<unsigned char>(c);
+        if (bytes_written_ > 0) {
+            target_.push_back(bytes_written_ % kHexBytesPerLine == 0 ? '\n' : ' ');
+        }
+        target_.push_back(kHex[byte >> 4]);
+        target_.push_back(kHex[byte & 0xF]);
+        ++bytes_written_;
+    }
+    storage_.clear();
+}
+
+DiscardSink::DiscardSink() : OutputSink(&storage_, kDiscardSinkBufferSize) {}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <string_view>
+
+// Append-only byte sink used by the streaming formatters. Writes go into a
+// std::string buffer; sinks backed by something other than memory drain the
+// buffer from Flush() once it grows past the flush threshold.
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+
+    void Append(std::string_view text) {
+        buffer_->append(text.data(), text.size());
+        if (buffer_->size() >= flush_threshold_) {
+            Flush();
+        }
+    }
+
+    void Put(char c) {
+        buffer_->push_back(c);
+        if (buffer_->size() >= flush_threshold_) {
+            Flush();
+        }
+    }
+
+    void PutRepeated(char c, size_t count) {
+        buffer_->append(count, c);
+        if (buffer_->size() >= flush_threshold_) {
+            Flush();
+        }
+    }
+
+    // Flushes whatever is still buffered. Returns false if the sink failed.
+    virtual bool Finish() {
+        Flush();
+        return true;
+    }
+
+protected:
+    OutputSink(std::string* buffer, size_t flush_threshold)
+        : buffer_(buffer), flush_threshold_(flush_threshold) {}
+
+    virtual void Flush() {}
+
+    std::string* buffer_;
+    size_t flush_threshold_;
+};
+
+// Collects all output in a caller-owned string.
+class StringSink : public OutputSink {
+public:
+    explicit StringSink(std::string& target)
+        : OutputSink(&target, std::numeric_limits<size_t>::max()) {}
+};
+
+// Streams output to a file through a fixed-size buffer, so formatted
+// results never have to be held in memory as a whole.
+class FileSink : public OutputSink {
+public:
+    FileSink();
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+    ~FileSink() override;
+
+    bool Open(const std::filesystem::path& path, std::string& error);
+    bool Finish() override;
+
+    size_t bytes_written() const {
+        return bytes_written_ + storage_.size();
+    }
+
+    // True once a write to the file failed.
+    bool failed() const {
+        return failed_;
+    }
+
+protected:
+    void Flush() override;
+
+private:
+    std::string storage_;
+    std::FILE* file_ = nullptr;
+    size_t bytes_written_ = 0;
+    bool failed_ = false;
+};
+
+// Writes everything as hex text, 32 space-separated bytes per line, so
+// binary output can be shown in the text viewer.
+class HexSink : public OutputSink {
+public:
+    explicit HexSink(std::string& target);
+
+    size_t bytes_written() const {
+        return bytes_written_ + storage_.size();
+    }
+
+protected:
+    void Flush() override;
+
+private:
+    std::string storage_;
+    std::string& target_;
+    size_t bytes_written_ = 0;
+};
+
+// Drops everything; for passes that only check their input.
+class DiscardSink : public OutputSink {
+public:
+    DiscardSink();
+
+protected:
+    void Flush() override {
+        storage_.clear();
+    }
+
+private:
+    std::string storage_;
+};
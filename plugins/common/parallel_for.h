@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Worker count to use instead of the hardware thread count, or 0. Lets
+// tests take the parallel paths on single-core machines.
+inline std::atomic<unsigned>& WorkerCountOverride() {
+    static std::atomic<unsigned> count{0};
+    return count;
+}
+
+// Number of workers used by ParallelFor: one per hardware thread.
+inline unsigned WorkerCount() {
+    const unsigned forced = WorkerCountOverride().load(std::memory_order_relaxed);
+    if (forced != 0) {
+        return forced;
+    }
+    const unsigned count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+// Runs body(i) for every i in [0, count), spreading the indices over up to
+// WorkerCount() threads. The calling thread takes part, and the call
+// returns once every index is done. Indices are handed out one at a time,
+// so uneven items balance out on their own.
+template <typename Body>
+void ParallelFor(size_t count, const Body& body) {
+    std::atomic<size_t> next{0};
+    const auto work = [&]() {
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            body(i);
+        }
+    };
+    const size_t helpers = (count < WorkerCount() ? count : WorkerCount()) - (count == 0 ? 0 : 1);
+    std::vector<std::thread> threads;
+    threads.reserve(helpers);
+    for (size_t t = 0; t < helpers; ++t) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,371 @@
+#include "syntax_highlight.h"
+
+#include <algorithm>
+
+#include "background_job.h"
+#include "line_index.h"
+
+namespace {
+
+constexpr size_t kJobCheckMask = 0xFFFF;
+// Longest entity reference colored as one; anything longer is plain text.
+constexpr size_t kMaxEntityBytes = 32;
+
+// Collects spans, merging neighbours of the same kind. Without a target it
+// only tracks state, which is all Build needs.
+class SpanWriter {
+public:
+    explicit SpanWriter(std::vector<SyntaxSpan>* spans) : spans_(spans) {}
+
+    bool active() const {
+        return spans_ != nullptr;
+    }
+
+    void Add(size_t begin, size_t end, SyntaxToken token) {
+        if (!spans_ || begin >= end) {
+            return;
+        }
+        if (!spans_->empty() && spans_->back().token == token && spans_->back().end == begin) {
+            spans_->back().end = static_cast<uint32_t>(end);
+            return;
+        }
+        spans_->push_back(SyntaxSpan{static_cast<uint32_t>(begin), static_cast<uint32_t>(end), token});
+    }
+
+private:
+    std::vector<SyntaxSpan>* spans_;
+};
+
+bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool IsWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || IsDigit(c) || c == '_';
+}
+
+bool IsXmlNameChar(char c) {
+    return IsWordChar(c) || c == ':' || c == '-' || c == '.' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+// ---------------------------------------------------------------------------
+// JSON
+
+enum JsonState : uint8_t {
+    kJsonValue,
+    kJsonInString // A string left open at the end of the previous line.
+};
+
+// One past the closing quote of the string whose body starts at `i`, or
+// npos if it runs past the end of the line.
+size_t FindJsonStringEnd(std::string_view line, size_t i) {
+    while (true) {
+        const size_t stop = line.find_first_of("\"\\", i);
+        if (stop == std::string_view::npos) {
+            return stop;
+        }
+        if (line[stop] == '"') {
+            return stop + 1;
+        }
+        i = stop + 2;
+        if (i > line.size()) {
+            return std::string_view::npos;
+        }
+    }
+}
+
+bool IsJsonPunctuation(char c) {
+    return c == '{' || c == '}' || c == '[' || c == ']' || c == ',' || c == ':';
+}
+
+uint8_t LexJson(std::string_view line, uint8_t state, SpanWriter& out) {
+    size_t i = 0;
+    if (state == kJsonInString) {
+        const size_t end = FindJsonStringEnd(line, 0);
+        if (end == std::string_view::npos) {
+            out.Add(0, line.size(), SyntaxToken::String);
+            return kJsonInString;
+        }
+        out.Add(0, end, SyntaxToken::String);
+        i = end;
+    }
+    while (i < line.size()) {
+        if (!out.active()) {
+            // Only strings carry state across lines.
+            i = line.find('"', i);
+            if (i == std::string_view::npos) {
+                return kJsonValue;
+            }
+        }
+        const char c = line[i];
+        size_t end = i + 1;
+        if (c == '"') {
+            end = FindJsonStringEnd(line, i + 1);
+            if (end == std::string_view::npos) {
+                out.Add(i, line.size(), SyntaxToken::String);
+                return kJsonInString;
+            }
+            size_t next = end;
+            while (next < line.size() && IsSpace(line[next])) {
+                ++next;
+            }
+            out.Add(i, end, next < line.size() && line[next] == ':' ? SyntaxToken::Key : SyntaxToken::String);
+        } else if (IsJsonPunctuation(c)) {
+            out.Add(i, end, SyntaxToken::Punctuation);
+        } else if (c == '-' || IsDigit(c)) {
+            while (end < line.size() && (IsDigit(line[end]) || line[end] == '.' || line[end] == 'e' ||
+                                         line[end] == 'E' || line[end] == '+' || line[end] == '-')) {
+                ++end;
+            }
+            out.Add(i, end, SyntaxToken::Number);
+        } else if (IsWordChar(c)) {
+            while (end < line.size() && IsWordChar(line[end])) {
+                ++end;
+            }
+            const std::string_view word = line.substr(i, end - i);
+            out.Add(i, end,
+                    word == "true" || word == "false" || word == "null" ? SyntaxToken::Literal : SyntaxToken::Text);
+        } else {
+            while (end < line.size() && line[end] != '"' && !IsJsonPunctuation(line[end]) && line[end] != '-' &&
+                   !IsWordChar(line[end])) {
+                ++end;
+            }
+            out.Add(i, end, SyntaxToken::Text);
+        }
+        i = end;
+    }
+    return kJsonValue;
+}
+
+// ---------------------------------------------------------------------------
+// XML
+
+enum XmlState : uint8_t {
+    kXmlText,
+    kXmlTag, // Inside a start or end tag, past its name.
+    kXmlDoubleQuoted,
+    kXmlSingleQuoted,
+    kXmlComment,
+    kXmlCData,
+    kXmlInstruction,
+    kXmlDoctype
+};
+
+bool StartsWith(std::string_view line, size_t i, std::string_view prefix) {
+    return line.compare(i, prefix.size(), prefix) == 0;
+}
+
+uint8_t LexXml(std::string_view line, uint8_t state, SpanWriter& out) {
+    size_t i = 0;
+    while (i < line.size()) {
+        std::string_view terminator;
+        SyntaxToken token = SyntaxToken::Markup;
+        switch (state) {
+            case kXmlComment:
+                terminator = "-->";
+                token = SyntaxToken::Comment;
+                break;
+            case kXmlCData:
+                terminator = "]]>";
+                break;
+            case kXmlInstruction:
+                terminator = "?>";
+                break;
+            case kXmlDoctype:
+                terminator = ">";
+                break;
+            case kXmlDoubleQuoted:
+                terminator = "\"";
+                token = SyntaxToken::String;
+                break;
+            case kXmlSingleQuoted:
+                terminator = "'";
+                token = SyntaxToken::String;
+                break;
+            default:
+                break;
+        }
+        if (!terminator.empty()) {
+            const size_t stop = line.find(terminator, i);
+            if (stop == std::string_view::npos) {
+                out.Add(i, line.size(), token);
+                return state;
+            }
+            const size_t end = stop + terminator.size();
+            out.Add(i, end, token);
+            i = end;
+            state = token == SyntaxToken::String ? kXmlTag : kXmlText;
+            continue;
+        }
+
+        const char c = line[i];
+        size_t end = i + 1;
+        if (state == kXmlTag) {
+            if (c == '>') {
+                out.Add(i, end, SyntaxToken::Tag);
+                state = kXmlText;
+            } else if (c == '/' && end < line.size() && line[end] == '>') {
+                ++end;
+                out.Add(i, end, SyntaxToken::Tag);
+                state = kXmlText;
+            } else if (c == '"' || c == '\'') {
+                out.Add(i, end, SyntaxToken::String);
+                state = c == '"' ? kXmlDoubleQuoted : kXmlSingleQuoted;
+            } else if (c == '=') {
+                out.Add(i, end, SyntaxToken::Punctuation);
+            } else if (IsXmlNameChar(c)) {
+                while (end < line.size() && IsXmlNameChar(line[end])) {
+                    ++end;
+                }
+                out.Add(i, end, SyntaxToken::Attribute);
+            } else {
+                out.Add(i, end, SyntaxToken::Text);
+            }
+            i = end;
+            continue;
+        }
+
+        // Text content.
+        if (c == '<') {
+            if (StartsWith(line, i, "<!--")) {
+                end = i + 4;
+                out.Add(i, end, SyntaxToken::Comment);
+                state = kXmlComment;
+            } else if (StartsWith(line, i, "<![CDATA[")) {
+                end = i + 9;
+                out.Add(i, end, SyntaxToken::Markup);
+                state = kXmlCData;
+            } else if (StartsWith(line, i, "<?")) {
+                end = i + 2;
+                out.Add(i, end, SyntaxToken::Markup);
+                state = kXmlInstruction;
+            } else if (StartsWith(line, i, "<!")) {
+                end = i + 2;
+                out.Add(i, end, SyntaxToken::Markup);
+                state = kXmlDoctype;
+            } else {
+                if (end < line.size() && line[end] == '/') {
+                    ++end;
+                }
+                while (end < line.size() && IsXmlNameChar(line[end])) {
+                    ++end;
+                }
+                out.Add(i, end, SyntaxToken::Tag);
+                state = kXmlTag;
+            }
+        } else if (c == '&' && out.active()) {
+            const size_t semicolon = line.substr(i, kMaxEntityBytes).find(';');
+            end = semicolon == std::string_view::npos ? end : i + semicolon + 1;
+            out.Add(i, end, semicolon == std::string_view::npos ? SyntaxToken::Text : SyntaxToken::Literal);
+        } else {
+            end = line.find_first_of(out.active() ? "<&" : "<", i);
+            if (end == std::string_view::npos) {
+                end = line.size();
+            }
+            out.Add(i, end, SyntaxToken::Text);
+        }
+        i = end;
+    }
+    return state;
+}
+
+uint8_t Lex(SyntaxLanguage language, std::string_view line, uint8_t state, SpanWriter& out) {
+    switch (language) {
+        case SyntaxLanguage::Json:
+            return LexJson(line, state, out);
+        case SyntaxLanguage::Xml:
+            return LexXml(line, state, out);
+        default:
+            out.Add(0, line.size(), SyntaxToken::Text);
+            return 0;
+    }
+}
+
+} // namespace
+
+bool SyntaxIndex::Build(SyntaxLanguage language, std::string_view text, const LineIndex& lines, JobContext* job) {
+    language_ = language;
+    states_.clear();
+    if (language == SyntaxLanguage::Plain) {
+        return true;
+    }
+    const size_t count = lines.line_count();
+    states_.resize(count);
+    SpanWriter none(nullptr);
+    uint8_t state = 0;
+    for (size_t line = 0; line < count; ++line) {
+        if (job && (line & kJobCheckMask) == 0) {
+            job->ReportProgress(lines.LineStart(line));
+            if (job->Cancelled()) {
+                Clear();
+                return false;
+            }
+        }
+        states_[line] = state;
+        state = Lex(language, lines.Line(text, line), state, none);
+    }
+    return true;
+}
+
+size_t SyntaxIndex::Update(std::string_view old_text,
+                           const LineIndex& old_lines,
+                           std::string_view text,
+                           const LineIndex& lines) {
+    if (language_ == SyntaxLanguage::Plain) {
+        return 0;
+    }
+    if (states_.size() != old_lines.line_count() || states_.empty()) {
+        Build(language_, text, lines);
+        return lines.line_count();
+    }
+    const size_t limit = std::min(old_text.size(), text.size());
+    const size_t prefix = static_cast<size_t>(
+        std::mismatch(text.begin(), text.begin() + static_cast<std::ptrdiff_t>(limit), old_text.begin()).first -
+        text.begin());
+    size_t suffix = 0;
+    while (suffix < limit - prefix && old_text[old_text.size() - 1 - suffix] == text[text.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    // Bytes from `changed_end` on are the same as the old text's tail,
+    // shifted by `delta` (wrapping around when the text shrank).
+    const size_t changed_end = text.size() - suffix;
+    const size_t delta = text.size() - old_text.size();
+
+    // The line holding the first change starts at the same offset, with the
+    // same state, in both versions.
+    const size_t first = lines.LineOfOffset(prefix);
+    std::vector<uint8_t> states(states_.begin(), states_.begin() + static_cast<std::ptrdiff_t>(first));
+    states.reserve(lines.line_count());
+    SpanWriter none(nullptr);
+    uint8_t state = states_[first];
+    size_t lexed = 0;
+    for (size_t line = first; line < lines.line_count(); ++line) {
+        const size_t start = lines.LineStart(line);
+        if (line > first && start > changed_end) {
+            const size_t old_line = old_lines.LineOfOffset(start - delta);
+            if (states_[old_line] == state) {
+                states.insert(states.end(), states_.begin() + static_cast<std::ptrdiff_t>(old_line), states_.end());
+                break;
+            }
+        }
+        states.push_back(state);
+        state = Lex(language_, lines.Line(text, line), state, none);
+        ++lexed;
+    }
+    states_ = std::move(states);
+    return lexed;
+}
+
+void SyntaxIndex::Clear() {
+    states_.clear();
+}
+
+void SyntaxIndex::LexLine(size_t line, std::string_view text, std::vector<SyntaxSpan>& spans) const {
+    spans.clear();
+    SpanWriter out(&spans);
+    Lex(language_, text, line < states_.size() ? states_[line] : 0, out);
+}
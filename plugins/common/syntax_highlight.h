@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class JobContext;
+class LineIndex;
+
+enum class SyntaxLanguage : uint8_t {
+    Plain,
+    Json,
+    Xml
+};
+
+enum class SyntaxToken : uint8_t {
+    Text,
+    Punctuation,
+    Key,
+    String,
+    Number,
+    Literal, // JSON true/false/null, XML entity references.
+    Tag,
+    Attribute,
+    Comment,
+    Markup // CDATA sections, processing instructions, DOCTYPE.
+};
+
+// A run of one token kind, as byte columns of a line.
+struct SyntaxSpan {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    SyntaxToken token = SyntaxToken::Text;
+};
+
+// Lexer state at the start of every line of a buffer, one byte per line,
+// built in one pass next to the buffer's LineIndex. Spans are not kept:
+// the viewer lexes just the lines it draws, starting from their recorded
+// state, so drawing costs the visible text only and the index stays far
+// smaller than the text. Tokens that span lines (XML comments, CDATA,
+// tags, unterminated JSON strings) carry over through the state.
+class SyntaxIndex {
+public:
+    // Lexes all of `text`. Returns false if the job was cancelled.
+    bool Build(SyntaxLanguage language, std::string_view text, const LineIndex& lines, JobContext* job = nullptr);
+
+    // Brings the index up to date after `old_text` (indexed by `old_lines`)
+    // was edited into `text`. Lines before the first changed byte keep their
+    // state; lexing resumes at the line holding it and stops at the first
+    // line past the change whose state matches the one it had before the
+    // edit, since everything after it lexes the same. Returns the number
+    // of lines lexed.
+    size_t Update(std::string_view old_text, const LineIndex& old_lines, std::string_view text, const LineIndex& lines);
+
+    void Clear();
+
+    SyntaxLanguage language() const {
+        return language_;
+    }
+
+    bool empty() const {
+        return states_.empty();
+    }
+
+    // Replaces `spans` with the spans covering `text`, which is line `line`
+    // of the indexed buffer or a prefix of it.
+    void LexLine(size_t line, std::string_view text, std::vector<SyntaxSpan>& spans) const;
+
+private:
+    SyntaxLanguage language_ = SyntaxLanguage::Plain;
+    std::vector<uint8_t> states_;
+};
@@ -0,0 +1,82 @@
+#include "text_location.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GTOOLS_LOCATION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Bytes of context kept on each side of the offset in the snippet.
+constexpr size_t kSnippetContext = 40;
+
+bool IsContinuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+size_t CountCodePoints(std::string_view text) {
+    size_t count = 0;
+    for (char c : text) {
+        count += IsContinuation(c) ? 0 : 1;
+    }
+    return count;
+}
+
+// Moves `pos` back to the first byte of the code point it falls in.
+size_t SnapToCodePoint(std::string_view text, size_t pos) {
+    while (pos > 0 && pos < text.size() && IsContinuation(text[pos])) {
+        --pos;
+    }
+    return pos;
+}
+
+} // namespace
+
+size_t CountNewlines(std::string_view text) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    size_t count = 0;
+#if defined(GTOOLS_LOCATION_SSE2)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - p >= 64; p += 64) {
+        const auto mask = [&](int at) {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + at));
+            return static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline))));
+        };
+        count += static_cast<size_t>(std::popcount(mask(0) | mask(16) << 16 | mask(32) << 32 | mask(48) << 48));
+    }
+#endif
+    for (; p < end; ++p) {
+        count += *p == '\n' ? 1 : 0;
+    }
+    return count;
+}
+
+TextLocation LocateOffset(std::string_view text, size_t offset) {
+    TextLocation location;
+    location.offset = std::min(offset, text.size());
+    const std::string_view before = text.substr(0, location.offset);
+    location.line = CountNewlines(before);
+    const size_t newline = before.rfind('\n');
+    const size_t line_start = newline == std::string_view::npos ? 0 : newline + 1;
+    size_t line_end = text.find('\n', location.offset);
+    if (line_end == std::string_view::npos) {
+        line_end = text.size();
+    }
+    location.column = CountCodePoints(text.substr(line_start, location.offset - line_start));
+
+    const size_t context_start = location.offset - std::min(location.offset, kSnippetContext);
+    const size_t from = SnapToCodePoint(text, std::max(line_start, context_start));
+    const size_t to = SnapToCodePoint(text, std::min(line_end, location.offset + kSnippetContext));
+    location.snippet.reserve(to - from);
+    for (size_t i = from; i < to; ++i) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        location.snippet.push_back(c < 0x20 || c == 0x7F ? ' ' : text[i]);
+    }
+    location.snippet_column = CountCodePoints(text.substr(from, location.offset - from));
+    return location;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Where a byte offset falls in a text buffer, for pointing at parse errors.
+struct TextLocation {
+    size_t offset = 0;
+    // Zero-based; column counts UTF-8 code points from the line start.
+    size_t line = 0;
+    size_t column = 0;
+    // Part of the line around the offset, with tabs and control characters
+    // shown as spaces, and the code points in it before the offset.
+    std::string snippet;
+    size_t snippet_column = 0;
+};
+
+// Number of '\n' bytes in `text`, compared 64 at a time on x86-64.
+size_t CountNewlines(std::string_view text);
+
+// Locates `offset` (clamped to the text) without building a LineIndex: one
+// newline count over the bytes before it, then a scan of its own line.
+TextLocation LocateOffset(std::string_view text, size_t offset);
@@ -0,0 +1,187 @@
+#include "text_search.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "background_job.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GTOOLS_SEARCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t kSearchCheckInterval = 1024 * 1024;
+
+char FoldCase(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+char OtherCase(char c) {
+    if (c >= 'a' && c <= 'z') {
+        return static_cast<char>(c - 'a' + 'A');
+    }
+    return c;
+}
+
+class Searcher {
+public:
+    Searcher(std::string_view text, std::string_view needle, bool match_case, JobContext* job)
+        : text_(text), needle_(needle), match_case_(match_case), job_(job) {
+        if (!match_case_) {
+            for (char& c : needle_) {
+                c = FoldCase(c);
+            }
+        }
+    }
+
+    TextSearchResult Run();
+
+private:
+    bool Matches(size_t pos) const {
+        if (match_case_) {
+            return std::memcmp(text_.data() + pos, needle_.data(), needle_.size()) == 0;
+        }
+        for (size_t i = 0; i < needle_.size(); ++i) {
+            if (FoldCase(text_[pos + i]) != needle_[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Confirms the candidate at `pos` and records it unless it overlaps the
+    // previous match.
+    void Candidate(size_t pos) {
+        if (pos < next_allowed_ || !Matches(pos)) {
+            return;
+        }
+        if (result_.matches.size() < kMaxStoredMatches) {
+            result_.matches.push_back(pos);
+        }
+        ++result_.count;
+        next_allowed_ = pos + needle_.size();
+    }
+
+    // Reports progress and returns false if the job was cancelled.
+    bool CheckJob(size_t pos) {
+        next_check_ = pos + kSearchCheckInterval;
+        job_->ReportProgress(pos);
+        if (job_->Cancelled()) {
+            result_.cancelled = true;
+            return false;
+        }
+        return true;
+    }
+
+    size_t ScanBlocks();
+    void ScanTail(size_t pos, size_t last);
+
+    std::string_view text_;
+    std::string needle_;
+    bool match_case_;
+    JobContext* job_;
+    size_t next_allowed_ = 0;
+    size_t next_check_ = 0;
+    TextSearchResult result_;
+};
+
+#if defined(GTOOLS_SEARCH_SSE2)
+
+// Tests 16 candidate starts per step: the first needle byte at p + i and
+// the last one at p + i + n - 1. Returns the first start it did not test.
+size_t Searcher::ScanBlocks() {
+    const size_t n = needle_.size();
+    if (text_.size() < n + 15) {
+        return 0;
+    }
+    const __m128i first_lo = _mm_set1_epi8(needle_.front());
+    const __m128i first_hi = _mm_set1_epi8(match_case_ ? needle_.front() : OtherCase(needle_.front()));
+    const __m128i last_lo = _mm_set1_epi8(needle_.back());
+    const __m128i last_hi = _mm_set1_epi8(match_case_ ? needle_.back() : OtherCase(needle_.back()));
+    const char* data = text_.data();
+    const size_t end = text_.size() - n - 15;
+    size_t pos = 0;
+    for (; pos <= end; pos += 16) {
+        if (job_ && pos >= next_check_ && !CheckJob(pos)) {
+            return text_.size();
+        }
+        const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + n - 1));
+        const __m128i first = _mm_or_si128(_mm_cmpeq_epi8(head, first_lo), _mm_cmpeq_epi8(head, first_hi));
+        const __m128i last = _mm_or_si128(_mm_cmpeq_epi8(tail, last_lo), _mm_cmpeq_epi8(tail, last_hi));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(first, last)));
+        while (mask != 0) {
+            Candidate(pos + static_cast<size_t>(std::countr_zero(mask)));
+            mask &= mask - 1;
+        }
+    }
+    return pos;
+}
+
+#else
+
+// First-byte filter with memchr; only usable when the byte has one case.
+size_t Searcher::ScanBlocks() {
+    const char first = needle_.front();
+    if (!match_case_ && OtherCase(first) != first) {
+        return 0;
+    }
+    const char* data = text_.data();
+    const size_t last = text_.size() - needle_.size();
+    size_t pos = 0;
+    while (pos <= last) {
+        if (job_ && pos >= next_check_ && !CheckJob(pos)) {
+            return text_.size();
+        }
+        const size_t window = std::min(last + 1 - pos, kSearchCheckInterval);
+        const void* hit = std::memchr(data + pos, first, window);
+        if (!hit) {
+            pos += window;
+            continue;
+        }
+        const size_t found = static_cast<size_t>(static_cast<const char*>(hit) - data);
+        Candidate(found);
+        pos = found + 1;
+    }
+    return pos;
+}
+
+#endif
+
+void Searcher::ScanTail(size_t pos, size_t last) {
+    const char first = needle_.front();
+    for (; pos <= last; ++pos) {
+        if (job_ && pos >= next_check_ && !CheckJob(pos)) {
+            return;
+        }
+        const char c = match_case_ ? text_[pos] : FoldCase(text_[pos]);
+        if (c == first) {
+            Candidate(pos);
+        }
+    }
+}
+
+TextSearchResult Searcher::Run() {
+    if (needle_.empty() || needle_.size() > text_.size()) {
+        return result_;
+    }
+    const size_t pos = ScanBlocks();
+    if (!result_.cancelled) {
+        ScanTail(pos, text_.size() - needle_.size());
+    }
+    if (job_ && !result_.cancelled) {
+        job_->ReportProgress(text_.size());
+    }
+    return result_;
+}
+
+} // namespace
+
+TextSearchResult FindText(std::string_view text, std::string_view needle, bool match_case, JobContext* job) {
+    return Searcher(text, needle, match_case, job).Run();
+}
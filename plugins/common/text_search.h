@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+class JobContext;
+
+struct TextSearchResult {
+    // Start offsets of the first kMaxStoredMatches matches, in order.
+    std::vector<size_t> matches;
+    // All matches, including the ones past the stored limit.
+    size_t count = 0;
+    bool cancelled = false;
+};
+
+// Past this many matches only the count is kept, so a one-letter needle
+// over a 100 MB buffer does not allocate gigabytes of offsets.
+constexpr size_t kMaxStoredMatches = 4 * 1024 * 1024;
+
+// Finds the non-overlapping occurrences of `needle` in `text`. Candidates
+// are found by comparing the needle's first and last byte against 16
+// positions at a time and confirmed with a full compare. Without
+// `match_case`, ASCII letters match either case; other bytes are compared
+// as-is.
+TextSearchResult FindText(std::string_view text, std::string_view needle, bool match_case, JobContext* job = nullptr);
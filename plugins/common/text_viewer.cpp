@@ -0,0 +1,364 @@
+#include "text_viewer.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+namespace {
+
+// Longer lines are cut when drawn; laying out a multi-megabyte single line
+// every frame would defeat the clipping.
+constexpr size_t kMaxDrawnLineBytes = 16 * 1024;
+
+const ImVec4 kCurrentMatchColor(1.0f, 0.6f, 0.0f, 0.55f);
+const ImVec4 kMarkColor(0.9f, 0.2f, 0.2f, 0.7f);
+
+// Moves `pos` back to the first byte of the UTF-8 sequence it falls in.
+size_t CodePointStart(std::string_view text, size_t pos) {
+    while (pos > 0 && pos < text.size() && (static_cast<unsigned char>(text[pos]) & 0xC0) == 0x80) {
+        --pos;
+    }
+    return pos;
+}
+
+ImU32 TokenColor(SyntaxToken token) {
+    switch (token) {
+        case SyntaxToken::Punctuation:
+            return ImGui::GetColorU32(ImVec4(0.75f, 0.75f, 0.75f, 1.0f));
+        case SyntaxToken::Key:
+        case SyntaxToken::Attribute:
+            return ImGui::GetColorU32(ImVec4(0.61f, 0.86f, 1.0f, 1.0f));
+        case SyntaxToken::String:
+            return ImGui::GetColorU32(ImVec4(0.81f, 0.57f, 0.47f, 1.0f));
+        case SyntaxToken::Number:
+            return ImGui::GetColorU32(ImVec4(0.71f, 0.81f, 0.66f, 1.0f));
+        case SyntaxToken::Literal:
+        case SyntaxToken::Tag:
+            return ImGui::GetColorU32(ImVec4(0.34f, 0.61f, 0.84f, 1.0f));
+        case SyntaxToken::Comment:
+            return ImGui::GetColorU32(ImVec4(0.42f, 0.60f, 0.33f, 1.0f));
+        case SyntaxToken::Markup:
+            return ImGui::GetColorU32(ImVec4(0.77f, 0.53f, 0.75f, 1.0f));
+        default:
+            return ImGui::GetColorU32(ImGuiCol_Text);
+    }
+}
+
+} // namespace
+
+void TextViewer::SetLanguage(SyntaxLanguage language) {
+    if (language == language_) {
+        return;
+    }
+    language_ = language;
+    syntax_.Build(language_, text_, lines_);
+    has_edit_snapshot_ = false;
+}
+
+void TextViewer::SetText(std::string_view text) {
+    LineIndex lines;
+    lines.Build(text);
+    SyntaxIndex syntax;
+    if (language_ != SyntaxLanguage::Plain) {
+        if (has_edit_snapshot_ && syntax_.language() == language_) {
+            syntax = std::move(syntax_);
+            syntax.Update(edit_snapshot_, lines_, text, lines);
+        } else {
+            syntax.Build(language_, text, lines);
+        }
+        edit_snapshot_.assign(text);
+        has_edit_snapshot_ = true;
+    }
+    Show(text, std::move(lines), std::move(syntax));
+    source_ = SharedText();
+}
+
+void TextViewer::SetText(std::string_view text, LineIndex lines) {
+    SyntaxIndex syntax;
+    syntax.Build(language_, text, lines);
+    Show(text, std::move(lines), std::move(syntax));
+    source_ = SharedText();
+    has_edit_snapshot_ = false;
+}
+
+void TextViewer::SetText(SharedText text, LineIndex lines) {
+    SetText(text.view(), std::move(lines));
+    source_ = std::move(text);
+}
+
+void TextViewer::SetText(SharedText text, LineIndex lines, SyntaxIndex syntax) {
+    Show(text.view(), std::move(lines), std::move(syntax));
+    source_ = std::move(text);
+    has_edit_snapshot_ = false;
+}
+
+void TextViewer::Clear() {
+    Show({}, LineIndex(), SyntaxIndex());
+    ClearMark();
+    source_ = SharedText();
+    has_edit_snapshot_ = false;
+    edit_snapshot_.clear();
+    edit_snapshot_.shrink_to_fit();
+}
+
+void TextViewer::Show(std::string_view text, LineIndex lines, SyntaxIndex syntax) {
+    text_ = text;
+    lines_ = std::move(lines);
+    syntax_ = std::move(syntax);
+    pending_scroll_line_ = kNoPendingScroll;
+    ResetSearch();
+}
+
+void TextViewer::ScrollToLine(size_t line) {
+    pending_scroll_line_ = line;
+}
+
+void TextViewer::MarkOffset(size_t offset) {
+    mark_ = offset;
+    mark_scroll_pending_ = true;
+    mark_scroll_x_pending_ = true;
+}
+
+void TextViewer::ClearMark() {
+    mark_ = kNoMark;
+    mark_scroll_pending_ = false;
+    mark_scroll_x_pending_ = false;
+}
+
+void TextViewer::Render(const char* id) {
+    ImGui::PushID(id);
+    const size_t line_count = lines_.line_count();
+
+    ImGui::SetNextItemWidth(120.0f);
+    ImGui::InputInt("##JumpLine", &jump_line_);
+    ImGui::SameLine();
+    if (ImGui::Button("Go to line") && line_count > 0) {
+        const size_t target = static_cast<size_t>(std::max(jump_line_, 1)) - 1;
+        ScrollToLine(std::min(target, line_count - 1));
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("%zu lines", line_count);
+    RenderFindBar();
+
+    ImGui::BeginChild("Lines", ImVec2(-1.0f, -1.0f), true, ImGuiWindowFlags_HorizontalScrollbar);
+    const float line_height = ImGui::GetTextLineHeightWithSpacing();
+    if (mark_scroll_pending_ && line_count > 0) {
+        pending_scroll_line_ = lines_.LineOfOffset(mark_);
+        mark_scroll_pending_ = false;
+    }
+    if (pending_scroll_line_ != kNoPendingScroll) {
+        ImGui::SetScrollY(static_cast<float>(pending_scroll_line_) * line_height);
+        pending_scroll_line_ = kNoPendingScroll;
+    }
+
+    const int gutter_width = std::snprintf(nullptr, 0, "%zu", line_count);
+
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(line_count), line_height);
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const size_t line = static_cast<size_t>(i);
+            ImGui::TextDisabled("%*zu", gutter_width, line + 1);
+            ImGui::SameLine();
+            const size_t line_start = lines_.LineStart(line);
+            const std::string_view text = lines_.Line(text_, line);
+            // A mark deep into a long line moves the drawn window to it.
+            size_t skipped = 0;
+            if (mark_ != kNoMark && mark_ >= line_start && mark_ <= line_start + text.size() &&
+                mark_ - line_start > kMaxDrawnLineBytes / 2) {
+                skipped = CodePointStart(text, mark_ - line_start - kMaxDrawnLineBytes / 2);
+                ImGui::TextDisabled("...");
+                ImGui::SameLine();
+            }
+            const std::string_view drawn = text.substr(skipped, kMaxDrawnLineBytes);
+            HighlightMatches(line_start + skipped, drawn);
+            HighlightMark(line_start + skipped, drawn);
+            if (skipped > 0) {
+                // The lexer state is only known at line starts.
+                ImGui::TextUnformatted(drawn.data(), drawn.data() + drawn.size());
+            } else {
+                DrawLine(line, drawn);
+            }
+            if (text.size() > skipped + kMaxDrawnLineBytes) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("...");
+            }
+        }
+    }
+    clipper.End();
+    ImGui::EndChild();
+    ImGui::PopID();
+}
+
+void TextViewer::DrawLine(size_t line, std::string_view drawn) {
+    if (syntax_.empty()) {
+        ImGui::TextUnformatted(drawn.data(), drawn.data() + drawn.size());
+        return;
+    }
+    syntax_.LexLine(line, drawn, spans_);
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    float x = origin.x;
+    for (const SyntaxSpan& span : spans_) {
+        const char* begin = drawn.data() + span.begin;
+        const char* end = drawn.data() + span.end;
+        draw_list->AddText(ImVec2(x, origin.y), TokenColor(span.token), begin, end);
+        x += ImGui::CalcTextSize(begin, end).x;
+    }
+    ImGui::Dummy(ImVec2(x - origin.x, ImGui::GetTextLineHeight()));
+}
+
+void TextViewer::RenderFindBar() {
+    ImGui::SetNextItemWidth(240.0f);
+    const bool enter = ImGui::InputTextWithHint("##Find", "Find", find_buf_, sizeof(find_buf_),
+                                                ImGuiInputTextFlags_EnterReturnsTrue);
+    if (enter) {
+        // Keep typing focus in the field so Enter can be pressed repeatedly.
+        ImGui::SetKeyboardFocusHere(-1);
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Match case", &match_case_);
+    if (searched_ != find_buf_ || searched_match_case_ != match_case_) {
+        StartSearch();
+    }
+
+    if (auto finished = search_.TakeResult()) {
+        matches_ = std::move(finished->matches);
+        match_count_ = finished->count;
+        current_match_ = 0;
+        if (!matches_.empty()) {
+            ScrollToLine(lines_.LineOfOffset(matches_[0]));
+        }
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Prev")) {
+        StepMatch(false);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Next") || enter) {
+        StepMatch(true);
+    }
+    char status[96] = "";
+    if (search_.Running()) {
+        std::snprintf(status, sizeof(status), "Searching... %.0f%%", search_.Fraction() * 100.0f);
+    } else if (searched_.empty()) {
+    } else if (match_count_ == 0) {
+        std::snprintf(status, sizeof(status), "%s", "No matches");
+    } else if (match_count_ > matches_.size()) {
+        std::snprintf(status, sizeof(status), "%zu of %zu (first %zu reachable)", current_match_ + 1, match_count_,
+                      matches_.size());
+    } else {
+        std::snprintf(status, sizeof(status), "%zu of %zu", current_match_ + 1, match_count_);
+    }
+    if (status[0] != '\0') {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", status);
+    }
+}
+
+void TextViewer::StartSearch() {
+    searched_ = find_buf_;
+    searched_match_case_ = match_case_;
+    matches_.clear();
+    match_count_ = 0;
+    current_match_ = 0;
+    if (searched_.empty() || text_.empty()) {
+        search_.Cancel();
+        return;
+    }
+    // Borrowed text may change under the worker; search a snapshot of it.
+    SharedText source = source_.view().empty() ? SharedText::Own(std::string(text_)) : source_;
+    search_.Start(text_.size(), [source, needle = searched_, match_case = match_case_](JobContext& job) {
+        return FindText(source.view(), needle, match_case, &job);
+    });
+}
+
+void TextViewer::ResetSearch() {
+    search_.Cancel();
+    searched_.clear();
+    matches_.clear();
+    match_count_ = 0;
+    current_match_ = 0;
+}
+
+void TextViewer::StepMatch(bool forward) {
+    if (matches_.empty()) {
+        return;
+    }
+    if (forward) {
+        current_match_ = current_match_ + 1 < matches_.size() ? current_match_ + 1 : 0;
+    } else {
+        current_match_ = current_match_ > 0 ? current_match_ - 1 : matches_.size() - 1;
+    }
+    ScrollToLine(lines_.LineOfOffset(matches_[current_match_]));
+}
+
+void TextViewer::HighlightMatches(size_t line_start, std::string_view drawn) {
+    if (matches_.empty()) {
+        return;
+    }
+    const size_t line_end = line_start + drawn.size();
+    auto it = std::lower_bound(matches_.begin(), matches_.end(), line_start);
+    if (it == matches_.end() || *it >= line_end) {
+        return;
+    }
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float height = ImGui::GetTextLineHeight();
+    const ImU32 match_color = ImGui::GetColorU32(ImGuiCol_TextSelectedBg);
+    const ImU32 current_color = ImGui::GetColorU32(kCurrentMatchColor);
+    // Measure left to right so each byte of the line is measured once.
+    float x = origin.x;
+    size_t measured = 0;
+    for (; it != matches_.end() && *it < line_end; ++it) {
+        const size_t column = *it - line_start;
+        const size_t length = std::min(searched_.size(), drawn.size() - column);
+        x += ImGui::CalcTextSize(drawn.data() + measured, drawn.data() + column).x;
+        const float width = ImGui::CalcTextSize(drawn.data() + column, drawn.data() + column + length).x;
+        const bool current = static_cast<size_t>(it - matches_.begin()) == current_match_;
+        draw_list->AddRectFilled(ImVec2(x, origin.y), ImVec2(x + width, origin.y + height),
+                                 current ? current_color : match_color);
+        x += width;
+        measured = column + length;
+    }
+}
+
+void TextViewer::HighlightMark(size_t line_start, std::string_view drawn) {
+    if (mark_ == kNoMark || mark_ < line_start || mark_ > line_start + drawn.size()) {
+        return;
+    }
+    const size_t column = mark_ - line_start;
+    size_t end = column + 1;
+    while (end < drawn.size() && (static_cast<unsigned char>(drawn[end]) & 0xC0) == 0x80) {
+        ++end;
+    }
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float x = origin.x + ImGui::CalcTextSize(drawn.data(), drawn.data() + column).x;
+    // Past the end of the line the mark covers one blank cell.
+    const float width = column < drawn.size() ? ImGui::CalcTextSize(drawn.data() + column, drawn.data() + end).x
+                                              : ImGui::CalcTextSize(" ").x;
+    ImGui::GetWindowDrawList()->AddRectFilled(ImVec2(x, origin.y),
+                                              ImVec2(x + width, origin.y + ImGui::GetTextLineHeight()),
+                                              ImGui::GetColorU32(kMarkColor));
+    if (mark_scroll_x_pending_) {
+        const float visible_x = x - ImGui::GetWindowPos().x;
+        ImGui::SetScrollX(std::max(0.0f, ImGui::GetScrollX() + visible_x - ImGui::GetWindowWidth() * 0.5f));
+        mark_scroll_x_pending_ = false;
+    }
+}
+
+bool RenderTextLocation(const char* id, const TextLocation& location) {
+    ImGui::PushID(id);
+    char label[96];
+    std::snprintf(label, sizeof(label), "Go to line %zu, column %zu", location.line + 1, location.column + 1);
+    const bool pressed = ImGui::SmallButton(label);
+    if (!location.snippet.empty()) {
+        ImGui::TextDisabled("%s", location.snippet.c_str());
+        ImGui::TextDisabled("%*s^", static_cast<int>(location.snippet_column), "");
+    }
+    ImGui::PopID();
+    return pressed;
+}
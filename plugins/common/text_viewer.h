@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "background_job.h"
+#include "line_index.h"
+#include "mapped_file.h"
+#include "syntax_highlight.h"
+#include "text_location.h"
+#include "text_search.h"
+
+// Read-only text view that lays out only the visible lines. The text is
+// addressed through a LineIndex and drawn with ImGuiListClipper, so the
+// per-frame cost depends on the window height, not the buffer size.
+//
+// The find bar searches the whole buffer on a background thread and keeps
+// the match offsets; visible matches are highlighted and Next/Prev map the
+// offset to a line through the index, so jumping costs a binary search.
+//
+// With a language set, lines are colored from a SyntaxIndex kept next to
+// the LineIndex; only the drawn lines are lexed each frame.
+class TextViewer {
+public:
+    // Colors text from the next SetText on; Plain turns coloring off.
+    void SetLanguage(SyntaxLanguage language);
+
+    // Shows `text`, which must stay alive until the next SetText/Clear.
+    // Searching it snapshots the buffer first. Calling it again with an
+    // edited version of the same buffer re-lexes only from the first
+    // changed line on, against a copy of the previous text.
+    void SetText(std::string_view text);
+    // Same, reusing an index that was already built for `text`.
+    void SetText(std::string_view text, LineIndex lines);
+    // Shows text the viewer shares ownership of; searches read it in place.
+    void SetText(SharedText text, LineIndex lines);
+    // Same, with a syntax index built off the UI thread. Its language wins
+    // over SetLanguage, so output that is not in the viewer's language
+    // (hex dumps, say) can come with a Plain index.
+    void SetText(SharedText text, LineIndex lines, SyntaxIndex syntax);
+    void Clear();
+
+    void ScrollToLine(size_t line);
+    // Marks byte `offset` and scrolls it into view, horizontally too. The
+    // line is found through the index once one is set, so this may be
+    // called before the text arrives. The mark stays until ClearMark or
+    // Clear; a long line holding it is drawn from around the mark instead
+    // of from its start.
+    void MarkOffset(size_t offset);
+    void ClearMark();
+    void Render(const char* id);
+
+    std::string_view text() const {
+        return text_;
+    }
+
+    const LineIndex& lines() const {
+        return lines_;
+    }
+
+private:
+    static constexpr size_t kNoPendingScroll = static_cast<size_t>(-1);
+    static constexpr size_t kNoMark = static_cast<size_t>(-1);
+
+    void Show(std::string_view text, LineIndex lines, SyntaxIndex syntax);
+    void DrawLine(size_t line, std::string_view drawn);
+    void RenderFindBar();
+    void StartSearch();
+    void ResetSearch();
+    void StepMatch(bool forward);
+    void HighlightMatches(size_t line_start, std::string_view drawn);
+    void HighlightMark(size_t line_start, std::string_view drawn);
+
+    std::string_view text_;
+    SharedText source_;
+    LineIndex lines_;
+    SyntaxLanguage language_ = SyntaxLanguage::Plain;
+    SyntaxIndex syntax_;
+    // The text as of the last SetText(text), for incremental re-lexing.
+    std::string edit_snapshot_;
+    bool has_edit_snapshot_ = false;
+    std::vector<SyntaxSpan> spans_;
+    size_t pending_scroll_line_ = kNoPendingScroll;
+    int jump_line_ = 1;
+    size_t mark_ = kNoMark;
+    bool mark_scroll_pending_ = false;
+    bool mark_scroll_x_pending_ = false;
+
+    char find_buf_[256] = "";
+    bool match_case_ = false;
+    // Needle and case mode of the last search started, so edits restart it.
+    std::string searched_;
+    bool searched_match_case_ = false;
+    BackgroundJob<TextSearchResult> search_;
+    std::vector<size_t> matches_;
+    size_t match_count_ = 0;
+    size_t current_match_ = 0;
+};
+
+// Draws a "Go to line L, column C" button for an error location with the
+// snippet around it and a caret under the error. Returns true when the
+// button is pressed.
+bool RenderTextLocation(const char* id, const TextLocation& location);
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "background_job.h"
+
+// Building blocks shared by the structural diffs of the formatter plugins.
+// Each format hashes its subtrees bottom-up with MixHash/CombineHash, then
+// walks both trees from the roots with RunTreeDiff, descending only into
+// pairs whose hashes differ.
+
+// splitmix64 finalizer.
+inline uint64_t MixHash(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint64_t CombineHash(uint64_t seed, uint64_t value) {
+    return MixHash(seed ^ (value + 0x9E3779B97F4A7C15ULL + (seed << 6) + (seed >> 2)));
+}
+
+enum class TreeDiffAction : uint8_t {
+    Compare,
+    Added,
+    Removed
+};
+
+// One piece of pending work. `left` or `right` is UINT32_MAX for a node
+// that exists on one side only.
+struct TreeDiffItem {
+    TreeDiffAction action = TreeDiffAction::Compare;
+    uint32_t left = UINT32_MAX;
+    uint32_t right = UINT32_MAX;
+    std::string path;
+};
+
+// Pushes `found`, which is in document order, onto the work stack so that
+// its first item is popped first.
+inline void PushInDocumentOrder(std::vector<TreeDiffItem>& found, std::vector<TreeDiffItem>& items) {
+    for (auto it = found.rbegin(); it != found.rend(); ++it) {
+        items.push_back(std::move(*it));
+    }
+}
+
+// Children [prefix, left_stop) and [prefix, right_stop) are what is left
+// once the runs of equal children at both ends are trimmed.
+struct TreeDiffTrim {
+    size_t prefix = 0;
+    size_t left_stop = 0;
+    size_t right_stop = 0;
+
+    bool empty() const {
+        return prefix == left_stop && prefix == right_stop;
+    }
+};
+
+template <typename LeftHash, typename RightHash>
+TreeDiffTrim TrimEqualEnds(const std::vector<uint32_t>& left,
+                           const std::vector<uint32_t>& right,
+                           const LeftHash& left_hash,
+                           const RightHash& right_hash) {
+    TreeDiffTrim trim;
+    while (trim.prefix < left.size() && trim.prefix < right.size() &&
+           left_hash(left[trim.prefix]) == right_hash(right[trim.prefix])) {
+        ++trim.prefix;
+    }
+    trim.left_stop = left.size();
+    trim.right_stop = right.size();
+    while (trim.left_stop > trim.prefix && trim.right_stop > trim.prefix &&
+           left_hash(left[trim.left_stop - 1]) == right_hash(right[trim.right_stop - 1])) {
+        --trim.left_stop;
+        --trim.right_stop;
+    }
+    return trim;
+}
+
+// Pairs the trimmed children by position: the overlap is compared and the
+// rest of the longer side is removed or added. `left_path(k)` and
+// `right_path(k)` give the path of child k on each side.
+template <typename LeftPath, typename RightPath>
+void PushPositionalPairs(const std::vector<uint32_t>& left,
+                         const std::vector<uint32_t>& right,
+                         const TreeDiffTrim& trim,
+                         const LeftPath& left_path,
+                         const RightPath& right_path,
+                         std::vector<TreeDiffItem>& items) {
+    std::vector<TreeDiffItem> found;
+    size_t i = trim.prefix;
+    for (; i < trim.left_stop && i < trim.right_stop; ++i) {
+        found.push_back(TreeDiffItem{TreeDiffAction::Compare, left[i], right[i], left_path(i)});
+    }
+    for (size_t k = i; k < trim.left_stop; ++k) {
+        found.push_back(TreeDiffItem{TreeDiffAction::Removed, left[k], UINT32_MAX, left_path(k)});
+    }
+    for (size_t k = i; k < trim.right_stop; ++k) {
+        found.push_back(TreeDiffItem{TreeDiffAction::Added, UINT32_MAX, right[k], right_path(k)});
+    }
+    PushInDocumentOrder(found, items);
+}
+
+// Walks the two trees from their roots with an explicit stack, so deep
+// documents cannot overflow the call stack, and hands the differences out
+// in document order. `compare(left, right, path, items)` handles a pair of
+// nodes: it reports changes itself and pushes work for their children.
+// `report(action, left, right, path)` gets the added and removed nodes.
+// Returns false if the job was cancelled.
+template <typename Compare, typename Report>
+bool RunTreeDiff(uint32_t left_root, uint32_t right_root, JobContext* job, Compare&& compare, Report&& report) {
+    constexpr size_t kJobCheckMask = 0xFFFF;
+    std::vector<TreeDiffItem> items;
+    items.push_back(TreeDiffItem{TreeDiffAction::Compare, left_root, right_root, std::string()});
+    size_t steps = 0;
+    while (!items.empty()) {
+        if (job && (++steps & kJobCheckMask) == 0 && job->Cancelled()) {
+            return false;
+        }
+        TreeDiffItem item = std::move(items.back());
+        items.pop_back();
+        if (item.action == TreeDiffAction::Compare) {
+            compare(item.left, item.right, item.path, items);
+        } else {
+            report(item.action, item.left, item.right, std::move(item.path));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,1015 @@
+#include "json_binary.h"
+
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+#include "background_job.h"
+#include "json_lexing.h"
+#include "json_tape.h"
+#include "output_sink.h"
+
+namespace {
+
+constexpr uint32_t kJobCheckMask = 0xFFFF;
+
+constexpr char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// ---------------------------------------------------------------------------
+// Encoding
+
+// First pass: one item count per container, in document order.
+class ContainerCounter : public JsonEventHandler {
+public:
+    explicit ContainerCounter(std::vector<uint32_t>& counts) : counts_(counts) {}
+
+    void Key(std::string_view, size_t) override {
+        ++counts_[open_.back().index];
+    }
+
+    void Value(JsonKind kind, std::string_view, size_t) override {
+        if (!open_.empty() && !open_.back().object) {
+            ++counts_[open_.back().index];
+        }
+        if (kind == JsonKind::Object || kind == JsonKind::Array) {
+            open_.push_back(Open{static_cast<uint32_t>(counts_.size()), kind == JsonKind::Object});
+            counts_.push_back(0);
+        }
+    }
+
+    void Close(size_t) override {
+        open_.pop_back();
+    }
+
+    size_t memory() const {
+        return open_.capacity() * sizeof(Open);
+    }
+
+private:
+    struct Open {
+        uint32_t index;
+        bool object;
+    };
+
+    std::vector<uint32_t>& counts_;
+    std::vector<Open> open_;
+};
+
+// Second pass: writes every event as it arrives. Container headers take
+// their sizes from the counts of the first pass.
+class BinaryWriter : public JsonEventHandler {
+public:
+    BinaryWriter(BinaryFormat format, const std::vector<uint32_t>& counts, OutputSink& out)
+        : format_(format), counts_(counts), out_(out) {}
+
+    void Key(std::string_view token, size_t offset) override {
+        WriteString(token, offset);
+    }
+
+    void Value(JsonKind kind, std::string_view token, size_t offset) override {
+        switch (kind) {
+            case JsonKind::Object:
+                WriteContainer(true, counts_[next_container_++]);
+                break;
+            case JsonKind::Array:
+                WriteContainer(false, counts_[next_container_++]);
+                break;
+            case JsonKind::String:
+                WriteString(token, offset);
+                break;
+            case JsonKind::Number:
+                WriteNumber(token, offset);
+                break;
+            case JsonKind::True:
+                Byte(format_ == BinaryFormat::Cbor ? 0xF5 : 0xC3);
+                break;
+            case JsonKind::False:
+                Byte(format_ == BinaryFormat::Cbor ? 0xF4 : 0xC2);
+                break;
+            case JsonKind::Null:
+                Byte(format_ == BinaryFormat::Cbor ? 0xF6 : 0xC0);
+                break;
+        }
+    }
+
+    void Close(size_t) override {}
+
+    // The first number that has no binary form, if any. Events cannot be
+    // stopped, so later output is garbage and gets discarded by the caller.
+    bool failed() const {
+        return failed_;
+    }
+
+    size_t error_offset() const {
+        return error_offset_;
+    }
+
+    size_t written() const {
+        return written_;
+    }
+
+    size_t memory() const {
+        return scratch_.capacity();
+    }
+
+private:
+    void Byte(unsigned value) {
+        out_.Put(static_cast<char>(value));
+        ++written_;
+    }
+
+    void BigEndian(uint64_t value, int bytes) {
+        char buffer[8];
+        for (int i = 0; i < bytes; ++i) {
+            buffer[i] = static_cast<char>(value >> (8 * (bytes - 1 - i)));
+        }
+        out_.Append(std::string_view(buffer, static_cast<size_t>(bytes)));
+        written_ += static_cast<size_t>(bytes);
+    }
+
+    void Bytes(std::string_view bytes) {
+        out_.Append(bytes);
+        written_ += bytes.size();
+    }
+
+    void CborHead(unsigned major, uint64_t value) {
+        major <<= 5;
+        if (value < 24) {
+            Byte(major | static_cast<unsigned>(value));
+        } else if (value <= 0xFF) {
+            Byte(major | 24);
+            BigEndian(value, 1);
+        } else if (value <= 0xFFFF) {
+            Byte(major | 25);
+            BigEndian(value, 2);
+        } else if (value <= 0xFFFFFFFF) {
+            Byte(major | 26);
+            BigEndian(value, 4);
+        } else {
+            Byte(major | 27);
+            BigEndian(value, 8);
+        }
+    }
+
+    // MessagePack's fixed forms, then the 16- and 32-bit length forms.
+    void PackLength(unsigned fixed, size_t fixed_limit, unsigned first_wide, uint64_t value) {
+        if (value <= fixed_limit) {
+            Byte(fixed | static_cast<unsigned>(value));
+        } else if (value <= 0xFFFF) {
+            Byte(first_wide);
+            BigEndian(value, 2);
+        } else {
+            Byte(first_wide + 1);
+            BigEndian(value, 4);
+        }
+    }
+
+    void WriteContainer(bool object, uint32_t count) {
+        if (format_ == BinaryFormat::Cbor) {
+            CborHead(object ? 5 : 4, count);
+        } else if (object) {
+            PackLength(0x80, 15, 0xDE, count);
+        } else {
+            PackLength(0x90, 15, 0xDC, count);
+        }
+    }
+
+    void WriteString(std::string_view token, size_t) {
+        std::string_view text = token.substr(1, token.size() - 2);
+        if (text.find('\\') != std::string_view::npos) {
+            DecodeJsonString(text, scratch_);
+            text = scratch_;
+        }
+        if (format_ == BinaryFormat::Cbor) {
+            CborHead(3, text.size());
+        } else if (text.size() <= 31) {
+            Byte(0xA0 | static_cast<unsigned>(text.size()));
+        } else if (text.size() <= 0xFF) {
+            Byte(0xD9);
+            BigEndian(text.size(), 1);
+        } else {
+            PackLength(0xA0, 0, 0xDA, text.size());
+        }
+        Bytes(text);
+    }
+
+    void WriteUnsigned(uint64_t value) {
+        if (format_ == BinaryFormat::Cbor) {
+            CborHead(0, value);
+        } else if (value <= 0x7F) {
+            Byte(static_cast<unsigned>(value));
+        } else if (value <= 0xFF) {
+            Byte(0xCC);
+            BigEndian(value, 1);
+        } else if (value <= 0xFFFF) {
+            Byte(0xCD);
+            BigEndian(value, 2);
+        } else if (value <= 0xFFFFFFFF) {
+            Byte(0xCE);
+            BigEndian(value, 4);
+        } else {
+            Byte(0xCF);
+            BigEndian(value, 8);
+        }
+    }
+
+    void WriteNegative(int64_t value) {
+        if (format_ == BinaryFormat::Cbor) {
+            CborHead(1, static_cast<uint64_t>(-(value + 1)));
+        } else if (value >= -32) {
+            Byte(static_cast<unsigned>(static_cast<uint8_t>(value)));
+        } else if (value >= INT8_MIN) {
+            Byte(0xD0);
+            BigEndian(static_cast<uint64_t>(value), 1);
+        } else if (value >= INT16_MIN) {
+            Byte(0xD1);
+            BigEndian(static_cast<uint64_t>(value), 2);
+        } else if (value >= INT32_MIN) {
+            Byte(0xD2);
+            BigEndian(static_cast<uint64_t>(value), 4);
+        } else {
+            Byte(0xD3);
+            BigEndian(static_cast<uint64_t>(value), 8);
+        }
+    }
+
+    void WriteNumber(std::string_view token, size_t offset) {
+        const char* begin = token.data();
+        const char* end = begin + token.size();
+        if (token.find_first_of(".eE") == std::string_view::npos) {
+            if (token[0] == '-') {
+                int64_t value = 0;
+                if (std::from_chars(begin, end, value).ec == std::errc()) {
+                    if (value < 0) {
+                        WriteNegative(value);
+                    } else {
+                        WriteUnsigned(0);
+                    }
+                    return;
+                }
+            } else {
+                uint64_t value = 0;
+                if (std::from_chars(begin, end, value).ec == std::errc()) {
+                    WriteUnsigned(value);
+                    return;
+                }
+            }
+        }
+        double value = 0.0;
+        const std::errc ec = std::from_chars(begin, end, value).ec;
+        if (ec == std::errc::result_out_of_range && JsonNumberMagnitude(token) <= 0) {
+            // Too small for a subnormal: rounds to zero, as JSON parsers do.
+            value = token[0] == '-' ? -0.0 : 0.0;
+        } else if (ec != std::errc()) {
+            if (!failed_) {
+                failed_ = true;
+                error_offset_ = offset;
+            }
+            return;
+        }
+        const bool single = std::fabs(value) <= FLT_MAX && static_cast<double>(static_cast<float>(value)) == value;
+        if (single) {
+            const float narrow = static_cast<float>(value);
+            uint32_t bits = 0;
+            std::memcpy(&bits, &narrow, sizeof(bits));
+            Byte(format_ == BinaryFormat::Cbor ? 0xFA : 0xCA);
+            BigEndian(bits, 4);
+        } else {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(bits));
+            Byte(format_ == BinaryFormat::Cbor ? 0xFB : 0xCB);
+            BigEndian(bits, 8);
+        }
+    }
+
+    BinaryFormat format_;
+    const std::vector<uint32_t>& counts_;
+    OutputSink& out_;
+    size_t next_container_ = 0;
+    size_t written_ = 0;
+    std::string scratch_;
+    bool failed_ = false;
+    size_t error_offset_ = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Decoding
+
+class BinaryDecoder {
+public:
+    BinaryDecoder(std::string_view bytes,
+                  BinaryFormat format,
+                  const JsonFormatOptions& options,
+                  bool minified,
+                  OutputSink& out,
+                  JobContext* job)
+        : bytes_(bytes),
+          format_(format),
+          indent_(minified || options.indent < 0 ? 0 : static_cast<size_t>(options.indent)),
+          minified_(minified),
+          out_(out),
+          job_(job) {}
+
+    JsonFormatResult Run();
+
+    size_t memory() const {
+        return frames_.capacity() * sizeof(Frame) + scratch_.capacity() + text_.capacity();
+    }
+
+private:
+    struct Frame {
+        bool map = false;
+        bool indefinite = false;
+        uint64_t remaining = 0; // Items still to read; a map counts keys and values.
+        uint64_t written = 0;
+    };
+
+    bool Fail(const char* message) {
+        result_.ok = false;
+        result_.error = std::string(message) + " at byte " + std::to_string(pos_);
+        result_.error_offset = pos_;
+        return false;
+    }
+
+    bool Need(uint64_t count) {
+        return bytes_.size() - pos_ >= count || Fail("unexpected end of input");
+    }
+
+    uint64_t ReadBigEndian(int count) {
+        uint64_t value = 0;
+        for (int i = 0; i < count; ++i) {
+            value = (value << 8) | static_cast<unsigned char>(bytes_[pos_++]);
+        }
+        return value;
+    }
+
+    void NewLine() {
+        if (!minified_) {
+            out_.Put('\n');
+            out_.PutRepeated(' ', indent_ * frames_.size());
+        }
+    }
+
+    // Scalars in key position are quoted so the result stays valid JSON.
+    void WriteScalar(std::string_view text, bool key) {
+        if (key) {
+            out_.Put('"');
+            out_.Append(text);
+            out_.Put('"');
+        } else {
+            out_.Append(text);
+        }
+    }
+
+    template <typename Number>
+    void WriteNumber(Number value, bool key) {
+        char buffer[32];
+        const auto printed = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        WriteScalar(std::string_view(buffer, static_cast<size_t>(printed.ptr - buffer)), key);
+    }
+
+    // Half and single floats are widened first: their shortest float
+    // digits would parse back as a different double.
+    void WriteFloat(double value, bool key) {
+        if (std::isfinite(value)) {
+            WriteNumber(value, key);
+        } else {
+            WriteScalar("null", key);
+        }
+    }
+
+    void WriteNegative(uint64_t magnitude_minus_one, bool key);
+    void WriteText(std::string_view text);
+    void WriteBase64(std::string_view data);
+    bool OpenContainer(bool map, bool indefinite, uint64_t count, bool key);
+    bool ReadCbor(bool key);
+    bool ReadCborArgument(unsigned info, uint64_t& value);
+    bool ReadCborChunks(unsigned major);
+    bool ReadMessagePack(bool key);
+    bool ReadValue(bool key) {
+        return format_ == BinaryFormat::Cbor ? ReadCbor(key) : ReadMessagePack(key);
+    }
+    bool Step();
+
+    std::string_view bytes_;
+    BinaryFormat format_;
+    size_t indent_;
+    bool minified_;
+    OutputSink& out_;
+    JobContext* job_;
+    size_t pos_ = 0;
+    std::vector<Frame> frames_;
+    std::string scratch_;
+    std::string text_;
+    JsonFormatResult result_;
+};
+
+void BinaryDecoder::WriteNegative(uint64_t magnitude_minus_one, bool key) {
+    if (magnitude_minus_one == UINT64_MAX) {
+        WriteScalar("-18446744073709551616", key);
+        return;
+    }
+    char buffer[32];
+    buffer[0] = '-';
+    const auto printed = std::to_chars(buffer + 1, buffer + sizeof(buffer), magnitude_minus_one + 1);
+    WriteScalar(std::string_view(buffer, static_cast<size_t>(printed.ptr - buffer)), key);
+}
+
+// Writes UTF-8 as a JSON string literal. Malformed sequences become U+FFFD
+// rather than failing, since MessagePack producers often put raw bytes in
+// str items.
+void BinaryDecoder::WriteText(std::string_view text) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    text_.clear();
+    text_.push_back('"');
+    const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+    const auto* end = p + text.size();
+    while (p < end) {
+        const unsigned char c = *p;
+        if (c >= 0x80) {
+            const size_t length = Utf8SequenceLength(p, end);
+            if (length == 0) {
+                text_ += "\xEF\xBF\xBD";
+                ++p;
+            } else {
+                text_.append(reinterpret_cast<const char*>(p), length);
+                p += length;
+            }
+            continue;
+        }
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            text_.push_back(static_cast<char>(c));
+        } else if (c == '"' || c == '\\') {
+            text_.push_back('\\');
+            text_.push_back(static_cast<char>(c));
+        } else if (c == '\n') {
+            text_ += "\\n";
+        } else if (c == '\r') {
+            text_ += "\\r";
+        } else if (c == '\t') {
+            text_ += "\\t";
+        } else {
+            text_ += "\\u00";
+            text_.push_back(kHex[c >> 4]);
+            text_.push_back(kHex[c & 0xF]);
+        }
+        ++p;
+    }
+    text_.push_back('"');
+    out_.Append(text_);
+}
+
+void BinaryDecoder::WriteBase64(std::string_view data) {
+    text_.clear();
+    text_.push_back('"');
+    const auto* p = reinterpret_cast<const unsigned char*>(data.data());
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        const uint32_t chunk = (uint32_t{p[i]} << 16) | (uint32_t{p[i + 1]} << 8) | p[i + 2];
+        text_.push_back(kBase64[chunk >> 18]);
+        text_.push_back(kBase64[(chunk >> 12) & 63]);
+        text_.push_back(kBase64[(chunk >> 6) & 63]);
+        text_.push_back(kBase64[chunk & 63]);
+    }
+    if (i < data.size()) {
+        const bool two = i + 1 < data.size();
+        const uint32_t chunk = (uint32_t{p[i]} << 16) | (two ? uint32_t{p[i + 1]} << 8 : 0);
+        text_.push_back(kBase64[chunk >> 18]);
+        text_.push_back(kBase64[(chunk >> 12) & 63]);
+        text_.push_back(two ? kBase64[(chunk >> 6) & 63] : '=');
+        text_.push_back('=');
+    }
+    text_.push_back('"');
+    out_.Append(text_);
+}
+
+bool BinaryDecoder::OpenContainer(bool map, bool indefinite, uint64_t count, bool key) {
+    if (key) {
+        return Fail("map key is not a scalar");
+    }
+    // Every item takes at least one byte, which also bounds `count * 2`.
+    if (!indefinite && count > bytes_.size() - pos_) {
+        return Fail("container is longer than the input");
+    }
+    out_.Put(map ? '{' : '[');
+    if (!indefinite && count == 0) {
+        out_.Put(map ? '}' : ']');
+        return true;
+    }
+    frames_.push_back(Frame{map, indefinite, map ? count * 2 : count, 0});
+    return true;
+}
+
+bool BinaryDecoder::ReadCborArgument(unsigned info, uint64_t& value) {
+    if (info < 24) {
+        value = info;
+        return true;
+    }
+    if (info > 27) {
+        return Fail("reserved additional information");
+    }
+    const int bytes = 1 << (info - 24);
+    if (!Need(static_cast<uint64_t>(bytes))) {
+        return false;
+    }
+    value = ReadBigEndian(bytes);
+    return true;
+}
+
+// Indefinite-length byte or text string: definite chunks of the same major
+// type up to a break byte.
+bool BinaryDecoder::ReadCborChunks(unsigned major) {
+    scratch_.clear();
+    while (true) {
+        if (!Need(1)) {
+            return false;
+        }
+        const auto initial = static_cast<unsigned char>(bytes_[pos_++]);
+        if (initial == 0xFF) {
+            return true;
+        }
+        uint64_t length = 0;
+        if ((initial >> 5) != major || (initial & 31) == 31) {
+            return Fail("bad chunk in indefinite-length string");
+        }
+        if (!ReadCborArgument(initial & 31, length) || !Need(length)) {
+            return false;
+        }
+        scratch_.append(bytes_.data() + pos_, static_cast<size_t>(length));
+        pos_ += static_cast<size_t>(length);
+    }
+}
+
+bool BinaryDecoder::ReadCbor(bool key) {
+    while (true) {
+        if (!Need(1)) {
+            return false;
+        }
+        const auto initial = static_cast<unsigned char>(bytes_[pos_++]);
+        const unsigned major = initial >> 5;
+        const unsigned info = initial & 31;
+        if (major == 7) {
+            switch (info) {
+                case 20:
+                    WriteScalar("false", key);
+                    return true;
+                case 21:
+                    WriteScalar("true", key);
+                    return true;
+                case 25: {
+                    if (!Need(2)) {
+                        return false;
+                    }
+                    const auto half = static_cast<unsigned>(ReadBigEndian(2));
+                    const int exponent = static_cast<int>((half >> 10) & 0x1F);
+                    const int mantissa = static_cast<int>(half & 0x3FF);
+                    double value = 0.0;
+                    if (exponent == 0) {
+                        value = std::ldexp(mantissa, -24);
+                    } else if (exponent != 31) {
+                        value = std::ldexp(mantissa + 1024, exponent - 25);
+                    } else {
+                        value = mantissa == 0 ? HUGE_VAL : NAN;
+                    }
+                    WriteFloat(half & 0x8000 ? -value : value, key);
+                    return true;
+                }
+                case 26: {
+                    if (!Need(4)) {
+                        return false;
+                    }
+                    const auto bits = static_cast<uint32_t>(ReadBigEndian(4));
+                    float value = 0.0f;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    WriteFloat(value, key);
+                    return true;
+                }
+                case 27: {
+                    if (!Need(8)) {
+                        return false;
+                    }
+                    const uint64_t bits = ReadBigEndian(8);
+                    double value = 0.0;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    WriteFloat(value, key);
+                    return true;
+                }
+                case 31:
+                    return Fail("unexpected break");
+                default:
+                    // null, undefined and the unassigned simple values.
+                    if (info == 24 && !Need(1)) {
+                        return false;
+                    }
+                    pos_ += info == 24 ? 1 : 0;
+                    if (info > 24) {
+                        return Fail("reserved additional information");
+                    }
+                    WriteScalar("null", key);
+                    return true;
+            }
+        }
+        if (info == 31) {
+            if (major == 2 || major == 3) {
+                if (!ReadCborChunks(major)) {
+                    return false;
+                }
+                if (major == 2) {
+                    WriteBase64(scratch_);
+                } else {
+                    WriteText(scratch_);
+                }
+                return true;
+            }
+            if (major == 4 || major == 5) {
+                return OpenContainer(major == 5, true, 0, key);
+            }
+            return Fail("indefinite length on a type that has none");
+        }
+        uint64_t argument = 0;
+        if (!ReadCborArgument(info, argument)) {
+            return false;
+        }
+        switch (major) {
+            case 0:
+                WriteNumber(argument, key);
+                return true;
+            case 1:
+                WriteNegative(argument, key);
+                return true;
+            case 2:
+            case 3: {
+                if (!Need(argument)) {
+                    return false;
+                }
+                const std::string_view data = bytes_.substr(pos_, static_cast<size_t>(argument));
+                pos_ += static_cast<size_t>(argument);
+                if (major == 2) {
+                    WriteBase64(data);
+                } else {
+                    WriteText(data);
+                }
+                return true;
+            }
+            case 4:
+            case 5:
+                return OpenContainer(major == 5, false, argument, key);
+            default:
+                // Tag: the tagged item stands in for it.
+                continue;
+        }
+    }
+}
+
+bool BinaryDecoder::ReadMessagePack(bool key) {
+    if (!Need(1)) {
+        return false;
+    }
+    const auto type = static_cast<unsigned char>(bytes_[pos_++]);
+    if (type <= 0x7F) {
+        WriteNumber(static_cast<unsigned>(type), key);
+        return true;
+    }
+    if (type >= 0xE0) {
+        WriteNumber(static_cast<int>(static_cast<int8_t>(type)), key);
+        return true;
+    }
+    if (type <= 0x8F) {
+        return OpenContainer(true, false, type & 0x0F, key);
+    }
+    if (type <= 0x9F) {
+        return OpenContainer(false, false, type & 0x0F, key);
+    }
+    uint64_t length = 0;
+    bool text = false;
+    bool extension = false;
+    if (type <= 0xBF) {
+        length = type & 0x1F;
+        text = true;
+    } else {
+        // Width of the length or value field that follows the type byte.
+        int width = 0;
+        switch (type) {
+            case 0xC0:
+                WriteScalar("null", key);
+                return true;
+            case 0xC2:
+                WriteScalar("false", key);
+                return true;
+            case 0xC3:
+                WriteScalar("true", key);
+                return true;
+            case 0xC4:
+            case 0xC5:
+            case 0xC6:
+                width = 1 << (type - 0xC4);
+                break;
+            case 0xC7:
+            case 0xC8:
+            case 0xC9:
+                width = 1 << (type - 0xC7);
+                extension = true;
+                break;
+            case 0xCA: {
+                if (!Need(4)) {
+                    return false;
+                }
+                const auto bits = static_cast<uint32_t>(ReadBigEndian(4));
+                float value = 0.0f;
+                std::memcpy(&value, &bits, sizeof(value));
+                WriteFloat(value, key);
+                return true;
+            }
+            case 0xCB: {
+                if (!Need(8)) {
+                    return false;
+                }
+                const uint64_t bits = ReadBigEndian(8);
+                double value = 0.0;
+                std::memcpy(&value, &bits, sizeof(value));
+                WriteFloat(value, key);
+                return true;
+            }
+            case 0xCC:
+            case 0xCD:
+            case 0xCE:
+            case 0xCF: {
+                const int bytes = 1 << (type - 0xCC);
+                if (!Need(static_cast<uint64_t>(bytes))) {
+                    return false;
+                }
+                WriteNumber(ReadBigEndian(bytes), key);
+                return true;
+            }
+            case 0xD0:
+            case 0xD1:
+            case 0xD2:
+            case 0xD3: {
+                const int bytes = 1 << (type - 0xD0);
+                if (!Need(static_cast<uint64_t>(bytes))) {
+                    return false;
+                }
+                const uint64_t raw = ReadBigEndian(bytes);
+                const int shift = 64 - 8 * bytes;
+                // Sign-extend through the top of a 64-bit word.
+                WriteNumber(static_cast<int64_t>(raw << shift) >> shift, key);
+                return true;
+            }
+            case 0xD4:
+            case 0xD5:
+            case 0xD6:
+            case 0xD7:
+            case 0xD8:
+                length = uint64_t{1} << (type - 0xD4);
+                extension = true;
+                break;
+            case 0xD9:
+            case 0xDA:
+            case 0xDB:
+                width = 1 << (type - 0xD9);
+                text = true;
+                break;
+            case 0xDC:
+            case 0xDD:
+            case 0xDE:
+            case 0xDF: {
+                const int bytes = type & 1 ? 4 : 2;
+                if (!Need(static_cast<uint64_t>(bytes))) {
+                    return false;
+                }
+                return OpenContainer(type >= 0xDE, false, ReadBigEndian(bytes), key);
+            }
+            default:
+                return Fail("never-used type byte");
+        }
+        if (width > 0) {
+            if (!Need(static_cast<uint64_t>(width))) {
+                return false;
+            }
+            length = ReadBigEndian(width);
+        }
+    }
+    // Extension payloads follow their type byte; the type is dropped.
+    if (!Need(length + (extension ? 1 : 0))) {
+        return false;
+    }
+    pos_ += extension ? 1 : 0;
+    const std::string_view data = bytes_.substr(pos_, static_cast<size_t>(length));
+    pos_ += static_cast<size_t>(length);
+    if (text) {
+        WriteText(data);
+    } else {
+        WriteBase64(data);
+    }
+    return true;
+}
+
+// Reads the next item of the innermost open container, or closes it.
+bool BinaryDecoder::Step() {
+    Frame& frame = frames_.back();
+    bool end = frame.remaining == 0;
+    if (frame.indefinite) {
+        if (!Need(1)) {
+            return false;
+        }
+        end = static_cast<unsigned char>(bytes_[pos_]) == 0xFF;
+    }
+    if (end) {
+        if (frame.indefinite) {
+            ++pos_;
+        }
+        if (frame.map && frame.written % 2 != 0) {
+            return Fail("map key without a value");
+        }
+        const char close = frame.map ? '}' : ']';
+        const bool any = frame.written > 0;
+        frames_.pop_back();
+        if (any) {
+            NewLine();
+        }
+        out_.Put(close);
+        return true;
+    }
+    const bool key = frame.map && frame.written % 2 == 0;
+    if (frame.map && !key) {
+        out_.Append(minified_ ? ":" : ": ");
+    } else {
+        if (frame.written > 0) {
+            out_.Put(',');
+        }
+        NewLine();
+    }
+    ++frame.written;
+    if (!frame.indefinite) {
+        --frame.remaining;
+    }
+    return ReadValue(key);
+}
+
+JsonFormatResult BinaryDecoder::Run() {
+    bool ok = ReadValue(false);
+    size_t steps = 0;
+    while (ok && !frames_.empty()) {
+        if (job_ && (++steps & kJobCheckMask) == 0) {
+            job_->ReportProgress(pos_);
+            if (job_->Cancelled()) {
+                result_.ok = false;
+                result_.cancelled = true;
+                result_.error = "cancelled";
+                return result_;
+            }
+        }
+        ok = Step();
+    }
+    if (ok && pos_ != bytes_.size()) {
+        ok = Fail("unexpected data after the first item");
+    }
+    if (!ok) {
+        return result_;
+    }
+    if (job_) {
+        job_->ReportProgress(bytes_.size());
+    }
+    if (!out_.Finish()) {
+        result_.ok = false;
+        result_.error = "failed to write output";
+    }
+    return result_;
+}
+
+int Base64Value(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (IsDigit(c)) {
+        return c - '0' + 52;
+    }
+    if (c == '+' || c == '-') {
+        return 62;
+    }
+    if (c == '/' || c == '_') {
+        return 63;
+    }
+    return -1;
+}
+
+} // namespace
+
+JsonFormatResult EncodeJsonBinary(std::string_view input,
+                                  BinaryFormat format,
+                                  OutputSink& out,
+                                  BinaryConversionStats& stats,
+                                  JobContext* job) {
+    stats = BinaryConversionStats{};
+    stats.bytes_in = input.size();
+    std::vector<uint32_t> counts;
+    ContainerCounter counter(counts);
+    JsonFormatResult result = ScanJsonEvents(input, counter, job);
+    if (!result.ok) {
+        return result;
+    }
+    BinaryWriter writer(format, counts, out);
+    result = ScanJsonEvents(input, writer, job);
+    stats.bytes_out = writer.written();
+    stats.peak_memory = counts.capacity() * sizeof(uint32_t) + counter.memory() + writer.memory();
+    if (result.ok && writer.failed()) {
+        result.ok = false;
+        result.error_offset = writer.error_offset();
+        result.error = "number at offset " + std::to_string(writer.error_offset()) + " does not fit a double";
+    }
+    if (result.ok && !out.Finish()) {
+        result.ok = false;
+        result.error = "failed to write output";
+    }
+    return result;
+}
+
+JsonFormatResult DecodeJsonBinary(std::string_view bytes,
+                                  BinaryFormat format,
+                                  const JsonFormatOptions& options,
+                                  bool minified,
+                                  OutputSink& out,
+                                  BinaryConversionStats& stats,
+                                  JobContext* job) {
+    stats = BinaryConversionStats{};
+    stats.bytes_in = bytes.size();
+    if (bytes.empty()) {
+        JsonFormatResult result;
+        result.ok = false;
+        result.error = "input is empty";
+        return result;
+    }
+    BinaryDecoder decoder(bytes, format, options, minified, out, job);
+    JsonFormatResult result = decoder.Run();
+    stats.peak_memory = decoder.memory();
+    return result;
+}
+
+bool ParseBinaryText(std::string_view text, std::string& bytes, std::string& error) {
+    bytes.clear();
+    bool hex = true;
+    size_t digits = 0;
+    for (const char c : text) {
+        if (IsJsonWhitespace(c)) {
+            continue;
+        }
+        ++digits;
+        hex = hex && IsHexDigit(c);
+    }
+    if (digits == 0) {
+        error = "input is empty";
+        return false;
+    }
+    if (hex && digits % 2 == 0) {
+        bytes.reserve(digits / 2);
+        int high = -1;
+        for (const char c : text) {
+            if (IsJsonWhitespace(c)) {
+                continue;
+            }
+            if (high < 0) {
+                high = static_cast<int>(HexValue(c));
+            } else {
+                bytes.push_back(static_cast<char>((high << 4) | static_cast<int>(HexValue(c))));
+                high = -1;
+            }
+        }
+        return true;
+    }
+    bytes.reserve(digits / 4 * 3 + 2);
+    uint32_t bits = 0;
+    int pending = 0;
+    bool padded = false;
+    for (const char c : text) {
+        if (IsJsonWhitespace(c)) {
+            continue;
+        }
+        if (c == '=') {
+            padded = true;
+            continue;
+        }
+        const int value = Base64Value(c);
+        if (value < 0 || padded) {
+            error = "input is neither hex nor base64";
+            return false;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        pending += 6;
+        if (pending >= 8) {
+            pending -= 8;
+            bytes.push_back(static_cast<char>((bits >> pending) & 0xFF));
+        }
+    }
+    if (pending >= 6) {
+        error = "base64 input is truncated";
+        return false;
+    }
+    return true;
+}
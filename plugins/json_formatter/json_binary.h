@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "json_stream_formatter.h"
+
+class JobContext;
+class OutputSink;
+
+enum class BinaryFormat {
+    Cbor,       // RFC 8949
+    MessagePack
+};
+
+struct BinaryConversionStats {
+    size_t bytes_in = 0;
+    size_t bytes_out = 0;
+    // Most memory the converter itself held at once; output buffers are
+    // the sink's and not counted.
+    size_t peak_memory = 0;
+};
+
+// Encodes one JSON document as CBOR or MessagePack, writing straight to
+// `out`. Both formats want container sizes up front, so a first event pass
+// records one count per container and a second pass writes the items;
+// memory is four bytes per container plus the nesting stack, never a DOM.
+// Integers that fit 64 bits are written as integers, other numbers as the
+// smallest float that holds them exactly; numbers below the double range
+// become a signed zero and only ones above it are an error.
+JsonFormatResult EncodeJsonBinary(std::string_view input,
+                                  BinaryFormat format,
+                                  OutputSink& out,
+                                  BinaryConversionStats& stats,
+                                  JobContext* job = nullptr);
+
+// Decodes one CBOR or MessagePack item to JSON in a single forward pass,
+// writing as it reads: re-indented like FormatJsonStream, or compact when
+// `minified`. Byte strings and extension payloads become base64 strings,
+// tags are dropped, non-finite floats and undefined become null, and
+// scalar map keys are written as strings.
+JsonFormatResult DecodeJsonBinary(std::string_view bytes,
+                                  BinaryFormat format,
+                                  const JsonFormatOptions& options,
+                                  bool minified,
+                                  OutputSink& out,
+                                  BinaryConversionStats& stats,
+                                  JobContext* job = nullptr);
+
+// Reads binary data pasted as text: hex digits, or base64 (standard or
+// URL alphabet, padding optional) when anything but hex digits shows up.
+// Whitespace is ignored.
+bool ParseBinaryText(std::string_view text, std::string& bytes, std::string& error);
@@ -0,0 +1,460 @@
+#include "json_canonical.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+#include "background_job.h"
+#include "json_lexing.h"
+#include "json_tape.h"
+#include "output_sink.h"
+
+namespace {
+
+constexpr uint32_t kJobCheckMask = 0xFFFF;
+// Integers up to this many digits are exact doubles below 1e21, so their
+// canonical form is the token itself.
+constexpr size_t kMaxPlainIntegerDigits = 15;
+
+unsigned ReadHex4(const char* p) {
+    return (HexValue(p[0]) << 12) | (HexValue(p[1]) << 8) | (HexValue(p[2]) << 4) | HexValue(p[3]);
+}
+
+// Decodes a validated string body into UTF-8. Unlike DecodeJsonString a
+// lone surrogate is an error: it has no UTF-8 form to canonicalize to.
+bool DecodeStrict(std::string_view body, std::string& out) {
+    out.clear();
+    for (size_t i = 0; i < body.size();) {
+        const char c = body[i];
+        if (c != '\\') {
+            out.push_back(c);
+            ++i;
+            continue;
+        }
+        const char esc = body[i + 1];
+        i += 2;
+        switch (esc) {
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u': {
+                unsigned code = ReadHex4(body.data() + i);
+                i += 4;
+                if (code >= 0xDC00 && code <= 0xDFFF) {
+                    return false;
+                }
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    if (i + 6 > body.size() || body[i] != '\\' || body[i + 1] != 'u') {
+                        return false;
+                    }
+                    const unsigned low = ReadHex4(body.data() + i + 2);
+                    if (low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+                AppendUtf8(out, code);
+                break;
+            }
+            default:
+                out.push_back(esc);
+                break;
+        }
+    }
+    return true;
+}
+
+// Writes decoded text as a canonical string literal: quote, backslash and
+// control characters are escaped, preferring the two-character forms;
+// everything else, including '/' and non-ASCII, is written as is.
+void AppendEscaped(std::string_view text, std::string& out) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    out.push_back('"');
+    for (const char c : text) {
+        const auto byte = static_cast<unsigned char>(c);
+        if (byte >= 0x20 && c != '"' && c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        out.push_back('\\');
+        switch (c) {
+            case '"':
+            case '\\':
+                out.push_back(c);
+                break;
+            case '\b':
+                out.push_back('b');
+                break;
+            case '\f':
+                out.push_back('f');
+                break;
+            case '\n':
+                out.push_back('n');
+                break;
+            case '\r':
+                out.push_back('r');
+                break;
+            case '\t':
+                out.push_back('t');
+                break;
+            default:
+                out += "u00";
+                out.push_back(kHex[byte >> 4]);
+                out.push_back(kHex[byte & 0xF]);
+                break;
+        }
+    }
+    out.push_back('"');
+}
+
+// UTF-16 code unit order on UTF-8 text. Byte order already matches code
+// point order; the two only disagree where U+E000..U+FFFF (leads EE, EF)
+// meets a supplementary character (leads F0..F4), whose surrogate pair
+// sorts first in UTF-16. Shared prefixes end on a character boundary or
+// inside one character, so the first differing bytes are either both
+// leads or both continuation bytes of the same kind of sequence.
+bool Utf16Less(std::string_view a, std::string_view b) {
+    const size_t n = std::min(a.size(), b.size());
+    const auto mismatch = std::mismatch(a.begin(), a.begin() + static_cast<std::ptrdiff_t>(n), b.begin());
+    const size_t i = static_cast<size_t>(mismatch.first - a.begin());
+    if (i == n) {
+        return a.size() < b.size();
+    }
+    const auto x = static_cast<unsigned char>(a[i]);
+    const auto y = static_cast<unsigned char>(b[i]);
+    const bool x_high_bmp = x == 0xEE || x == 0xEF;
+    const bool y_high_bmp = y == 0xEE || y == 0xEF;
+    if (x_high_bmp && y >= 0xF0) {
+        return false;
+    }
+    if (y_high_bmp && x >= 0xF0) {
+        return true;
+    }
+    return x < y;
+}
+
+class Canonicalizer {
+public:
+    Canonicalizer(const JsonTape& tape, OutputSink& out, JobContext* job) : tape_(tape), out_(out), job_(job) {}
+
+    JsonFormatResult Run();
+
+private:
+    struct Member {
+        uint32_t key = 0;
+        std::string_view name; // Decoded; a view into the input or the frame's names.
+        uint32_t decoded = 0;  // Start in the frame's names, or kRaw.
+        uint32_t length = 0;
+    };
+
+    static constexpr uint32_t kRaw = UINT32_MAX;
+
+    // One open container. Frames are reused by depth so that their vectors
+    // keep their capacity across siblings.
+    struct Frame {
+        bool object = false;
+        uint32_t item = 0; // Arrays: next item entry.
+        uint32_t end = 0;  // Arrays: one past the last item.
+        size_t position = 0;
+        std::vector<Member> members;
+        std::string names;
+    };
+
+    bool Fail(const char* message, uint32_t entry) {
+        result_.ok = false;
+        result_.error = message;
+        result_.error_offset = tape_.offset(entry);
+        return false;
+    }
+
+    bool WriteString(uint32_t entry);
+    bool WriteNumber(uint32_t entry);
+    bool WriteValue(uint32_t entry);
+    bool OpenObject(uint32_t entry);
+    bool Step();
+
+    const JsonTape& tape_;
+    OutputSink& out_;
+    JobContext* job_;
+    std::vector<Frame> frames_;
+    size_t depth_ = 0;
+    std::string scratch_;
+    std::string text_;
+    size_t steps_ = 0;
+    JsonFormatResult result_;
+};
+
+bool Canonicalizer::WriteString(uint32_t entry) {
+    const std::string_view token = tape_.Token(entry);
+    const std::string_view body = token.substr(1, token.size() - 2);
+    // Validated strings without escapes hold no control characters, so
+    // they are canonical already.
+    if (body.find('\\') == std::string_view::npos) {
+        out_.Append(token);
+        return true;
+    }
+    if (!DecodeStrict(body, scratch_)) {
+        return Fail("string has a lone surrogate", entry);
+    }
+    text_.clear();
+    AppendEscaped(scratch_, text_);
+    out_.Append(text_);
+    return true;
+}
+
+bool Canonicalizer::WriteNumber(uint32_t entry) {
+    const std::string_view token = tape_.Token(entry);
+    text_.clear();
+    if (!AppendCanonicalNumber(token, text_)) {
+        return Fail("number is out of range for canonical JSON", entry);
+    }
+    out_.Append(text_);
+    return true;
+}
+
+bool Canonicalizer::OpenObject(uint32_t entry) {
+    if (depth_ == frames_.size()) {
+        frames_.emplace_back();
+    }
+    Frame& frame = frames_[depth_++];
+    frame.object = true;
+    frame.position = 0;
+    frame.members.clear();
+    frame.names.clear();
+    for (uint32_t key = entry + 1, end = tape_.next(entry); key < end; key = tape_.next(key + 1)) {
+        const std::string_view token = tape_.Token(key);
+        const std::string_view body = token.substr(1, token.size() - 2);
+        if (body.find('\\') == std::string_view::npos) {
+            frame.members.push_back(Member{key, body, kRaw, 0});
+            continue;
+        }
+        if (!DecodeStrict(body, scratch_)) {
+            return Fail("member name has a lone surrogate", key);
+        }
+        frame.members.push_back(Member{key, std::string_view(), static_cast<uint32_t>(frame.names.size()),
+                                       static_cast<uint32_t>(scratch_.size())});
+        frame.names += scratch_;
+    }
+    // Decoded names become views into `names` once it stops growing.
+    for (Member& member : frame.members) {
+        if (member.decoded != kRaw) {
+            member.name = std::string_view(frame.names.data() + member.decoded, member.length);
+        }
+    }
+    std::sort(frame.members.begin(), frame.members.end(),
+              [](const Member& a, const Member& b) { return Utf16Less(a.name, b.name); });
+    for (size_t i = 1; i < frame.members.size(); ++i) {
+        if (frame.members[i - 1].name == frame.members[i].name) {
+            return Fail("duplicate member name", frame.members[i].key);
+        }
+    }
+    return true;
+}
+
+bool Canonicalizer::WriteValue(uint32_t entry) {
+    switch (tape_.kind(entry)) {
+        case JsonKind::Object:
+            out_.Put('{');
+            return OpenObject(entry);
+        case JsonKind::Array: {
+            out_.Put('[');
+            if (depth_ == frames_.size()) {
+                frames_.emplace_back();
+            }
+            Frame& frame = frames_[depth_++];
+            frame.object = false;
+            frame.item = entry + 1;
+            frame.end = tape_.next(entry);
+            frame.position = 0;
+            return true;
+        }
+        case JsonKind::String:
+            return WriteString(entry);
+        case JsonKind::Number:
+            return WriteNumber(entry);
+        default:
+            out_.Append(tape_.Token(entry));
+            return true;
+    }
+}
+
+// Writes the next member or item of the innermost open container, or
+// closes it.
+bool Canonicalizer::Step() {
+    Frame& frame = frames_[depth_ - 1];
+    if (frame.object) {
+        if (frame.position == frame.members.size()) {
+            out_.Put('}');
+            --depth_;
+            return true;
+        }
+        if (frame.position > 0) {
+            out_.Put(',');
+        }
+        const uint32_t key = frame.members[frame.position++].key;
+        if (!WriteString(key)) {
+            return false;
+        }
+        out_.Put(':');
+        return WriteValue(key + 1);
+    }
+    if (frame.item == frame.end) {
+        out_.Put(']');
+        --depth_;
+        return true;
+    }
+    if (frame.position++ > 0) {
+        out_.Put(',');
+    }
+    const uint32_t item = frame.item;
+    frame.item = tape_.next(item);
+    return WriteValue(item);
+}
+
+JsonFormatResult Canonicalizer::Run() {
+    if (tape_.empty()) {
+        return result_;
+    }
+    bool ok = WriteValue(JsonTape::kRoot);
+    const size_t total = tape_.input().size();
+    while (ok && depth_ > 0) {
+        if (job_ && (++steps_ & kJobCheckMask) == 0) {
+            // Members are written out of input order, so progress counts
+            // entries rather than following offsets.
+            job_->ReportProgress(static_cast<size_t>(static_cast<double>(total) *
+                                                     static_cast<double>(std::min(steps_, tape_.size())) /
+                                                     static_cast<double>(tape_.size())));
+            if (job_->Cancelled()) {
+                result_.ok = false;
+                result_.cancelled = true;
+                result_.error = "cancelled";
+                return result_;
+            }
+        }
+        ok = Step();
+    }
+    if (!ok) {
+        return result_;
+    }
+    if (job_) {
+        job_->ReportProgress(total);
+    }
+    if (!out_.Finish()) {
+        result_.ok = false;
+        result_.error = "failed to write output";
+    }
+    return result_;
+}
+
+} // namespace
+
+bool AppendCanonicalNumber(std::string_view token, std::string& out) {
+    // Plain integers short enough to be exact keep their spelling; only
+    // "-0" needs a change.
+    const size_t sign = token[0] == '-' ? 1 : 0;
+    if (token.size() - sign <= kMaxPlainIntegerDigits &&
+        std::all_of(token.begin() + static_cast<std::ptrdiff_t>(sign), token.end(), IsDigit)) {
+        if (token == "-0") {
+            out.push_back('0');
+        } else {
+            out.append(token);
+        }
+        return true;
+    }
+
+    double value = 0.0;
+    const auto parsed = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (parsed.ec == std::errc::result_out_of_range) {
+        if (JsonNumberMagnitude(token) > 0) {
+            return false;
+        }
+        value = 0.0;
+    }
+    if (value == 0.0) {
+        out.push_back('0');
+        return true;
+    }
+
+    // Shortest round-trip digits, then laid out per ECMAScript
+    // Number::toString: with value = 0.DIGITS * 10^point, plain notation
+    // for 1e-6 <= |value| < 1e21 and exponent notation elsewhere.
+    char buffer[32];
+    const auto printed = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::scientific);
+    std::string_view scientific(buffer, static_cast<size_t>(printed.ptr - buffer));
+    if (scientific[0] == '-') {
+        out.push_back('-');
+        scientific.remove_prefix(1);
+    }
+    const size_t e = scientific.find('e');
+    char digits[24];
+    int count = 0;
+    for (size_t i = 0; i < e; ++i) {
+        if (scientific[i] != '.') {
+            digits[count++] = scientific[i];
+        }
+    }
+    int exponent = 0;
+    const char* exponent_begin = scientific.data() + e + 1;
+    if (*exponent_begin == '+') {
+        ++exponent_begin;
+    }
+    std::from_chars(exponent_begin, scientific.data() + scientific.size(), exponent);
+    const int point = exponent + 1;
+
+    if (count <= point && point <= 21) {
+        out.append(digits, static_cast<size_t>(count));
+        out.append(static_cast<size_t>(point - count), '0');
+    } else if (0 < point && point <= 21) {
+        out.append(digits, static_cast<size_t>(point));
+        out.push_back('.');
+        out.append(digits + point, static_cast<size_t>(count - point));
+    } else if (-6 < point && point <= 0) {
+        out += "0.";
+        out.append(static_cast<size_t>(-point), '0');
+        out.append(digits, static_cast<size_t>(count));
+    } else {
+        out.push_back(digits[0]);
+        if (count > 1) {
+            out.push_back('.');
+            out.append(digits + 1, static_cast<size_t>(count - 1));
+        }
+        out.push_back('e');
+        out.push_back(exponent < 0 ? '-' : '+');
+        out += std::to_string(exponent < 0 ? -exponent : exponent);
+    }
+    return true;
+}
+
+JsonFormatResult CanonicalizeJsonTape(const JsonTape& tape, OutputSink& out, JobContext* job) {
+    return Canonicalizer(tape, out, job).Run();
+}
+
+JsonFormatResult CanonicalizeJson(std::string_view input, OutputSink& out, JobContext* job) {
+    JsonTape tape;
+    std::string error;
+    if (!tape.Build(input, error, job)) {
+        // Rescan for the offset; Build only reports the message.
+        JsonFormatResult result = ValidateJson(input, job);
+        if (result.ok) {
+            result.ok = false;
+            result.error = error;
+        }
+        return result;
+    }
+    return CanonicalizeJsonTape(tape, out, job);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "json_stream_formatter.h"
+
+class JobContext;
+class JsonTape;
+class OutputSink;
+
+// Writes the document on `tape` as RFC 8785 canonical JSON (JCS): no
+// whitespace, object members sorted by their UTF-16 code units, strings
+// with only the mandatory escapes, and numbers in the shortest form that
+// round-trips, spelled the way ECMAScript prints them. Members are sorted
+// in small per-object index arrays over the tape, so memory stays close
+// to the tape itself. Duplicate member names, lone surrogates and numbers
+// outside the double range are reported as errors, since they have no
+// canonical form.
+JsonFormatResult CanonicalizeJsonTape(const JsonTape& tape, OutputSink& out, JobContext* job = nullptr);
+
+// Builds a tape for `input` and canonicalizes it.
+JsonFormatResult CanonicalizeJson(std::string_view input, OutputSink& out, JobContext* job = nullptr);
+
+// Appends the canonical spelling of the JSON number `token`. Returns false
+// if it overflows a double.
+bool AppendCanonicalNumber(std::string_view token, std::string& out);
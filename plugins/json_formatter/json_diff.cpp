@@ -0,0 +1,248 @@
+#include "json_diff.h"
+
+#include <bit>
+#include <charconv>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "background_job.h"
+#include "json_lexing.h"
+#include "json_tape.h"
+#include "tree_diff.h"
+
+namespace {
+
+constexpr size_t kMaxReportedDifferences = 10000;
+constexpr uint32_t kJobCheckMask = 0xFFFF;
+
+constexpr uint64_t kStringTag = 0x5354524E47000001ULL;
+constexpr uint64_t kNumberTag = 0x4E554D4245520002ULL;
+constexpr uint64_t kArrayTag = 0x4152524159000003ULL;
+constexpr uint64_t kObjectTag = 0x4F424A4543540004ULL;
+constexpr uint64_t kTrueHash = 0x54525545000005ULL;
+constexpr uint64_t kFalseHash = 0x46414C5345000006ULL;
+constexpr uint64_t kNullHash = 0x4E554C4C000007ULL;
+
+bool IsContainer(JsonKind kind) {
+    return kind == JsonKind::Object || kind == JsonKind::Array;
+}
+
+// String contents without quotes, decoded only when it has escapes.
+std::string_view StringText(std::string_view token, std::string& scratch) {
+    const std::string_view body = token.substr(1, token.size() - 2);
+    if (body.find('\\') == std::string_view::npos) {
+        return body;
+    }
+    DecodeJsonString(body, scratch);
+    return scratch;
+}
+
+uint64_t HashScalar(JsonKind kind, std::string_view token, std::string& scratch) {
+    switch (kind) {
+        case JsonKind::String:
+            return MixHash(std::hash<std::string_view>{}(StringText(token, scratch)) ^ kStringTag);
+        case JsonKind::Number: {
+            double value = 0.0;
+            std::from_chars(token.data(), token.data() + token.size(), value);
+            if (value == 0.0) {
+                value = 0.0; // -0 equals 0.
+            }
+            return MixHash(std::bit_cast<uint64_t>(value) ^ kNumberTag);
+        }
+        case JsonKind::True:
+            return kTrueHash;
+        case JsonKind::False:
+            return kFalseHash;
+        default:
+            return kNullHash;
+    }
+}
+
+class Differ {
+public:
+    Differ(const JsonTape& left,
+           const std::vector<uint64_t>& left_hashes,
+           const JsonTape& right,
+           const std::vector<uint64_t>& right_hashes)
+        : left_(left), right_(right), left_hashes_(left_hashes), right_hashes_(right_hashes) {}
+
+    JsonDiffResult Run(JobContext* job);
+
+private:
+    void Report(JsonDiffKind kind, uint32_t left, uint32_t right, std::string path) {
+        if (result_.count++ < kMaxReportedDifferences) {
+            result_.entries.push_back(JsonDiffEntry{kind, std::move(path), left, right});
+        }
+    }
+
+    static std::string Child(const std::string& path, std::string_view token) {
+        std::string child = path;
+        AppendJsonPointerToken(token, child);
+        return child;
+    }
+
+    static std::string Child(const std::string& path, size_t index) {
+        return path + '/' + std::to_string(index);
+    }
+
+    void Compare(uint32_t left, uint32_t right, const std::string& path, std::vector<TreeDiffItem>& items);
+    void CompareObjects(uint32_t left, uint32_t right, const std::string& path, std::vector<TreeDiffItem>& items);
+    void CompareArrays(uint32_t left, uint32_t right, const std::string& path, std::vector<TreeDiffItem>& items);
+
+    const JsonTape& left_;
+    const JsonTape& right_;
+    const std::vector<uint64_t>& left_hashes_;
+    const std::vector<uint64_t>& right_hashes_;
+    std::string left_scratch_;
+    std::string right_scratch_;
+    JsonDiffResult result_;
+};
+
+void Differ::Compare(uint32_t left, uint32_t right, const std::string& path, std::vector<TreeDiffItem>& items) {
+    if (left_hashes_[left] == right_hashes_[right]) {
+        return;
+    }
+    const JsonKind kind = left_.kind(left);
+    if (kind != right_.kind(right) || !IsContainer(kind)) {
+        Report(JsonDiffKind::Changed, left, right, path);
+    } else if (kind == JsonKind::Object) {
+        CompareObjects(left, right, path, items);
+    } else {
+        CompareArrays(left, right, path, items);
+    }
+}
+
+void Differ::CompareObjects(uint32_t left,
+                            uint32_t right,
+                            const std::string& path,
+                            std::vector<TreeDiffItem>& items) {
+    std::vector<TreeDiffItem> found;
+    const uint32_t left_end = left_.next(left);
+    const uint32_t right_end = right_.next(right);
+    uint32_t l = left + 1;
+    uint32_t r = right + 1;
+    // Members usually come in the same order on both sides; pair them up
+    // directly until the names diverge.
+    while (l < left_end && r < right_end && left_hashes_[l] == right_hashes_[r]) {
+        if (left_hashes_[l + 1] != right_hashes_[r + 1]) {
+            found.push_back(TreeDiffItem{TreeDiffAction::Compare, l + 1, r + 1,
+                                         Child(path, StringText(left_.Token(l), left_scratch_))});
+        }
+        l = left_.next(l + 1);
+        r = right_.next(r + 1);
+    }
+    if (l < left_end || r < right_end) {
+        std::unordered_map<std::string, uint32_t> right_members;
+        for (uint32_t key = r; key < right_end; key = right_.next(key + 1)) {
+            right_members.emplace(StringText(right_.Token(key), right_scratch_), key + 1);
+        }
+        std::unordered_set<std::string> left_names;
+        for (uint32_t key = l; key < left_end; key = left_.next(key + 1)) {
+            std::string name(StringText(left_.Token(key), left_scratch_));
+            auto it = right_members.find(name);
+            if (it == right_members.end()) {
+                found.push_back(
+                    TreeDiffItem{TreeDiffAction::Removed, key + 1, JsonDiffEntry::kNoEntry, Child(path, name)});
+            } else if (left_hashes_[key + 1] != right_hashes_[it->second]) {
+                found.push_back(TreeDiffItem{TreeDiffAction::Compare, key + 1, it->second, Child(path, name)});
+            }
+            left_names.insert(std::move(name));
+        }
+        for (uint32_t key = r; key < right_end; key = right_.next(key + 1)) {
+            const std::string_view name = StringText(right_.Token(key), right_scratch_);
+            if (left_names.find(std::string(name)) == left_names.end()) {
+                found.push_back(
+                    TreeDiffItem{TreeDiffAction::Added, JsonDiffEntry::kNoEntry, key + 1, Child(path, name)});
+            }
+        }
+    }
+    PushInDocumentOrder(found, items);
+}
+
+void Differ::CompareArrays(uint32_t left,
+                           uint32_t right,
+                           const std::string& path,
+                           std::vector<TreeDiffItem>& items) {
+    std::vector<uint32_t> left_items;
+    std::vector<uint32_t> right_items;
+    for (uint32_t item = left + 1, end = left_.next(left); item < end; item = left_.next(item)) {
+        left_items.push_back(item);
+    }
+    for (uint32_t item = right + 1, end = right_.next(right); item < end; item = right_.next(item)) {
+        right_items.push_back(item);
+    }
+    const TreeDiffTrim trim = TrimEqualEnds(
+        left_items, right_items, [this](uint32_t item) { return left_hashes_[item]; },
+        [this](uint32_t item) { return right_hashes_[item]; });
+    const auto index_path = [&path](size_t k) { return Child(path, k); };
+    PushPositionalPairs(left_items, right_items, trim, index_path, index_path, items);
+}
+
+JsonDiffResult Differ::Run(JobContext* job) {
+    result_.cancelled = !RunTreeDiff(
+        JsonTape::kRoot, JsonTape::kRoot, job,
+        [this](uint32_t left, uint32_t right, const std::string& path, std::vector<TreeDiffItem>& items) {
+            Compare(left, right, path, items);
+        },
+        [this](TreeDiffAction action, uint32_t left, uint32_t right, std::string path) {
+            Report(action == TreeDiffAction::Added ? JsonDiffKind::Added : JsonDiffKind::Removed, left, right,
+                   std::move(path));
+        });
+    return result_;
+}
+
+} // namespace
+
+bool HashJsonTape(const JsonTape& tape, std::vector<uint64_t>& hashes, JobContext* job) {
+    const auto size = static_cast<uint32_t>(tape.size());
+    hashes.assign(size, 0);
+    std::string scratch;
+    // Children follow their container on the tape, so a backward sweep sees
+    // every subtree before its parent.
+    for (uint32_t entry = size; entry-- > 0;) {
+        if (job && (entry & kJobCheckMask) == 0) {
+            job->ReportProgress(tape.offset(entry));
+            if (job->Cancelled()) {
+                return false;
+            }
+        }
+        const JsonKind kind = tape.kind(entry);
+        if (!IsContainer(kind)) {
+            hashes[entry] = HashScalar(kind, tape.Token(entry), scratch);
+            continue;
+        }
+        const uint32_t end = tape.next(entry);
+        uint64_t hash = 0;
+        uint64_t count = 0;
+        if (kind == JsonKind::Array) {
+            hash = kArrayTag;
+            for (uint32_t child = entry + 1; child < end; child = tape.next(child)) {
+                hash = CombineHash(hash, hashes[child]);
+            }
+        } else {
+            // Summing the member hashes makes the result independent of the
+            // member order.
+            for (uint32_t key = entry + 1; key < end; key = tape.next(key + 1)) {
+                hash += CombineHash(hashes[key], hashes[key + 1]);
+                ++count;
+            }
+            hash = CombineHash(kObjectTag ^ count, hash);
+        }
+        hashes[entry] = hash;
+    }
+    return true;
+}
+
+JsonDiffResult DiffJson(const JsonTape& left,
+                        const std::vector<uint64_t>& left_hashes,
+                        const JsonTape& right,
+                        const std::vector<uint64_t>& right_hashes,
+                        JobContext* job) {
+    if (left.empty() || right.empty()) {
+        return JsonDiffResult{};
+    }
+    return Differ(left, left_hashes, right, right_hashes).Run(job);
+}
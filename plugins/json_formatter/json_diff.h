@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobContext;
+class JsonTape;
+
+enum class JsonDiffKind : uint8_t {
+    Added,
+    Removed,
+    Changed
+};
+
+struct JsonDiffEntry {
+    static constexpr uint32_t kNoEntry = UINT32_MAX;
+
+    JsonDiffKind kind = JsonDiffKind::Changed;
+    std::string path; // JSON Pointer; the left side's for changes.
+    uint32_t left = kNoEntry;  // Tape entry in the left document, if any.
+    uint32_t right = kNoEntry; // Tape entry in the right document, if any.
+};
+
+struct JsonDiffResult {
+    // The first few differences in document order; count has the total.
+    std::vector<JsonDiffEntry> entries;
+    size_t count = 0;
+    bool cancelled = false;
+};
+
+// Fills `hashes` with one 64-bit hash per tape entry, computed bottom-up:
+// scalars hash their decoded value (so "\u0041" equals "A" and 1.0
+// equals 1), arrays combine their items in order, and objects combine their
+// members order-independently, so equal subtrees hash equal whatever their
+// whitespace or key order. Subtrees with equal 64-bit hashes are treated
+// as equal. Returns false if the job was cancelled.
+bool HashJsonTape(const JsonTape& tape, std::vector<uint64_t>& hashes, JobContext* job = nullptr);
+
+// Structural diff of two documents given their tapes and HashJsonTape
+// hashes. Subtrees with equal hashes are skipped without being visited,
+// so the cost follows the size of the differences rather than of the
+// documents. Object members are matched by name; array items by position
+// after trimming the common prefix and suffix.
+JsonDiffResult DiffJson(const JsonTape& left,
+                        const std::vector<uint64_t>& left_hashes,
+                        const JsonTape& right,
+                        const std::vector<uint64_t>& right_hashes,
+                        JobContext* job = nullptr);
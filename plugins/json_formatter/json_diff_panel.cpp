@@ -0,0 +1,176 @@
+#include "json_diff_panel.h"
+
+#include <imgui.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "input_text.h"
+#include "parallel_for.h"
+
+namespace {
+
+// Scalars longer than this are cut in the result rows.
+constexpr int kMaxPreviewChars = 80;
+
+void PreviewCell(const std::shared_ptr<const JsonDocument>& document, uint32_t entry) {
+    if (entry == JsonDiffEntry::kNoEntry) {
+        ImGui::TextDisabled("%s", "-");
+        return;
+    }
+    const JsonTape& tape = document->tape;
+    const JsonKind kind = tape.kind(entry);
+    if (kind == JsonKind::Object || kind == JsonKind::Array) {
+        ImGui::TextUnformatted(kind == JsonKind::Object ? "{...}" : "[...]");
+        return;
+    }
+    const std::string_view token = tape.Token(entry);
+    const int shown = token.size() > kMaxPreviewChars ? kMaxPreviewChars : static_cast<int>(token.size());
+    ImGui::Text("%.*s%s", shown, token.data(), shown < static_cast<int>(token.size()) ? "..." : "");
+}
+
+} // namespace
+
+void JsonDiffPanel::Compare(SharedText input, std::shared_ptr<const JsonDocument> input_document) {
+    const SharedText other = other_file_ ? SharedText::Map(other_file_) : SharedText::Copy(other_text_);
+    status_.clear();
+    job_.Start(input.view().size() + other.view().size(), [input, input_document, other](JobContext& job) {
+        DiffOutput output;
+        const auto start = std::chrono::steady_clock::now();
+        const SharedText sources[2] = {input, other};
+        std::shared_ptr<const JsonDocument> documents[2] = {input_document, nullptr};
+        std::vector<uint64_t> hashes[2];
+        std::string errors[2];
+        bool hashed[2] = {false, false};
+        ParallelFor(2, [&](size_t side) {
+            if (!documents[side]) {
+                auto document = std::make_shared<JsonDocument>();
+                document->source = sources[side];
+                if (!document->tape.Build(sources[side].view(), errors[side], &job)) {
+                    return;
+                }
+                documents[side] = std::move(document);
+            }
+            hashed[side] = HashJsonTape(documents[side]->tape, hashes[side], &job);
+        });
+        if (job.Cancelled() || (documents[0] && documents[1] && (!hashed[0] || !hashed[1]))) {
+            output.error = "cancelled";
+            return output;
+        }
+        if (!documents[0] || !documents[1]) {
+            output.error = !documents[0] ? "input: " + errors[0] : "other document: " + errors[1];
+            return output;
+        }
+        output.result = DiffJson(documents[0]->tape, hashes[0], documents[1]->tape, hashes[1], &job);
+        if (output.result.cancelled) {
+            output.error = "cancelled";
+            return output;
+        }
+        output.milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        output.left = documents[0];
+        output.right = documents[1];
+        return output;
+    });
+}
+
+void JsonDiffPanel::Clear() {
+    job_.Cancel();
+    result_ = JsonDiffResult{};
+    left_.reset();
+    right_.reset();
+    status_.clear();
+}
+
+bool JsonDiffPanel::Render(const char* id) {
+    if (auto finished = job_.TakeResult()) {
+        if (finished->error.empty()) {
+            result_ = std::move(finished->result);
+            left_ = std::move(finished->left);
+            right_ = std::move(finished->right);
+            char buffer[128];
+            if (result_.count == 0) {
+                std::snprintf(buffer, sizeof(buffer), "Documents are equal (%.1f ms).", finished->milliseconds);
+            } else {
+                std::snprintf(buffer, sizeof(buffer), "%zu differences in %.1f ms.", result_.count,
+                              finished->milliseconds);
+            }
+            status_ = buffer;
+        } else {
+            Clear();
+            status_ = "Compare failed: " + finished->error;
+        }
+    }
+
+    ImGui::PushID(id);
+    ImGui::SetNextItemWidth(320.0f);
+    ImGui::InputTextWithHint("##OtherPath", "other file path", other_path_, sizeof(other_path_));
+    ImGui::SameLine();
+    if (ImGui::Button("Open other...")) {
+        auto file = std::make_shared<MappedFile>();
+        std::string error;
+        if (file->Open(other_path_, error)) {
+            other_file_ = std::move(file);
+        } else {
+            status_ = "Open failed: " + error;
+        }
+    }
+    if (other_file_) {
+        ImGui::SameLine();
+        if (ImGui::Button("Close other")) {
+            other_file_.reset();
+        }
+        ImGui::TextDisabled("Comparing with %s (%zu bytes).", other_file_->path().string().c_str(),
+                            other_file_->size());
+    } else {
+        InputTextMultilineString("##Other", &other_text_, ImVec2(-1.0f, ImGui::GetContentRegionAvail().y * 0.3f));
+    }
+
+    const bool compare = ImGui::Button("Compare with input");
+    ImGui::SameLine();
+    if (job_.Running()) {
+        ImGui::TextDisabled("Comparing... %.0f%%", job_.Fraction() * 100.0f);
+    } else if (!status_.empty()) {
+        ImGui::TextWrapped("%s", status_.c_str());
+    }
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+    if (!job_.Running() && left_ && ImGui::BeginTable("Differences", 4, flags, ImVec2(-1.0f, -1.0f))) {
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed, 16.0f);
+        ImGui::TableSetupColumn("Path");
+        ImGui::TableSetupColumn("Input");
+        ImGui::TableSetupColumn("Other");
+        ImGui::TableHeadersRow();
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(result_.entries.size()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                const JsonDiffEntry& entry = result_.entries[static_cast<size_t>(i)];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(entry.kind == JsonDiffKind::Added     ? "+"
+                                       : entry.kind == JsonDiffKind::Removed ? "-"
+                                                                             : "~");
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(entry.path.empty() ? "(root)" : entry.path.c_str());
+                ImGui::TableNextColumn();
+                PreviewCell(left_, entry.left);
+                ImGui::TableNextColumn();
+                PreviewCell(right_, entry.right);
+            }
+        }
+        clipper.End();
+        if (result_.count > result_.entries.size()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TableNextColumn();
+            ImGui::TextDisabled("... and %zu more", result_.count - result_.entries.size());
+        }
+        ImGui::EndTable();
+    }
+    ImGui::PopID();
+    return compare;
+}
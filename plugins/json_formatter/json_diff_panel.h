@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "background_job.h"
+#include "json_diff.h"
+#include "json_document.h"
+#include "mapped_file.h"
+
+// Structural comparison of the input against a second document, typed in
+// or mapped from a file. Both sides are parsed and hashed concurrently on
+// a background job (reusing the input's tape when it is loaded), then
+// DiffJson lists the added, removed and changed paths side by side.
+class JsonDiffPanel {
+public:
+    // Draws the panel. Returns true when the user asked for a comparison;
+    // the caller then hands the current input to Compare().
+    bool Render(const char* id);
+    void Compare(SharedText input, std::shared_ptr<const JsonDocument> input_document);
+    void Clear();
+
+private:
+    struct DiffOutput {
+        JsonDiffResult result;
+        std::string error;
+        double milliseconds = 0.0;
+        std::shared_ptr<const JsonDocument> left;
+        std::shared_ptr<const JsonDocument> right;
+    };
+
+    char other_path_[512] = "";
+    std::shared_ptr<MappedFile> other_file_;
+    std::string other_text_ = "{\n}";
+    BackgroundJob<DiffOutput> job_;
+    std::string status_;
+    JsonDiffResult result_;
+    // Documents the shown result refers to, for the value previews.
+    std::shared_ptr<const JsonDocument> left_;
+    std::shared_ptr<const JsonDocument> right_;
+};
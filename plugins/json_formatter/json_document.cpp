@@ -0,0 +1,8 @@
+#include "json_document.h"
+
+#include <utility>
+
+bool JsonDocument::Build(SharedText text, std::string& error, JobContext& job) {
+    source = std::move(text);
+    return tape.Build(source.view(), error, &job);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "background_job.h"
+#include "document_loader.h"
+#include "json_tape.h"
+#include "mapped_file.h"
+
+// A tape together with the bytes it points into, tagged with the input
+// revision it was built from.
+struct JsonDocument {
+    using Source = SharedText;
+
+    SharedText source;
+    size_t revision = 0;
+    JsonTape tape;
+
+    bool Build(SharedText text, std::string& error, JobContext& job);
+};
+
+// Keeps one tape per input revision for the tree, query and format
+// features.
+using JsonDocumentLoader = DocumentLoader<JsonDocument>;
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Small lexical helpers shared by the JSON scanners and writers.
+
+inline bool IsJsonWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline bool IsHexDigit(char c) {
+    return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Length of the UTF-8 sequence starting at `p`, or 0 if it is malformed.
+inline size_t Utf8SequenceLength(const unsigned char* p, const unsigned char* end) {
+    unsigned char lead = p[0];
+    size_t len = 0;
+    unsigned char lo = 0x80;
+    unsigned char hi = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        len = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        len = 3;
+        if (lead == 0xE0) {
+            lo = 0xA0;
+        } else if (lead == 0xED) {
+            hi = 0x9F;
+        }
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        len = 4;
+        if (lead == 0xF0) {
+            lo = 0x90;
+        } else if (lead == 0xF4) {
+            hi = 0x8F;
+        }
+    } else {
+        return 0;
+    }
+    if (static_cast<size_t>(end - p) < len) {
+        return 0;
+    }
+    if (p[1] < lo || p[1] > hi) {
+        return 0;
+    }
+    for (size_t i = 2; i < len; ++i) {
+        if (p[i] < 0x80 || p[i] > 0xBF) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+// Returns the length of the JSON number at the start of `text`, or 0 if
+// `text` does not start with one.
+inline size_t ScanJsonNumber(std::string_view text) {
+    size_t p = 0;
+    const size_t n = text.size();
+    if (p < n && text[p] == '-') {
+        ++p;
+    }
+    if (p < n && text[p] == '0') {
+        ++p;
+    } else if (p < n && text[p] >= '1' && text[p] <= '9') {
+        while (p < n && IsDigit(text[p])) {
+            ++p;
+        }
+    } else {
+        return 0;
+    }
+    if (p < n && text[p] == '.') {
+        ++p;
+        if (p >= n || !IsDigit(text[p])) {
+            return 0;
+        }
+        while (p < n && IsDigit(text[p])) {
+            ++p;
+        }
+    }
+    if (p < n && (text[p] == 'e' || text[p] == 'E')) {
+        ++p;
+        if (p < n && (text[p] == '+' || text[p] == '-')) {
+            ++p;
+        }
+        if (p >= n || !IsDigit(text[p])) {
+            return 0;
+        }
+        while (p < n && IsDigit(text[p])) {
+            ++p;
+        }
+    }
+    return p;
+}
+
+// Checks the escape sequences of a string body (the bytes between the
+// quotes). Returns the offset of the first bad backslash, or npos.
+inline size_t FindInvalidEscape(std::string_view body) {
+    const char* data = body.data();
+    const char* end = data + body.size();
+    const char* p = data;
+    while ((p = static_cast<const char*>(std::memchr(p, '\\', static_cast<size_t>(end - p)))) != nullptr) {
+        if (p + 1 >= end) {
+            return static_cast<size_t>(p - data);
+        }
+        char esc = p[1];
+        if (esc == 'u') {
+            if (end - p < 6 || !IsHexDigit(p[2]) || !IsHexDigit(p[3]) || !IsHexDigit(p[4]) ||
+                !IsHexDigit(p[5])) {
+                return static_cast<size_t>(p - data);
+            }
+            p += 6;
+        } else if (esc == '"' || esc == '\\' || esc == '/' || esc == 'b' || esc == 'f' ||
+                   esc == 'n' || esc == 'r' || esc == 't') {
+            p += 2;
+        } else {
+            return static_cast<size_t>(p - data);
+        }
+    }
+    return std::string_view::npos;
+}
+
+inline unsigned HexValue(char c) {
+    if (IsDigit(c)) {
+        return static_cast<unsigned>(c - '0');
+    }
+    return static_cast<unsigned>((c | 0x20) - 'a' + 10);
+}
+
+inline void AppendUtf8(std::string& out, unsigned code_point) {
+    if (code_point < 0x80) {
+        out.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+}
+
+// Decodes the escapes of a validated string body into UTF-8. Lone
+// surrogates are replaced with U+FFFD.
+inline void DecodeJsonString(std::string_view body, std::string& out) {
+    out.clear();
+    out.reserve(body.size());
+    for (size_t i = 0; i < body.size();) {
+        const char c = body[i];
+        if (c != '\\') {
+            out.push_back(c);
+            ++i;
+            continue;
+        }
+        const char esc = body[i + 1];
+        i += 2;
+        switch (esc) {
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u': {
+                unsigned code = (HexValue(body[i]) << 12) | (HexValue(body[i + 1]) << 8) |
+                                (HexValue(body[i + 2]) << 4) | HexValue(body[i + 3]);
+                i += 4;
+                if (code >= 0xD800 && code <= 0xDBFF && i + 6 <= body.size() && body[i] == '\\' &&
+                    body[i + 1] == 'u') {
+                    const unsigned low = (HexValue(body[i + 2]) << 12) | (HexValue(body[i + 3]) << 8) |
+                                         (HexValue(body[i + 4]) << 4) | HexValue(body[i + 5]);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                AppendUtf8(out, code >= 0xD800 && code <= 0xDFFF ? 0xFFFD : code);
+                break;
+            }
+            default:
+                out.push_back(esc);
+                break;
+        }
+    }
+}
+
+// Appends "/" and `token` to a JSON Pointer, escaping '~' and '/'.
+inline void AppendJsonPointerToken(std::string_view token, std::string& out) {
+    out.push_back('/');
+    for (char c : token) {
+        if (c == '~') {
+            out += "~0";
+        } else if (c == '/') {
+            out += "~1";
+        } else {
+            out.push_back(c);
+        }
+    }
+}
+
+// Rough decimal exponent of a number token that from_chars found out of
+// range: positive for overflow, zero or negative for underflow.
+inline long JsonNumberMagnitude(std::string_view token) {
+    size_t p = token.empty() || token[0] != '-' ? 0 : 1;
+    long magnitude = 0;
+    if (token[p] != '0') {
+        while (p < token.size() && IsDigit(token[p])) {
+            ++magnitude;
+            ++p;
+        }
+    } else {
+        ++p;
+    }
+    if (p < token.size() && token[p] == '.') {
+        ++p;
+        if (magnitude == 0) {
+            while (p < token.size() && token[p] == '0') {
+                --magnitude;
+                ++p;
+            }
+        }
+        while (p < token.size() && IsDigit(token[p])) {
+            ++p;
+        }
+    }
+    if (p < token.size() && (token[p] == 'e' || token[p] == 'E')) {
+        magnitude += std::strtol(std::string(token.substr(p + 1)).c_str(), nullptr, 10);
+    }
+    return magnitude;
+}
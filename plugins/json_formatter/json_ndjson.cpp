@@ -0,0 +1,141 @@
+#include "json_ndjson.h"
+
+#include <cstring>
+#include <utility>
+
+#include "background_job.h"
+#include "json_canonical.h"
+#include "json_lexing.h"
+#include "json_structural_index.h"
+#include "output_sink.h"
+#include "parallel_for.h"
+
+namespace {
+
+// Work item size. Large enough to amortize the hand-off, small enough for
+// the waves to balance across cores.
+constexpr size_t kChunkBytes = 1024 * 1024;
+// Chunks per worker in one wave; output of a wave is held in memory until
+// it is written in order.
+constexpr size_t kChunksPerWorker = 4;
+constexpr size_t kMaxReportedErrors = 1000;
+
+struct ChunkOutput {
+    std::string text;
+    std::vector<NdjsonError> errors; // Lines relative to the chunk start.
+    size_t lines = 0;
+    size_t records = 0;
+    size_t error_count = 0;
+};
+
+std::string_view TrimJsonWhitespace(std::string_view text) {
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && IsJsonWhitespace(text[begin])) {
+        ++begin;
+    }
+    while (end > begin && IsJsonWhitespace(text[end - 1])) {
+        --end;
+    }
+    return text.substr(begin, end - begin);
+}
+
+void ProcessChunk(std::string_view chunk,
+                  NdjsonOutput output,
+                  const JsonFormatOptions& options,
+                  ChunkOutput& result,
+                  JobContext* job) {
+    StringSink sink(result.text);
+    if (output != NdjsonOutput::None) {
+        result.text.reserve(output == NdjsonOutput::Formatted ? chunk.size() * 2 : chunk.size());
+    }
+    size_t pos = 0;
+    while (pos < chunk.size()) {
+        if (job && job->Cancelled()) {
+            return;
+        }
+        const char* newline = static_cast<const char*>(std::memchr(chunk.data() + pos, '\n', chunk.size() - pos));
+        const size_t end = newline ? static_cast<size_t>(newline - chunk.data()) : chunk.size();
+        const std::string_view record = TrimJsonWhitespace(chunk.substr(pos, end - pos));
+        pos = end + 1;
+        ++result.lines;
+        if (record.empty()) {
+            continue;
+        }
+        ++result.records;
+        const size_t mark = result.text.size();
+        JsonFormatResult status;
+        if (output == NdjsonOutput::Formatted) {
+            status = FormatJsonStream(record, options, sink);
+        } else if (output == NdjsonOutput::Canonical) {
+            status = CanonicalizeJson(record, sink);
+        } else {
+            status = ValidateJson(record);
+            if (status.ok && output == NdjsonOutput::Minified) {
+                MinifyJson(record, sink);
+            }
+        }
+        if (!status.ok) {
+            result.text.resize(mark);
+            if (result.error_count++ < kMaxReportedErrors) {
+                result.errors.push_back(NdjsonError{result.lines, std::move(status.error)});
+            }
+        } else if (output != NdjsonOutput::None) {
+            sink.Put('\n');
+        }
+    }
+}
+
+} // namespace
+
+NdjsonResult ProcessNdjson(std::string_view input,
+                           NdjsonOutput output,
+                           const JsonFormatOptions& options,
+                           OutputSink& out,
+                           JobContext* job) {
+    NdjsonResult result;
+    const size_t wave_chunks = WorkerCount() * kChunksPerWorker;
+    std::vector<std::string_view> chunks;
+    std::vector<ChunkOutput> outputs;
+    size_t line_base = 0;
+    size_t cursor = 0;
+    while (cursor < input.size()) {
+        chunks.clear();
+        while (cursor < input.size() && chunks.size() < wave_chunks) {
+            size_t end = input.size();
+            if (input.size() - cursor > kChunkBytes) {
+                const char* newline = static_cast<const char*>(
+                    std::memchr(input.data() + cursor + kChunkBytes, '\n', input.size() - cursor - kChunkBytes));
+                end = newline ? static_cast<size_t>(newline - input.data()) + 1 : input.size();
+            }
+            chunks.push_back(input.substr(cursor, end - cursor));
+            cursor = end;
+        }
+
+        outputs.clear();
+        outputs.resize(chunks.size());
+        ParallelFor(chunks.size(), [&](size_t i) { ProcessChunk(chunks[i], output, options, outputs[i], job); });
+        if (job && job->Cancelled()) {
+            result.cancelled = true;
+            return result;
+        }
+
+        for (ChunkOutput& chunk : outputs) {
+            out.Append(chunk.text);
+            for (NdjsonError& error : chunk.errors) {
+                if (result.errors.size() < kMaxReportedErrors) {
+                    error.line += line_base;
+                    result.errors.push_back(std::move(error));
+                }
+            }
+            result.records += chunk.records;
+            result.error_count += chunk.error_count;
+            line_base += chunk.lines;
+        }
+        if (job) {
+            job->ReportProgress(cursor);
+        }
+    }
+    result.write_failed = !out.Finish();
+    return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json_stream_formatter.h"
+
+class JobContext;
+class OutputSink;
+
+enum class NdjsonOutput {
+    Formatted, // Each record re-indented, records separated by a newline.
+    Minified,  // One compact record per line.
+    Canonical, // One RFC 8785 canonical record per line.
+    None       // Validate only.
+};
+
+struct NdjsonError {
+    size_t line = 0; // One-based input line.
+    std::string message;
+};
+
+struct NdjsonResult {
+    size_t records = 0;
+    size_t error_count = 0;
+    // The first few errors; error_count has the total.
+    std::vector<NdjsonError> errors;
+    bool cancelled = false;
+    bool write_failed = false;
+};
+
+// Treats every non-blank line of `input` as its own JSON document (NDJSON /
+// JSON Lines). The input is cut into chunks at line boundaries and the
+// chunks are validated and written on all cores, a few waves at a time so
+// that pending output stays bounded. Output keeps the input order. Records
+// that fail are left out and reported with their line numbers.
+NdjsonResult ProcessNdjson(std::string_view input,
+                           NdjsonOutput output,
+                           const JsonFormatOptions& options,
+                           OutputSink& out,
+                           JobContext* job = nullptr);
@@ -0,0 +1,871 @@
+#include "json_path.h"
+
+#include <charconv>
+#include <cstdio>
+#include <utility>
+
+#include "background_job.h"
+#include "json_lexing.h"
+#include "json_tape.h"
+
+namespace {
+
+constexpr size_t kJobCheckMask = 0xFFFF;
+
+bool IsNameFirst(char c) {
+    const auto u = static_cast<unsigned char>(c);
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || u >= 0x80;
+}
+
+bool IsNameChar(char c) {
+    return IsNameFirst(c) || IsDigit(c);
+}
+
+bool IsContainer(JsonKind kind) {
+    return kind == JsonKind::Object || kind == JsonKind::Array;
+}
+
+double ParseNumber(std::string_view text) {
+    double value = 0.0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+} // namespace
+
+class JsonPath::Parser {
+public:
+    Parser(JsonPath& path, std::string_view text) : path_(path), text_(text) {}
+
+    bool Parse(std::string& error) {
+        SkipSpace();
+        if (!Consume('$')) {
+            Fail("'$'");
+        } else if (ParseSegments(path_.query_)) {
+            SkipSpace();
+            if (pos_ < text_.size()) {
+                Fail("end of expression");
+            }
+        }
+        error = error_;
+        return error_.empty();
+    }
+
+private:
+    bool Fail(const char* expected) {
+        if (!error_.empty()) {
+            return false;
+        }
+        char got[32];
+        if (pos_ >= text_.size()) {
+            std::snprintf(got, sizeof(got), "%s", "end of expression");
+        } else {
+            std::snprintf(got, sizeof(got), "'%c'", text_[pos_]);
+        }
+        char message[128];
+        std::snprintf(message, sizeof(message), "unexpected %s at position %zu; expected %s", got, pos_,
+                      expected);
+        error_ = message;
+        return false;
+    }
+
+    char Peek() const {
+        return pos_ < text_.size() ? text_[pos_] : '\0';
+    }
+
+    void SkipSpace() {
+        while (pos_ < text_.size() && IsJsonWhitespace(text_[pos_])) {
+            ++pos_;
+        }
+    }
+
+    bool Consume(char c) {
+        if (Peek() != c) {
+            return false;
+        }
+        ++pos_;
+        return true;
+    }
+
+    bool Consume(std::string_view token) {
+        if (text_.substr(pos_, token.size()) != token) {
+            return false;
+        }
+        pos_ += token.size();
+        return true;
+    }
+
+    bool ParseSegments(Query& query);
+    bool ParseBracket(Segment& segment);
+    bool ParseSelector(Selector& selector);
+    bool ParseName(std::string& name);
+    bool ParseString(std::string& out);
+    bool ParseInteger(int64_t& value, bool& present);
+    bool ParseOr(int& node);
+    bool ParseAnd(int& node);
+    bool ParseBasic(int& node);
+    bool ParseComparable(int& operand);
+
+    int AddNode(FilterNode::Op op, int left, int right) {
+        FilterNode node;
+        node.op = op;
+        node.left = left;
+        node.right = right;
+        path_.nodes_.push_back(node);
+        return static_cast<int>(path_.nodes_.size() - 1);
+    }
+
+    JsonPath& path_;
+    std::string_view text_;
+    size_t pos_ = 0;
+    std::string error_;
+};
+
+bool JsonPath::Parser::ParseSegments(Query& query) {
+    while (true) {
+        const size_t before = pos_;
+        SkipSpace();
+        Segment segment;
+        if (Consume("..")) {
+            segment.descendant = true;
+            if (Peek() == '[') {
+                if (!ParseBracket(segment)) {
+                    return false;
+                }
+            } else {
+                Selector selector;
+                if (!Consume('*')) {
+                    selector.kind = Selector::Kind::Name;
+                    if (!ParseName(selector.name)) {
+                        return false;
+                    }
+                }
+                segment.selectors.push_back(std::move(selector));
+            }
+        } else if (Consume('.')) {
+            Selector selector;
+            if (!Consume('*')) {
+                selector.kind = Selector::Kind::Name;
+                if (!ParseName(selector.name)) {
+                    return false;
+                }
+            }
+            segment.selectors.push_back(std::move(selector));
+        } else if (Peek() == '[') {
+            if (!ParseBracket(segment)) {
+                return false;
+            }
+        } else {
+            pos_ = before;
+            return true;
+        }
+        query.push_back(std::move(segment));
+    }
+}
+
+bool JsonPath::Parser::ParseBracket(Segment& segment) {
+    ++pos_;
+    do {
+        SkipSpace();
+        Selector selector;
+        if (!ParseSelector(selector)) {
+            return false;
+        }
+        segment.selectors.push_back(std::move(selector));
+        SkipSpace();
+    } while (Consume(','));
+    return Consume(']') || Fail("',' or ']'");
+}
+
+bool JsonPath::Parser::ParseSelector(Selector& selector) {
+    const char c = Peek();
+    if (c == '\'' || c == '"') {
+        selector.kind = Selector::Kind::Name;
+        return ParseString(selector.name);
+    }
+    if (Consume('*')) {
+        selector.kind = Selector::Kind::Wildcard;
+        return true;
+    }
+    if (Consume('?')) {
+        selector.kind = Selector::Kind::Filter;
+        return ParseOr(selector.filter);
+    }
+    if (!ParseInteger(selector.start, selector.has_start)) {
+        return false;
+    }
+    SkipSpace();
+    if (!Consume(':')) {
+        if (!selector.has_start) {
+            return Fail("selector");
+        }
+        selector.kind = Selector::Kind::Index;
+        return true;
+    }
+    selector.kind = Selector::Kind::Slice;
+    SkipSpace();
+    if (!ParseInteger(selector.end, selector.has_end)) {
+        return false;
+    }
+    SkipSpace();
+    if (Consume(':')) {
+        SkipSpace();
+        bool has_step = false;
+        if (!ParseInteger(selector.step, has_step)) {
+            return false;
+        }
+        if (!has_step) {
+            selector.step = 1;
+        }
+    }
+    return true;
+}
+
+bool JsonPath::Parser::ParseName(std::string& name) {
+    if (!IsNameFirst(Peek())) {
+        return Fail("member name");
+    }
+    const size_t start = pos_;
+    while (pos_ < text_.size() && IsNameChar(text_[pos_])) {
+        ++pos_;
+    }
+    name.assign(text_.substr(start, pos_ - start));
+    return true;
+}
+
+bool JsonPath::Parser::ParseString(std::string& out) {
+    const char quote = text_[pos_++];
+    out.clear();
+    while (pos_ < text_.size()) {
+        const char c = text_[pos_++];
+        if (c == quote) {
+            return true;
+        }
+        if (c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        const char esc = Peek();
+        ++pos_;
+        switch (esc) {
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case '/':
+            case '\\':
+            case '\'':
+            case '"':
+                out.push_back(esc);
+                break;
+            case 'u': {
+                unsigned code = 0;
+                for (int i = 0; i < 4; ++i, ++pos_) {
+                    if (!IsHexDigit(Peek())) {
+                        return Fail("hex digit");
+                    }
+                    code = (code << 4) | HexValue(text_[pos_]);
+                }
+                if (code >= 0xD800 && code <= 0xDBFF && Consume("\\u")) {
+                    unsigned low = 0;
+                    for (int i = 0; i < 4; ++i, ++pos_) {
+                        if (!IsHexDigit(Peek())) {
+                            return Fail("hex digit");
+                        }
+                        low = (low << 4) | HexValue(text_[pos_]);
+                    }
+                    if (low < 0xDC00 || low > 0xDFFF) {
+                        return Fail("low surrogate");
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                AppendUtf8(out, code);
+                break;
+            }
+            default:
+                --pos_;
+                return Fail("escape sequence");
+        }
+    }
+    return Fail("closing quote");
+}
+
+bool JsonPath::Parser::ParseInteger(int64_t& value, bool& present) {
+    const size_t start = pos_;
+    Consume('-');
+    if (!IsDigit(Peek())) {
+        pos_ = start;
+        present = false;
+        return true;
+    }
+    while (IsDigit(Peek())) {
+        ++pos_;
+    }
+    const auto parsed = std::from_chars(text_.data() + start, text_.data() + pos_, value);
+    if (parsed.ec != std::errc()) {
+        pos_ = start;
+        return Fail("integer in range");
+    }
+    present = true;
+    return true;
+}
+
+bool JsonPath::Parser::ParseOr(int& node) {
+    if (!ParseAnd(node)) {
+        return false;
+    }
+    while (true) {
+        SkipSpace();
+        if (!Consume("||")) {
+            return true;
+        }
+        int right = -1;
+        if (!ParseAnd(right)) {
+            return false;
+        }
+        node = AddNode(FilterNode::Op::Or, node, right);
+    }
+}
+
+bool JsonPath::Parser::ParseAnd(int& node) {
+    if (!ParseBasic(node)) {
+        return false;
+    }
+    while (true) {
+        SkipSpace();
+        if (!Consume("&&")) {
+            return true;
+        }
+        int right = -1;
+        if (!ParseBasic(right)) {
+            return false;
+        }
+        node = AddNode(FilterNode::Op::And, node, right);
+    }
+}
+
+bool JsonPath::Parser::ParseBasic(int& node) {
+    SkipSpace();
+    const bool negate = Consume('!');
+    SkipSpace();
+    if (Consume('(')) {
+        if (!ParseOr(node)) {
+            return false;
+        }
+        SkipSpace();
+        if (!Consume(')')) {
+            return Fail("')'");
+        }
+    } else {
+        int left = -1;
+        if (!ParseComparable(left)) {
+            return false;
+        }
+        SkipSpace();
+        CompareOp op = CompareOp::Equal;
+        if (Consume("==")) {
+            op = CompareOp::Equal;
+        } else if (Consume("!=")) {
+            op = CompareOp::NotEqual;
+        } else if (Consume("<=")) {
+            op = CompareOp::LessEqual;
+        } else if (Consume(">=")) {
+            op = CompareOp::GreaterEqual;
+        } else if (Consume('<')) {
+            op = CompareOp::Less;
+        } else if (Consume('>')) {
+            op = CompareOp::Greater;
+        } else {
+            const Operand::Kind kind = path_.operands_[static_cast<size_t>(left)].kind;
+            if (kind != Operand::Kind::Current && kind != Operand::Kind::Root) {
+                return Fail("comparison operator");
+            }
+            node = AddNode(FilterNode::Op::Exists, left, -1);
+            if (negate) {
+                node = AddNode(FilterNode::Op::Not, node, -1);
+            }
+            return true;
+        }
+        int right = -1;
+        if (!ParseComparable(right)) {
+            return false;
+        }
+        node = AddNode(FilterNode::Op::Compare, left, right);
+        path_.nodes_[static_cast<size_t>(node)].compare = op;
+    }
+    if (negate) {
+        node = AddNode(FilterNode::Op::Not, node, -1);
+    }
+    return true;
+}
+
+bool JsonPath::Parser::ParseComparable(int& operand) {
+    SkipSpace();
+    Operand value;
+    const char c = Peek();
+    if (c == '@' || c == '$') {
+        ++pos_;
+        value.kind = c == '@' ? Operand::Kind::Current : Operand::Kind::Root;
+        if (!ParseSegments(value.query)) {
+            return false;
+        }
+    } else if (c == '\'' || c == '"') {
+        value.kind = Operand::Kind::String;
+        if (!ParseString(value.text)) {
+            return false;
+        }
+    } else if (Consume("true")) {
+        value.kind = Operand::Kind::True;
+    } else if (Consume("false")) {
+        value.kind = Operand::Kind::False;
+    } else if (Consume("null")) {
+        value.kind = Operand::Kind::Null;
+    } else if (c == '-' || IsDigit(c)) {
+        const size_t length = ScanJsonNumber(text_.substr(pos_));
+        if (length == 0) {
+            return Fail("number");
+        }
+        value.kind = Operand::Kind::Number;
+        value.number = ParseNumber(text_.substr(pos_, length));
+        pos_ += length;
+    } else {
+        return Fail("value or query");
+    }
+    path_.operands_.push_back(std::move(value));
+    operand = static_cast<int>(path_.operands_.size() - 1);
+    return true;
+}
+
+class JsonPath::Evaluator {
+public:
+    Evaluator(const JsonPath& path, const JsonTape& tape, JobContext* job)
+        : path_(path), tape_(tape), job_(job), roots_(path.operands_.size()) {}
+
+    // Runs `query` from `start`, appending matches to `out`. Returns false
+    // once the job is cancelled.
+    bool Run(const Query& query, uint32_t start, std::vector<uint32_t>& out);
+
+private:
+    // One side of a filter comparison: a single node, a literal or nothing.
+    struct Value {
+        bool present = false;
+        bool literal = false;
+        uint32_t entry = 0;
+        const Operand* operand = nullptr;
+    };
+
+    // A "$" query in a filter gives the same nodes for every candidate, so
+    // it runs once and is kept here, indexed like path_.operands_.
+    struct RootResult {
+        bool resolved = false;
+        bool exists = false;
+        Value value;
+    };
+
+    bool Tick() {
+        if (job_ && (++visited_ & kJobCheckMask) == 0 && job_->Cancelled()) {
+            cancelled_ = true;
+        }
+        return !cancelled_;
+    }
+
+    void ApplySegment(const Segment& segment, uint32_t node, std::vector<uint32_t>& out);
+    void Select(const Selector& selector, uint32_t node, std::vector<uint32_t>& out);
+    void SelectSlice(const Selector& selector, uint32_t node, std::vector<uint32_t>& out);
+    bool KeyMatches(uint32_t key, std::string_view name);
+    std::string_view Decoded(uint32_t entry, std::string& storage) const;
+    bool Test(int node, uint32_t current);
+    Value Resolve(int index, uint32_t current);
+    const RootResult& ResolveRoot(int index);
+    JsonKind KindOf(const Value& value) const;
+    double NumberOf(const Value& value) const;
+    bool Equal(const Value& a, const Value& b);
+    bool Less(const Value& a, const Value& b);
+    bool DeepEqual(uint32_t a, uint32_t b);
+
+    const JsonPath& path_;
+    const JsonTape& tape_;
+    JobContext* job_;
+    size_t visited_ = 0;
+    bool cancelled_ = false;
+    std::string key_storage_;
+    std::vector<RootResult> roots_;
+};
+
+bool JsonPath::Evaluator::Run(const Query& query, uint32_t start, std::vector<uint32_t>& out) {
+    std::vector<uint32_t> current{start};
+    std::vector<uint32_t> next;
+    for (const Segment& segment : query) {
+        next.clear();
+        for (uint32_t node : current) {
+            ApplySegment(segment, node, next);
+            if (cancelled_) {
+                return false;
+            }
+        }
+        current.swap(next);
+        if (current.empty()) {
+            break;
+        }
+    }
+    out.insert(out.end(), current.begin(), current.end());
+    return !cancelled_;
+}
+
+void JsonPath::Evaluator::ApplySegment(const Segment& segment, uint32_t node, std::vector<uint32_t>& out) {
+    for (const Selector& selector : segment.selectors) {
+        Select(selector, node, out);
+    }
+    if (!segment.descendant) {
+        return;
+    }
+    // Subtrees are contiguous and keys are always strings, so every
+    // container inside [node, next) is a descendant value, already in
+    // document order.
+    const uint32_t end = tape_.next(node);
+    for (uint32_t entry = node + 1; entry < end && Tick(); ++entry) {
+        if (IsContainer(tape_.kind(entry))) {
+            for (const Selector& selector : segment.selectors) {
+                Select(selector, entry, out);
+            }
+        }
+    }
+}
+
+void JsonPath::Evaluator::Select(const Selector& selector, uint32_t node, std::vector<uint32_t>& out) {
+    const JsonKind kind = tape_.kind(node);
+    if (!IsContainer(kind)) {
+        return;
+    }
+    const bool object = kind == JsonKind::Object;
+    const uint32_t end = tape_.next(node);
+    switch (selector.kind) {
+        case Selector::Kind::Name:
+            if (object) {
+                for (uint32_t key = node + 1; key < end && Tick(); key = tape_.next(key + 1)) {
+                    if (KeyMatches(key, selector.name)) {
+                        out.push_back(key + 1);
+                    }
+                }
+            }
+            return;
+        case Selector::Kind::Wildcard:
+        case Selector::Kind::Filter:
+            for (uint32_t child = node + 1; child < end && Tick();) {
+                const uint32_t value = object ? child + 1 : child;
+                if (selector.kind == Selector::Kind::Wildcard || Test(selector.filter, value)) {
+                    out.push_back(value);
+                }
+                child = tape_.next(value);
+            }
+            return;
+        case Selector::Kind::Index: {
+            if (object) {
+                return;
+            }
+            int64_t target = selector.start;
+            if (target < 0) {
+                int64_t count = 0;
+                for (uint32_t child = node + 1; child < end; child = tape_.next(child)) {
+                    ++count;
+                }
+                target += count;
+                if (target < 0) {
+                    return;
+                }
+            }
+            uint32_t child = node + 1;
+            for (int64_t i = 0; i < target && child < end && Tick(); ++i) {
+                child = tape_.next(child);
+            }
+            if (child < end) {
+                out.push_back(child);
+            }
+            return;
+        }
+        case Selector::Kind::Slice:
+            if (!object) {
+                SelectSlice(selector, node, out);
+            }
+            return;
+    }
+}
+
+void JsonPath::Evaluator::SelectSlice(const Selector& selector, uint32_t node, std::vector<uint32_t>& out) {
+    if (selector.step == 0) {
+        return;
+    }
+    std::vector<uint32_t> elements;
+    const uint32_t end = tape_.next(node);
+    for (uint32_t child = node + 1; child < end && Tick(); child = tape_.next(child)) {
+        elements.push_back(child);
+    }
+    const auto count = static_cast<int64_t>(elements.size());
+    const auto normalize = [count](int64_t i) { return i >= 0 ? i : count + i; };
+    const int64_t step = selector.step;
+    if (step > 0) {
+        int64_t lower = selector.has_start ? normalize(selector.start) : 0;
+        int64_t upper = selector.has_end ? normalize(selector.end) : count;
+        lower = lower < 0 ? 0 : (lower > count ? count : lower);
+        upper = upper < 0 ? 0 : (upper > count ? count : upper);
+        for (int64_t i = lower; i < upper; i += step) {
+            out.push_back(elements[static_cast<size_t>(i)]);
+        }
+    } else {
+        int64_t upper = selector.has_start ? normalize(selector.start) : count - 1;
+        int64_t lower = selector.has_end ? normalize(selector.end) : -count - 1;
+        upper = upper < -1 ? -1 : (upper > count - 1 ? count - 1 : upper);
+        lower = lower < -1 ? -1 : (lower > count - 1 ? count - 1 : lower);
+        for (int64_t i = upper; i > lower; i += step) {
+            out.push_back(elements[static_cast<size_t>(i)]);
+        }
+    }
+}
+
+std::string_view JsonPath::Evaluator::Decoded(uint32_t entry, std::string& storage) const {
+    const std::string_view token = tape_.Token(entry);
+    const std::string_view body = token.substr(1, token.size() - 2);
+    if (body.find('\\') == std::string_view::npos) {
+        return body;
+    }
+    DecodeJsonString(body, storage);
+    return storage;
+}
+
+bool JsonPath::Evaluator::KeyMatches(uint32_t key, std::string_view name) {
+    return Decoded(key, key_storage_) == name;
+}
+
+bool JsonPath::Evaluator::Test(int node, uint32_t current) {
+    const FilterNode& filter = path_.nodes_[static_cast<size_t>(node)];
+    switch (filter.op) {
+        case FilterNode::Op::Or:
+            return Test(filter.left, current) || Test(filter.right, current);
+        case FilterNode::Op::And:
+            return Test(filter.left, current) && Test(filter.right, current);
+        case FilterNode::Op::Not:
+            return !Test(filter.left, current);
+        case FilterNode::Op::Exists: {
+            const Operand& operand = path_.operands_[static_cast<size_t>(filter.left)];
+            if (operand.kind == Operand::Kind::Root) {
+                return ResolveRoot(filter.left).exists;
+            }
+            std::vector<uint32_t> found;
+            Run(operand.query, current, found);
+            return !found.empty();
+        }
+        case FilterNode::Op::Compare: {
+            const Value a = Resolve(filter.left, current);
+            const Value b = Resolve(filter.right, current);
+            switch (filter.compare) {
+                case CompareOp::Equal:
+                    return Equal(a, b);
+                case CompareOp::NotEqual:
+                    return !Equal(a, b);
+                case CompareOp::Less:
+                    return Less(a, b);
+                case CompareOp::LessEqual:
+                    return Less(a, b) || Equal(a, b);
+                case CompareOp::Greater:
+                    return Less(b, a);
+                case CompareOp::GreaterEqual:
+                    return Less(b, a) || Equal(a, b);
+            }
+        }
+    }
+    return false;
+}
+
+JsonPath::Evaluator::Value JsonPath::Evaluator::Resolve(int index, uint32_t current) {
+    const Operand& operand = path_.operands_[static_cast<size_t>(index)];
+    Value value;
+    if (operand.kind == Operand::Kind::Root) {
+        return ResolveRoot(index).value;
+    }
+    if (operand.kind != Operand::Kind::Current) {
+        value.present = true;
+        value.literal = true;
+        value.operand = &operand;
+        return value;
+    }
+    std::vector<uint32_t> found;
+    Run(operand.query, current, found);
+    // Comparisons need exactly one node; anything else compares as nothing.
+    if (found.size() == 1) {
+        value.present = true;
+        value.entry = found[0];
+    }
+    return value;
+}
+
+const JsonPath::Evaluator::RootResult& JsonPath::Evaluator::ResolveRoot(int index) {
+    RootResult& root = roots_[static_cast<size_t>(index)];
+    if (!root.resolved) {
+        std::vector<uint32_t> found;
+        // A cancelled run stops the whole evaluation, so its partial
+        // result is never used.
+        Run(path_.operands_[static_cast<size_t>(index)].query, JsonTape::kRoot, found);
+        root.resolved = true;
+        root.exists = !found.empty();
+        if (found.size() == 1) {
+            root.value.present = true;
+            root.value.entry = found[0];
+        }
+    }
+    return root;
+}
+
+JsonKind JsonPath::Evaluator::KindOf(const Value& value) const {
+    if (!value.literal) {
+        return tape_.kind(value.entry);
+    }
+    switch (value.operand->kind) {
+        case Operand::Kind::Number:
+            return JsonKind::Number;
+        case Operand::Kind::String:
+            return JsonKind::String;
+        case Operand::Kind::True:
+            return JsonKind::True;
+        case Operand::Kind::False:
+            return JsonKind::False;
+        default:
+            return JsonKind::Null;
+    }
+}
+
+double JsonPath::Evaluator::NumberOf(const Value& value) const {
+    return value.literal ? value.operand->number : ParseNumber(tape_.Token(value.entry));
+}
+
+bool JsonPath::Evaluator::Equal(const Value& a, const Value& b) {
+    if (!a.present || !b.present) {
+        return a.present == b.present;
+    }
+    const JsonKind kind = KindOf(a);
+    if (kind != KindOf(b)) {
+        return false;
+    }
+    switch (kind) {
+        case JsonKind::Number:
+            return NumberOf(a) == NumberOf(b);
+        case JsonKind::String: {
+            std::string a_storage;
+            std::string b_storage;
+            const std::string_view a_text = a.literal ? a.operand->text : Decoded(a.entry, a_storage);
+            const std::string_view b_text = b.literal ? b.operand->text : Decoded(b.entry, b_storage);
+            return a_text == b_text;
+        }
+        case JsonKind::Object:
+        case JsonKind::Array:
+            return DeepEqual(a.entry, b.entry);
+        default:
+            return true;
+    }
+}
+
+bool JsonPath::Evaluator::Less(const Value& a, const Value& b) {
+    if (!a.present || !b.present) {
+        return false;
+    }
+    const JsonKind kind = KindOf(a);
+    if (kind != KindOf(b)) {
+        return false;
+    }
+    if (kind == JsonKind::Number) {
+        return NumberOf(a) < NumberOf(b);
+    }
+    if (kind == JsonKind::String) {
+        std::string a_storage;
+        std::string b_storage;
+        const std::string_view a_text = a.literal ? a.operand->text : Decoded(a.entry, a_storage);
+        const std::string_view b_text = b.literal ? b.operand->text : Decoded(b.entry, b_storage);
+        return a_text < b_text;
+    }
+    return false;
+}
+
+bool JsonPath::Evaluator::DeepEqual(uint32_t a, uint32_t b) {
+    Value left;
+    left.present = true;
+    left.entry = a;
+    Value right = left;
+    right.entry = b;
+    const JsonKind kind = tape_.kind(a);
+    if (kind != tape_.kind(b)) {
+        return false;
+    }
+    if (!IsContainer(kind)) {
+        return Equal(left, right);
+    }
+    const uint32_t a_end = tape_.next(a);
+    const uint32_t b_end = tape_.next(b);
+    if (kind == JsonKind::Array) {
+        uint32_t x = a + 1;
+        uint32_t y = b + 1;
+        for (; x < a_end && y < b_end; x = tape_.next(x), y = tape_.next(y)) {
+            if (!DeepEqual(x, y)) {
+                return false;
+            }
+        }
+        return x >= a_end && y >= b_end;
+    }
+    size_t a_keys = 0;
+    size_t b_keys = 0;
+    for (uint32_t key = a + 1; key < a_end; key = tape_.next(key + 1)) {
+        ++a_keys;
+    }
+    for (uint32_t key = b + 1; key < b_end; key = tape_.next(key + 1)) {
+        ++b_keys;
+    }
+    if (a_keys != b_keys) {
+        return false;
+    }
+    std::string name_storage;
+    for (uint32_t key = a + 1; key < a_end; key = tape_.next(key + 1)) {
+        const std::string name(Decoded(key, name_storage));
+        bool matched = false;
+        for (uint32_t other = b + 1; other < b_end; other = tape_.next(other + 1)) {
+            if (KeyMatches(other, name)) {
+                matched = DeepEqual(key + 1, other + 1);
+                break;
+            }
+        }
+        if (!matched) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonPath::Compile(std::string_view expression, std::string& error) {
+    query_.clear();
+    nodes_.clear();
+    operands_.clear();
+    Parser parser(*this, expression);
+    compiled_ = parser.Parse(error);
+    if (!compiled_) {
+        query_.clear();
+        nodes_.clear();
+        operands_.clear();
+    }
+    return compiled_;
+}
+
+bool JsonPath::Evaluate(const JsonTape& tape, std::vector<uint32_t>& matches, JobContext* job) const {
+    if (!compiled_ || tape.empty()) {
+        return true;
+    }
+    Evaluator evaluator(*this, tape, job);
+    return evaluator.Run(query_, JsonTape::kRoot, matches);
+}
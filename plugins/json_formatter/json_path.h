@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JobContext;
+class JsonTape;
+
+// JSONPath expression (RFC 9535 syntax) compiled once and evaluated against
+// a JsonTape. Supported: `$`, `.name`, `['name']`, `*`, `[n]`, `[a:b:c]`,
+// unions, `..` descendants and `[?...]` filters with existence tests,
+// comparisons, `&&`, `||` and `!`. Goessner-style `[?(...)]` is accepted
+// as well. Evaluation walks the tape and jumps over subtrees that cannot
+// match, so nothing is materialized.
+class JsonPath {
+public:
+    bool Compile(std::string_view expression, std::string& error);
+
+    // Appends the matching entries to `matches` in selection order. Returns
+    // false if the job was cancelled.
+    bool Evaluate(const JsonTape& tape, std::vector<uint32_t>& matches, JobContext* job = nullptr) const;
+
+    bool compiled() const {
+        return compiled_;
+    }
+
+private:
+    struct Selector {
+        enum class Kind : uint8_t {
+            Name,
+            Wildcard,
+            Index,
+            Slice,
+            Filter
+        };
+        Kind kind = Kind::Wildcard;
+        bool has_start = false;
+        bool has_end = false;
+        int64_t start = 0; // Index value, or slice start.
+        int64_t end = 0;
+        int64_t step = 1;
+        int filter = -1;   // Root of the filter expression in nodes_.
+        std::string name;  // Decoded member name.
+    };
+
+    struct Segment {
+        bool descendant = false;
+        std::vector<Selector> selectors;
+    };
+
+    using Query = std::vector<Segment>;
+
+    struct Operand {
+        enum class Kind : uint8_t {
+            Current, // @...
+            Root,    // $...
+            Number,
+            String,
+            True,
+            False,
+            Null
+        };
+        Kind kind = Kind::Null;
+        Query query;
+        double number = 0.0;
+        std::string text;
+    };
+
+    enum class CompareOp : uint8_t {
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual
+    };
+
+    struct FilterNode {
+        enum class Op : uint8_t {
+            Or,
+            And,
+            Not,
+            Exists,
+            Compare
+        };
+        Op op = Op::Exists;
+        CompareOp compare = CompareOp::Equal;
+        // Child nodes for Or/And/Not, operand indices for Exists/Compare.
+        int left = -1;
+        int right = -1;
+    };
+
+    class Parser;
+    class Evaluator;
+
+    Query query_;
+    std::vector<FilterNode> nodes_;
+    std::vector<Operand> operands_;
+    bool compiled_ = false;
+};
@@ -0,0 +1,826 @@
+#include "json_pattern.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Code point standing for "before the start" or "past the end" of the text.
+constexpr uint32_t kNone = UINT32_MAX;
+constexpr uint32_t kMaxCodePoint = 0x10FFFF;
+// Limits on what a schema may ask for; both are far past real patterns.
+constexpr size_t kMaxProgramSize = 20000;
+constexpr int kMaxNesting = 200;
+constexpr int kUnbounded = -1;
+
+bool IsWordChar(uint32_t cp) {
+    return (cp >= '0' && cp <= '9') || (cp >= 'A' && cp <= 'Z') || (cp >= 'a' && cp <= 'z') || cp == '_';
+}
+
+bool IsLineTerminator(uint32_t cp) {
+    return cp == '\n' || cp == '\r' || cp == 0x2028 || cp == 0x2029;
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Decodes the code point at text[i] into `length` bytes; a malformed
+// sequence yields its first byte on its own.
+uint32_t DecodeAt(std::string_view text, size_t i, size_t& length) {
+    const auto byte = [&](size_t k) { return static_cast<unsigned char>(text[k]); };
+    const unsigned char lead = byte(i);
+    length = 1;
+    if (lead < 0x80) {
+        return lead;
+    }
+    const size_t trail = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+    if (trail == 0 || text.size() - i <= trail) {
+        return lead;
+    }
+    uint32_t cp = lead & (0x3Fu >> trail);
+    for (size_t k = 1; k <= trail; ++k) {
+        if ((byte(i + k) & 0xC0) != 0x80) {
+            return lead;
+        }
+        cp = (cp << 6) | (byte(i + k) & 0x3F);
+    }
+    length = trail + 1;
+    return cp;
+}
+
+} // namespace
+
+// Recursive descent over the pattern into a small syntax tree, then a
+// Thompson-style program from the tree. Counted repeats are expanded, which
+// is what kMaxProgramSize bounds.
+class JsonPattern::Parser {
+public:
+    Parser(std::string_view source, JsonPattern& pattern) : source_(source), pattern_(pattern) {}
+
+    // Returns false with `error` set, or with `unsupported` set when the
+    // pattern needs a feature only std::regex has.
+    bool Run(std::string& error, bool& unsupported) {
+        const int root = ParseAlternation(0);
+        if (root >= 0 && pos_ < source_.size()) {
+            Fail("unmatched ')'");
+        }
+        if (root >= 0 && !failed_) {
+            Emit(root);
+            Add({Op::Match, 0, 0});
+        }
+        if (failed_ || unsupported_) {
+            error = error_;
+            unsupported = unsupported_;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    enum class Kind : uint8_t { Empty, Char, Any, Class, Begin, End, WordBoundary, NotWordBoundary, Concat, Alternate, Repeat };
+
+    struct Node {
+        Kind kind = Kind::Empty;
+        uint32_t value = 0; // Code point for Char, class index for Class.
+        int min = 0;
+        int max = 0; // kUnbounded for no upper limit.
+        bool greedy = true;
+        std::vector<int> children;
+    };
+
+    // A single escape or class member: a code point or a set of ranges.
+    struct Atom {
+        bool is_set = false;
+        uint32_t cp = 0;
+        std::vector<Range> set;
+    };
+
+    bool AtEnd() const {
+        return pos_ >= source_.size();
+    }
+
+    char Peek(size_t ahead = 0) const {
+        return pos_ + ahead < source_.size() ? source_[pos_ + ahead] : '\0';
+    }
+
+    int Fail(std::string message) {
+        if (!failed_) {
+            failed_ = true;
+            error_ = std::move(message);
+        }
+        return -1;
+    }
+
+    int Unsupported() {
+        unsupported_ = true;
+        return -1;
+    }
+
+    bool Stopped() const {
+        return failed_ || unsupported_;
+    }
+
+    int AddNode(Node node) {
+        nodes_.push_back(std::move(node));
+        return static_cast<int>(nodes_.size() - 1);
+    }
+
+    int AddNode(Kind kind, uint32_t value = 0) {
+        Node node;
+        node.kind = kind;
+        node.value = value;
+        return AddNode(std::move(node));
+    }
+
+    int AddClass(std::vector<Range> ranges, bool negated) {
+        std::sort(ranges.begin(), ranges.end(),
+                  [](const Range& a, const Range& b) { return a.first < b.first; });
+        CharClass merged;
+        merged.negated = negated;
+        for (const Range& range : ranges) {
+            if (!merged.ranges.empty() && range.first <= merged.ranges.back().last + 1) {
+                merged.ranges.back().last = std::max(merged.ranges.back().last, range.last);
+            } else {
+                merged.ranges.push_back(range);
+            }
+        }
+        pattern_.classes_.push_back(std::move(merged));
+        return AddNode(Kind::Class, static_cast<uint32_t>(pattern_.classes_.size() - 1));
+    }
+
+    int ParseAlternation(int depth) {
+        if (depth > kMaxNesting) {
+            return Fail("pattern nests too deeply");
+        }
+        Node alternate;
+        alternate.kind = Kind::Alternate;
+        while (true) {
+            const int branch = ParseSequence(depth);
+            if (branch < 0) {
+                return -1;
+            }
+            alternate.children.push_back(branch);
+            if (Peek() != '|') {
+                break;
+            }
+            ++pos_;
+        }
+        if (alternate.children.size() == 1) {
+            return alternate.children.front();
+        }
+        return AddNode(std::move(alternate));
+    }
+
+    int ParseSequence(int depth) {
+        Node concat;
+        concat.kind = Kind::Concat;
+        while (!AtEnd() && Peek() != '|' && Peek() != ')') {
+            int atom = ParseAtom(depth);
+            if (atom < 0) {
+                return -1;
+            }
+            atom = ParseQuantifier(atom);
+            if (atom < 0) {
+                return -1;
+            }
+            concat.children.push_back(atom);
+        }
+        if (concat.children.empty()) {
+            return AddNode(Kind::Empty);
+        }
+        if (concat.children.size() == 1) {
+            return concat.children.front();
+        }
+        return AddNode(std::move(concat));
+    }
+
+    // Reads a decimal count for {n,m}, saturating far past any useful size.
+    bool ParseCount(size_t& at, int& value) const {
+        const size_t start = at;
+        value = 0;
+        while (at < source_.size() && source_[at] >= '0' && source_[at] <= '9') {
+            value = std::min(value * 10 + (source_[at] - '0'), 1000000);
+            ++at;
+        }
+        return at > start;
+    }
+
+    int ParseQuantifier(int atom) {
+        int min = 0;
+        int max = kUnbounded;
+        const char c = Peek();
+        if (c == '*') {
+            ++pos_;
+        } else if (c == '+') {
+            min = 1;
+            ++pos_;
+        } else if (c == '?') {
+            max = 1;
+            ++pos_;
+        } else if (c == '{') {
+            // A brace that does not form {n}, {n,} or {n,m} is a literal.
+            size_t at = pos_ + 1;
+            if (!ParseCount(at, min)) {
+                return atom;
+            }
+            max = min;
+            if (at < source_.size() && source_[at] == ',') {
+                ++at;
+                if (!ParseCount(at, max)) {
+                    max = kUnbounded;
+                }
+            }
+            if (at >= source_.size() || source_[at] != '}') {
+                return atom;
+            }
+            if (max != kUnbounded && max < min) {
+                return Fail("numbers out of order in {} quantifier");
+            }
+            pos_ = at + 1;
+        } else {
+            return atom;
+        }
+        const Kind kind = nodes_[static_cast<size_t>(atom)].kind;
+        if (kind == Kind::Begin || kind == Kind::End || kind == Kind::WordBoundary || kind == Kind::NotWordBoundary) {
+            return Fail("nothing to repeat");
+        }
+        Node repeat;
+        repeat.kind = Kind::Repeat;
+        repeat.min = min;
+        repeat.max = max;
+        if (Peek() == '?' && !AtEnd()) {
+            repeat.greedy = false;
+            ++pos_;
+        }
+        repeat.children.push_back(atom);
+        return AddNode(std::move(repeat));
+    }
+
+    int ParseAtom(int depth) {
+        const char c = Peek();
+        switch (c) {
+        case '^':
+            ++pos_;
+            return AddNode(Kind::Begin);
+        case '$':
+            ++pos_;
+            return AddNode(Kind::End);
+        case '.':
+            ++pos_;
+            return AddNode(Kind::Any);
+        case '*':
+        case '+':
+        case '?':
+            return Fail("nothing to repeat");
+        case '(':
+            return ParseGroup(depth);
+        case '[':
+            ++pos_;
+            return ParseClass();
+        case '\\': {
+            ++pos_;
+            if (Peek() == 'b' || Peek() == 'B') {
+                const bool negated = Peek() == 'B';
+                ++pos_;
+                return AddNode(negated ? Kind::NotWordBoundary : Kind::WordBoundary);
+            }
+            Atom atom;
+            if (!ParseEscape(atom)) {
+                return -1;
+            }
+            if (atom.is_set) {
+                return AddClass(std::move(atom.set), false);
+            }
+            return AddNode(Kind::Char, atom.cp);
+        }
+        default:
+            return AddNode(Kind::Char, ReadLiteral());
+        }
+    }
+
+    uint32_t ReadLiteral() {
+        size_t length = 1;
+        const uint32_t cp = DecodeAt(source_, pos_, length);
+        pos_ += length;
+        return cp;
+    }
+
+    int ParseGroup(int depth) {
+        ++pos_;
+        if (Peek() == '?') {
+            const char kind = Peek(1);
+            if (kind == ':') {
+                pos_ += 2;
+            } else if (kind == '=' || kind == '!' || (kind == '<' && (Peek(2) == '=' || Peek(2) == '!'))) {
+                return Unsupported();
+            } else if (kind == '<') {
+                // Named group; only backreferences would need the name.
+                const size_t close = source_.find('>', pos_ + 2);
+                if (close == std::string_view::npos || close == pos_ + 2) {
+                    return Fail("invalid group name");
+                }
+                pos_ = close + 1;
+            } else {
+                return Fail("invalid group");
+            }
+        }
+        const int inner = ParseAlternation(depth + 1);
+        if (inner < 0) {
+            return -1;
+        }
+        if (Peek() != ')' || AtEnd()) {
+            return Fail("missing ')'");
+        }
+        ++pos_;
+        return inner;
+    }
+
+    int ParseClass() {
+        bool negated = false;
+        if (Peek() == '^' && !AtEnd()) {
+            negated = true;
+            ++pos_;
+        }
+        std::vector<Range> ranges;
+        while (true) {
+            if (AtEnd()) {
+                return Fail("missing ']'");
+            }
+            if (Peek() == ']') {
+                ++pos_;
+                break;
+            }
+            Atom low;
+            if (!ParseClassAtom(low)) {
+                return -1;
+            }
+            if (Peek() == '-' && Peek(1) != ']' && pos_ + 1 < source_.size()) {
+                ++pos_;
+                Atom high;
+                if (!ParseClassAtom(high)) {
+                    return -1;
+                }
+                if (low.is_set || high.is_set) {
+                    return Fail("invalid range in character class");
+                }
+                if (low.cp > high.cp) {
+                    return Fail("range out of order in character class");
+                }
+                ranges.push_back({low.cp, high.cp});
+                continue;
+            }
+            if (low.is_set) {
+                ranges.insert(ranges.end(), low.set.begin(), low.set.end());
+            } else {
+                ranges.push_back({low.cp, low.cp});
+            }
+        }
+        return AddClass(std::move(ranges), negated);
+    }
+
+    bool ParseClassAtom(Atom& atom) {
+        if (Peek() != '\\') {
+            atom.cp = ReadLiteral();
+            return true;
+        }
+        ++pos_;
+        if (Peek() == 'b') {
+            ++pos_;
+            atom.cp = 0x08;
+            return true;
+        }
+        if (Peek() == '-') {
+            ++pos_;
+            atom.cp = '-';
+            return true;
+        }
+        return ParseEscape(atom);
+    }
+
+    static std::vector<Range> Complement(const std::vector<Range>& ranges) {
+        std::vector<Range> result;
+        uint32_t next = 0;
+        for (const Range& range : ranges) {
+            if (range.first > next) {
+                result.push_back({next, range.first - 1});
+            }
+            next = range.last + 1;
+        }
+        if (next <= kMaxCodePoint) {
+            result.push_back({next, kMaxCodePoint});
+        }
+        return result;
+    }
+
+    static std::vector<Range> BuiltinSet(char name) {
+        std::vector<Range> set;
+        switch (name) {
+        case 'd':
+            set = {{'0', '9'}};
+            break;
+        case 'w':
+            set = {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}};
+            break;
+        default:
+            // ECMAScript WhiteSpace and LineTerminator.
+            set = {{0x09, 0x0D},     {0x20, 0x20},     {0xA0, 0xA0},     {0x1680, 0x1680}, {0x2000, 0x200A},
+                   {0x2028, 0x2029}, {0x202F, 0x202F}, {0x205F, 0x205F}, {0x3000, 0x3000}, {0xFEFF, 0xFEFF}};
+            break;
+        }
+        return set;
+    }
+
+    // Reads four hex digits at pos_ + offset, or returns false.
+    bool ReadHex4(size_t offset, uint32_t& value) const {
+        value = 0;
+        for (size_t k = 0; k < 4; ++k) {
+            const int digit = HexValue(Peek(offset + k));
+            if (digit < 0 || pos_ + offset + k >= source_.size()) {
+                return false;
+            }
+            value = value * 16 + static_cast<uint32_t>(digit);
+        }
+        return true;
+    }
+
+    // Parses the escape after a backslash (pos_ is past the backslash).
+    bool ParseEscape(Atom& atom) {
+        if (AtEnd()) {
+            Fail("pattern ends with '\\'");
+            return false;
+        }
+        const char c = Peek();
+        switch (c) {
+        case 'd':
+        case 'D':
+        case 'w':
+        case 'W':
+        case 's':
+        case 'S': {
+            ++pos_;
+            const char lower = static_cast<char>(c | 0x20);
+            atom.is_set = true;
+            atom.set = c == lower ? BuiltinSet(lower) : Complement(BuiltinSet(lower));
+            return true;
+        }
+        case 'n':
+            ++pos_;
+            atom.cp = '\n';
+            return true;
+        case 'r':
+            ++pos_;
+            atom.cp = '\r';
+            return true;
+        case 't':
+            ++pos_;
+            atom.cp = '\t';
+            return true;
+        case 'f':
+            ++pos_;
+            atom.cp = '\f';
+            return true;
+        case 'v':
+            ++pos_;
+            atom.cp = '\v';
+            return true;
+        case 'x': {
+            const int high = HexValue(Peek(1));
+            const int low = HexValue(Peek(2));
+            if (high >= 0 && low >= 0 && pos_ + 2 < source_.size()) {
+                pos_ += 3;
+                atom.cp = static_cast<uint32_t>(high * 16 + low);
+            } else {
+                ++pos_;
+                atom.cp = 'x';
+            }
+            return true;
+        }
+        case 'u': {
+            uint32_t unit = 0;
+            if (!ReadHex4(1, unit)) {
+                ++pos_;
+                atom.cp = 'u';
+                return true;
+            }
+            pos_ += 5;
+            uint32_t trail = 0;
+            if (unit >= 0xD800 && unit <= 0xDBFF && Peek() == '\\' && Peek(1) == 'u' && ReadHex4(2, trail) &&
+                trail >= 0xDC00 && trail <= 0xDFFF) {
+                pos_ += 6;
+                unit = 0x10000 + ((unit - 0xD800) << 10) + (trail - 0xDC00);
+            }
+            atom.cp = unit;
+            return true;
+        }
+        case 'c': {
+            const char letter = Peek(1);
+            if ((letter >= 'a' && letter <= 'z') || (letter >= 'A' && letter <= 'Z')) {
+                pos_ += 2;
+                atom.cp = static_cast<uint32_t>(letter) % 32;
+            } else {
+                // Not a control escape: the backslash is a literal.
+                atom.cp = '\\';
+            }
+            return true;
+        }
+        case '0':
+            if (Peek(1) < '0' || Peek(1) > '9') {
+                ++pos_;
+                atom.cp = 0;
+                return true;
+            }
+            Unsupported();
+            return false;
+        case 'k':
+        case 'p':
+        case 'P':
+            Unsupported();
+            return false;
+        default:
+            if (c >= '1' && c <= '9') {
+                // Backreference (or a legacy octal escape inside a class).
+                Unsupported();
+                return false;
+            }
+            atom.cp = ReadLiteral();
+            return true;
+        }
+    }
+
+    size_t Add(Instruction instruction) {
+        std::vector<Instruction>& program = pattern_.program_;
+        if (program.size() >= kMaxProgramSize) {
+            Fail("pattern is too large");
+            return program.size();
+        }
+        program.push_back(instruction);
+        return program.size() - 1;
+    }
+
+    void Emit(int index) {
+        if (Stopped()) {
+            return;
+        }
+        const Node& node = nodes_[static_cast<size_t>(index)];
+        std::vector<Instruction>& program = pattern_.program_;
+        switch (node.kind) {
+        case Kind::Empty:
+            break;
+        case Kind::Char:
+            Add({Op::Char, node.value, 0});
+            break;
+        case Kind::Any:
+            Add({Op::Any, 0, 0});
+            break;
+        case Kind::Class:
+            Add({Op::Class, node.value, 0});
+            break;
+        case Kind::Begin:
+            Add({Op::Begin, 0, 0});
+            break;
+        case Kind::End:
+            Add({Op::End, 0, 0});
+            break;
+        case Kind::WordBoundary:
+            Add({Op::WordBoundary, 0, 0});
+            break;
+        case Kind::NotWordBoundary:
+            Add({Op::NotWordBoundary, 0, 0});
+            break;
+        case Kind::Concat:
+            for (const int child : node.children) {
+                Emit(child);
+            }
+            break;
+        case Kind::Alternate: {
+            std::vector<size_t> exits;
+            for (size_t i = 0; i + 1 < node.children.size() && !Stopped(); ++i) {
+                const size_t split = Add({Op::Split, 0, 0});
+                Emit(node.children[i]);
+                exits.push_back(Add({Op::Jump, 0, 0}));
+                if (Stopped()) {
+                    return;
+                }
+                program[split].x = static_cast<uint32_t>(split + 1);
+                program[split].y = static_cast<uint32_t>(program.size());
+            }
+            Emit(node.children.back());
+            if (Stopped()) {
+                return;
+            }
+            for (const size_t exit : exits) {
+                program[exit].x = static_cast<uint32_t>(program.size());
+            }
+            break;
+        }
+        case Kind::Repeat:
+            EmitRepeat(node);
+            break;
+        }
+    }
+
+    void EmitRepeat(const Node& node) {
+        std::vector<Instruction>& program = pattern_.program_;
+        const int child = node.children.front();
+        for (int i = 0; i < node.min && !Stopped(); ++i) {
+            const size_t before = program.size();
+            Emit(child);
+            if (program.size() == before) {
+                // Repeating an empty match matches the same.
+                return;
+            }
+        }
+        const auto set_split = [&](size_t split, size_t body, size_t out) {
+            program[split].x = static_cast<uint32_t>(node.greedy ? body : out);
+            program[split].y = static_cast<uint32_t>(node.greedy ? out : body);
+        };
+        if (node.max == kUnbounded) {
+            const size_t loop = Add({Op::Split, 0, 0});
+            Emit(child);
+            Add({Op::Jump, static_cast<uint32_t>(loop), 0});
+            if (!Stopped()) {
+                set_split(loop, loop + 1, program.size());
+            }
+            return;
+        }
+        std::vector<size_t> splits;
+        for (int i = node.min; i < node.max && !Stopped(); ++i) {
+            splits.push_back(Add({Op::Split, 0, 0}));
+            const size_t before = program.size();
+            Emit(child);
+            if (program.size() == before) {
+                break;
+            }
+        }
+        if (Stopped()) {
+            return;
+        }
+        for (const size_t split : splits) {
+            set_split(split, split + 1, program.size());
+        }
+    }
+
+    std::string_view source_;
+    JsonPattern& pattern_;
+    size_t pos_ = 0;
+    std::vector<Node> nodes_;
+    bool failed_ = false;
+    bool unsupported_ = false;
+    std::string error_;
+};
+
+bool JsonPattern::Compile(std::string_view source, std::string& error) {
+    program_.clear();
+    classes_.clear();
+    fallback_ = false;
+    bool unsupported = false;
+    Parser parser(source, *this);
+    if (parser.Run(error, unsupported)) {
+        return true;
+    }
+    program_.clear();
+    classes_.clear();
+    if (!unsupported) {
+        return false;
+    }
+    try {
+        regex_.assign(std::string(source), std::regex::ECMAScript | std::regex::optimize);
+    } catch (const std::regex_error& e) {
+        error = e.what();
+        return false;
+    }
+    fallback_ = true;
+    return true;
+}
+
+bool JsonPattern::InClass(uint32_t index, uint32_t cp) const {
+    const CharClass& set = classes_[index];
+    const auto it = std::upper_bound(set.ranges.begin(), set.ranges.end(), cp,
+                                     [](uint32_t value, const Range& range) { return value < range.first; });
+    const bool inside = it != set.ranges.begin() && cp <= std::prev(it)->last;
+    return inside != set.negated;
+}
+
+bool JsonPattern::Search(std::string_view text, bool& too_long) const {
+    too_long = false;
+    if (fallback_) {
+        if (text.size() > kMaxFallbackInput) {
+            too_long = true;
+            return false;
+        }
+        return std::regex_search(text.begin(), text.end(), regex_);
+    }
+
+    // Thread lists hold consuming instructions only; `mark` stamps the
+    // instructions already added at the current step so each is added once.
+    std::vector<uint32_t> current;
+    std::vector<uint32_t> next;
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> mark(program_.size(), 0);
+    uint32_t step = 1;
+    current.reserve(program_.size());
+    next.reserve(program_.size());
+
+    // Follows the non-consuming instructions from `start` between code
+    // points `before` and `after`; returns true on reaching Match.
+    const auto add = [&](std::vector<uint32_t>& list, uint32_t start, uint32_t before, uint32_t after) {
+        stack.push_back(start);
+        while (!stack.empty()) {
+            const uint32_t pc = stack.back();
+            stack.pop_back();
+            if (mark[pc] == step) {
+                continue;
+            }
+            mark[pc] = step;
+            const Instruction& instruction = program_[pc];
+            switch (instruction.op) {
+            case Op::Jump:
+                stack.push_back(instruction.x);
+                break;
+            case Op::Split:
+                stack.push_back(instruction.y);
+                stack.push_back(instruction.x);
+                break;
+            case Op::Begin:
+                if (before == kNone) {
+                    stack.push_back(pc + 1);
+                }
+                break;
+            case Op::End:
+                if (after == kNone) {
+                    stack.push_back(pc + 1);
+                }
+                break;
+            case Op::WordBoundary:
+            case Op::NotWordBoundary: {
+                const bool boundary = (before != kNone && IsWordChar(before)) != (after != kNone && IsWordChar(after));
+                if (boundary == (instruction.op == Op::WordBoundary)) {
+                    stack.push_back(pc + 1);
+                }
+                break;
+            }
+            case Op::Match:
+                stack.clear();
+                return true;
+            default:
+                list.push_back(pc);
+                break;
+            }
+        }
+        return false;
+    };
+
+    size_t pos = 0;
+    size_t length = 0;
+    uint32_t before = kNone;
+    uint32_t cp = text.empty() ? kNone : DecodeAt(text, 0, length);
+    while (true) {
+        // Unanchored search: a new thread starts at every position.
+        if (add(current, 0, before, cp)) {
+            return true;
+        }
+        if (cp == kNone) {
+            return false;
+        }
+        const size_t after_pos = pos + length;
+        size_t after_length = 0;
+        const uint32_t after = after_pos < text.size() ? DecodeAt(text, after_pos, after_length) : kNone;
+        ++step;
+        next.clear();
+        for (const uint32_t pc : current) {
+            const Instruction& instruction = program_[pc];
+            bool consumed = false;
+            switch (instruction.op) {
+            case Op::Char:
+                consumed = cp == instruction.x;
+                break;
+            case Op::Any:
+                consumed = !IsLineTerminator(cp);
+                break;
+            case Op::Class:
+                consumed = InClass(instruction.x, cp);
+                break;
+            default:
+                break;
+            }
+            if (consumed && add(next, pc + 1, cp, after)) {
+                return true;
+            }
+        }
+        current.swap(next);
+        before = cp;
+        cp = after;
+        pos = after_pos;
+        length = after_length;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Regular expression for the JSON Schema "pattern" keyword, matched by
+// simulating its NFA over the input's code points: time is linear in the
+// input for a given pattern and the stack does not grow with the input, so
+// an untrusted document cannot exhaust it. Covers the ECMAScript syntax
+// schemas use: literals and escapes, ".", classes with ranges and \d \w \s
+// (and their negations), groups, alternation, greedy and lazy quantifiers,
+// ^, $, \b and \B. Patterns with backreferences or lookaround fall back to
+// std::regex, whose matcher recurses per input character, so those are
+// only run on strings up to kMaxFallbackInput code units.
+class JsonPattern {
+public:
+    static constexpr size_t kMaxFallbackInput = 1024;
+
+    // Returns false with `error` set for a malformed or oversized pattern.
+    bool Compile(std::string_view source, std::string& error);
+
+    // True if the pattern matches anywhere in `text`. Sets `too_long`
+    // instead of matching when a fallback pattern meets a string over
+    // kMaxFallbackInput.
+    bool Search(std::string_view text, bool& too_long) const;
+
+private:
+    enum class Op : uint8_t {
+        Char,
+        Any,
+        Class,
+        Split,
+        Jump,
+        Begin,
+        End,
+        WordBoundary,
+        NotWordBoundary,
+        Match
+    };
+
+    struct Instruction {
+        Op op = Op::Match;
+        // Code point for Char, class index for Class, targets for
+        // Split (x preferred) and Jump.
+        uint32_t x = 0;
+        uint32_t y = 0;
+    };
+
+    struct Range {
+        uint32_t first = 0;
+        uint32_t last = 0;
+    };
+
+    struct CharClass {
+        std::vector<Range> ranges;
+        bool negated = false;
+    };
+
+    class Parser;
+
+    bool InClass(uint32_t index, uint32_t cp) const;
+
+    std::vector<Instruction> program_;
+    std::vector<CharClass> classes_;
+    bool fallback_ = false;
+    std::regex regex_;
+};
@@ -0,0 +1,124 @@
+#include "json_query_panel.h"
+
+#include <imgui.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+// Scalars longer than this are cut in the result rows.
+constexpr int kMaxPreviewChars = 120;
+
+} // namespace
+
+void JsonQueryPanel::Start(std::shared_ptr<const JsonDocument> document) {
+    std::shared_ptr<const JsonPath> path = std::move(pending_);
+    queried_ = document;
+    query_job_.Start(document->tape.size(), [document, path](JobContext& job) {
+        QueryOutput output;
+        const auto start = std::chrono::steady_clock::now();
+        if (!path->Evaluate(document->tape, output.matches, &job)) {
+            output.error = "cancelled";
+            return output;
+        }
+        output.milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return output;
+    });
+}
+
+void JsonQueryPanel::Clear() {
+    query_job_.Cancel();
+    pending_.reset();
+    queried_.reset();
+    document_.reset();
+    matches_.clear();
+    status_.clear();
+}
+
+bool JsonQueryPanel::Render(const char* id, const JsonDocumentLoader& documents, size_t revision) {
+    if (auto finished = query_job_.TakeResult()) {
+        if (finished->error.empty()) {
+            document_ = queried_;
+            matches_ = std::move(finished->matches);
+            char buffer[128];
+            std::snprintf(buffer, sizeof(buffer), "%zu matches in %.1f ms", matches_.size(),
+                          finished->milliseconds);
+            status_ = buffer;
+        } else {
+            matches_.clear();
+            status_ = "Query failed: " + finished->error;
+        }
+    }
+
+    ImGui::PushID(id);
+    ImGui::SetNextItemWidth(-120.0f);
+    bool run = ImGui::InputTextWithHint("##Query", "$.items[*].id", query_, sizeof(query_),
+                                        ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::SameLine();
+    run |= ImGui::Button("Run query");
+    if (run) {
+        auto path = std::make_shared<JsonPath>();
+        std::string error;
+        if (path->Compile(query_, error)) {
+            pending_ = std::move(path);
+            status_.clear();
+        } else {
+            pending_.reset();
+            status_ = "Query error: " + error;
+        }
+    }
+
+    bool needs_document = false;
+    if (pending_) {
+        if (auto document = documents.Get(revision)) {
+            Start(std::move(document));
+        } else if (!documents.Loading() && !documents.Needs(revision)) {
+            pending_.reset();
+            status_ = "Cannot query: " + documents.error();
+        } else {
+            needs_document = true;
+        }
+    }
+
+    if (pending_ && documents.Loading()) {
+        ImGui::TextDisabled("Indexing... %.0f%%", documents.Fraction() * 100.0f);
+    } else if (query_job_.Running()) {
+        // Filters and descendant segments revisit entries, so the work has
+        // no known total: show that the query is busy rather than a share.
+        static const char kSpinner[] = "|/-\\";
+        ImGui::TextDisabled("Querying... %c", kSpinner[static_cast<int>(ImGui::GetTime() * 8.0) & 3]);
+    } else if (!status_.empty()) {
+        ImGui::TextWrapped("%s", status_.c_str());
+    }
+
+    ImGui::BeginChild("Results", ImVec2(-1.0f, -1.0f), true);
+    if (document_ && !query_job_.Running()) {
+        const JsonTape& tape = document_->tape;
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(matches_.size()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                const uint32_t entry = matches_[static_cast<size_t>(i)];
+                const JsonKind kind = tape.kind(entry);
+                if (kind == JsonKind::Object || kind == JsonKind::Array) {
+                    ImGui::Text("%zu  @%zu  %s", static_cast<size_t>(i), tape.offset(entry),
+                                kind == JsonKind::Object ? "{...}" : "[...]");
+                    continue;
+                }
+                const std::string_view token = tape.Token(entry);
+                const int shown =
+                    token.size() > kMaxPreviewChars ? kMaxPreviewChars : static_cast<int>(token.size());
+                ImGui::Text("%zu  @%zu  %.*s%s", static_cast<size_t>(i), tape.offset(entry), shown,
+                            token.data(), shown < static_cast<int>(token.size()) ? "..." : "");
+            }
+        }
+        clipper.End();
+    }
+    ImGui::EndChild();
+    ImGui::PopID();
+    return needs_document;
+}
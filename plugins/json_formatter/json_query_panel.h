@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "background_job.h"
+#include "json_document.h"
+#include "json_path.h"
+
+// JSONPath query bar with a clipped result list. Queries run against the
+// shared document tape, so repeated queries on the same input only pay for
+// evaluation.
+class JsonQueryPanel {
+public:
+    // Draws the panel and evaluates a submitted query once `documents` has
+    // the tape for `revision`. Returns true while a query is waiting for a
+    // tape that the caller still has to Load().
+    bool Render(const char* id, const JsonDocumentLoader& documents, size_t revision);
+    void Clear();
+
+private:
+    struct QueryOutput {
+        std::vector<uint32_t> matches;
+        std::string error;
+        double milliseconds = 0.0;
+    };
+
+    void Start(std::shared_ptr<const JsonDocument> document);
+
+    char query_[512] = "$";
+    std::string status_;
+    std::shared_ptr<const JsonPath> pending_;
+    BackgroundJob<QueryOutput> query_job_;
+    // Document the running or last finished query was evaluated on.
+    std::shared_ptr<const JsonDocument> queried_;
+    std::shared_ptr<const JsonDocument> document_;
+    std::vector<uint32_t> matches_;
+};
@@ -0,0 +1,875 @@
+#include "json_schema.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+#include "json_lexing.h"
+#include "json_tape.h"
+
+namespace {
+
+constexpr size_t kMaxCachedSchemas = 8;
+constexpr size_t kNoCapture = static_cast<size_t>(-1);
+constexpr uint8_t kExclusiveMinimumFlag = 1;
+constexpr uint8_t kExclusiveMaximumFlag = 2;
+
+double ParseNumber(std::string_view text) {
+    double value = 0.0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+bool IsInteger(double value) {
+    return std::isfinite(value) && std::floor(value) == value;
+}
+
+size_t CodePointCount(std::string_view text) {
+    size_t count = 0;
+    for (char c : text) {
+        count += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+    }
+    return count;
+}
+
+// Enum values and document values are compared by a canonical text: strings
+// decoded and re-quoted with only '"' and '\' escaped, numbers printed
+// shortest round-trip (so 1, 1.0 and 1e0 compare equal), literals as-is, and
+// containers built from those with no whitespace. Object members, each as
+// its canonical "key":value text, are sorted bytewise, so member order
+// does not matter.
+void AppendCanonicalString(std::string_view token, std::string& scratch, std::string& out) {
+    DecodeJsonString(token.substr(1, token.size() - 2), scratch);
+    out.push_back('"');
+    for (char c : scratch) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+void AppendCanonicalScalar(JsonKind kind, std::string_view token, std::string& scratch, std::string& out) {
+    if (kind == JsonKind::String) {
+        AppendCanonicalString(token, scratch, out);
+    } else if (kind == JsonKind::Number) {
+        double value = ParseNumber(token);
+        if (value == 0.0) {
+            value = 0.0; // -0 equals 0.
+        }
+        char buffer[32];
+        const auto printed = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, printed.ptr);
+    } else {
+        out.append(token);
+    }
+}
+
+void AppendCanonical(const JsonTape& tape, uint32_t entry, std::string& scratch, std::string& out) {
+    const JsonKind kind = tape.kind(entry);
+    if (kind != JsonKind::Object && kind != JsonKind::Array) {
+        AppendCanonicalScalar(kind, tape.Token(entry), scratch, out);
+        return;
+    }
+    if (kind == JsonKind::Array) {
+        out.push_back('[');
+        bool first = true;
+        for (uint32_t child : tape.Children(entry)) {
+            if (!first) {
+                out.push_back(',');
+            }
+            first = false;
+            AppendCanonical(tape, child, scratch, out);
+        }
+        out.push_back(']');
+        return;
+    }
+    std::vector<std::string> members;
+    for (uint32_t key : tape.Children(entry)) {
+        std::string& member = members.emplace_back();
+        AppendCanonicalString(tape.Token(key), scratch, member);
+        member.push_back(':');
+        AppendCanonical(tape, key + 1, scratch, member);
+    }
+    std::sort(members.begin(), members.end());
+    out.push_back('{');
+    for (size_t i = 0; i < members.size(); ++i) {
+        if (i > 0) {
+            out.push_back(',');
+        }
+        out.append(members[i]);
+    }
+    out.push_back('}');
+}
+
+} // namespace
+
+class JsonSchema::Compiler {
+public:
+    Compiler(JsonSchema& schema, const JsonTape& tape) : schema_(schema), tape_(tape) {}
+
+    bool Run(std::string& error) {
+        int root = kAny;
+        if (!CompileNode(JsonTape::kRoot, "#", root)) {
+            error = error_;
+            return false;
+        }
+        schema_.root_ = root;
+        return true;
+    }
+
+private:
+    bool Fail(const std::string& path, const std::string& message) {
+        error_ = message + " at " + path;
+        return false;
+    }
+
+    std::string_view Decode(uint32_t entry) {
+        const std::string_view token = tape_.Token(entry);
+        DecodeJsonString(token.substr(1, token.size() - 2), decoded_);
+        return decoded_;
+    }
+
+    bool ReadNumber(uint32_t entry, const std::string& path, const char* keyword, double& value) {
+        if (tape_.kind(entry) != JsonKind::Number) {
+            return Fail(path, std::string("'") + keyword + "' must be a number");
+        }
+        value = ParseNumber(tape_.Token(entry));
+        return true;
+    }
+
+    bool ReadCount(uint32_t entry, const std::string& path, const char* keyword, size_t& value) {
+        double number = 0.0;
+        if (tape_.kind(entry) != JsonKind::Number || (number = ParseNumber(tape_.Token(entry))) < 0.0 ||
+            !IsInteger(number)) {
+            return Fail(path, std::string("'") + keyword + "' must be a non-negative integer");
+        }
+        value = number >= static_cast<double>(SIZE_MAX) ? SIZE_MAX : static_cast<size_t>(number);
+        return true;
+    }
+
+    bool ReadTypes(uint32_t entry, const std::string& path, uint8_t& types);
+    bool Resolve(std::string_view reference, const std::string& path, uint32_t& target);
+    bool CompileNode(uint32_t entry, const std::string& path, int& out);
+    bool CompileMember(std::string_view keyword, uint32_t value, const std::string& path, Node& node,
+                       std::vector<Property>& properties, std::vector<std::string>& required,
+                       std::vector<std::string>& enums, uint8_t& draft4_exclusive);
+
+    JsonSchema& schema_;
+    const JsonTape& tape_;
+    // Subschema entries already given a node, so $ref cycles terminate.
+    std::unordered_map<uint32_t, int> compiled_;
+    // $ref entries being resolved, to reject reference loops.
+    std::vector<uint32_t> resolving_;
+    std::string decoded_;
+    std::string error_;
+};
+
+bool JsonSchema::Compiler::ReadTypes(uint32_t entry, const std::string& path, uint8_t& types) {
+    static constexpr std::pair<std::string_view, uint8_t> kNames[] = {
+        {"null", kNull},     {"boolean", kBoolean}, {"object", kObject},   {"array", kArray},
+        {"number", kNumber}, {"string", kString},   {"integer", kInteger},
+    };
+    std::vector<uint32_t> names;
+    if (tape_.kind(entry) == JsonKind::Array) {
+        names = tape_.Children(entry);
+    } else {
+        names.push_back(entry);
+    }
+    types = 0;
+    for (uint32_t name : names) {
+        if (tape_.kind(name) != JsonKind::String) {
+            return Fail(path, "'type' must be a string or an array of strings");
+        }
+        const std::string_view text = Decode(name);
+        auto it = std::find_if(std::begin(kNames), std::end(kNames), [&](const auto& n) { return n.first == text; });
+        if (it == std::end(kNames)) {
+            return Fail(path, "unknown type '" + std::string(text) + "'");
+        }
+        types |= it->second;
+    }
+    return true;
+}
+
+bool JsonSchema::Compiler::Resolve(std::string_view reference, const std::string& path, uint32_t& target) {
+    if (reference.empty() || reference[0] != '#' || (reference.size() > 1 && reference[1] != '/')) {
+        return Fail(path, "only local '#/...' references are supported, got '" + std::string(reference) + "'");
+    }
+    target = JsonTape::kRoot;
+    size_t pos = 1;
+    while (pos < reference.size()) {
+        const size_t end = std::min(reference.find('/', pos + 1), reference.size());
+        std::string segment;
+        for (size_t i = pos + 1; i < end; ++i) {
+            if (reference[i] == '~' && i + 1 < end && (reference[i + 1] == '0' || reference[i + 1] == '1')) {
+                segment.push_back(reference[++i] == '0' ? '~' : '/');
+            } else {
+                segment.push_back(reference[i]);
+            }
+        }
+        pos = end;
+        bool found = false;
+        if (tape_.kind(target) == JsonKind::Object) {
+            for (uint32_t key : tape_.Children(target)) {
+                if (Decode(key) == segment) {
+                    target = key + 1;
+                    found = true;
+                    break;
+                }
+            }
+        } else if (tape_.kind(target) == JsonKind::Array) {
+            size_t index = 0;
+            const auto parsed = std::from_chars(segment.data(), segment.data() + segment.size(), index);
+            const std::vector<uint32_t> items = tape_.Children(target);
+            if (parsed.ec == std::errc() && parsed.ptr == segment.data() + segment.size() && index < items.size()) {
+                target = items[index];
+                found = true;
+            }
+        }
+        if (!found) {
+            return Fail(path, "cannot resolve $ref '" + std::string(reference) + "'");
+        }
+    }
+    return true;
+}
+
+bool JsonSchema::Compiler::CompileNode(uint32_t entry, const std::string& path, int& out) {
+    if (auto it = compiled_.find(entry); it != compiled_.end()) {
+        out = it->second;
+        return true;
+    }
+    const JsonKind kind = tape_.kind(entry);
+    if (kind == JsonKind::True) {
+        out = kAny;
+        return true;
+    }
+    if (kind == JsonKind::False) {
+        Node never;
+        never.never = true;
+        out = static_cast<int>(schema_.nodes_.size());
+        schema_.nodes_.push_back(never);
+        compiled_.emplace(entry, out);
+        return true;
+    }
+    if (kind != JsonKind::Object) {
+        return Fail(path, "schema must be an object or a boolean");
+    }
+
+    const std::vector<uint32_t> keys = tape_.Children(entry);
+    for (uint32_t key : keys) {
+        if (Decode(key) != "$ref") {
+            continue;
+        }
+        // A reference replaces the whole subschema; sibling keywords are
+        // ignored, as in draft 7.
+        if (tape_.kind(key + 1) != JsonKind::String) {
+            return Fail(path, "'$ref' must be a string");
+        }
+        if (std::find(resolving_.begin(), resolving_.end(), entry) != resolving_.end()) {
+            return Fail(path, "circular $ref");
+        }
+        const std::string reference(Decode(key + 1));
+        uint32_t target = 0;
+        if (!Resolve(reference, path, target)) {
+            return false;
+        }
+        resolving_.push_back(entry);
+        const bool ok = CompileNode(target, reference, out);
+        resolving_.pop_back();
+        if (ok) {
+            compiled_.emplace(entry, out);
+        }
+        return ok;
+    }
+
+    // Reserve the index first so references back to this node resolve.
+    const int index = static_cast<int>(schema_.nodes_.size());
+    schema_.nodes_.emplace_back();
+    compiled_.emplace(entry, index);
+
+    Node node;
+    std::vector<Property> properties;
+    std::vector<std::string> required;
+    std::vector<std::string> enums;
+    uint8_t draft4_exclusive = 0;
+    for (uint32_t key : keys) {
+        const std::string keyword(Decode(key));
+        std::string member_path = path;
+        AppendJsonPointerToken(keyword, member_path);
+        if (!CompileMember(keyword, key + 1, member_path, node, properties, required, enums, draft4_exclusive)) {
+            return false;
+        }
+    }
+    if ((draft4_exclusive & kExclusiveMinimumFlag) && node.has_minimum) {
+        node.has_minimum = false;
+        node.has_exclusive_minimum = true;
+        node.exclusive_minimum = node.minimum;
+    }
+    if ((draft4_exclusive & kExclusiveMaximumFlag) && node.has_maximum) {
+        node.has_maximum = false;
+        node.has_exclusive_maximum = true;
+        node.exclusive_maximum = node.maximum;
+    }
+
+    for (const std::string& name : required) {
+        auto it = std::find_if(properties.begin(), properties.end(), [&](const Property& p) { return p.name == name; });
+        if (it == properties.end()) {
+            properties.push_back(Property{name, kAny, -1});
+            it = properties.end() - 1;
+        }
+        if (it->required_slot < 0) {
+            it->required_slot = static_cast<int>(node.required_count++);
+        }
+    }
+    std::stable_sort(properties.begin(), properties.end(),
+                     [](const Property& a, const Property& b) { return a.name < b.name; });
+    node.properties_begin = static_cast<uint32_t>(schema_.properties_.size());
+    for (Property& property : properties) {
+        schema_.properties_.push_back(std::move(property));
+    }
+    node.properties_end = static_cast<uint32_t>(schema_.properties_.size());
+    node.enums_begin = static_cast<uint32_t>(schema_.enums_.size());
+    for (std::string& value : enums) {
+        schema_.enums_.push_back(std::move(value));
+    }
+    node.enums_end = static_cast<uint32_t>(schema_.enums_.size());
+    schema_.nodes_[static_cast<size_t>(index)] = node;
+    out = index;
+    return true;
+}
+
+bool JsonSchema::Compiler::CompileMember(std::string_view keyword,
+                                         uint32_t value,
+                                         const std::string& path,
+                                         Node& node,
+                                         std::vector<Property>& properties,
+                                         std::vector<std::string>& required,
+                                         std::vector<std::string>& enums,
+                                         uint8_t& draft4_exclusive) {
+    const JsonKind kind = tape_.kind(value);
+    if (keyword == "type") {
+        return ReadTypes(value, path, node.types);
+    }
+    if (keyword == "properties") {
+        if (kind != JsonKind::Object) {
+            return Fail(path, "'properties' must be an object");
+        }
+        for (uint32_t key : tape_.Children(value)) {
+            Property property;
+            property.name = Decode(key);
+            std::string property_path = path;
+            AppendJsonPointerToken(property.name, property_path);
+            if (!CompileNode(key + 1, property_path, property.node)) {
+                return false;
+            }
+            properties.push_back(std::move(property));
+        }
+        return true;
+    }
+    if (keyword == "required") {
+        if (kind != JsonKind::Array) {
+            return Fail(path, "'required' must be an array of strings");
+        }
+        for (uint32_t name : tape_.Children(value)) {
+            if (tape_.kind(name) != JsonKind::String) {
+                return Fail(path, "'required' must be an array of strings");
+            }
+            required.emplace_back(Decode(name));
+        }
+        return true;
+    }
+    if (keyword == "additionalProperties") {
+        return CompileNode(value, path, node.additional);
+    }
+    if (keyword == "items") {
+        if (kind == JsonKind::Array) {
+            return Fail(path, "tuple-form 'items' is not supported");
+        }
+        return CompileNode(value, path, node.items);
+    }
+    if (keyword == "enum" || keyword == "const") {
+        if (keyword == "enum" && kind != JsonKind::Array) {
+            return Fail(path, "'enum' must be an array");
+        }
+        std::string scratch;
+        std::vector<std::string> allowed;
+        for (uint32_t item : keyword == "enum" ? tape_.Children(value) : std::vector<uint32_t>{value}) {
+            allowed.emplace_back();
+            AppendCanonical(tape_, item, scratch, allowed.back());
+        }
+        if (node.has_enum) {
+            // enum and const together: only values allowed by both remain.
+            std::erase_if(enums, [&](const std::string& v) {
+                return std::find(allowed.begin(), allowed.end(), v) == allowed.end();
+            });
+        } else {
+            enums = std::move(allowed);
+            node.has_enum = true;
+        }
+        return true;
+    }
+    if (keyword == "pattern") {
+        if (kind != JsonKind::String) {
+            return Fail(path, "'pattern' must be a string");
+        }
+        Pattern pattern;
+        pattern.source = Decode(value);
+        std::string reason;
+        if (!pattern.matcher.Compile(pattern.source, reason)) {
+            return Fail(path, "invalid 'pattern' '" + pattern.source + "'" + (reason.empty() ? "" : ": " + reason));
+        }
+        node.pattern = static_cast<int>(schema_.patterns_.size());
+        schema_.patterns_.push_back(std::move(pattern));
+        return true;
+    }
+    if (keyword == "minimum") {
+        node.has_minimum = true;
+        return ReadNumber(value, path, "minimum", node.minimum);
+    }
+    if (keyword == "maximum") {
+        node.has_maximum = true;
+        return ReadNumber(value, path, "maximum", node.maximum);
+    }
+    if (keyword == "exclusiveMinimum" || keyword == "exclusiveMaximum") {
+        const bool minimum = keyword == "exclusiveMinimum";
+        if (kind == JsonKind::True || kind == JsonKind::False) {
+            // Draft 4: a flag on minimum/maximum, which may come later.
+            if (kind == JsonKind::True) {
+                draft4_exclusive |= minimum ? kExclusiveMinimumFlag : kExclusiveMaximumFlag;
+            }
+            return true;
+        }
+        (minimum ? node.has_exclusive_minimum : node.has_exclusive_maximum) = true;
+        return ReadNumber(value, path, minimum ? "exclusiveMinimum" : "exclusiveMaximum",
+                          minimum ? node.exclusive_minimum : node.exclusive_maximum);
+    }
+    if (keyword == "minLength") {
+        return ReadCount(value, path, "minLength", node.min_length);
+    }
+    if (keyword == "maxLength") {
+        return ReadCount(value, path, "maxLength", node.max_length);
+    }
+    if (keyword == "minItems") {
+        return ReadCount(value, path, "minItems", node.min_items);
+    }
+    if (keyword == "maxItems") {
+        return ReadCount(value, path, "maxItems", node.max_items);
+    }
+    if (keyword == "minProperties") {
+        return ReadCount(value, path, "minProperties", node.min_properties);
+    }
+    if (keyword == "maxProperties") {
+        return ReadCount(value, path, "maxProperties", node.max_properties);
+    }
+    return true;
+}
+
+bool JsonSchema::Compile(std::string_view schema, std::string& error) {
+    *this = JsonSchema();
+    JsonTape tape;
+    std::string parse_error;
+    if (!tape.Build(schema, parse_error)) {
+        error = "schema is not valid JSON: " + parse_error;
+        return false;
+    }
+    return Compiler(*this, tape).Run(error);
+}
+
+class JsonSchema::Validator : public JsonEventHandler {
+public:
+    Validator(const JsonSchema& schema, JsonSchemaResult& result) : schema_(schema), result_(result) {}
+
+    void Key(std::string_view token, size_t offset) override;
+    void Value(JsonKind kind, std::string_view token, size_t offset) override;
+    void Close(size_t offset) override;
+
+private:
+    struct Frame {
+        int node = kAny;
+        bool object = false;
+        size_t count = 0;        // Items or members seen so far.
+        int child = kAny;        // Node for the value of the current member.
+        std::string key;         // Decoded name of the current member.
+        std::vector<uint8_t> seen; // Required properties, by slot.
+        size_t capture = kNoCapture; // Start of this container in capture_.
+        // While capturing: where this container and its members start in
+        // capture_, so an object's members can be sorted when it closes.
+        size_t captured = kNoCapture;
+        std::vector<size_t> members;
+    };
+
+    const Node* NodeAt(int index) const {
+        return index == kAny ? nullptr : &schema_.nodes_[static_cast<size_t>(index)];
+    }
+
+    void Report(size_t offset, const std::string& message);
+    bool CheckType(const Node& node, JsonKind kind, std::string_view token, size_t offset);
+    void CheckString(const Node& node, std::string_view token, size_t offset);
+    void CheckNumber(const Node& node, std::string_view token, size_t offset);
+    bool InEnum(const Node& node, std::string_view canonical) const;
+    void SortCapturedMembers(const Frame& frame);
+
+    const JsonSchema& schema_;
+    JsonSchemaResult& result_;
+    // Open containers are frames_[0, depth_); frames past depth_ are kept
+    // so their buffers are reused by the next container at that depth.
+    std::vector<Frame> frames_;
+    size_t depth_ = 0;
+    // Canonical text of the open containers that have an enum to match.
+    std::string capture_;
+    size_t capturing_ = 0;
+    std::string scratch_;
+    std::string canonical_;
+    std::vector<std::string_view> sorted_;
+    std::string reordered_;
+};
+
+void JsonSchema::Validator::Report(size_t offset, const std::string& message) {
+    if (result_.error_count++ >= JsonSchemaResult::kMaxReportedErrors) {
+        return;
+    }
+    JsonSchemaError error;
+    error.offset = offset;
+    for (size_t i = 0; i < depth_; ++i) {
+        const Frame& frame = frames_[i];
+        if (frame.object) {
+            AppendJsonPointerToken(frame.key, error.path);
+        } else {
+            error.path += '/' + std::to_string(frame.count - 1);
+        }
+    }
+    error.message = message;
+    result_.errors.push_back(std::move(error));
+}
+
+bool JsonSchema::Validator::InEnum(const Node& node, std::string_view canonical) const {
+    const auto begin = schema_.enums_.begin() + node.enums_begin;
+    const auto end = schema_.enums_.begin() + node.enums_end;
+    return std::find(begin, end, canonical) != end;
+}
+
+bool JsonSchema::Validator::CheckType(const Node& node, JsonKind kind, std::string_view token, size_t offset) {
+    uint8_t bit = kNull;
+    const char* name = "null";
+    switch (kind) {
+        case JsonKind::Object:
+            bit = kObject;
+            name = "object";
+            break;
+        case JsonKind::Array:
+            bit = kArray;
+            name = "array";
+            break;
+        case JsonKind::String:
+            bit = kString;
+            name = "string";
+            break;
+        case JsonKind::Number:
+            bit = kNumber;
+            name = "number";
+            break;
+        case JsonKind::True:
+        case JsonKind::False:
+            bit = kBoolean;
+            name = "boolean";
+            break;
+        case JsonKind::Null:
+            break;
+    }
+    if ((node.types & bit) != 0 ||
+        (kind == JsonKind::Number && (node.types & kInteger) != 0 && IsInteger(ParseNumber(token)))) {
+        return true;
+    }
+    static constexpr const char* kTypeNames[] = {"null", "boolean", "object", "array", "number", "string", "integer"};
+    std::string expected;
+    for (int i = 0; i < 7; ++i) {
+        if (node.types & (1 << i)) {
+            expected += expected.empty() ? "" : " or ";
+            expected += kTypeNames[i];
+        }
+    }
+    Report(offset, "expected " + (expected.empty() ? std::string("no value") : expected) + ", got " + name);
+    return false;
+}
+
+void JsonSchema::Validator::CheckString(const Node& node, std::string_view token, size_t offset) {
+    if (node.min_length == 0 && node.max_length == SIZE_MAX && node.pattern < 0) {
+        return;
+    }
+    std::string_view text = token.substr(1, token.size() - 2);
+    if (text.find('\\') != std::string_view::npos) {
+        DecodeJsonString(text, scratch_);
+        text = scratch_;
+    }
+    const size_t length = CodePointCount(text);
+    char message[96];
+    if (length < node.min_length) {
+        std::snprintf(message, sizeof(message), "string is shorter than %zu characters", node.min_length);
+        Report(offset, message);
+    }
+    if (length > node.max_length) {
+        std::snprintf(message, sizeof(message), "string is longer than %zu characters", node.max_length);
+        Report(offset, message);
+    }
+    if (node.pattern >= 0) {
+        const Pattern& pattern = schema_.patterns_[static_cast<size_t>(node.pattern)];
+        bool too_long = false;
+        if (!pattern.matcher.Search(text, too_long)) {
+            Report(offset, std::string(too_long ? "string is too long to check against pattern '"
+                                                : "string does not match pattern '") +
+                               pattern.source + "'");
+        }
+    }
+}
+
+void JsonSchema::Validator::CheckNumber(const Node& node, std::string_view token, size_t offset) {
+    if (!node.has_minimum && !node.has_maximum && !node.has_exclusive_minimum && !node.has_exclusive_maximum) {
+        return;
+    }
+    const double value = ParseNumber(token);
+    const int shown = static_cast<int>(std::min<size_t>(token.size(), 32));
+    char message[128];
+    if (node.has_minimum && value < node.minimum) {
+        std::snprintf(message, sizeof(message), "%.*s is less than the minimum %g", shown, token.data(), node.minimum);
+        Report(offset, message);
+    }
+    if (node.has_exclusive_minimum && value <= node.exclusive_minimum) {
+        std::snprintf(message, sizeof(message), "%.*s is not greater than %g", shown, token.data(),
+                      node.exclusive_minimum);
+        Report(offset, message);
+    }
+    if (node.has_maximum && value > node.maximum) {
+        std::snprintf(message, sizeof(message), "%.*s is greater than the maximum %g", shown, token.data(),
+                      node.maximum);
+        Report(offset, message);
+    }
+    if (node.has_exclusive_maximum && value >= node.exclusive_maximum) {
+        std::snprintf(message, sizeof(message), "%.*s is not less than %g", shown, token.data(),
+                      node.exclusive_maximum);
+        Report(offset, message);
+    }
+}
+
+// Puts the members of the object being closed at the end of capture_ in
+// the order AppendCanonical uses.
+void JsonSchema::Validator::SortCapturedMembers(const Frame& frame) {
+    if (frame.captured == kNoCapture || frame.members.size() < 2) {
+        return;
+    }
+    const std::string_view captured(capture_);
+    sorted_.clear();
+    for (size_t i = 0; i < frame.members.size(); ++i) {
+        // Each member but the last is followed by its comma.
+        const size_t end = i + 1 < frame.members.size() ? frame.members[i + 1] - 1 : captured.size();
+        sorted_.push_back(captured.substr(frame.members[i], end - frame.members[i]));
+    }
+    std::sort(sorted_.begin(), sorted_.end());
+    reordered_.clear();
+    for (size_t i = 0; i < sorted_.size(); ++i) {
+        if (i > 0) {
+            reordered_.push_back(',');
+        }
+        reordered_.append(sorted_[i]);
+    }
+    capture_.replace(frame.members.front(), std::string::npos, reordered_);
+}
+
+void JsonSchema::Validator::Key(std::string_view token, size_t offset) {
+    Frame& frame = frames_[depth_ - 1];
+    if (capturing_ > 0) {
+        if (frame.count > 0) {
+            capture_.push_back(',');
+        }
+        frame.members.push_back(capture_.size());
+        AppendCanonicalString(token, scratch_, capture_);
+        capture_.push_back(':');
+    }
+    ++frame.count;
+    const std::string_view name = token.substr(1, token.size() - 2);
+    if (name.find('\\') == std::string_view::npos) {
+        frame.key.assign(name);
+    } else {
+        DecodeJsonString(name, frame.key);
+    }
+    frame.child = kAny;
+    const Node* node = NodeAt(frame.node);
+    if (!node) {
+        return;
+    }
+    const auto begin = schema_.properties_.begin() + node->properties_begin;
+    const auto end = schema_.properties_.begin() + node->properties_end;
+    const auto it = std::lower_bound(begin, end, frame.key,
+                                     [](const Property& p, const std::string& key) { return p.name < key; });
+    if (it != end && it->name == frame.key) {
+        frame.child = it->node;
+        if (it->required_slot >= 0) {
+            frame.seen[static_cast<size_t>(it->required_slot)] = 1;
+        }
+        return;
+    }
+    const Node* additional = NodeAt(node->additional);
+    if (additional && additional->never) {
+        Report(offset, "property '" + frame.key + "' is not allowed");
+        return;
+    }
+    frame.child = node->additional;
+}
+
+void JsonSchema::Validator::Value(JsonKind kind, std::string_view token, size_t offset) {
+    int index = schema_.root_;
+    if (depth_ > 0) {
+        Frame& parent = frames_[depth_ - 1];
+        if (parent.object) {
+            index = parent.child;
+        } else {
+            if (capturing_ > 0 && parent.count > 0) {
+                capture_.push_back(',');
+            }
+            ++parent.count;
+            const Node* node = NodeAt(parent.node);
+            index = node ? node->items : kAny;
+        }
+    }
+    const bool container = kind == JsonKind::Object || kind == JsonKind::Array;
+    const Node* node = NodeAt(index);
+    if (node && node->never) {
+        Report(offset, "no value is allowed here");
+        node = nullptr;
+    } else if (node && !CheckType(*node, kind, token, offset)) {
+        node = nullptr;
+    }
+
+    if (container) {
+        if (depth_ == frames_.size()) {
+            frames_.emplace_back();
+        }
+        Frame& frame = frames_[depth_++];
+        frame.node = node ? index : kAny;
+        frame.object = kind == JsonKind::Object;
+        frame.count = 0;
+        frame.child = kAny;
+        frame.key.clear();
+        frame.seen.assign(node ? node->required_count : 0, 0);
+        frame.capture = kNoCapture;
+        frame.captured = kNoCapture;
+        frame.members.clear();
+        if (node && node->has_enum) {
+            frame.capture = capture_.size();
+            ++capturing_;
+        }
+        if (capturing_ > 0) {
+            frame.captured = capture_.size();
+            capture_.push_back(frame.object ? '{' : '[');
+        }
+        return;
+    }
+
+    if (capturing_ > 0) {
+        AppendCanonicalScalar(kind, token, scratch_, capture_);
+    }
+    if (!node) {
+        return;
+    }
+    if (kind == JsonKind::String) {
+        CheckString(*node, token, offset);
+    } else if (kind == JsonKind::Number) {
+        CheckNumber(*node, token, offset);
+    }
+    if (node->has_enum) {
+        canonical_.clear();
+        AppendCanonicalScalar(kind, token, scratch_, canonical_);
+        if (!InEnum(*node, canonical_)) {
+            Report(offset, "value is not one of the allowed values");
+        }
+    }
+}
+
+void JsonSchema::Validator::Close(size_t offset) {
+    const Frame& frame = frames_[--depth_];
+    if (capturing_ > 0) {
+        if (frame.object) {
+            SortCapturedMembers(frame);
+        }
+        capture_.push_back(frame.object ? '}' : ']');
+    }
+    const Node* node = NodeAt(frame.node);
+    if (!node) {
+        return;
+    }
+    // Errors about the container itself are reported at its closing
+    // bracket, where its size is known; the path still names it.
+    char message[96];
+    if (frame.object) {
+        if (frame.count < node->min_properties) {
+            std::snprintf(message, sizeof(message), "object has fewer than %zu properties", node->min_properties);
+            Report(offset, message);
+        }
+        if (frame.count > node->max_properties) {
+            std::snprintf(message, sizeof(message), "object has more than %zu properties", node->max_properties);
+            Report(offset, message);
+        }
+        for (uint32_t i = node->properties_begin; i < node->properties_end; ++i) {
+            const Property& property = schema_.properties_[i];
+            if (property.required_slot >= 0 && !frame.seen[static_cast<size_t>(property.required_slot)]) {
+                Report(offset, "missing required property '" + property.name + "'");
+            }
+        }
+    } else {
+        if (frame.count < node->min_items) {
+            std::snprintf(message, sizeof(message), "array has fewer than %zu items", node->min_items);
+            Report(offset, message);
+        }
+        if (frame.count > node->max_items) {
+            std::snprintf(message, sizeof(message), "array has more than %zu items", node->max_items);
+            Report(offset, message);
+        }
+    }
+    if (frame.capture != kNoCapture) {
+        if (!InEnum(*node, std::string_view(capture_).substr(frame.capture))) {
+            Report(offset, "value is not one of the allowed values");
+        }
+        if (--capturing_ == 0) {
+            capture_.clear();
+        }
+    }
+}
+
+JsonSchemaResult JsonSchema::Validate(std::string_view document, JobContext* job) const {
+    JsonSchemaResult result;
+    Validator validator(*this, result);
+    result.syntax = ScanJsonEvents(document, validator, job);
+    return result;
+}
+
+std::shared_ptr<const JsonSchema> JsonSchemaCache::Get(std::string_view text, bool& hit, std::string& error) {
+    const size_t hash = std::hash<std::string_view>{}(text);
+    ++clock_;
+    for (Entry& entry : entries_) {
+        if (entry.hash == hash && entry.text == text) {
+            entry.last_use = clock_;
+            hit = true;
+            return entry.schema;
+        }
+    }
+    hit = false;
+    auto schema = std::make_shared<JsonSchema>();
+    if (!schema->Compile(text, error)) {
+        return nullptr;
+    }
+    if (entries_.size() >= kMaxCachedSchemas) {
+        entries_.erase(std::min_element(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+            return a.last_use < b.last_use;
+        }));
+    }
+    entries_.push_back(Entry{hash, std::string(text), schema, clock_});
+    return schema;
+}
+
+void JsonSchemaCache::Clear() {
+    entries_.clear();
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json_pattern.h"
+#include "json_stream_formatter.h"
+
+class JobContext;
+class JsonTape;
+
+struct JsonSchemaError {
+    size_t line = 0; // One-based NDJSON record line; 0 for a single document.
+    size_t offset = 0;
+    std::string path; // JSON Pointer of the failing value.
+    std::string message;
+};
+
+struct JsonSchemaResult {
+    // Most errors kept in `errors`, so a document that fails everywhere
+    // does not allocate one message per value.
+    static constexpr size_t kMaxReportedErrors = 1000;
+
+    // Syntax check of the document; the schema errors below only cover the
+    // part that was read before a syntax error.
+    JsonFormatResult syntax;
+    size_t error_count = 0;
+    // The first few errors; error_count has the total.
+    std::vector<JsonSchemaError> errors;
+
+    bool valid() const {
+        return syntax.ok && error_count == 0;
+    }
+};
+
+// JSON Schema subset compiled into a flat program: one node per subschema,
+// with properties, enum values and patterns in shared tables referenced by
+// index. Supported keywords: type, properties, required,
+// additionalProperties, items, enum, const, pattern, minimum, maximum,
+// exclusiveMinimum, exclusiveMaximum, minLength, maxLength, minItems,
+// maxItems, minProperties, maxProperties and local "#/..." $ref. Other
+// keywords are ignored. Validation is a single streaming pass over the
+// document's tokens with one frame per open container, so no DOM is built.
+class JsonSchema {
+public:
+    bool Compile(std::string_view schema, std::string& error);
+
+    JsonSchemaResult Validate(std::string_view document, JobContext* job = nullptr) const;
+
+    size_t node_count() const {
+        return nodes_.size();
+    }
+
+private:
+    // Node index meaning "no constraints" (the `true` schema or no schema).
+    static constexpr int kAny = -1;
+
+    enum TypeBits : uint8_t {
+        kNull = 1 << 0,
+        kBoolean = 1 << 1,
+        kObject = 1 << 2,
+        kArray = 1 << 3,
+        kNumber = 1 << 4,
+        kString = 1 << 5,
+        kInteger = 1 << 6,
+        kAllTypes = 0x7F
+    };
+
+    struct Node {
+        uint8_t types = kAllTypes;
+        bool never = false; // The `false` schema.
+        bool has_enum = false;
+        bool has_minimum = false;
+        bool has_maximum = false;
+        bool has_exclusive_minimum = false;
+        bool has_exclusive_maximum = false;
+        double minimum = 0.0;
+        double maximum = 0.0;
+        double exclusive_minimum = 0.0;
+        double exclusive_maximum = 0.0;
+        size_t min_length = 0;
+        size_t max_length = SIZE_MAX;
+        size_t min_items = 0;
+        size_t max_items = SIZE_MAX;
+        size_t min_properties = 0;
+        size_t max_properties = SIZE_MAX;
+        int items = kAny;
+        int additional = kAny;
+        int pattern = -1;
+        // Ranges in properties_ (sorted by name) and enums_.
+        uint32_t properties_begin = 0;
+        uint32_t properties_end = 0;
+        uint32_t required_count = 0;
+        uint32_t enums_begin = 0;
+        uint32_t enums_end = 0;
+    };
+
+    struct Property {
+        std::string name;
+        int node = kAny;
+        int required_slot = -1;
+    };
+
+    struct Pattern {
+        std::string source;
+        JsonPattern matcher;
+    };
+
+    class Compiler;
+    class Validator;
+
+    int root_ = kAny;
+    std::vector<Node> nodes_;
+    std::vector<Property> properties_;
+    // Canonical text of each enum/const value, see AppendCanonical*.
+    std::vector<std::string> enums_;
+    std::vector<Pattern> patterns_;
+};
+
+// Compiled schemas keyed by a hash of their text, so validating many
+// documents against the same schema compiles it once. Least recently used
+// entries are dropped past a handful of schemas.
+class JsonSchemaCache {
+public:
+    // Returns the compiled schema for `text`, compiling it on a miss.
+    // `hit` tells whether it came from the cache.
+    std::shared_ptr<const JsonSchema> Get(std::string_view text, bool& hit, std::string& error);
+    void Clear();
+
+private:
+    struct Entry {
+        size_t hash = 0;
+        std::string text;
+        std::shared_ptr<const JsonSchema> schema;
+        uint64_t last_use = 0;
+    };
+
+    std::vector<Entry> entries_;
+    uint64_t clock_ = 0;
+};
@@ -0,0 +1,171 @@
+#include "json_schema_panel.h"
+
+#include <imgui.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#include "input_text.h"
+#include "json_lexing.h"
+
+namespace {
+
+// Validates every non-blank line of `input` as its own document. Errors
+// carry their line, and offsets are made relative to the whole input.
+void ValidateRecords(const JsonSchema& schema, std::string_view input, JsonSchemaResult& result, size_t& records,
+                     size_t& invalid_records, JobContext& job) {
+    size_t line = 0;
+    size_t pos = 0;
+    while (pos < input.size()) {
+        if (job.Cancelled()) {
+            result.syntax.ok = false;
+            result.syntax.cancelled = true;
+            return;
+        }
+        job.ReportProgress(pos);
+        const char* newline = static_cast<const char*>(std::memchr(input.data() + pos, '\n', input.size() - pos));
+        const size_t end = newline ? static_cast<size_t>(newline - input.data()) : input.size();
+        size_t begin = pos;
+        size_t stop = end;
+        pos = end + 1;
+        ++line;
+        while (begin < stop && IsJsonWhitespace(input[begin])) {
+            ++begin;
+        }
+        while (stop > begin && IsJsonWhitespace(input[stop - 1])) {
+            --stop;
+        }
+        if (begin == stop) {
+            continue;
+        }
+        ++records;
+        JsonSchemaResult record = schema.Validate(input.substr(begin, stop - begin));
+        if (record.valid()) {
+            continue;
+        }
+        ++invalid_records;
+        if (!record.syntax.ok) {
+            ++record.error_count;
+            record.errors.push_back(JsonSchemaError{0, record.syntax.error_offset, std::string(),
+                                                    "invalid JSON: " + record.syntax.error});
+        }
+        for (JsonSchemaError& error : record.errors) {
+            if (result.errors.size() >= JsonSchemaResult::kMaxReportedErrors) {
+                break;
+            }
+            error.line = line;
+            error.offset += begin;
+            result.errors.push_back(std::move(error));
+        }
+        result.error_count += record.error_count;
+    }
+}
+
+} // namespace
+
+void JsonSchemaPanel::Validate(SharedText input, bool ndjson) {
+    bool hit = false;
+    std::string error;
+    const auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const JsonSchema> schema = cache_.Get(schema_text_, hit, error);
+    if (!schema) {
+        job_.Cancel();
+        errors_.clear();
+        error_count_ = 0;
+        status_ = "Schema error: " + error;
+        return;
+    }
+    char note[96];
+    if (hit) {
+        std::snprintf(note, sizeof(note), "cached schema, %zu nodes", schema->node_count());
+    } else {
+        std::snprintf(note, sizeof(note), "schema compiled in %.2f ms, %zu nodes",
+                      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                      schema->node_count());
+    }
+    compile_note_ = note;
+    status_.clear();
+    job_.Start(input.view().size(), [schema, input, ndjson](JobContext& job) {
+        ValidationOutput output;
+        output.ndjson = ndjson;
+        const auto begin = std::chrono::steady_clock::now();
+        if (ndjson) {
+            ValidateRecords(*schema, input.view(), output.result, output.records, output.invalid_records, job);
+        } else {
+            output.result = schema->Validate(input.view(), &job);
+        }
+        output.cancelled = output.result.syntax.cancelled;
+        output.milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        return output;
+    });
+}
+
+void JsonSchemaPanel::Clear() {
+    job_.Cancel();
+    errors_.clear();
+    error_count_ = 0;
+    status_.clear();
+}
+
+bool JsonSchemaPanel::Render(const char* id) {
+    if (auto finished = job_.TakeResult()) {
+        const JsonSchemaResult& result = finished->result;
+        errors_ = std::move(finished->result.errors);
+        error_count_ = result.error_count;
+        char buffer[512];
+        if (finished->cancelled) {
+            std::snprintf(buffer, sizeof(buffer), "%s", "Cancelled.");
+        } else if (finished->ndjson) {
+            std::snprintf(buffer, sizeof(buffer), "%zu of %zu records valid in %.1f ms (%s).",
+                          finished->records - finished->invalid_records, finished->records,
+                          finished->milliseconds, compile_note_.c_str());
+        } else if (!result.syntax.ok) {
+            std::snprintf(buffer, sizeof(buffer), "Not valid JSON: %s", result.syntax.error.c_str());
+        } else if (result.error_count == 0) {
+            std::snprintf(buffer, sizeof(buffer), "Valid in %.1f ms (%s).", finished->milliseconds,
+                          compile_note_.c_str());
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "%zu schema errors in %.1f ms (%s).", result.error_count,
+                          finished->milliseconds, compile_note_.c_str());
+        }
+        status_ = buffer;
+    }
+
+    ImGui::PushID(id);
+    InputTextMultilineString("##Schema", &schema_text_, ImVec2(-1.0f, ImGui::GetContentRegionAvail().y * 0.4f));
+    const bool validate = ImGui::Button("Validate input");
+    ImGui::SameLine();
+    if (job_.Running()) {
+        ImGui::TextDisabled("Validating... %.0f%%", job_.Fraction() * 100.0f);
+    } else if (!status_.empty()) {
+        ImGui::TextWrapped("%s", status_.c_str());
+    }
+
+    ImGui::BeginChild("SchemaErrors", ImVec2(-1.0f, -1.0f), true);
+    if (!job_.Running()) {
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(errors_.size()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                const JsonSchemaError& error = errors_[static_cast<size_t>(i)];
+                const char* path = error.path.empty() ? "(root)" : error.path.c_str();
+                if (error.line > 0) {
+                    ImGui::Text("line %zu  @%zu  %s: %s", error.line, error.offset, path, error.message.c_str());
+                } else {
+                    ImGui::Text("@%zu  %s: %s", error.offset, path, error.message.c_str());
+                }
+            }
+        }
+        clipper.End();
+        if (error_count_ > errors_.size()) {
+            ImGui::TextDisabled("... and %zu more", error_count_ - errors_.size());
+        }
+    }
+    ImGui::EndChild();
+    ImGui::PopID();
+    return validate;
+}
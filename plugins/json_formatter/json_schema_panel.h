@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "background_job.h"
+#include "json_schema.h"
+#include "mapped_file.h"
+
+// Schema editor with a clipped validation report. Validation streams over
+// the input text on a background thread, so it needs no tape and works on
+// mapped files; compiled schemas are reused through a JsonSchemaCache as
+// long as the schema text is unchanged.
+class JsonSchemaPanel {
+public:
+    // Draws the panel. Returns true when the user asked for a validation;
+    // the caller then hands the current input to Validate().
+    bool Render(const char* id);
+    void Validate(SharedText input, bool ndjson);
+    void Clear();
+
+private:
+    struct ValidationOutput {
+        JsonSchemaResult result;
+        bool ndjson = false;
+        size_t records = 0;
+        size_t invalid_records = 0;
+        bool cancelled = false;
+        double milliseconds = 0.0;
+    };
+
+    std::string schema_text_ = "{\n    \"type\": \"object\"\n}";
+    JsonSchemaCache cache_;
+    BackgroundJob<ValidationOutput> job_;
+    std::string compile_note_;
+    std::string status_;
+    std::vector<JsonSchemaError> errors_;
+    size_t error_count_ = 0;
+};
@@ -0,0 +1,595 @@
+#include "json_stream_formatter.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "background_job.h"
+#include "json_lexing.h"
+#include "json_structural_index.h"
+#include "json_tape.h"
+#include "output_sink.h"
+#include "parallel_for.h"
+
+namespace {
+
+constexpr size_t kJobCheckInterval = 64 * 1024;
+// Target size of one slice in FormatJsonParallel, and the input size below
+// which splitting is not worth it.
+constexpr size_t kSliceBytes = 1024 * 1024;
+constexpr size_t kMinParallelBytes = 8 * kSliceBytes;
+// Slices per worker in one wave of FormatJsonParallel.
+constexpr size_t kSlicesPerWorker = 4;
+
+// Stage 2: walks the structural index produced by JsonStructuralScanner,
+// checks the grammar and, when given a sink, writes the re-indented output.
+// When given a tape it also records one JsonTape entry per key and value;
+// when given a handler it reports them as events.
+class IndexedFormatter {
+public:
+    IndexedFormatter(std::string_view input,
+                     const JsonFormatOptions& options,
+                     OutputSink* out,
+                     JobContext* job,
+                     std::vector<uint64_t>* tape = nullptr,
+                     JsonEventHandler* events = nullptr)
+        : input_(input),
+          scanner_(input),
+          indent_(options.indent < 0 ? 0 : static_cast<size_t>(options.indent)),
+          out_(out),
+          job_(job),
+          tape_(tape),
+          events_(events) {}
+
+    // Treats the input as the body of an open container whose closing
+    // bracket is `close`: a comma-separated run of values (or members),
+    // written as if nested one level deep. Must be called before Run().
+    void BeginSlice(char close) {
+        stack_.push_back(close);
+        expect_ = close == '}' ? Expect::Key : Expect::Value;
+        slice_ = true;
+    }
+
+    JsonFormatResult Run();
+
+private:
+    enum class Expect {
+        Value,
+        Key,
+        Colon,
+        CommaOrClose,
+        End
+    };
+
+    void Emit(std::string_view text) {
+        if (out_) {
+            out_->Append(text);
+        }
+    }
+
+    void EmitChar(char c) {
+        if (out_) {
+            out_->Put(c);
+        }
+    }
+
+    void NewLine() {
+        if (out_) {
+            out_->Put('\n');
+            out_->PutRepeated(' ', indent_ * stack_.size());
+        }
+    }
+
+    bool Fail(const char* expected) {
+        if (pos_ >= input_.size() && scanner_.failed()) {
+            return FailAt(scanner_.error_offset(), scanner_.error());
+        }
+        char got[32];
+        if (pos_ >= input_.size()) {
+            std::snprintf(got, sizeof(got), "%s", "end of input");
+        } else {
+            unsigned char c = static_cast<unsigned char>(input_[pos_]);
+            if (c >= 0x20 && c < 0x7F) {
+                std::snprintf(got, sizeof(got), "'%c'", c);
+            } else {
+                std::snprintf(got, sizeof(got), "byte 0x%02X", c);
+            }
+        }
+        char message[128];
+        std::snprintf(message, sizeof(message), "unexpected %s at offset %zu; expected %s",
+                      got, pos_, expected);
+        result_.ok = false;
+        result_.error = message;
+        result_.error_offset = pos_;
+        return false;
+    }
+
+    bool FailAt(size_t offset, const char* message) {
+        pos_ = offset;
+        char buffer[128];
+        std::snprintf(buffer, sizeof(buffer), "%s at offset %zu", message, offset);
+        result_.ok = false;
+        result_.error = buffer;
+        result_.error_offset = offset;
+        return false;
+    }
+
+    // Appends a tape entry for the token at pos_. Fails once the tape has
+    // run out of addressable entries.
+    bool Record(JsonKind kind, uint64_t link) {
+        if (!tape_) {
+            return true;
+        }
+        if (tape_->size() >= JsonTape::kMaxLink) {
+            return FailAt(pos_, "too many values for the document tape");
+        }
+        tape_->push_back(JsonTape::Encode(kind, pos_, link < JsonTape::kMaxLink ? link : JsonTape::kMaxLink));
+        return true;
+    }
+
+    // Reports progress and returns false if the job was cancelled.
+    bool CheckJob() {
+        next_check_ = pos_ + kJobCheckInterval;
+        job_->ReportProgress(pos_);
+        if (job_->Cancelled()) {
+            result_.ok = false;
+            result_.cancelled = true;
+            result_.error = "cancelled";
+            return false;
+        }
+        return true;
+    }
+
+    // End of the string or scalar token at pos_: the next structural offset
+    // with the whitespace in between trimmed off.
+    bool TokenEnd(size_t& end) {
+        end = scanner_.Peek();
+        if (end == input_.size() && scanner_.failed()) {
+            return FailAt(scanner_.error_offset(), scanner_.error());
+        }
+        while (end > pos_ && IsJsonWhitespace(input_[end - 1])) {
+            --end;
+        }
+        return true;
+    }
+
+    bool CopyString();
+    bool CopyScalar();
+    bool BeginValue();
+    void EndValue();
+
+    std::string_view input_;
+    JsonStructuralScanner scanner_;
+    size_t indent_;
+    OutputSink* out_;
+    JobContext* job_;
+    std::vector<uint64_t>* tape_;
+    JsonEventHandler* events_;
+    // Tape entries of the open containers, patched when they close.
+    std::vector<uint32_t> open_;
+    size_t pos_ = 0;
+    size_t next_check_ = 0;
+    Expect expect_ = Expect::Value;
+    bool slice_ = false;
+    // One entry per open container: '}' for objects, ']' for arrays.
+    std::vector<char> stack_;
+    JsonFormatResult result_;
+};
+
+bool IndexedFormatter::CopyString() {
+    size_t end = 0;
+    if (!TokenEnd(end)) {
+        return false;
+    }
+    if (end - pos_ < 2 || input_[end - 1] != '"') {
+        return FailAt(pos_, "unterminated string");
+    }
+    const size_t bad = FindInvalidEscape(input_.substr(pos_ + 1, end - pos_ - 2));
+    if (bad != std::string_view::npos) {
+        const size_t offset = pos_ + 1 + bad;
+        const bool unicode = offset + 1 < input_.size() && input_[offset + 1] == 'u';
+        return FailAt(offset, unicode ? "invalid \\u escape" : "invalid escape sequence");
+    }
+    const std::string_view token = input_.substr(pos_, end - pos_);
+    if (events_) {
+        if (expect_ == Expect::Key) {
+            events_->Key(token, pos_);
+        } else {
+            events_->Value(JsonKind::String, token, pos_);
+        }
+    }
+    Emit(token);
+    return Record(JsonKind::String, token.size());
+}
+
+bool IndexedFormatter::CopyScalar() {
+    size_t end = 0;
+    if (!TokenEnd(end)) {
+        return false;
+    }
+    const std::string_view token = input_.substr(pos_, end - pos_);
+    const char c = token[0];
+    JsonKind kind = JsonKind::Number;
+    if (c == 't' || c == 'f' || c == 'n') {
+        if (token == "true") {
+            kind = JsonKind::True;
+        } else if (token == "false") {
+            kind = JsonKind::False;
+        } else if (token == "null") {
+            kind = JsonKind::Null;
+        } else {
+            return FailAt(pos_, "invalid literal");
+        }
+    } else if (c == '-' || IsDigit(c)) {
+        if (ScanJsonNumber(token) != token.size()) {
+            return FailAt(pos_, "invalid number");
+        }
+    } else {
+        return Fail("value");
+    }
+    if (events_) {
+        events_->Value(kind, token, pos_);
+    }
+    Emit(token);
+    return Record(kind, token.size());
+}
+
+bool IndexedFormatter::BeginValue() {
+    const char c = input_[pos_];
+    if (c == '{' || c == '[') {
+        const char close = c == '{' ? '}' : ']';
+        const JsonKind kind = c == '{' ? JsonKind::Object : JsonKind::Array;
+        const size_t next = scanner_.Peek();
+        if (events_) {
+            events_->Value(kind, input_.substr(pos_, 1), pos_);
+        }
+        if (next < input_.size() && input_[next] == close) {
+            scanner_.Next();
+            if (events_) {
+                events_->Close(next);
+            }
+            EmitChar(c);
+            EmitChar(close);
+            EndValue();
+            return Record(kind, tape_ ? tape_->size() + 1 : 0);
+        }
+        EmitChar(c);
+        stack_.push_back(close);
+        if (tape_) {
+            open_.push_back(static_cast<uint32_t>(tape_->size()));
+        }
+        if (!Record(kind, 0)) {
+            return false;
+        }
+        NewLine();
+        expect_ = c == '{' ? Expect::Key : Expect::Value;
+        return true;
+    }
+    if (c == '"') {
+        if (!CopyString()) {
+            return false;
+        }
+    } else if (c == '}' || c == ']' || c == ':' || c == ',') {
+        return Fail("value");
+    } else if (!CopyScalar()) {
+        return false;
+    }
+    EndValue();
+    return true;
+}
+
+void IndexedFormatter::EndValue() {
+    expect_ = stack_.empty() ? Expect::End : Expect::CommaOrClose;
+}
+
+JsonFormatResult IndexedFormatter::Run() {
+    while (true) {
+        pos_ = scanner_.Next();
+        if (pos_ >= input_.size()) {
+            break;
+        }
+        if (job_ && pos_ >= next_check_ && !CheckJob()) {
+            return result_;
+        }
+        const char c = input_[pos_];
+        switch (expect_) {
+            case Expect::Value:
+                if (!BeginValue()) {
+                    return result_;
+                }
+                break;
+            case Expect::Key:
+                if (c != '"') {
+                    Fail("object key");
+                    return result_;
+                }
+                if (!CopyString()) {
+                    return result_;
+                }
+                expect_ = Expect::Colon;
+                break;
+            case Expect::Colon:
+                if (c != ':') {
+                    Fail("':'");
+                    return result_;
+                }
+                Emit(": ");
+                expect_ = Expect::Value;
+                break;
+            case Expect::CommaOrClose:
+                if (c == ',') {
+                    EmitChar(',');
+                    NewLine();
+                    expect_ = stack_.back() == '}' ? Expect::Key : Expect::Value;
+                } else if (c == stack_.back()) {
+                    stack_.pop_back();
+                    if (events_) {
+                        events_->Close(pos_);
+                    }
+                    if (tape_) {
+                        (*tape_)[open_.back()] |= static_cast<uint64_t>(tape_->size()) << 32;
+                        open_.pop_back();
+                    }
+                    NewLine();
+                    EmitChar(c);
+                    EndValue();
+                } else {
+                    Fail(stack_.back() == '}' ? "',' or '}'" : "',' or ']'");
+                    return result_;
+                }
+                break;
+            case Expect::End:
+                Fail("end of input");
+                return result_;
+        }
+    }
+    if (scanner_.failed()) {
+        FailAt(scanner_.error_offset(), scanner_.error());
+    } else if (slice_ ? expect_ != Expect::CommaOrClose || stack_.size() != 1 : expect_ != Expect::End) {
+        Fail(expect_ == Expect::Key ? "object key" : "value");
+    }
+    return result_;
+}
+
+// Pre-scan for FormatJsonParallel: finds the root container's brackets and
+// commas directly inside it, about every kSliceBytes. Returns false when
+// the document is not a single non-empty container or the scanner reports
+// an error; the sequential formatter then produces the result or message.
+bool FindSlices(std::string_view input, size_t& open, size_t& close, std::vector<size_t>& cuts, JobContext* job) {
+    JsonStructuralScanner scanner(input);
+    open = scanner.Next();
+    if (open >= input.size() || (input[open] != '[' && input[open] != '{')) {
+        return false;
+    }
+    size_t depth = 1;
+    size_t next_cut = open + kSliceBytes;
+    size_t next_check = 0;
+    close = input.size();
+    for (size_t pos = scanner.Next(); pos < input.size(); pos = scanner.Next()) {
+        if (job && pos >= next_check) {
+            next_check = pos + kSliceBytes;
+            if (job->Cancelled()) {
+                return false;
+            }
+        }
+        const char c = input[pos];
+        if (c == '[' || c == '{') {
+            ++depth;
+        } else if (c == ']' || c == '}') {
+            if (--depth == 0) {
+                close = pos;
+                break;
+            }
+        } else if (c == ',' && depth == 1 && pos >= next_cut) {
+            cuts.push_back(pos);
+            next_cut = pos + kSliceBytes;
+        }
+    }
+    if (close == input.size() || scanner.Next() < input.size() || scanner.failed()) {
+        return false;
+    }
+    return input[close] == (input[open] == '[' ? ']' : '}') && !cuts.empty();
+}
+
+JsonFormatResult CancelledResult() {
+    JsonFormatResult result;
+    result.ok = false;
+    result.cancelled = true;
+    result.error = "cancelled";
+    return result;
+}
+
+} // namespace
+
+JsonFormatResult FormatJsonStream(std::string_view input,
+                                  const JsonFormatOptions& options,
+                                  OutputSink& out,
+                                  JobContext* job) {
+    IndexedFormatter formatter(input, options, &out, job);
+    JsonFormatResult result = formatter.Run();
+    if (job && result.ok) {
+        job->ReportProgress(input.size());
+    }
+    if (!out.Finish() && result.ok) {
+        result.ok = false;
+        result.error = "failed to write output";
+    }
+    return result;
+}
+
+JsonFormatResult FormatJsonParallel(std::string_view input,
+                                    const JsonFormatOptions& options,
+                                    OutputSink& out,
+                                    JobContext* job) {
+    size_t open = 0;
+    size_t close = 0;
+    std::vector<size_t> cuts;
+    if (input.size() < kMinParallelBytes || WorkerCount() < 2 || !FindSlices(input, open, close, cuts, job)) {
+        if (job && job->Cancelled()) {
+            return CancelledResult();
+        }
+        return FormatJsonStream(input, options, out, job);
+    }
+
+    const size_t indent = options.indent < 0 ? 0 : static_cast<size_t>(options.indent);
+    const char close_char = input[close];
+    // Slice i spans (cuts[i - 1], cuts[i]), with the brackets as the outer
+    // bounds; the commas between slices are written here.
+    cuts.push_back(close);
+    const size_t wave_slices = WorkerCount() * kSlicesPerWorker;
+    std::vector<std::string> buffers;
+    std::vector<JsonFormatResult> results;
+    out.Put(input[open]);
+    for (size_t first = 0; first < cuts.size(); first += wave_slices) {
+        const size_t count = cuts.size() - first < wave_slices ? cuts.size() - first : wave_slices;
+        buffers.assign(count, std::string());
+        results.assign(count, JsonFormatResult{});
+        ParallelFor(count, [&](size_t i) {
+            const size_t begin = first + i == 0 ? open + 1 : cuts[first + i - 1] + 1;
+            const std::string_view slice = input.substr(begin, cuts[first + i] - begin);
+            buffers[i].reserve(slice.size() + slice.size() / 2);
+            StringSink sink(buffers[i]);
+            IndexedFormatter formatter(slice, options, &sink, nullptr);
+            formatter.BeginSlice(close_char);
+            results[i] = formatter.Run();
+        });
+        for (size_t i = 0; i < count; ++i) {
+            if (!results[i].ok) {
+                // Offsets inside a slice mean nothing to the caller; rerun
+                // the validator for the exact sequential message. The output
+                // is partial either way, so a document the validator accepts
+                // still fails.
+                JsonFormatResult result = ValidateJson(input, job);
+                out.Finish();
+                if (result.ok) {
+                    result.ok = false;
+                    result.error = "internal error: formatting a slice failed: " + results[i].error;
+                }
+                return result;
+            }
+            if (first + i != 0) {
+                out.Put(',');
+            }
+            out.Put('\n');
+            out.PutRepeated(' ', indent);
+            out.Append(buffers[i]);
+        }
+        if (job) {
+            job->ReportProgress(cuts[first + count - 1]);
+            if (job->Cancelled()) {
+                out.Finish();
+                return CancelledResult();
+            }
+        }
+    }
+    out.Put('\n');
+    out.Put(close_char);
+
+    JsonFormatResult result;
+    if (job) {
+        job->ReportProgress(input.size());
+    }
+    if (!out.Finish()) {
+        result.ok = false;
+        result.error = "failed to write output";
+    }
+    return result;
+}
+
+JsonFormatResult BuildJsonTape(std::string_view input, std::vector<uint64_t>& tape, JobContext* job) {
+    IndexedFormatter builder(input, JsonFormatOptions{}, nullptr, job, &tape);
+    JsonFormatResult result = builder.Run();
+    if (job && result.ok) {
+        job->ReportProgress(input.size());
+    }
+    return result;
+}
+
+JsonFormatResult ScanJsonEvents(std::string_view input, JsonEventHandler& handler, JobContext* job) {
+    IndexedFormatter scanner(input, JsonFormatOptions{}, nullptr, job, nullptr, &handler);
+    JsonFormatResult result = scanner.Run();
+    if (job && result.ok) {
+        job->ReportProgress(input.size());
+    }
+    return result;
+}
+
+JsonFormatResult FormatJsonTape(const JsonTape& tape,
+                                const JsonFormatOptions& options,
+                                OutputSink& out,
+                                JobContext* job) {
+    JsonFormatResult result;
+    const size_t indent = options.indent < 0 ? 0 : static_cast<size_t>(options.indent);
+    struct Open {
+        uint32_t end;
+        bool object;
+    };
+    std::vector<Open> open;
+    const auto new_line = [&]() {
+        out.Put('\n');
+        out.PutRepeated(' ', indent * open.size());
+    };
+    const auto size = static_cast<uint32_t>(tape.size());
+    uint32_t entry = JsonTape::kRoot;
+    uint32_t next_check = 0;
+    while (entry < size) {
+        if (job && entry >= next_check) {
+            next_check = entry + 0x10000;
+            job->ReportProgress(tape.offset(entry));
+            if (job->Cancelled()) {
+                result.ok = false;
+                result.cancelled = true;
+                result.error = "cancelled";
+                break;
+            }
+        }
+        if (!open.empty() && open.back().object) {
+            out.Append(tape.Token(entry));
+            out.Append(": ");
+            ++entry;
+        }
+        const JsonKind kind = tape.kind(entry);
+        const uint32_t next = tape.next(entry);
+        if (kind == JsonKind::Object || kind == JsonKind::Array) {
+            const char close = kind == JsonKind::Object ? '}' : ']';
+            out.Put(kind == JsonKind::Object ? '{' : '[');
+            if (next > entry + 1) {
+                open.push_back(Open{next, kind == JsonKind::Object});
+                new_line();
+                ++entry;
+                continue;
+            }
+            out.Put(close);
+        } else {
+            out.Append(tape.Token(entry));
+        }
+        entry = next;
+        while (!open.empty() && entry == open.back().end) {
+            const char close = open.back().object ? '}' : ']';
+            open.pop_back();
+            new_line();
+            out.Put(close);
+        }
+        if (open.empty()) {
+            break;
+        }
+        out.Put(',');
+        new_line();
+    }
+    if (job && result.ok) {
+        job->ReportProgress(tape.input().size());
+    }
+    if (!out.Finish() && result.ok) {
+        result.ok = false;
+        result.error = "failed to write output";
+    }
+    return result;
+}
+
+JsonFormatResult ValidateJson(std::string_view input, JobContext* job) {
+    IndexedFormatter validator(input, JsonFormatOptions{}, nullptr, job);
+    JsonFormatResult result = validator.Run();
+    if (job && result.ok) {
+        job->ReportProgress(input.size());
+    }
+    return result;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JobContext;
+class JsonTape;
+class OutputSink;
+enum class JsonKind : uint8_t;
+
+struct JsonFormatOptions {
+    int indent = 4;
+};
+
+struct JsonFormatResult {
+    bool ok = true;
+    bool cancelled = false;
+    std::string error;
+    size_t error_offset = 0;
+};
+
+// Validates `input` as a single JSON document and writes it re-indented to
+// `out` in one forward pass over the SIMD structural index. Number and
+// string lexemes are copied through byte-for-byte; besides one index chunk
+// the only state kept is one byte per open container, so memory is bounded
+// by nesting depth rather than document size. When `job` is given, progress
+// is reported to it and cancellation is polled every few kilobytes of input.
+JsonFormatResult FormatJsonStream(std::string_view input,
+                                  const JsonFormatOptions& options,
+                                  OutputSink& out,
+                                  JobContext* job = nullptr);
+
+// Same output as FormatJsonStream, produced on all cores when the root is a
+// large array or object: a structural pre-scan cuts the root's body at
+// top-level commas, the slices are formatted concurrently into separate
+// buffers, and the buffers are written out in order. Small inputs and
+// anything the pre-scan cannot split go through FormatJsonStream.
+JsonFormatResult FormatJsonParallel(std::string_view input,
+                                    const JsonFormatOptions& options,
+                                    OutputSink& out,
+                                    JobContext* job = nullptr);
+
+// Same checks as FormatJsonStream without producing any output.
+JsonFormatResult ValidateJson(std::string_view input, JobContext* job = nullptr);
+
+// Same checks as ValidateJson, appending one JsonTape entry per key and
+// value to `tape` on the way. Used by JsonTape::Build.
+JsonFormatResult BuildJsonTape(std::string_view input, std::vector<uint64_t>& tape, JobContext* job = nullptr);
+
+// Receives the tokens of a document in order while ScanJsonEvents checks
+// it. Tokens are views into the input; strings keep their quotes and
+// escapes. Events for a malformed document stop at the error.
+class JsonEventHandler {
+public:
+    virtual ~JsonEventHandler() = default;
+    virtual void Key(std::string_view token, size_t offset) = 0;
+    // For containers `token` is the opening bracket; Close() follows after
+    // the last child.
+    virtual void Value(JsonKind kind, std::string_view token, size_t offset) = 0;
+    virtual void Close(size_t offset) = 0;
+};
+
+// Same checks as ValidateJson, reporting every key and value to `handler`
+// without building anything in memory.
+JsonFormatResult ScanJsonEvents(std::string_view input, JsonEventHandler& handler, JobContext* job = nullptr);
+
+// Writes an already validated document from its tape, producing the same
+// output as FormatJsonStream without rescanning the input.
+JsonFormatResult FormatJsonTape(const JsonTape& tape,
+                                const JsonFormatOptions& options,
+                                OutputSink& out,
+                                JobContext* job = nullptr);
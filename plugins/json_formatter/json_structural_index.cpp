@@ -0,0 +1,443 @@
+#include "json_structural_index.h"
+
+#include <bit>
+#include <cstring>
+#include <vector>
+
+#include "background_job.h"
+#include "json_lexing.h"
+#include "output_sink.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GTOOLS_JSON_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define GTOOLS_TARGET_AVX2
+#else
+#define GTOOLS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+constexpr size_t kChunkBytes = 256 * 1024;
+constexpr size_t kMinifyCheckInterval = 64 * 1024;
+constexpr uint64_t kEvenBits = 0x5555555555555555ULL;
+
+struct BlockMasks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t whitespace = 0;
+    uint64_t op = 0;
+    uint64_t control = 0;
+    uint64_t high = 0;
+};
+
+using ClassifyFn = void (*)(const unsigned char* block, BlockMasks& masks);
+
+#if !defined(GTOOLS_JSON_X86)
+
+void ClassifyScalar(const unsigned char* block, BlockMasks& masks) {
+    masks = BlockMasks{};
+    for (int i = 0; i < 64; ++i) {
+        const unsigned char c = block[i];
+        const uint64_t bit = 1ULL << i;
+        switch (c) {
+            case '"':
+                masks.quote |= bit;
+                break;
+            case '\\':
+                masks.backslash |= bit;
+                break;
+            case ' ':
+                masks.whitespace |= bit;
+                break;
+            case '\t':
+            case '\n':
+            case '\r':
+                masks.whitespace |= bit;
+                masks.control |= bit;
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                masks.op |= bit;
+                break;
+            default:
+                if (c < 0x20) {
+                    masks.control |= bit;
+                } else if (c >= 0x80) {
+                    masks.high |= bit;
+                }
+                break;
+        }
+    }
+}
+
+#else
+
+void ClassifySse2(const unsigned char* block, BlockMasks& masks) {
+    masks = BlockMasks{};
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i open_brace = _mm_set1_epi8('{');
+    const __m128i close_brace = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i control_max = _mm_set1_epi8(0x1F);
+    for (int i = 0; i < 4; ++i) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+        // '[' and ']' differ from '{' and '}' only in bit 5.
+        const __m128i folded = _mm_or_si128(v, case_bit);
+        const __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+        const __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, open_brace), _mm_cmpeq_epi8(folded, close_brace)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+        const __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(v, control_max), control_max);
+        const int shift = i * 16;
+        masks.quote |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+        masks.backslash |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+        masks.whitespace |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(ws))) << shift;
+        masks.op |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(op))) << shift;
+        masks.control |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(control))) << shift;
+        masks.high |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(v))) << shift;
+    }
+}
+
+GTOOLS_TARGET_AVX2 void ClassifyAvx2(const unsigned char* block, BlockMasks& masks) {
+    masks = BlockMasks{};
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i open_brace = _mm256_set1_epi8('{');
+    const __m256i close_brace = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i control_max = _mm256_set1_epi8(0x1F);
+    for (int i = 0; i < 2; ++i) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i * 32));
+        const __m256i folded = _mm256_or_si256(v, case_bit);
+        const __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr)));
+        const __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, open_brace), _mm256_cmpeq_epi8(folded, close_brace)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+        const __m256i control = _mm256_cmpeq_epi8(_mm256_max_epu8(v, control_max), control_max);
+        const int shift = i * 32;
+        masks.quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << shift;
+        masks.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << shift;
+        masks.whitespace |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ws))) << shift;
+        masks.op |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << shift;
+        masks.control |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(control))) << shift;
+        masks.high |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(v))) << shift;
+    }
+}
+
+bool CpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4] = {};
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+struct Kernel {
+    ClassifyFn classify;
+    const char* name;
+};
+
+Kernel SelectKernel() {
+#if defined(GTOOLS_JSON_X86)
+    if (CpuHasAvx2()) {
+        return {&ClassifyAvx2, "AVX2"};
+    }
+    return {&ClassifySse2, "SSE2"};
+#else
+    return {&ClassifyScalar, "scalar"};
+#endif
+}
+
+const Kernel g_kernel = SelectKernel();
+
+// Copies the bytes of a 64-byte block whose bit is set in `keep` to `dst`,
+// in order. May write up to 8 bytes past the returned count.
+using CompactFn = size_t (*)(const unsigned char* block, uint64_t keep, char* dst);
+
+// For every 8-bit mask, the positions of its set bits packed into bytes.
+struct CompactTable {
+    uint64_t shuffle[256];
+
+    constexpr CompactTable() : shuffle() {
+        for (int mask = 0; mask < 256; ++mask) {
+            uint64_t packed = 0;
+            int count = 0;
+            for (int bit = 0; bit < 8; ++bit) {
+                if (mask & (1 << bit)) {
+                    packed |= static_cast<uint64_t>(bit) << (8 * count);
+                    ++count;
+                }
+            }
+            shuffle[mask] = packed;
+        }
+    }
+};
+
+constexpr CompactTable kCompactTable;
+
+size_t CompactScalar(const unsigned char* block, uint64_t keep, char* dst) {
+    size_t written = 0;
+    while (keep != 0) {
+        dst[written++] = static_cast<char>(block[std::countr_zero(keep)]);
+        keep &= keep - 1;
+    }
+    return written;
+}
+
+#if defined(GTOOLS_JSON_X86)
+
+// pshufb-based compaction, 16 bytes per step. Only used on CPUs with AVX2,
+// which implies SSSE3.
+GTOOLS_TARGET_AVX2 size_t CompactShuffle(const unsigned char* block, uint64_t keep, char* dst) {
+    char* out = dst;
+    for (int lane = 0; lane < 4; ++lane) {
+        const auto bits = static_cast<uint32_t>((keep >> (lane * 16)) & 0xFFFF);
+        const uint32_t lo = bits & 0xFF;
+        const uint32_t hi = bits >> 8;
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + lane * 16));
+        const __m128i shuffle = _mm_set_epi64x(
+            static_cast<long long>(kCompactTable.shuffle[hi] + 0x0808080808080808ULL),
+            static_cast<long long>(kCompactTable.shuffle[lo]));
+        const __m128i packed = _mm_shuffle_epi8(v, shuffle);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), packed);
+        out += std::popcount(lo);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_unpackhi_epi64(packed, packed));
+        out += std::popcount(hi);
+    }
+    return static_cast<size_t>(out - dst);
+}
+
+CompactFn SelectCompact() {
+    return CpuHasAvx2() ? &CompactShuffle : &CompactScalar;
+}
+
+#else
+
+CompactFn SelectCompact() {
+    return &CompactScalar;
+}
+
+#endif
+
+const CompactFn g_compact = SelectCompact();
+
+// Bit i is set when byte i is the character after an odd-length run of
+// backslashes, i.e. an escaped character.
+uint64_t FindEscaped(uint64_t backslash, uint64_t& prev_odd_backslash) {
+    const uint64_t odd_bits = ~kEvenBits;
+    const uint64_t start_edges = backslash & ~(backslash << 1);
+    const uint64_t even_start_mask = kEvenBits ^ prev_odd_backslash;
+    const uint64_t even_starts = start_edges & even_start_mask;
+    const uint64_t odd_starts = start_edges & ~even_start_mask;
+    const uint64_t even_carries = backslash + even_starts;
+    uint64_t odd_carries = backslash + odd_starts;
+    const bool ends_odd = odd_carries < backslash;
+    odd_carries |= prev_odd_backslash;
+    prev_odd_backslash = ends_odd ? 1 : 0;
+    const uint64_t even_carry_ends = even_carries & ~backslash;
+    const uint64_t odd_carry_ends = odd_carries & ~backslash;
+    return (even_carry_ends & odd_bits) | (odd_carry_ends & kEvenBits);
+}
+
+uint64_t PrefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+} // namespace
+
+JsonStructuralScanner::JsonStructuralScanner(std::string_view input) : input_(input) {
+    // A block never yields more than 64 offsets; the slack lets the
+    // extraction loop below write eight at a time unconditionally. Inputs
+    // smaller than a chunk, like NDJSON records, only get what they need.
+    const size_t blocks = (input.size() + 63) / 64 * 64;
+    positions_.resize((blocks < kChunkBytes ? blocks : kChunkBytes) + 64);
+}
+
+const char* JsonStructuralScanner::KernelName() {
+    return g_kernel.name;
+}
+
+void JsonStructuralScanner::Fail(size_t offset, const char* message) {
+    if (error_ == nullptr || offset < error_offset_) {
+        error_ = message;
+        error_offset_ = offset;
+    }
+}
+
+void JsonStructuralScanner::ScanBlock(const unsigned char* block, size_t base, size_t valid_bytes) {
+    BlockMasks masks;
+    g_kernel.classify(block, masks);
+    const uint64_t valid = valid_bytes == 64 ? ~0ULL : (1ULL << valid_bytes) - 1;
+
+    const uint64_t escaped = FindEscaped(masks.backslash, prev_odd_backslash_);
+    const uint64_t quotes = masks.quote & ~escaped;
+    // Set from each opening quote up to (not including) its closing quote.
+    const uint64_t in_string = PrefixXor(quotes) ^ prev_in_string_;
+    prev_in_string_ = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+    const uint64_t boundary = masks.whitespace | masks.op | masks.quote;
+    const uint64_t scalar = ~in_string & ~boundary;
+    const uint64_t scalar_starts = scalar & ((boundary << 1) | prev_scalar_boundary_);
+    prev_scalar_boundary_ = boundary >> 63;
+
+    const uint64_t string_starts = quotes & in_string;
+    if (string_starts != 0) {
+        last_string_start_ = base + 63 - static_cast<size_t>(std::countl_zero(string_starts));
+    }
+    uint64_t structurals = ((masks.op & ~in_string) | string_starts | scalar_starts) & valid;
+    const size_t found = static_cast<size_t>(std::popcount(structurals));
+    uint32_t* out = positions_.data() + count_;
+    const auto relative = static_cast<uint32_t>(base - chunk_base_);
+    for (size_t written = 0; written < found; written += 8) {
+        for (int i = 0; i < 8; ++i) {
+            out[written + i] = relative + static_cast<uint32_t>(std::countr_zero(structurals));
+            structurals &= structurals - 1;
+        }
+    }
+    count_ += found;
+
+    const uint64_t bad_control = masks.control & in_string & valid;
+    if (bad_control != 0) {
+        Fail(base + static_cast<size_t>(std::countr_zero(bad_control)), "control character in string");
+    }
+
+    uint64_t high = masks.high & valid;
+    const auto* data = reinterpret_cast<const unsigned char*>(input_.data());
+    const auto* end = data + input_.size();
+    while (high != 0) {
+        const size_t offset = base + static_cast<size_t>(std::countr_zero(high));
+        high &= high - 1;
+        if (offset < utf8_resume_) {
+            continue;
+        }
+        const size_t len = Utf8SequenceLength(data + offset, end);
+        if (len == 0) {
+            Fail(offset, "invalid UTF-8");
+            break;
+        }
+        utf8_resume_ = offset + len;
+    }
+}
+
+bool JsonStructuralScanner::Refill() {
+    count_ = 0;
+    cursor_ = 0;
+    const auto* data = reinterpret_cast<const unsigned char*>(input_.data());
+    while (count_ == 0 && !failed() && scanned_ < input_.size()) {
+        chunk_base_ = scanned_;
+        const size_t end = input_.size() - scanned_ > kChunkBytes ? scanned_ + kChunkBytes : input_.size();
+        while (scanned_ + 64 <= end && !failed()) {
+            ScanBlock(data + scanned_, scanned_, 64);
+            scanned_ += 64;
+        }
+        if (!failed() && scanned_ < end) {
+            unsigned char tail[64];
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, data + scanned_, end - scanned_);
+            ScanBlock(tail, scanned_, end - scanned_);
+            scanned_ = end;
+        }
+        if (!failed() && scanned_ == input_.size() && prev_in_string_ != 0) {
+            Fail(last_string_start_, "unterminated string");
+        }
+    }
+    if (failed()) {
+        while (count_ > 0 && chunk_base_ + positions_[count_ - 1] >= error_offset_) {
+            --count_;
+        }
+    }
+    return count_ != 0;
+}
+
+bool MinifyJson(std::string_view input, OutputSink& out, JobContext* job) {
+    constexpr size_t kStagingBytes = 64 * 1024;
+    const auto* data = reinterpret_cast<const unsigned char*>(input.data());
+    // Blocks are compacted into a local buffer, which is handed to the sink
+    // whenever it fills up. Small inputs such as NDJSON records only get
+    // as much as they need.
+    std::vector<char> staging((input.size() < kStagingBytes ? input.size() : kStagingBytes) + 128);
+    size_t staged = 0;
+    uint64_t prev_in_string = 0;
+    uint64_t prev_odd_backslash = 0;
+    size_t next_check = 0;
+    for (size_t base = 0; base < input.size(); base += 64) {
+        if (job && base >= next_check) {
+            next_check = base + kMinifyCheckInterval;
+            job->ReportProgress(base);
+            if (job->Cancelled()) {
+                return false;
+            }
+        }
+        const size_t valid_bytes = input.size() - base < 64 ? input.size() - base : 64;
+        const unsigned char* block = data + base;
+        unsigned char tail[64];
+        if (valid_bytes < 64) {
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, block, valid_bytes);
+            block = tail;
+        }
+        BlockMasks masks;
+        g_kernel.classify(block, masks);
+        const uint64_t valid = valid_bytes == 64 ? ~0ULL : (1ULL << valid_bytes) - 1;
+        const uint64_t quotes = masks.quote & ~FindEscaped(masks.backslash, prev_odd_backslash);
+        const uint64_t in_string = PrefixXor(quotes) ^ prev_in_string;
+        prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+        const uint64_t keep = ~(masks.whitespace & ~in_string) & valid;
+        if (keep == ~0ULL) {
+            std::memcpy(staging.data() + staged, block, 64);
+            staged += 64;
+        } else {
+            staged += g_compact(block, keep, staging.data() + staged);
+        }
+        if (staged >= kStagingBytes) {
+            out.Append(std::string_view(staging.data(), staged));
+            staged = 0;
+        }
+    }
+    out.Append(std::string_view(staging.data(), staged));
+    if (job) {
+        job->ReportProgress(input.size());
+    }
+    return true;
+}
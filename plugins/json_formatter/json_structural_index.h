@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Stage 1 of the JSON pipeline. Classifies the input 64 bytes at a time
+// (AVX2 or SSE when the CPU has them, plain C++ otherwise) and produces the
+// offsets of every structural token: the characters {}[]:, outside strings,
+// the opening quote of each string and the first byte of each number or
+// literal. UTF-8 and control characters inside strings are validated here
+// so stage 2 only has to check the grammar.
+//
+// The index is produced in chunks, so walking a whole document only keeps
+// one chunk's worth of offsets in memory.
+class JobContext;
+class OutputSink;
+
+class JsonStructuralScanner {
+public:
+    explicit JsonStructuralScanner(std::string_view input);
+
+    // Offset of the next structural token, or input().size() once the input
+    // (or the part before a stage-1 error) is exhausted.
+    size_t Next() {
+        if (cursor_ == count_ && !Refill()) {
+            return input_.size();
+        }
+        return chunk_base_ + positions_[cursor_++];
+    }
+
+    size_t Peek() {
+        if (cursor_ == count_ && !Refill()) {
+            return input_.size();
+        }
+        return chunk_base_ + positions_[cursor_];
+    }
+
+    std::string_view input() const {
+        return input_;
+    }
+
+    bool failed() const {
+        return error_ != nullptr;
+    }
+
+    const char* error() const {
+        return error_;
+    }
+
+    size_t error_offset() const {
+        return error_offset_;
+    }
+
+    // Name of the block classifier picked for this CPU, for the status line.
+    static const char* KernelName();
+
+private:
+    bool Refill();
+    void ScanBlock(const unsigned char* block, size_t base, size_t valid_bytes);
+    void Fail(size_t offset, const char* message);
+
+    std::string_view input_;
+    size_t scanned_ = 0;
+    // Offsets of the current chunk, relative to chunk_base_.
+    std::vector<uint32_t> positions_;
+    size_t chunk_base_ = 0;
+    size_t count_ = 0;
+    size_t cursor_ = 0;
+
+    // State carried from one 64-byte block to the next.
+    uint64_t prev_in_string_ = 0;
+    uint64_t prev_odd_backslash_ = 0;
+    uint64_t prev_scalar_boundary_ = 1;
+    size_t utf8_resume_ = 0;
+    size_t last_string_start_ = 0;
+
+    const char* error_ = nullptr;
+    size_t error_offset_ = 0;
+};
+
+// Copies `input` to `out` without insignificant whitespace. Runs on the same
+// block classifier as the scanner, tracking string state across blocks, and
+// copies every other byte through untouched. `input` must already be valid
+// JSON. Returns false if `job` was cancelled.
+bool MinifyJson(std::string_view input, OutputSink& out, JobContext* job = nullptr);
@@ -0,0 +1,83 @@
+#include "json_tape.h"
+
+#include <cstring>
+#include <limits>
+
+#include "json_lexing.h"
+#include "json_stream_formatter.h"
+
+bool JsonTape::Build(std::string_view input, std::string& error, JobContext* job) {
+    Clear();
+    if (input.size() > std::numeric_limits<uint32_t>::max()) {
+        error = "document is larger than 4 GiB";
+        return false;
+    }
+    // Typical documents hold one value per 8-16 bytes; reserving up front
+    // keeps regrowth copies rare without committing input-sized memory.
+    entries_.reserve(input.size() / 12 + 16);
+    JsonFormatResult result = BuildJsonTape(input, entries_, job);
+    if (!result.ok) {
+        Clear();
+        error = result.error;
+        return false;
+    }
+    if (entries_.capacity() - entries_.size() > entries_.size() / 4) {
+        entries_.shrink_to_fit();
+    }
+    input_ = input;
+    return true;
+}
+
+void JsonTape::Clear() {
+    input_ = {};
+    entries_.clear();
+    entries_.shrink_to_fit();
+}
+
+std::string_view JsonTape::Token(uint32_t entry) const {
+    const size_t start = offset(entry);
+    switch (kind(entry)) {
+        case JsonKind::Object:
+        case JsonKind::Array:
+            return input_.substr(start, 1);
+        case JsonKind::True:
+        case JsonKind::Null:
+            return input_.substr(start, 4);
+        case JsonKind::False:
+            return input_.substr(start, 5);
+        case JsonKind::Number:
+        case JsonKind::String:
+            break;
+    }
+    const uint64_t length = Link(entry);
+    if (length < kMaxLink) {
+        return input_.substr(start, static_cast<size_t>(length));
+    }
+    if (kind(entry) == JsonKind::Number) {
+        return input_.substr(start, ScanJsonNumber(input_.substr(start)));
+    }
+    size_t p = start + 1;
+    while (true) {
+        const char* quote = static_cast<const char*>(std::memchr(input_.data() + p, '"', input_.size() - p));
+        const size_t q = static_cast<size_t>(quote - input_.data());
+        size_t backslashes = 0;
+        while (q - backslashes > start && input_[q - backslashes - 1] == '\\') {
+            ++backslashes;
+        }
+        if (backslashes % 2 == 0) {
+            return input_.substr(start, q + 1 - start);
+        }
+        p = q + 1;
+    }
+}
+
+std::vector<uint32_t> JsonTape::Children(uint32_t entry) const {
+    std::vector<uint32_t> children;
+    const uint32_t end = next(entry);
+    const bool object = kind(entry) == JsonKind::Object;
+    for (uint32_t child = entry + 1; child < end;) {
+        children.push_back(child);
+        child = object ? next(child + 1) : next(child);
+    }
+    return children;
+}
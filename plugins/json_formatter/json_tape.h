@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JobContext;
+
+enum class JsonKind : uint8_t {
+    Object,
+    Array,
+    String,
+    Number,
+    True,
+    False,
+    Null
+};
+
+// Read-only tape DOM over a validated JSON buffer: one tagged 64-bit entry
+// per key or value, in document order. Each entry packs
+//
+//   bits 63..61  JsonKind
+//   bits 60..32  link: for containers the entry after the whole subtree,
+//                for strings and numbers the lexeme length
+//   bits 31..0   byte offset of the lexeme
+//
+// so children can be enumerated without touching their descendants and
+// scalars are sliced out of the buffer without rescanning. Strings stay as
+// views into the buffer, which must outlive the tape. The entries live in
+// one allocation: a 200 MB document costs roughly its value count times
+// eight bytes, and freeing it is a single deallocation.
+class JsonTape {
+public:
+    static constexpr uint32_t kRoot = 0;
+    // Largest link value; longer lexemes store it and are measured on use.
+    static constexpr uint64_t kMaxLink = (uint64_t{1} << 29) - 1;
+
+    static constexpr uint64_t Encode(JsonKind kind, size_t offset, uint64_t link) {
+        return (static_cast<uint64_t>(kind) << 61) | (link << 32) | static_cast<uint32_t>(offset);
+    }
+
+    // Validates `input` and builds the tape in the same pass. Inputs over
+    // 4 GiB or with more than kMaxLink values are rejected.
+    bool Build(std::string_view input, std::string& error, JobContext* job = nullptr);
+    void Clear();
+
+    bool empty() const {
+        return entries_.empty();
+    }
+
+    size_t size() const {
+        return entries_.size();
+    }
+
+    size_t memory_bytes() const {
+        return entries_.capacity() * sizeof(uint64_t);
+    }
+
+    std::string_view input() const {
+        return input_;
+    }
+
+    JsonKind kind(uint32_t entry) const {
+        return static_cast<JsonKind>(entries_[entry] >> 61);
+    }
+
+    // One past the last entry of `entry`'s subtree.
+    uint32_t next(uint32_t entry) const {
+        const JsonKind k = kind(entry);
+        return k == JsonKind::Object || k == JsonKind::Array ? static_cast<uint32_t>(Link(entry)) : entry + 1;
+    }
+
+    size_t offset(uint32_t entry) const {
+        return static_cast<uint32_t>(entries_[entry]);
+    }
+
+    // Raw lexeme of a scalar or string entry (quotes included). For
+    // containers this is just the opening bracket.
+    std::string_view Token(uint32_t entry) const;
+
+    // Direct children of a container. For arrays these are the element
+    // entries; for objects they are the key entries, each followed by its
+    // value at key + 1.
+    std::vector<uint32_t> Children(uint32_t entry) const;
+
+private:
+    uint64_t Link(uint32_t entry) const {
+        return (entries_[entry] >> 32) & kMaxLink;
+    }
+
+    std::string_view input_;
+    std::vector<uint64_t> entries_;
+};
@@ -0,0 +1,148 @@
+#include "json_tree_view.h"
+
+#include <imgui.h>
+
+#include <cstdio>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+// Scalars longer than this are cut in the tree labels.
+constexpr int kMaxPreviewChars = 120;
+
+const char* ContainerSuffix(JsonKind kind, bool open) {
+    if (kind == JsonKind::Object) {
+        return open ? "{" : "{...}";
+    }
+    return open ? "[" : "[...]";
+}
+
+} // namespace
+
+void JsonTreeView::Clear() {
+    children_.clear();
+    expanded_.clear();
+    rows_.clear();
+    document_.reset();
+}
+
+const std::vector<uint32_t>& JsonTreeView::ChildrenOf(uint32_t entry) {
+    auto it = children_.find(entry);
+    if (it == children_.end()) {
+        it = children_.emplace(entry, document_->tape.Children(entry)).first;
+    }
+    return it->second;
+}
+
+void JsonTreeView::BuildRows() {
+    rows_.clear();
+    const JsonTape& tape = document_->tape;
+    // Pre-order walk of the expanded nodes; children are pushed in reverse
+    // so they pop in document order.
+    std::vector<Row> stack{Row{}};
+    while (!stack.empty()) {
+        const Row row = stack.back();
+        stack.pop_back();
+        rows_.push_back(row);
+        if (!expanded_.count(row.entry)) {
+            continue;
+        }
+        const bool object = tape.kind(row.entry) == JsonKind::Object;
+        const std::vector<uint32_t>& children = ChildrenOf(row.entry);
+        for (size_t i = children.size(); i-- > 0;) {
+            stack.push_back(Row{object ? children[i] + 1 : children[i], static_cast<uint32_t>(i), row.depth + 1,
+                                object});
+        }
+    }
+}
+
+bool JsonTreeView::RenderRow(const Row& row) {
+    const JsonTape& tape = document_->tape;
+    char element[32];
+    const char* label = "root";
+    int label_len = 4;
+    if (row.keyed) {
+        const std::string_view key = tape.Token(row.entry - 1);
+        label = key.data() + 1;
+        label_len = static_cast<int>(key.size()) - 2;
+    } else if (row.depth > 0) {
+        label = element;
+        label_len = std::snprintf(element, sizeof(element), "[%u]", row.index);
+    }
+
+    const JsonKind kind = tape.kind(row.entry);
+    void* node_id = reinterpret_cast<void*>(static_cast<uintptr_t>(row.entry) + 1);
+    constexpr ImGuiTreeNodeFlags kRowFlags = ImGuiTreeNodeFlags_NoTreePushOnOpen | ImGuiTreeNodeFlags_SpanAvailWidth;
+    if (kind != JsonKind::Object && kind != JsonKind::Array) {
+        const std::string_view token = tape.Token(row.entry);
+        const int shown = token.size() > kMaxPreviewChars ? kMaxPreviewChars : static_cast<int>(token.size());
+        ImGui::TreeNodeEx(node_id, kRowFlags | ImGuiTreeNodeFlags_Leaf, "%.*s: %.*s%s", label_len, label, shown,
+                          token.data(), shown < static_cast<int>(token.size()) ? "..." : "");
+        return false;
+    }
+
+    const bool expanded = expanded_.count(row.entry) != 0;
+    ImGui::SetNextItemOpen(expanded);
+    auto cached = children_.find(row.entry);
+    bool open = false;
+    if (cached != children_.end()) {
+        open = ImGui::TreeNodeEx(node_id, kRowFlags | ImGuiTreeNodeFlags_OpenOnArrow, "%.*s: %s %zu %s", label_len,
+                                 label, ContainerSuffix(kind, true), cached->second.size(),
+                                 kind == JsonKind::Object ? "keys }" : "items ]");
+    } else {
+        open = ImGui::TreeNodeEx(node_id, kRowFlags | ImGuiTreeNodeFlags_OpenOnArrow, "%.*s: %s", label_len, label,
+                                 ContainerSuffix(kind, false));
+    }
+    if (open == expanded) {
+        return false;
+    }
+    if (open) {
+        expanded_.insert(row.entry);
+    } else {
+        expanded_.erase(row.entry);
+    }
+    return true;
+}
+
+void JsonTreeView::Render(const char* id, const JsonDocumentLoader& documents) {
+    if (documents.latest() != document_) {
+        children_.clear();
+        expanded_.clear();
+        rows_.clear();
+        document_ = documents.latest();
+        if (document_) {
+            expanded_.insert(JsonTape::kRoot);
+            BuildRows();
+        }
+    }
+
+    ImGui::BeginChild(id, ImVec2(-1.0f, -1.0f), true);
+    if (documents.Loading()) {
+        ImGui::TextDisabled("Indexing... %.0f%%", documents.Fraction() * 100.0f);
+    } else if (!documents.error().empty()) {
+        ImGui::TextWrapped("Cannot build tree: %s", documents.error().c_str());
+    } else if (document_) {
+        ImGui::TextDisabled("%zu values, %.1f MB tape", document_->tape.size(),
+                            static_cast<double>(document_->tape.memory_bytes()) / (1024.0 * 1024.0));
+        const float indent = ImGui::GetStyle().IndentSpacing;
+        const float left = ImGui::GetCursorPosX();
+        bool toggled = false;
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(rows_.size()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                const Row& row = rows_[static_cast<size_t>(i)];
+                ImGui::SetCursorPosX(left + indent * static_cast<float>(row.depth));
+                toggled |= RenderRow(row);
+            }
+        }
+        clipper.End();
+        // The rows are rebuilt after drawing so the clipper never sees the
+        // list change under it.
+        if (toggled) {
+            BuildRows();
+        }
+    }
+    ImGui::EndChild();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "json_document.h"
+
+// Collapsible tree over the tape of a JsonDocument. Children of a node are
+// enumerated the first time it is expanded. The expanded part of the tree
+// is kept as a flat list of rows, one line each, so a single clipper draws
+// only the visible rows however deep or long the tree is.
+class JsonTreeView {
+public:
+    // Shows the latest document of `documents`, or its build state.
+    void Render(const char* id, const JsonDocumentLoader& documents);
+    void Clear();
+
+private:
+    struct Row {
+        uint32_t entry = 0;
+        uint32_t index = 0; // Position among the parent's children.
+        uint32_t depth = 0;
+        bool keyed = false; // Object member: the key is at entry - 1.
+    };
+
+    const std::vector<uint32_t>& ChildrenOf(uint32_t entry);
+    void BuildRows();
+    // Draws one row; returns true if the user toggled it open or closed.
+    bool RenderRow(const Row& row);
+
+    std::shared_ptr<const JsonDocument> document_;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> children_;
+    std::unordered_set<uint32_t> expanded_;
+    std::vector<Row> rows_;
+};
@@ -1,66 +1,551 @@
 #include <imgui.h>
-#include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include "background_job.h"
+#include "file_io_panel.h"
+#include "input_text.h"
+#include "json_binary.h"
+#include "json_canonical.h"
+#include "json_diff_panel.h"
+#include "json_document.h"
+#include "json_ndjson.h"
+#include "json_query_panel.h"
+#include "json_schema_panel.h"
+#include "json_stream_formatter.h"
+#include "json_structural_index.h"
+#include "json_tree_view.h"
+#include "line_index.h"
+#include "live_reformat.h"
+#include "output_sink.h"
 #include "plugin_api.h"
+#include "syntax_highlight.h"
+#include "text_location.h"
+#include "text_viewer.h"
 
 namespace {
 
-int InputTextResizeCallback(ImGuiInputTextCallbackData* data) {
-    if (data->EventFlag == ImGuiInputTextFlags_CallbackResize) {
-        auto* str = static_cast<std::string*>(data->UserData);
-        str->resize(static_cast<size_t>(data->BufTextLen));
-        data->Buf = const_cast<char*>(str->c_str());
+double ToMegabytes(size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+enum class JsonAction {
+    Format,
+    Minify,
+    Canonicalize,
+    ToCbor,
+    ToMessagePack,
+    Validate
+};
+
+enum class InputFormat {
+    Json,
+    Cbor,
+    MessagePack
+};
+
+// How the input bytes are to be read.
+struct InputEncoding {
+    InputFormat format = InputFormat::Json;
+    // Binary input typed into the editor is hex or base64 text; a mapped
+    // file holds the raw bytes.
+    bool text = true;
+};
+
+bool IsBinaryExport(JsonAction action) {
+    return action == JsonAction::ToCbor || action == JsonAction::ToMessagePack;
+}
+
+struct FormatOutput {
+    JsonAction action = JsonAction::Format;
+    bool ndjson = false;
+    JsonFormatResult result;
+    // NDJSON only: records seen and the ones that failed.
+    size_t records = 0;
+    size_t error_count = 0;
+    std::vector<NdjsonError> record_errors;
+    std::string text;
+    LineIndex lines;
+    SyntaxIndex syntax;
+    std::string destination;
+    size_t bytes_written = 0;
+    std::string write_error;
+    // Where a parse error sits in the JSON input, when it has one.
+    bool error_located = false;
+    TextLocation error_location;
+    // CBOR and MessagePack conversions: sizes, converter memory and time.
+    bool binary = false;
+    BinaryConversionStats stats;
+    double milliseconds = 0.0;
+};
+
+// Writes the result of a Format, Minify or Canonicalize action to `sink`. A
+// tape built for `input` means the document is already validated, so the
+// work runs straight off the tape or the raw bytes.
+JsonFormatResult Transform(std::string_view input,
+                           const JsonDocument* document,
+                           JsonAction action,
+                           OutputSink& sink,
+                           JobContext& job) {
+    if (action == JsonAction::Canonicalize) {
+        return document ? CanonicalizeJsonTape(document->tape, sink, &job) : CanonicalizeJson(input, sink, &job);
+    }
+    if (action != JsonAction::Minify) {
+        return document ? FormatJsonTape(document->tape, JsonFormatOptions{}, sink, &job)
+                        : FormatJsonParallel(input, JsonFormatOptions{}, sink, &job);
+    }
+    JsonFormatResult result = document ? JsonFormatResult{} : ValidateJson(input, &job);
+    if (!result.ok) {
+        return result;
+    }
+    if (!MinifyJson(input, sink, &job)) {
+        result.ok = false;
+        result.cancelled = true;
+        result.error = "cancelled";
+    } else if (!sink.Finish()) {
+        result.ok = false;
+        result.error = "failed to write output";
+    }
+    return result;
+}
+
+// NDJSON counterpart of Transform: every line is its own document.
+JsonFormatResult TransformNdjson(std::string_view input,
+                                 JsonAction action,
+                                 OutputSink& sink,
+                                 JobContext& job,
+                                 FormatOutput& output) {
+    NdjsonOutput mode = NdjsonOutput::None;
+    if (action == JsonAction::Format) {
+        mode = NdjsonOutput::Formatted;
+    } else if (action == JsonAction::Minify) {
+        mode = NdjsonOutput::Minified;
+    } else if (action == JsonAction::Canonicalize) {
+        mode = NdjsonOutput::Canonical;
+    }
+    NdjsonResult ndjson = ProcessNdjson(input, mode, JsonFormatOptions{}, sink, &job);
+    output.records = ndjson.records;
+    output.error_count = ndjson.error_count;
+    output.record_errors = std::move(ndjson.errors);
+    JsonFormatResult result;
+    if (ndjson.cancelled) {
+        result.ok = false;
+        result.cancelled = true;
+        result.error = "cancelled";
+    } else if (ndjson.write_failed) {
+        result.ok = false;
+        result.error = "failed to write output";
+    }
+    return result;
+}
+
+// Runs `write` against the sink the action's output goes to: nothing for
+// Validate, the save destination, hex text for binary results kept in
+// memory, or plain text.
+template <typename Write>
+void WriteConversion(FormatOutput& output, const std::string& destination, bool binary_output, const Write& write) {
+    if (output.action == JsonAction::Validate) {
+        DiscardSink sink;
+        output.result = write(sink);
+        return;
+    }
+    if (!destination.empty()) {
+        output.destination = destination;
+        FileSink sink;
+        if (!sink.Open(destination, output.write_error)) {
+            return;
+        }
+        output.result = write(sink);
+        output.bytes_written = sink.bytes_written();
+        output.stats.bytes_out = output.bytes_written;
+        if (sink.failed()) {
+            output.write_error = "failed to write " + destination;
+        }
+        return;
+    }
+    if (binary_output) {
+        HexSink sink(output.text);
+        output.result = write(sink);
+        output.stats.bytes_out = sink.bytes_written();
+    } else {
+        StringSink sink(output.text);
+        output.result = write(sink);
+        output.stats.bytes_out = output.text.size();
     }
-    return 0;
+    if (!output.result.ok) {
+        output.text.clear();
+        output.text.shrink_to_fit();
+        return;
+    }
+    output.lines.Build(output.text);
+    output.syntax.Build(binary_output ? SyntaxLanguage::Plain : SyntaxLanguage::Json, output.text, output.lines);
 }
 
-bool InputTextMultilineString(const char* label,
-                              std::string* str,
-                              const ImVec2& size,
-                              ImGuiInputTextFlags flags) {
-    if (str->capacity() < str->size() + 1) {
-        str->reserve(str->size() + 1);
-    }
-    return ImGui::InputTextMultiline(
-        label,
-        const_cast<char*>(str->c_str()),
-        str->capacity() + 1,
-        size,
-        flags | ImGuiInputTextFlags_CallbackResize,
-        InputTextResizeCallback,
-        str);
+// Conversions with CBOR or MessagePack on either side. Format, Minify and
+// Validate decode binary input straight to the output; Canonicalize and
+// re-encoding go through the decoded JSON text.
+FormatOutput RunBinaryConversion(std::string_view input,
+                                 JsonAction action,
+                                 const InputEncoding& encoding,
+                                 const std::string& destination,
+                                 JobContext& job) {
+    FormatOutput output;
+    output.action = action;
+    output.binary = true;
+    const auto start = std::chrono::steady_clock::now();
+    std::string bytes_buffer;
+    std::string json_buffer;
+    std::string_view json = input;
+    size_t bytes_in = input.size();
+    const bool direct =
+        encoding.format != InputFormat::Json && !IsBinaryExport(action) && action != JsonAction::Canonicalize;
+    BinaryConversionStats decoded;
+    if (encoding.format != InputFormat::Json) {
+        std::string_view bytes = input;
+        if (encoding.text) {
+            if (!ParseBinaryText(input, bytes_buffer, output.result.error)) {
+                output.result.ok = false;
+                return output;
+            }
+            bytes = bytes_buffer;
+        }
+        bytes_in = bytes.size();
+        const BinaryFormat from =
+            encoding.format == InputFormat::Cbor ? BinaryFormat::Cbor : BinaryFormat::MessagePack;
+        if (direct) {
+            WriteConversion(output, destination, false, [&](OutputSink& sink) {
+                return DecodeJsonBinary(bytes, from, JsonFormatOptions{}, action != JsonAction::Format, sink,
+                                        decoded, &job);
+            });
+        } else {
+            StringSink sink(json_buffer);
+            output.result = DecodeJsonBinary(bytes, from, JsonFormatOptions{}, true, sink, decoded, &job);
+            json = json_buffer;
+        }
+    }
+    BinaryConversionStats encoded;
+    if (!direct && output.result.ok) {
+        WriteConversion(output, destination, IsBinaryExport(action), [&](OutputSink& sink) {
+            if (action == JsonAction::Canonicalize) {
+                return Transform(json, nullptr, action, sink, job);
+            }
+            const BinaryFormat to = action == JsonAction::ToCbor ? BinaryFormat::Cbor : BinaryFormat::MessagePack;
+            return EncodeJsonBinary(json, to, sink, encoded, &job);
+        });
+    }
+    output.stats.bytes_in = bytes_in;
+    output.stats.peak_memory = std::max(decoded.peak_memory, encoded.peak_memory) + bytes_buffer.capacity() +
+                               json_buffer.capacity();
+    output.milliseconds =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return output;
+}
+
+FormatOutput RunFormat(std::string_view input,
+                       const JsonDocument* document,
+                       JsonAction action,
+                       bool ndjson,
+                       const InputEncoding& encoding,
+                       const std::string& destination,
+                       JobContext& job) {
+    if (encoding.format != InputFormat::Json || IsBinaryExport(action)) {
+        if (ndjson && encoding.format == InputFormat::Json) {
+            FormatOutput output;
+            output.action = action;
+            output.result.ok = false;
+            output.result.error = "binary export takes a single JSON document, not NDJSON";
+            return output;
+        }
+        return RunBinaryConversion(input, action, encoding, destination, job);
+    }
+    FormatOutput output;
+    output.action = action;
+    output.ndjson = ndjson;
+    if (action == JsonAction::Validate) {
+        if (ndjson) {
+            std::string unused;
+            StringSink sink(unused);
+            output.result = TransformNdjson(input, action, sink, job, output);
+        } else if (!document) {
+            output.result = ValidateJson(input, &job);
+        }
+        return output;
+    }
+    if (!destination.empty()) {
+        output.destination = destination;
+        FileSink sink;
+        if (!sink.Open(destination, output.write_error)) {
+            return output;
+        }
+        output.result = ndjson ? TransformNdjson(input, action, sink, job, output)
+                               : Transform(input, document, action, sink, job);
+        output.bytes_written = sink.bytes_written();
+        if (sink.failed()) {
+            output.write_error = "failed to write " + destination;
+        }
+        return output;
+    }
+    output.text.reserve(action == JsonAction::Format ? input.size() + input.size() / 2 : input.size());
+    StringSink sink(output.text);
+    output.result = ndjson ? TransformNdjson(input, action, sink, job, output)
+                           : Transform(input, document, action, sink, job);
+    if (!output.result.ok) {
+        output.text.clear();
+        output.text.shrink_to_fit();
+        return output;
+    }
+    output.lines.Build(output.text);
+    output.syntax.Build(SyntaxLanguage::Json, output.text, output.lines, &job);
+    return output;
+}
+
+// Input for the next job. A tape built for the current input already holds
+// its bytes, so the editor buffer is not copied again.
+SharedText JobInput(const FileIoPanel& files, const std::string& input_buf, const JsonDocument* document) {
+    return document ? document->source : files.Source(input_buf);
+}
+
+void StartFormatJob(BackgroundJob<FormatOutput>& format_job,
+                    SharedText input,
+                    std::shared_ptr<const JsonDocument> document,
+                    std::string destination,
+                    JsonAction action,
+                    bool ndjson,
+                    InputEncoding encoding) {
+    // A tape only exists for single JSON documents.
+    if (ndjson || encoding.format != InputFormat::Json) {
+        document.reset();
+    }
+    const size_t total = input.view().size();
+    format_job.Start(total, [input, document, action, ndjson, encoding,
+                             destination = std::move(destination)](JobContext& job) {
+        FormatOutput output = RunFormat(input.view(), document.get(), action, ndjson, encoding, destination, job);
+        // Error offsets of JSON input point into the text the job read; NDJSON
+        // records report their own line instead.
+        if (!output.result.ok && !output.result.cancelled && output.write_error.empty() && !ndjson &&
+            encoding.format == InputFormat::Json) {
+            output.error_location = LocateOffset(input.view(), output.result.error_offset);
+            output.error_located = true;
+        }
+        return output;
+    });
 }
 
 void RenderJsonFormatter() {
     static std::string input_buf = "{\"hello\":\"world\",\"value\":42}";
-    static std::string output_buf;
+    static SharedText output_text;
     static char status_buf[256] = "Ready.";
+    static BackgroundJob<FormatOutput> format_job;
+    static FileIoPanel files;
+    static TextViewer input_viewer;
+    static TextViewer output_viewer;
+    static bool input_view_stale = true;
+    // Tape shared by Tree, Query and the format actions.
+    static JsonDocumentLoader documents;
+    static JsonTreeView tree_view;
+    static bool tree_requested = false;
+    static JsonQueryPanel query_panel;
+    static JsonSchemaPanel schema_panel;
+    static JsonDiffPanel diff_panel;
+    // Bumped whenever the input changes; documents remember which revision
+    // they were built from.
+    static size_t input_revision = 0;
+    static const MappedFile* last_file = nullptr;
+    static LiveReformat live;
+    static bool ndjson = false;
+    static int input_format = 0;
+    static std::vector<NdjsonError> record_errors;
+    static size_t record_error_count = 0;
+    // Last parse error of the input, kept while the input is unchanged.
+    static bool parse_error_located = false;
+    static TextLocation parse_error;
+    static size_t parse_error_revision = 0;
+    static bool select_input_view = false;
 
     ImGui::Begin("JSON Formatter");
     ImGui::Text("Input JSON and format it automatically.");
+    // CBOR and MessagePack input is hex or base64 text, or raw bytes.
+    const SyntaxLanguage input_language = input_format == 0 ? SyntaxLanguage::Json : SyntaxLanguage::Plain;
+    files.language = input_language;
+    input_viewer.SetLanguage(input_language);
+    RenderFileIoPanel(files, status_buf, sizeof(status_buf));
+    if (files.file.get() != last_file) {
+        last_file = files.file.get();
+        ++input_revision;
+    }
+    documents.Poll();
+    const std::shared_ptr<const JsonDocument> document = documents.Get(input_revision);
+
+    ImGui::Checkbox("NDJSON (one document per line)", &ndjson);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(140.0f);
+    ImGui::Combo("Input format", &input_format, "JSON\0CBOR\0MessagePack\0");
+    const InputEncoding encoding{static_cast<InputFormat>(input_format), !files.HasFile()};
+
+    if (ImGui::Button("Format") && files.CheckDestination(status_buf, sizeof(status_buf))) {
+        StartFormatJob(format_job, JobInput(files, input_buf, document.get()), document, files.Destination(),
+                       JsonAction::Format, ndjson, encoding);
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Minify") && files.CheckDestination(status_buf, sizeof(status_buf))) {
+        StartFormatJob(format_job, JobInput(files, input_buf, document.get()), document, files.Destination(),
+                       JsonAction::Minify, ndjson, encoding);
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Canonicalize") && files.CheckDestination(status_buf, sizeof(status_buf))) {
+        StartFormatJob(format_job, JobInput(files, input_buf, document.get()), document, files.Destination(),
+                       JsonAction::Canonicalize, ndjson, encoding);
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("To CBOR") && files.CheckDestination(status_buf, sizeof(status_buf))) {
+        StartFormatJob(format_job, JobInput(files, input_buf, document.get()), document, files.Destination(),
+                       JsonAction::ToCbor, ndjson, encoding);
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("To MessagePack") && files.CheckDestination(status_buf, sizeof(status_buf))) {
+        StartFormatJob(format_job, JobInput(files, input_buf, document.get()), document, files.Destination(),
+                       JsonAction::ToMessagePack, ndjson, encoding);
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Validate") && files.CheckDestination(status_buf, sizeof(status_buf))) {
+        StartFormatJob(format_job, JobInput(files, input_buf, document.get()), document, files.Destination(),
+                       JsonAction::Validate, ndjson, encoding);
+    }
 
-    if (ImGui::Button("Format")) {
-        try {
-            auto parsed = nlohmann::json::parse(input_buf);
-            output_buf = parsed.dump(4);
-            std::snprintf(status_buf, sizeof(status_buf), "%s", "Format OK.");
-        } catch (const std::exception& ex) {
-            std::snprintf(status_buf, sizeof(status_buf), "Parse error: %s", ex.what());
+    if (!files.HasFile()) {
+        ImGui::SameLine();
+        RenderLiveReformatControls(live);
+        // Live results always stay in memory, whatever the save settings.
+        if (live.Poll(ImGui::GetTime())) {
+            StartFormatJob(format_job, SharedText::Copy(input_buf), nullptr, std::string(), JsonAction::Format,
+                           ndjson, encoding);
+        }
+    }
+
+    if (format_job.Running()) {
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            format_job.Cancel();
+            std::snprintf(status_buf, sizeof(status_buf), "%s", "Cancelled.");
+        }
+    }
+
+    if (auto finished = format_job.TakeResult()) {
+        if (!finished->result.cancelled) {
+            parse_error_located = finished->error_located;
+            parse_error = std::move(finished->error_location);
+            parse_error_revision = input_revision;
+            input_viewer.ClearMark();
+            files.viewer.ClearMark();
+        }
+        if (!finished->write_error.empty()) {
+            std::snprintf(status_buf, sizeof(status_buf), "Write error: %s",
+                          finished->write_error.c_str());
+        } else if (finished->result.ok && finished->binary) {
+            if (finished->destination.empty() && finished->action != JsonAction::Validate) {
+                output_text = SharedText::Own(std::move(finished->text));
+                output_viewer.SetText(output_text, std::move(finished->lines), std::move(finished->syntax));
+            }
+            const double seconds = finished->milliseconds / 1000.0;
+            std::snprintf(status_buf, sizeof(status_buf),
+                          "%s %.1f MB -> %.1f MB in %.0f ms (%.0f MB/s), peak converter memory %.1f MB.",
+                          finished->action == JsonAction::Validate ? "Decoded" : "Converted",
+                          ToMegabytes(finished->stats.bytes_in), ToMegabytes(finished->stats.bytes_out),
+                          finished->milliseconds, seconds > 0.0 ? ToMegabytes(finished->stats.bytes_in) / seconds : 0.0,
+                          ToMegabytes(finished->stats.peak_memory));
+        } else if (finished->result.ok && finished->action == JsonAction::Validate) {
+            std::snprintf(status_buf, sizeof(status_buf), "Valid JSON (%s scanner).",
+                          JsonStructuralScanner::KernelName());
+        } else if (finished->result.ok && !finished->destination.empty()) {
+            std::snprintf(status_buf, sizeof(status_buf), "Wrote %.1f MB to %s.",
+                          ToMegabytes(finished->bytes_written), finished->destination.c_str());
+        } else if (finished->result.ok) {
+            output_text = SharedText::Own(std::move(finished->text));
+            output_viewer.SetText(output_text, std::move(finished->lines), std::move(finished->syntax));
+            const char* message = "Format OK.";
+            if (finished->action == JsonAction::Minify) {
+                message = "Minify OK.";
+            } else if (finished->action == JsonAction::Canonicalize) {
+                message = "Canonicalize OK.";
+            }
+            std::snprintf(status_buf, sizeof(status_buf), "%s", message);
+        } else if (!finished->result.cancelled) {
+            std::snprintf(status_buf, sizeof(status_buf), "Parse error: %s",
+                          finished->result.error.c_str());
+        }
+        if (finished->ndjson && finished->result.ok) {
+            record_errors = std::move(finished->record_errors);
+            record_error_count = finished->error_count;
+            if (record_errors.empty()) {
+                std::snprintf(status_buf, sizeof(status_buf), "NDJSON: %zu records OK.", finished->records);
+            } else {
+                std::snprintf(status_buf, sizeof(status_buf), "NDJSON: %zu records, %zu failed; line %zu: %s",
+                              finished->records, record_error_count, record_errors[0].line,
+                              record_errors[0].message.c_str());
+            }
+        } else if (!finished->result.cancelled) {
+            record_errors.clear();
+            record_error_count = 0;
         }
     }
 
     ImGui::SameLine();
     if (ImGui::Button("Clear")) {
+        format_job.Cancel();
+        CloseMappedFile(files);
         input_buf.clear();
-        output_buf.clear();
+        output_text = SharedText();
+        input_viewer.Clear();
+        output_viewer.Clear();
+        documents.Clear();
+        tree_view.Clear();
+        query_panel.Clear();
+        schema_panel.Clear();
+        diff_panel.Clear();
+        record_errors.clear();
+        record_error_count = 0;
+        parse_error_located = false;
+        input_view_stale = true;
+        ++input_revision;
         std::snprintf(status_buf, sizeof(status_buf), "%s", "Cleared.");
     }
 
     ImGui::SameLine();
-    ImGui::Text("Status: %s", status_buf);
+    if (format_job.Running()) {
+        ImGui::Text("Status: Formatting... %.1f / %.1f MB",
+                    ToMegabytes(format_job.BytesDone()),
+                    ToMegabytes(format_job.BytesTotal()));
+        ImGui::SameLine();
+        ImGui::ProgressBar(format_job.Fraction(), ImVec2(160.0f, 0.0f));
+    } else {
+        ImGui::Text("Status: %s", status_buf);
+    }
+    if (parse_error_located && parse_error_revision != input_revision) {
+        parse_error_located = false;
+        input_viewer.ClearMark();
+        files.viewer.ClearMark();
+    }
+    if (parse_error_located && RenderTextLocation("ParseError", parse_error)) {
+        // The viewers map the offset to a line through their own index.
+        if (files.HasFile()) {
+            files.viewer.MarkOffset(parse_error.offset);
+        } else {
+            input_viewer.MarkOffset(parse_error.offset);
+            select_input_view = true;
+        }
+    }
     ImGui::Separator();
 
     ImVec2 avail = ImGui::GetContentRegionAvail();
@@ -70,21 +555,33 @@ void RenderJsonFormatter() {
         ImGui::BeginChild("InputPanel", ImVec2(0.0f, 0.0f), true);
         ImGui::TextUnformatted("Input");
         ImGui::Separator();
-        if (ImGui::BeginTabBar("InputTabs")) {
+        if (files.HasFile()) {
+            RenderMappedFileView(files);
+        } else if (ImGui::BeginTabBar("InputTabs")) {
             if (ImGui::BeginTabItem("Edit")) {
-                InputTextMultilineString(
-                    "##Input",
-                    &input_buf,
-                    ImVec2(-1.0f, -1.0f),
-                    ImGuiInputTextFlags_NoHorizontalScroll);
+                if (InputTextMultilineString(
+                        "##Input",
+                        &input_buf,
+                        ImVec2(-1.0f, -1.0f),
+                        ImGuiInputTextFlags_NoHorizontalScroll)) {
+                    input_view_stale = true;
+                    ++input_revision;
+                    // A job still reading the old text can only produce a
+                    // stale result, so stop it now rather than at the debounce.
+                    if (live.enabled) {
+                        format_job.Cancel();
+                    }
+                    live.MarkEdited(ImGui::GetTime());
+                }
                 ImGui::EndTabItem();
             }
-            if (ImGui::BeginTabItem("Wrap view")) {
-                ImGui::BeginChild("WrapInputView", ImVec2(-1.0f, -1.0f), true);
-                ImGui::PushTextWrapPos(0.0f);
-                ImGui::TextUnformatted(input_buf.c_str());
-                ImGui::PopTextWrapPos();
-                ImGui::EndChild();
+            if (ImGui::BeginTabItem("View", nullptr, select_input_view ? ImGuiTabItemFlags_SetSelected : 0)) {
+                select_input_view = false;
+                if (input_view_stale) {
+                    input_viewer.SetText(input_buf);
+                    input_view_stale = false;
+                }
+                input_viewer.Render("InputView");
                 ImGui::EndTabItem();
             }
             ImGui::EndTabBar();
@@ -96,20 +593,61 @@ void RenderJsonFormatter() {
         ImGui::TextUnformatted("Output");
         ImGui::Separator();
         if (ImGui::BeginTabBar("OutputTabs")) {
-            if (ImGui::BeginTabItem("Edit")) {
-                InputTextMultilineString(
-                    "##Output",
-                    &output_buf,
-                    ImVec2(-1.0f, -1.0f),
-                    ImGuiInputTextFlags_ReadOnly | ImGuiInputTextFlags_NoHorizontalScroll);
+            if (ImGui::BeginTabItem("View")) {
+                if (!record_errors.empty() &&
+                    ImGui::TreeNodeEx("RecordErrors", 0, "%zu NDJSON records failed", record_error_count)) {
+                    ImGuiListClipper clipper;
+                    clipper.Begin(static_cast<int>(record_errors.size()));
+                    while (clipper.Step()) {
+                        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                            const NdjsonError& error = record_errors[static_cast<size_t>(i)];
+                            ImGui::Text("line %zu: %s", error.line, error.message.c_str());
+                        }
+                    }
+                    clipper.End();
+                    if (record_error_count > record_errors.size()) {
+                        ImGui::TextDisabled("... and %zu more", record_error_count - record_errors.size());
+                    }
+                    ImGui::TreePop();
+                }
+                if (ImGui::Button("Copy all")) {
+                    ImGui::SetClipboardText(std::string(output_text.view()).c_str());
+                }
+                ImGui::SameLine();
+                output_viewer.Render("OutputView");
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("Tree")) {
+                if (!tree_requested) {
+                    tree_requested = true;
+                    if (documents.Needs(input_revision)) {
+                        documents.Load(files.Source(input_buf), input_revision);
+                    }
+                } else if (documents.latest() && documents.Needs(input_revision)) {
+                    if (ImGui::Button("Input changed - rebuild tree")) {
+                        documents.Load(files.Source(input_buf), input_revision);
+                    }
+                }
+                tree_view.Render("InputTree", documents);
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("Query")) {
+                if (query_panel.Render("InputQuery", documents, input_revision) &&
+                    documents.Needs(input_revision)) {
+                    documents.Load(files.Source(input_buf), input_revision);
+                }
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("Schema")) {
+                if (schema_panel.Render("InputSchema")) {
+                    schema_panel.Validate(JobInput(files, input_buf, document.get()), ndjson);
+                }
                 ImGui::EndTabItem();
             }
-            if (ImGui::BeginTabItem("Wrap view")) {
-                ImGui::BeginChild("WrapOutputView", ImVec2(-1.0f, -1.0f), true);
-                ImGui::PushTextWrapPos(0.0f);
-                ImGui::TextUnformatted(output_buf.c_str());
-                ImGui::PopTextWrapPos();
-                ImGui::EndChild();
+            if (ImGui::BeginTabItem("Diff")) {
+                if (diff_panel.Render("InputDiff")) {
+                    diff_panel.Compare(JobInput(files, input_buf, document.get()), document);
+                }
                 ImGui::EndTabItem();
             }
             ImGui::EndTabBar();
@@ -2,69 +2,407 @@
 #include <pugixml.hpp>
 
 #include <cstdio>
-#include <sstream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
 
+#include "background_job.h"
+#include "file_io_panel.h"
+#include "input_text.h"
+#include "line_index.h"
+#include "live_reformat.h"
+#include "output_sink.h"
 #include "plugin_api.h"
+#include "syntax_highlight.h"
+#include "text_location.h"
+#include "text_viewer.h"
+#include "xml_canonical.h"
+#include "xml_diff_panel.h"
+#include "xml_document.h"
+#include "xml_stream_formatter.h"
+#include "xml_to_json.h"
+#include "xml_tree_view.h"
+#include "xml_xpath_panel.h"
 
 namespace {
 
-int InputTextResizeCallback(ImGuiInputTextCallbackData* data) {
-    if (data->EventFlag == ImGuiInputTextFlags_CallbackResize) {
-        auto* str = static_cast<std::string*>(data->UserData);
-        str->resize(static_cast<size_t>(data->BufTextLen));
-        data->Buf = const_cast<char*>(str->c_str());
+double ToMegabytes(size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+// Forwards serialized XML to an OutputSink. Once the job is cancelled
+// further chunks are dropped so that save() unwinds quickly.
+class CancellableSinkWriter : public pugi::xml_writer {
+public:
+    CancellableSinkWriter(OutputSink& out, JobContext& job) : out_(out), job_(job) {}
+
+    void write(const void* data, size_t size) override {
+        if (cancelled_ || job_.Cancelled()) {
+            cancelled_ = true;
+            return;
+        }
+        out_.Append(std::string_view(static_cast<const char*>(data), size));
     }
-    return 0;
+
+    bool cancelled() const {
+        return cancelled_;
+    }
+
+private:
+    OutputSink& out_;
+    JobContext& job_;
+    bool cancelled_ = false;
+};
+
+enum class XmlAction {
+    Format,
+    Canonicalize,
+    ToJson
+};
+
+struct FormatOutput {
+    XmlAction action = XmlAction::Format;
+    bool ok = false;
+    bool cancelled = false;
+    std::string error;
+    size_t error_offset = 0;
+    std::string text;
+    LineIndex lines;
+    SyntaxIndex syntax;
+    std::string destination;
+    size_t bytes_written = 0;
+    std::string write_error;
+    // Left unset when editor text was parsed in place, which rewrites it;
+    // the UI locates those errors against its own buffer.
+    bool error_located = false;
+    TextLocation error_location;
+};
+
+// Writes `doc` to `destination`, or into output.text when there is none.
+// Indexing the text is left to the caller, which may free the DOM first.
+void SaveDocument(const pugi::xml_document& doc,
+                  size_t input_size,
+                  const std::string& destination,
+                  JobContext& job,
+                  FormatOutput& output) {
+    if (!destination.empty()) {
+        output.destination = destination;
+        FileSink sink;
+        if (!sink.Open(destination, output.write_error)) {
+            return;
+        }
+        CancellableSinkWriter writer(sink, job);
+        doc.save(writer, "  ", pugi::format_default, pugi::encoding_utf8);
+        if (!sink.Finish()) {
+            output.write_error = "failed to write " + destination;
+        }
+        output.bytes_written = sink.bytes_written();
+        output.cancelled = writer.cancelled();
+        output.ok = !output.cancelled && output.write_error.empty();
+        return;
+    }
+    // Indenting adds to the input size; reserving for it up front avoids
+    // regrowing, and briefly doubling, a large output string.
+    output.text.reserve(input_size + input_size / 4);
+    StringSink sink(output.text);
+    CancellableSinkWriter writer(sink, job);
+    doc.save(writer, "  ", pugi::format_default, pugi::encoding_utf8);
+    output.cancelled = writer.cancelled();
+    output.ok = !output.cancelled;
 }
 
-bool InputTextMultilineString(const char* label,
-                              std::string* str,
-                              const ImVec2& size,
-                              ImGuiInputTextFlags flags) {
-    if (str->capacity() < str->size() + 1) {
-        str->reserve(str->size() + 1);
-    }
-    return ImGui::InputTextMultiline(
-        label,
-        const_cast<char*>(str->c_str()),
-        str->capacity() + 1,
-        size,
-        flags | ImGuiInputTextFlags_CallbackResize,
-        InputTextResizeCallback,
-        str);
+void IndexOutput(FormatOutput& output, JobContext& job) {
+    if (output.ok && output.destination.empty()) {
+        output.lines.Build(output.text);
+        output.syntax.Build(SyntaxLanguage::Xml, output.text, output.lines, &job);
+    }
+}
+
+// Formats from `document` when the XPath panel already parsed this input,
+// and parses `source` otherwise.
+FormatOutput RunFormat(XmlSource& source,
+                       std::shared_ptr<const XmlDocument> document,
+                       const std::string& destination,
+                       JobContext& job) {
+    FormatOutput output;
+    if (document) {
+        const size_t input_size = document->input_size;
+        source = XmlSource();
+        SaveDocument(document->dom, input_size, destination, job, output);
+        job.ReportProgress(input_size);
+        document.reset();
+        IndexOutput(output, job);
+        return output;
+    }
+    const size_t input_size = source.view().size();
+    pugi::xml_document doc;
+    pugi::xml_parse_result result = ParseXmlSource(doc, source);
+    if (!result) {
+        output.error = result.description();
+        output.error_offset = static_cast<size_t>(result.offset);
+        if (!source.editor) {
+            output.error_location = LocateOffset(source.mapped.view(), output.error_offset);
+            output.error_located = true;
+        }
+        return output;
+    }
+    job.ReportProgress(input_size);
+    if (job.Cancelled()) {
+        output.cancelled = true;
+        return output;
+    }
+    SaveDocument(doc, input_size, destination, job, output);
+    // Release the document and the text it points into before indexing
+    // the output.
+    doc.reset();
+    source = XmlSource();
+    IndexOutput(output, job);
+    return output;
+}
+
+// Formats, canonicalizes or converts to JSON without building a DOM, so
+// memory is bounded by nesting depth plus the output, or a fixed buffer
+// when writing to a file. The input is read where it is and never modified.
+FormatOutput RunStreamFormat(const XmlSource& source,
+                             const std::string& destination,
+                             XmlAction action,
+                             JobContext& job) {
+    FormatOutput output;
+    const std::string_view input = source.view();
+    auto run = [&](OutputSink& sink) {
+        switch (action) {
+            case XmlAction::Canonicalize:
+                return CanonicalizeXml(input, XmlCanonicalOptions{}, sink, &job);
+            case XmlAction::ToJson:
+                return ConvertXmlToJson(input, XmlToJsonOptions{}, sink, &job);
+            default:
+                return FormatXmlStream(input, XmlFormatOptions{}, sink, &job);
+        }
+    };
+    XmlFormatResult result;
+    if (!destination.empty()) {
+        output.destination = destination;
+        FileSink sink;
+        if (!sink.Open(destination, output.write_error)) {
+            return output;
+        }
+        result = run(sink);
+        output.bytes_written = sink.bytes_written();
+        if (sink.failed()) {
+            output.write_error = "failed to write " + destination;
+        }
+    } else {
+        output.text.reserve(input.size() + input.size() / 4);
+        StringSink sink(output.text);
+        result = run(sink);
+    }
+    output.ok = result.ok;
+    output.cancelled = result.cancelled;
+    if (!result.ok) {
+        output.text.clear();
+        output.text.shrink_to_fit();
+        if (!result.cancelled && output.write_error.empty()) {
+            output.error = result.error;
+            output.error_offset = result.error_offset;
+            output.error_location = LocateOffset(input, result.error_offset);
+            output.error_located = true;
+        }
+        return output;
+    }
+    if (destination.empty()) {
+        output.lines.Build(output.text);
+        output.syntax.Build(action == XmlAction::ToJson ? SyntaxLanguage::Json : SyntaxLanguage::Xml, output.text,
+                            output.lines, &job);
+    }
+    return output;
+}
+
+XmlSource JobSource(const FileIoPanel& files, const std::string& editor_text) {
+    XmlSource source;
+    if (files.HasFile()) {
+        source.mapped = SharedText::Map(files.file);
+    } else {
+        source.editor = std::make_shared<std::string>(editor_text);
+    }
+    return source;
+}
+
+void StartFormatJob(BackgroundJob<FormatOutput>& format_job,
+                    const FileIoPanel& files,
+                    const std::string& editor_text,
+                    std::shared_ptr<const XmlDocument> document,
+                    std::string destination,
+                    XmlAction action,
+                    bool streaming) {
+    // Only the DOM path formats from a parsed document, and that document
+    // already holds the text, so the editor is not copied again.
+    if (streaming || action != XmlAction::Format) {
+        document.reset();
+    }
+    XmlSource source = document ? XmlSource() : JobSource(files, editor_text);
+    const size_t total = document ? document->input_size : source.view().size();
+    format_job.Start(total, [source = std::move(source), document = std::move(document),
+                             destination = std::move(destination), action, streaming](JobContext& job) mutable {
+        // Canonicalization and the JSON converter always stream; they have
+        // no DOM path.
+        FormatOutput output = streaming || action != XmlAction::Format
+                                  ? RunStreamFormat(source, destination, action, job)
+                                  : RunFormat(source, std::move(document), destination, job);
+        output.action = action;
+        return output;
+    });
 }
 
 void RenderXmlFormatter() {
     static std::string input_buf = "<root><item>hello</item><value>42</value></root>";
-    static std::string output_buf;
+    static SharedText output_text;
     static char status_buf[256] = "Ready.";
+    static BackgroundJob<FormatOutput> format_job;
+    static FileIoPanel files;
+    static TextViewer input_viewer;
+    static TextViewer output_viewer;
+    static bool input_view_stale = true;
+    static LiveReformat live;
+    // Bumped whenever the input changes, so a parse error is only shown
+    // for the input it was found in.
+    static size_t input_revision = 0;
+    static size_t job_revision = 0;
+    static const MappedFile* last_file = nullptr;
+    static bool parse_error_located = false;
+    static TextLocation parse_error;
+    static size_t parse_error_revision = 0;
+    static bool select_input_view = false;
+    static bool streaming = false;
+    static XmlDocumentLoader documents;
+    static XmlTreeView tree_view;
+    static bool tree_requested = false;
+    static XmlXPathPanel xpath_panel;
+    static XmlDiffPanel diff_panel;
 
     ImGui::Begin("XML Formatter");
     ImGui::Text("Input XML and format it automatically.");
+    files.language = SyntaxLanguage::Xml;
+    input_viewer.SetLanguage(SyntaxLanguage::Xml);
+    RenderFileIoPanel(files, status_buf, sizeof(status_buf));
+    if (files.file.get() != last_file) {
+        last_file = files.file.get();
+        ++input_revision;
+    }
+    documents.Poll();
 
-    if (ImGui::Button("Format")) {
-        pugi::xml_document doc;
-        pugi::xml_parse_result result = doc.load_string(input_buf.c_str());
-        if (result) {
-            std::ostringstream oss;
-            doc.save(oss, "  ", pugi::format_default, pugi::encoding_utf8);
-            output_buf = oss.str();
-            std::snprintf(status_buf, sizeof(status_buf), "%s", "Format OK.");
-        } else {
-            std::snprintf(status_buf, sizeof(status_buf), "Parse error: %s", result.description());
+    if (ImGui::Button("Format") && files.CheckDestination(status_buf, sizeof(status_buf))) {
+        job_revision = input_revision;
+        StartFormatJob(format_job, files, input_buf, documents.Get(input_revision), files.Destination(),
+                       XmlAction::Format, streaming);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Canonicalize") && files.CheckDestination(status_buf, sizeof(status_buf))) {
+        job_revision = input_revision;
+        StartFormatJob(format_job, files, input_buf, nullptr, files.Destination(), XmlAction::Canonicalize,
+                       true);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("To JSON") && files.CheckDestination(status_buf, sizeof(status_buf))) {
+        job_revision = input_revision;
+        StartFormatJob(format_job, files, input_buf, nullptr, files.Destination(), XmlAction::ToJson, true);
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Streaming (no DOM, for huge files)", &streaming);
+
+    if (!files.HasFile()) {
+        ImGui::SameLine();
+        RenderLiveReformatControls(live);
+        // Live results always stay in memory, whatever the save settings.
+        if (live.Poll(ImGui::GetTime())) {
+            job_revision = input_revision;
+            StartFormatJob(format_job, files, input_buf, documents.Get(input_revision), std::string(),
+                           XmlAction::Format, streaming);
+        }
+    }
+
+    if (format_job.Running()) {
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            format_job.Cancel();
+            std::snprintf(status_buf, sizeof(status_buf), "%s", "Cancelled.");
+        }
+    }
+
+    if (auto finished = format_job.TakeResult()) {
+        if (!finished->cancelled) {
+            parse_error_located = finished->error_located;
+            parse_error = std::move(finished->error_location);
+            parse_error_revision = job_revision;
+            // Editor text was parsed in place; locate against the editor
+            // buffer while it still holds what the job read.
+            if (!finished->ok && !finished->error.empty() && !parse_error_located &&
+                job_revision == input_revision && !files.HasFile()) {
+                parse_error = LocateOffset(input_buf, finished->error_offset);
+                parse_error_located = true;
+            }
+            input_viewer.ClearMark();
+            files.viewer.ClearMark();
+        }
+        if (!finished->write_error.empty()) {
+            std::snprintf(status_buf, sizeof(status_buf), "Write error: %s",
+                          finished->write_error.c_str());
+        } else if (finished->ok && !finished->destination.empty()) {
+            std::snprintf(status_buf, sizeof(status_buf), "Wrote %.1f MB to %s.",
+                          ToMegabytes(finished->bytes_written), finished->destination.c_str());
+        } else if (finished->ok) {
+            output_text = SharedText::Own(std::move(finished->text));
+            output_viewer.SetText(output_text, std::move(finished->lines), std::move(finished->syntax));
+            const char* done = finished->action == XmlAction::ToJson         ? "Converted to JSON."
+                               : finished->action == XmlAction::Canonicalize ? "Canonicalized (Exclusive C14N)."
+                                                                             : "Format OK.";
+            std::snprintf(status_buf, sizeof(status_buf), "%s", done);
+        } else if (!finished->cancelled) {
+            std::snprintf(status_buf, sizeof(status_buf), "Parse error: %s", finished->error.c_str());
         }
     }
 
     ImGui::SameLine();
     if (ImGui::Button("Clear")) {
+        format_job.Cancel();
+        CloseMappedFile(files);
         input_buf.clear();
-        output_buf.clear();
+        output_text = SharedText();
+        input_viewer.Clear();
+        output_viewer.Clear();
+        documents.Clear();
+        tree_view.Clear();
+        xpath_panel.Clear();
+        diff_panel.Clear();
+        parse_error_located = false;
+        input_view_stale = true;
+        ++input_revision;
         std::snprintf(status_buf, sizeof(status_buf), "%s", "Cleared.");
     }
 
     ImGui::SameLine();
-    ImGui::Text("Status: %s", status_buf);
+    if (format_job.Running()) {
+        ImGui::Text("Status: Formatting... %.1f / %.1f MB",
+                    ToMegabytes(format_job.BytesDone()),
+                    ToMegabytes(format_job.BytesTotal()));
+        ImGui::SameLine();
+        ImGui::ProgressBar(format_job.Fraction(), ImVec2(160.0f, 0.0f));
+    } else {
+        ImGui::Text("Status: %s", status_buf);
+    }
+    if (parse_error_located && parse_error_revision != input_revision) {
+        parse_error_located = false;
+        input_viewer.ClearMark();
+        files.viewer.ClearMark();
+    }
+    if (parse_error_located && RenderTextLocation("ParseError", parse_error)) {
+        if (files.HasFile()) {
+            files.viewer.MarkOffset(parse_error.offset);
+        } else {
+            input_viewer.MarkOffset(parse_error.offset);
+            select_input_view = true;
+        }
+    }
     ImGui::Separator();
 
     ImVec2 avail = ImGui::GetContentRegionAvail();
@@ -74,21 +412,33 @@ void RenderXmlFormatter() {
         ImGui::BeginChild("InputPanel", ImVec2(0.0f, 0.0f), true);
         ImGui::TextUnformatted("Input");
         ImGui::Separator();
-        if (ImGui::BeginTabBar("InputTabs")) {
+        if (files.HasFile()) {
+            RenderMappedFileView(files);
+        } else if (ImGui::BeginTabBar("InputTabs")) {
             if (ImGui::BeginTabItem("Edit")) {
-                InputTextMultilineString(
-                    "##Input",
-                    &input_buf,
-                    ImVec2(-1.0f, -1.0f),
-                    ImGuiInputTextFlags_NoHorizontalScroll);
+                if (InputTextMultilineString(
+                        "##Input",
+                        &input_buf,
+                        ImVec2(-1.0f, -1.0f),
+                        ImGuiInputTextFlags_NoHorizontalScroll)) {
+                    input_view_stale = true;
+                    ++input_revision;
+                    // A job still reading the old text can only produce a
+                    // stale result, so stop it now rather than at the debounce.
+                    if (live.enabled) {
+                        format_job.Cancel();
+                    }
+                    live.MarkEdited(ImGui::GetTime());
+                }
                 ImGui::EndTabItem();
             }
-            if (ImGui::BeginTabItem("Wrap view")) {
-                ImGui::BeginChild("WrapInputView", ImVec2(-1.0f, -1.0f), true);
-                ImGui::PushTextWrapPos(0.0f);
-                ImGui::TextUnformatted(input_buf.c_str());
-                ImGui::PopTextWrapPos();
-                ImGui::EndChild();
+            if (ImGui::BeginTabItem("View", nullptr, select_input_view ? ImGuiTabItemFlags_SetSelected : 0)) {
+                select_input_view = false;
+                if (input_view_stale) {
+                    input_viewer.SetText(input_buf);
+                    input_view_stale = false;
+                }
+                input_viewer.Render("InputView");
                 ImGui::EndTabItem();
             }
             ImGui::EndTabBar();
@@ -100,20 +450,39 @@ void RenderXmlFormatter() {
         ImGui::TextUnformatted("Output");
         ImGui::Separator();
         if (ImGui::BeginTabBar("OutputTabs")) {
-            if (ImGui::BeginTabItem("Edit")) {
-                InputTextMultilineString(
-                    "##Output",
-                    &output_buf,
-                    ImVec2(-1.0f, -1.0f),
-                    ImGuiInputTextFlags_ReadOnly | ImGuiInputTextFlags_NoHorizontalScroll);
+            if (ImGui::BeginTabItem("View")) {
+                if (ImGui::Button("Copy all")) {
+                    ImGui::SetClipboardText(std::string(output_text.view()).c_str());
+                }
+                ImGui::SameLine();
+                output_viewer.Render("OutputView");
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("Tree")) {
+                if (!tree_requested) {
+                    tree_requested = true;
+                    if (documents.Needs(input_revision)) {
+                        documents.Load(JobSource(files, input_buf), input_revision);
+                    }
+                } else if (documents.latest() && documents.Needs(input_revision)) {
+                    if (ImGui::Button("Input changed - rebuild tree")) {
+                        documents.Load(JobSource(files, input_buf), input_revision);
+                    }
+                }
+                tree_view.Render("InputTree", documents);
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("XPath")) {
+                if (xpath_panel.Render("InputXPath", documents, input_revision) &&
+                    documents.Needs(input_revision)) {
+                    documents.Load(JobSource(files, input_buf), input_revision);
+                }
                 ImGui::EndTabItem();
             }
-            if (ImGui::BeginTabItem("Wrap view")) {
-                ImGui::BeginChild("WrapOutputView", ImVec2(-1.0f, -1.0f), true);
-                ImGui::PushTextWrapPos(0.0f);
-                ImGui::TextUnformatted(output_buf.c_str());
-                ImGui::PopTextWrapPos();
-                ImGui::EndChild();
+            if (ImGui::BeginTabItem("Diff")) {
+                if (diff_panel.Render("InputDiff")) {
+                    diff_panel.Compare(files.Source(input_buf));
+                }
                 ImGui::EndTabItem();
             }
             ImGui::EndTabBar();
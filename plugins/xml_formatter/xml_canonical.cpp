@@ -0,0 +1,376 @@
+#include "xml_canonical.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "background_job.h"
+#include "output_sink.h"
+
+namespace {
+
+constexpr std::string_view kXmlNamespace = "http://www.w3.org/XML/1998/namespace";
+// Longest entity name quoted in an error message.
+constexpr size_t kMaxQuotedName = 64;
+
+// Prefix of a qualified name, or empty when it has none.
+std::string_view Prefix(std::string_view name) {
+    const size_t colon = name.find(':');
+    return colon == std::string_view::npos ? std::string_view() : name.substr(0, colon);
+}
+
+std::string_view LocalName(std::string_view name) {
+    const size_t colon = name.find(':');
+    return colon == std::string_view::npos ? name : name.substr(colon + 1);
+}
+
+bool IsDeclaration(std::string_view target) {
+    return target.size() == 3 && (target[0] | 0x20) == 'x' && (target[1] | 0x20) == 'm' &&
+           (target[2] | 0x20) == 'l';
+}
+
+void AppendCodePoint(uint32_t cp, std::string& out) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+bool NeedsEscape(char c, bool attribute) {
+    switch (c) {
+        case '&':
+        case '<':
+        case '\r':
+            return true;
+        case '>':
+            return !attribute;
+        case '"':
+        case '\t':
+        case '\n':
+            return attribute;
+        default:
+            return false;
+    }
+}
+
+// Writes decoded `text` with the escapes C14N prescribes for text nodes or
+// attribute values.
+void PutEscaped(OutputSink& out, std::string_view text, bool attribute) {
+    size_t i = 0;
+    while (i < text.size()) {
+        size_t end = i;
+        while (end < text.size() && !NeedsEscape(text[end], attribute)) {
+            ++end;
+        }
+        if (end > i) {
+            out.Append(text.substr(i, end - i));
+            i = end;
+            continue;
+        }
+        switch (text[i]) {
+            case '&':
+                out.Append("&amp;");
+                break;
+            case '<':
+                out.Append("&lt;");
+                break;
+            case '>':
+                out.Append("&gt;");
+                break;
+            case '"':
+                out.Append("&quot;");
+                break;
+            case '\t':
+                out.Append("&#x9;");
+                break;
+            case '\n':
+                out.Append("&#xA;");
+                break;
+            default:
+                out.Append("&#xD;");
+                break;
+        }
+        ++i;
+    }
+}
+
+// Writes `text` with line ends normalized to "\n", for content copied
+// without reference expansion.
+void PutNormalized(OutputSink& out, std::string_view text) {
+    size_t cr = text.find('\r');
+    while (cr != std::string_view::npos) {
+        out.Append(text.substr(0, cr));
+        out.Put('\n');
+        text.remove_prefix(cr + (cr + 1 < text.size() && text[cr + 1] == '\n' ? 2 : 1));
+        cr = text.find('\r');
+    }
+    out.Append(text);
+}
+
+} // namespace
+
+XmlCanonicalizer::XmlCanonicalizer(const XmlCanonicalOptions& options, OutputSink& out)
+    : with_comments_(options.with_comments), out_(out) {}
+
+std::string_view XmlCanonicalizer::Resolve(std::string_view prefix) const {
+    if (prefix == "xml") {
+        return kXmlNamespace;
+    }
+    for (size_t i = bindings_.size(); i > 0; --i) {
+        if (bindings_[i - 1].prefix == prefix) {
+            return bindings_[i - 1].uri;
+        }
+    }
+    return {};
+}
+
+const std::string* XmlCanonicalizer::Rendered(std::string_view prefix) const {
+    for (size_t i = rendered_.size(); i > 0; --i) {
+        if (rendered_[i - 1].prefix == prefix) {
+            return &rendered_[i - 1].uri;
+        }
+    }
+    return nullptr;
+}
+
+void XmlCanonicalizer::Fail(size_t offset, const std::string& message) {
+    if (failed_) {
+        return;
+    }
+    failed_ = true;
+    error_offset_ = offset;
+    char suffix[48];
+    std::snprintf(suffix, sizeof(suffix), " at offset %zu", offset);
+    error_ = message + suffix;
+}
+
+bool XmlCanonicalizer::Decode(std::string_view raw, bool attribute, size_t offset, std::string& decoded) {
+    decoded.clear();
+    for (size_t i = 0; i < raw.size(); ++i) {
+        const char c = raw[i];
+        if (c == '\r') {
+            // "\r\n" and a lone "\r" both count as one line end.
+            if (i + 1 < raw.size() && raw[i + 1] == '\n') {
+                ++i;
+            }
+            decoded.push_back(attribute ? ' ' : '\n');
+        } else if (attribute && (c == '\n' || c == '\t')) {
+            decoded.push_back(' ');
+        } else if (c != '&') {
+            decoded.push_back(c);
+        } else {
+            // The scanner has already checked that the reference ends in ';'.
+            const size_t semicolon = raw.find(';', i);
+            const std::string_view name = raw.substr(i + 1, semicolon - i - 1);
+            if (name[0] == '#') {
+                const bool hex = name.size() > 1 && name[1] == 'x';
+                const std::string digits(name.substr(hex ? 2 : 1));
+                AppendCodePoint(static_cast<uint32_t>(std::strtoul(digits.c_str(), nullptr, hex ? 16 : 10)),
+                                decoded);
+            } else if (name == "lt") {
+                decoded.push_back('<');
+            } else if (name == "gt") {
+                decoded.push_back('>');
+            } else if (name == "amp") {
+                decoded.push_back('&');
+            } else if (name == "quot") {
+                decoded.push_back('"');
+            } else if (name == "apos") {
+                decoded.push_back('\'');
+            } else {
+                Fail(attribute ? offset : offset + i, "entity &" + std::string(name.substr(0, kMaxQuotedName)) +
+                                     "; is defined in a DTD and cannot be canonicalized");
+                return false;
+            }
+            i = semicolon;
+        }
+    }
+    return true;
+}
+
+void XmlCanonicalizer::StartElement(std::string_view name, size_t offset) {
+    pending_name_ = name;
+    pending_offset_ = offset;
+    attributes_.clear();
+}
+
+void XmlCanonicalizer::Attribute(std::string_view name, std::string_view value, char) {
+    attributes_.push_back(PendingAttribute{name, value});
+}
+
+void XmlCanonicalizer::StartTagEnd(bool empty) {
+    const OpenElement element{pending_name_, bindings_.size(), rendered_.size()};
+    for (const PendingAttribute& attribute : attributes_) {
+        const bool default_namespace = attribute.name == "xmlns";
+        if (default_namespace || Prefix(attribute.name) == "xmlns") {
+            Binding binding{default_namespace ? std::string_view() : LocalName(attribute.name), std::string()};
+            Decode(attribute.value, true, pending_offset_, binding.uri);
+            bindings_.push_back(std::move(binding));
+        }
+    }
+
+    // Prefixes visibly used by this element: its own, including the
+    // default namespace, and those of its prefixed attributes.
+    used_.assign(1, Prefix(pending_name_));
+    for (const PendingAttribute& attribute : attributes_) {
+        const std::string_view prefix = Prefix(attribute.name);
+        if (!prefix.empty() && prefix != "xmlns" && prefix != "xml" &&
+            std::find(used_.begin(), used_.end(), prefix) == used_.end()) {
+            used_.push_back(prefix);
+        }
+    }
+    std::sort(used_.begin(), used_.end());
+    out_.Put('<');
+    out_.Append(pending_name_);
+    for (const std::string_view prefix : used_) {
+        if (prefix == "xml") {
+            continue;
+        }
+        const std::string_view uri = Resolve(prefix);
+        const std::string* rendered = Rendered(prefix);
+        if (rendered ? *rendered == uri : uri.empty()) {
+            continue;
+        }
+        out_.Append(prefix.empty() ? " xmlns" : " xmlns:");
+        out_.Append(prefix);
+        out_.Append("=\"");
+        PutEscaped(out_, uri, true);
+        out_.Put('"');
+        rendered_.push_back(Binding{prefix, std::string(uri)});
+    }
+
+    sorted_.clear();
+    for (const PendingAttribute& attribute : attributes_) {
+        const std::string_view prefix = Prefix(attribute.name);
+        if (attribute.name == "xmlns" || prefix == "xmlns") {
+            continue;
+        }
+        // Unprefixed attributes are in no namespace, whatever the default.
+        sorted_.push_back(SortedAttribute{prefix.empty() ? std::string_view() : Resolve(prefix),
+                                         LocalName(attribute.name), &attribute});
+    }
+    std::sort(sorted_.begin(), sorted_.end(), [](const SortedAttribute& a, const SortedAttribute& b) {
+        return a.uri != b.uri ? a.uri < b.uri : a.local < b.local;
+    });
+    for (const SortedAttribute& entry : sorted_) {
+        out_.Put(' ');
+        out_.Append(entry.attribute->name);
+        out_.Append("=\"");
+        const std::string_view value = entry.attribute->value;
+        if (value.find_first_of("&\r\n\t") == std::string_view::npos) {
+            PutEscaped(out_, value, true);
+        } else if (Decode(value, true, pending_offset_, scratch_)) {
+            PutEscaped(out_, scratch_, true);
+        }
+        out_.Put('"');
+    }
+    out_.Put('>');
+
+    stack_.push_back(element);
+    if (empty) {
+        EndElement(pending_name_, pending_offset_);
+    }
+}
+
+void XmlCanonicalizer::EndElement(std::string_view, size_t) {
+    const OpenElement element = stack_.back();
+    stack_.pop_back();
+    out_.Append("</");
+    out_.Append(element.name);
+    out_.Put('>');
+    bindings_.resize(element.bindings);
+    rendered_.resize(element.rendered);
+    after_root_ = stack_.empty();
+}
+
+void XmlCanonicalizer::Text(std::string_view text, size_t offset) {
+    if (text.find_first_of("&\r") == std::string_view::npos) {
+        PutEscaped(out_, text, false);
+    } else if (Decode(text, false, offset, scratch_)) {
+        PutEscaped(out_, scratch_, false);
+    }
+}
+
+void XmlCanonicalizer::CData(std::string_view content, size_t) {
+    if (content.find('\r') == std::string_view::npos) {
+        PutEscaped(out_, content, false);
+        return;
+    }
+    scratch_.clear();
+    StringSink normalized(scratch_);
+    PutNormalized(normalized, content);
+    PutEscaped(out_, scratch_, false);
+}
+
+void XmlCanonicalizer::BeginTopLevel() {
+    if (stack_.empty() && after_root_) {
+        out_.Put('\n');
+    }
+}
+
+void XmlCanonicalizer::EndTopLevel() {
+    if (stack_.empty() && !after_root_) {
+        out_.Put('\n');
+    }
+}
+
+void XmlCanonicalizer::Comment(std::string_view content, size_t) {
+    if (!with_comments_) {
+        return;
+    }
+    BeginTopLevel();
+    out_.Append("<!--");
+    PutNormalized(out_, content);
+    out_.Append("-->");
+    EndTopLevel();
+}
+
+void XmlCanonicalizer::ProcessingInstruction(std::string_view target, std::string_view content, size_t) {
+    if (IsDeclaration(target)) {
+        return;
+    }
+    BeginTopLevel();
+    out_.Append("<?");
+    out_.Append(target);
+    if (!content.empty()) {
+        out_.Put(' ');
+        PutNormalized(out_, content);
+    }
+    out_.Append("?>");
+    EndTopLevel();
+}
+
+void XmlCanonicalizer::Doctype(std::string_view, size_t) {}
+
+XmlFormatResult CanonicalizeXml(std::string_view input,
+                                const XmlCanonicalOptions& options,
+                                OutputSink& out,
+                                JobContext* job) {
+    XmlCanonicalizer canonicalizer(options, out);
+    XmlFormatResult result = ScanXmlEvents(input, &canonicalizer, job);
+    if (!result.ok) {
+        return result;
+    }
+    if (canonicalizer.failed()) {
+        result.ok = false;
+        result.error = canonicalizer.error();
+        result.error_offset = canonicalizer.error_offset();
+        return result;
+    }
+    if (!out.Finish()) {
+        result.ok = false;
+        result.error = "failed to write output";
+    }
+    return result;
+}
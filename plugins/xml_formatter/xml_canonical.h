@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "xml_stream_formatter.h"
+
+class JobContext;
+class OutputSink;
+
+struct XmlCanonicalOptions {
+    // Keeps comments, as the "#WithComments" variant does.
+    bool with_comments = false;
+};
+
+// Exclusive XML Canonicalization 1.0 of the markup reported by
+// ScanXmlEvents, written to `out` as it arrives. Each start tag is held
+// back only until its attributes are in, so memory is bounded by nesting
+// depth and the largest tag. The rules applied:
+//   - the XML declaration and the doctype are dropped, and so are comments
+//     unless asked for;
+//   - empty elements are written as a start and an end tag;
+//   - a namespace declaration is written on the first output element that
+//     visibly uses its prefix (in the element name or in an attribute
+//     name) and whose nearest output ancestor did not already declare the
+//     same URI; other declarations are dropped;
+//   - namespace declarations come first, sorted by prefix, followed by
+//     attributes sorted by namespace URI and then local name;
+//   - attribute values are whitespace-normalized and double-quoted;
+//   - character and predefined entity references are expanded, CDATA
+//     sections are replaced by their escaped content, and line ends are
+//     normalized to "\n";
+//   - whitespace outside the root element is dropped, and processing
+//     instructions and comments there are separated by a newline.
+// The inclusive-namespaces prefix list of the specification is not
+// supported. Entity references declared in a DTD cannot be expanded
+// without reading it, so they are reported as errors.
+class XmlCanonicalizer : public XmlEventHandler {
+public:
+    XmlCanonicalizer(const XmlCanonicalOptions& options, OutputSink& out);
+
+    void StartElement(std::string_view name, size_t offset) override;
+    void Attribute(std::string_view name, std::string_view value, char quote) override;
+    void StartTagEnd(bool empty) override;
+    void EndElement(std::string_view name, size_t offset) override;
+    void Text(std::string_view text, size_t offset) override;
+    void CData(std::string_view content, size_t offset) override;
+    void Comment(std::string_view content, size_t offset) override;
+    void ProcessingInstruction(std::string_view target, std::string_view content, size_t offset) override;
+    void Doctype(std::string_view declaration, size_t offset) override;
+
+    // Set at the first input that has no canonical form here; the output
+    // written so far is then incomplete.
+    bool failed() const {
+        return failed_;
+    }
+
+    const std::string& error() const {
+        return error_;
+    }
+
+    size_t error_offset() const {
+        return error_offset_;
+    }
+
+private:
+    struct Binding {
+        std::string_view prefix;
+        std::string uri;
+    };
+
+    struct PendingAttribute {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    struct SortedAttribute {
+        std::string_view uri;
+        std::string_view local;
+        const PendingAttribute* attribute = nullptr;
+    };
+
+    struct OpenElement {
+        std::string_view name;
+        // Sizes of bindings_ and rendered_ before this element.
+        size_t bindings = 0;
+        size_t rendered = 0;
+    };
+
+    std::string_view Resolve(std::string_view prefix) const;
+    const std::string* Rendered(std::string_view prefix) const;
+    // Expands references and normalizes line ends into `decoded`. Returns
+    // false, failing the canonicalization, at an entity only a DTD defines.
+    bool Decode(std::string_view raw, bool attribute, size_t offset, std::string& decoded);
+    void Fail(size_t offset, const std::string& message);
+    // Newline separating markup outside the root element from it.
+    void BeginTopLevel();
+    void EndTopLevel();
+
+    bool with_comments_;
+    OutputSink& out_;
+    std::string_view pending_name_;
+    size_t pending_offset_ = 0;
+    std::vector<PendingAttribute> attributes_;
+    // Per-tag scratch, kept to avoid allocating for every element.
+    std::vector<std::string_view> used_;
+    std::vector<SortedAttribute> sorted_;
+    std::vector<OpenElement> stack_;
+    // In-scope namespace declarations of the input, innermost last.
+    std::vector<Binding> bindings_;
+    // Declarations written on output ancestors, innermost last.
+    std::vector<Binding> rendered_;
+    bool after_root_ = false;
+    std::string scratch_;
+    bool failed_ = false;
+    std::string error_;
+    size_t error_offset_ = 0;
+};
+
+// Writes the Exclusive C14N form of `input` to `out` in one forward pass.
+XmlFormatResult CanonicalizeXml(std::string_view input,
+                                const XmlCanonicalOptions& options,
+                                OutputSink& out,
+                                JobContext* job = nullptr);
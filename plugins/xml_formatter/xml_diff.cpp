@@ -0,0 +1,349 @@
+#include "xml_diff.h"
+
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+#include "background_job.h"
+#include "output_sink.h"
+#include "tree_diff.h"
+#include "xml_canonical.h"
+
+namespace {
+
+constexpr size_t kMaxReportedDifferences = 10000;
+
+constexpr uint64_t kDocumentTag = 0x444F43554D000001ULL;
+constexpr uint64_t kElementTag = 0x454C454D4E000002ULL;
+constexpr uint64_t kTextTag = 0x54455854000003ULL;
+constexpr uint64_t kPiTag = 0x5049000004ULL;
+
+uint64_t HashBytes(std::string_view bytes, uint64_t tag) {
+    return MixHash(std::hash<std::string_view>{}(bytes) ^ tag);
+}
+
+bool IsWhitespaceOnly(std::string_view text) {
+    for (char c : text) {
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Feeds the markup through an XmlCanonicalizer writing into a scratch
+// buffer, and turns the canonical bytes of each node into a tree node.
+// Adjacent text and CDATA form one text run, as in the canonical form.
+class TreeBuilder : public XmlEventHandler {
+public:
+    TreeBuilder(std::vector<XmlCanonicalTree::Node>& nodes, bool ignore_whitespace)
+        : nodes_(nodes), ignore_whitespace_(ignore_whitespace), sink_(scratch_),
+          canonicalizer_(XmlCanonicalOptions{}, sink_) {
+        nodes_.push_back(XmlCanonicalTree::Node{});
+        open_.push_back(Open{XmlCanonicalTree::kDocument, kDocumentTag});
+    }
+
+    void StartElement(std::string_view name, size_t offset) override {
+        FlushText();
+        element_offset_ = offset;
+        canonicalizer_.StartElement(name, offset);
+    }
+
+    void Attribute(std::string_view name, std::string_view value, char quote) override {
+        canonicalizer_.Attribute(name, value, quote);
+    }
+
+    // StartElement flushed any text, so the scratch buffer holds just the
+    // canonical tag.
+    void StartTagEnd(bool empty) override {
+        canonicalizer_.StartTagEnd(empty);
+        std::string_view tag = scratch_;
+        if (empty) {
+            // Drop the end tag written along with it, so that "<a/>" and
+            // "<a></a>" give the same start tag hash.
+            tag.remove_suffix(tag.size() - tag.find_last_of('<'));
+        }
+        XmlCanonicalTree::Node node;
+        node.kind = XmlCanonicalTree::Kind::Element;
+        node.offset = element_offset_;
+        node.tag_hash = HashBytes(tag, kElementTag);
+        scratch_.clear();
+        open_.push_back(Open{static_cast<uint32_t>(nodes_.size()), CombineHash(kElementTag, node.tag_hash)});
+        nodes_.push_back(node);
+        if (empty) {
+            Close();
+        }
+    }
+
+    void EndElement(std::string_view name, size_t offset) override {
+        FlushText();
+        canonicalizer_.EndElement(name, offset);
+        scratch_.clear();
+        Close();
+    }
+
+    void Text(std::string_view text, size_t offset) override {
+        if (scratch_.empty()) {
+            text_offset_ = offset;
+        }
+        canonicalizer_.Text(text, offset);
+    }
+
+    void CData(std::string_view content, size_t offset) override {
+        if (scratch_.empty()) {
+            text_offset_ = offset;
+        }
+        canonicalizer_.CData(content, offset);
+    }
+
+    void Comment(std::string_view, size_t) override {}
+
+    void ProcessingInstruction(std::string_view target, std::string_view content, size_t offset) override {
+        FlushText();
+        canonicalizer_.ProcessingInstruction(target, content, offset);
+        if (scratch_.empty()) {
+            return; // The XML declaration.
+        }
+        // Newlines around markup outside the root are only separators.
+        std::string_view bytes = scratch_;
+        while (!bytes.empty() && bytes.front() == '\n') {
+            bytes.remove_prefix(1);
+        }
+        while (!bytes.empty() && bytes.back() == '\n') {
+            bytes.remove_suffix(1);
+        }
+        AddLeaf(XmlCanonicalTree::Kind::ProcessingInstruction, offset, HashBytes(bytes, kPiTag));
+        scratch_.clear();
+    }
+
+    void Doctype(std::string_view, size_t) override {}
+
+    const XmlCanonicalizer& canonicalizer() const {
+        return canonicalizer_;
+    }
+
+    void Finish() {
+        XmlCanonicalTree::Node& document = nodes_.front();
+        document.hash = open_.front().hash;
+        document.next = static_cast<uint32_t>(nodes_.size());
+    }
+
+private:
+    struct Open {
+        uint32_t index = 0;
+        uint64_t hash = 0;
+    };
+
+    void AddLeaf(XmlCanonicalTree::Kind kind, size_t offset, uint64_t hash) {
+        XmlCanonicalTree::Node node;
+        node.kind = kind;
+        node.offset = offset;
+        node.hash = hash;
+        node.next = static_cast<uint32_t>(nodes_.size() + 1);
+        nodes_.push_back(node);
+        open_.back().hash = CombineHash(open_.back().hash, hash);
+    }
+
+    void FlushText() {
+        if (scratch_.empty()) {
+            return;
+        }
+        if (!ignore_whitespace_ || !IsWhitespaceOnly(scratch_)) {
+            AddLeaf(XmlCanonicalTree::Kind::Text, text_offset_, HashBytes(scratch_, kTextTag));
+        }
+        scratch_.clear();
+    }
+
+    void Close() {
+        const Open closed = open_.back();
+        open_.pop_back();
+        nodes_[closed.index].hash = closed.hash;
+        nodes_[closed.index].next = static_cast<uint32_t>(nodes_.size());
+        open_.back().hash = CombineHash(open_.back().hash, closed.hash);
+    }
+
+    std::vector<XmlCanonicalTree::Node>& nodes_;
+    bool ignore_whitespace_;
+    std::string scratch_;
+    StringSink sink_;
+    XmlCanonicalizer canonicalizer_;
+    std::vector<Open> open_;
+    size_t element_offset_ = 0;
+    size_t text_offset_ = 0;
+};
+
+class Differ {
+public:
+    Differ(const XmlCanonicalTree& left, const XmlCanonicalTree& right) : left_(left), right_(right) {}
+
+    XmlDiffResult Run(JobContext* job);
+
+private:
+    void Report(XmlDiffKind kind, uint32_t left, uint32_t right, std::string path) {
+        if (result_.count++ < kMaxReportedDifferences) {
+            result_.entries.push_back(XmlDiffEntry{kind, std::move(path), left, right});
+        }
+    }
+
+    void Compare(uint32_t left, uint32_t right, const std::string& path, std::vector<TreeDiffItem>& items);
+    void CompareChildren(uint32_t left, uint32_t right, const std::string& path, std::vector<TreeDiffItem>& items);
+    // XPath steps of children[begin, end), such as "item[2]" or "text()",
+    // numbered only where the same step occurs more than once among all
+    // the children.
+    static std::vector<std::string> ChildSteps(const XmlCanonicalTree& tree,
+                                               const std::vector<uint32_t>& children,
+                                               size_t begin,
+                                               size_t end);
+
+    const XmlCanonicalTree& left_;
+    const XmlCanonicalTree& right_;
+    XmlDiffResult result_;
+};
+
+std::string_view Step(const XmlCanonicalTree& tree, uint32_t node) {
+    switch (tree[node].kind) {
+        case XmlCanonicalTree::Kind::Element:
+            return tree.Name(node);
+        case XmlCanonicalTree::Kind::Text:
+            return "text()";
+        default:
+            return "processing-instruction()";
+    }
+}
+
+std::vector<std::string> Differ::ChildSteps(const XmlCanonicalTree& tree,
+                                            const std::vector<uint32_t>& children,
+                                            size_t begin,
+                                            size_t end) {
+    std::unordered_map<std::string_view, size_t> totals;
+    for (const uint32_t child : children) {
+        ++totals[Step(tree, child)];
+    }
+    std::unordered_map<std::string_view, size_t> positions;
+    std::vector<std::string> steps;
+    steps.reserve(end - begin);
+    for (size_t k = 0; k < end; ++k) {
+        const std::string_view step = Step(tree, children[k]);
+        const size_t position = ++positions[step];
+        if (k < begin) {
+            continue;
+        }
+        std::string numbered(step);
+        if (totals[step] > 1) {
+            numbered += '[' + std::to_string(position) + ']';
+        }
+        steps.push_back(std::move(numbered));
+    }
+    return steps;
+}
+
+void Differ::Compare(uint32_t left, uint32_t right, const std::string& path, std::vector<TreeDiffItem>& items) {
+    const XmlCanonicalTree::Node& l = left_[left];
+    const XmlCanonicalTree::Node& r = right_[right];
+    if (l.hash == r.hash) {
+        return;
+    }
+    if (l.kind == XmlCanonicalTree::Kind::Document && r.kind == XmlCanonicalTree::Kind::Document) {
+        CompareChildren(left, right, path, items);
+        return;
+    }
+    if (l.kind != XmlCanonicalTree::Kind::Element || r.kind != XmlCanonicalTree::Kind::Element ||
+        left_.Name(left) != right_.Name(right)) {
+        Report(XmlDiffKind::Changed, left, right, path);
+        return;
+    }
+    if (l.tag_hash != r.tag_hash) {
+        Report(XmlDiffKind::Changed, left, right, path);
+    }
+    CompareChildren(left, right, path, items);
+}
+
+void Differ::CompareChildren(uint32_t left,
+                             uint32_t right,
+                             const std::string& path,
+                             std::vector<TreeDiffItem>& items) {
+    std::vector<uint32_t> left_items;
+    std::vector<uint32_t> right_items;
+    for (uint32_t child = left + 1, end = left_[left].next; child < end; child = left_[child].next) {
+        left_items.push_back(child);
+    }
+    for (uint32_t child = right + 1, end = right_[right].next; child < end; child = right_[child].next) {
+        right_items.push_back(child);
+    }
+    const TreeDiffTrim trim = TrimEqualEnds(
+        left_items, right_items, [this](uint32_t child) { return left_[child].hash; },
+        [this](uint32_t child) { return right_[child].hash; });
+    if (trim.empty()) {
+        return;
+    }
+    const std::vector<std::string> left_steps = ChildSteps(left_, left_items, trim.prefix, trim.left_stop);
+    const std::vector<std::string> right_steps = ChildSteps(right_, right_items, trim.prefix, trim.right_stop);
+    PushPositionalPairs(
+        left_items, right_items, trim, [&](size_t k) { return path + '/' + left_steps[k - trim.prefix]; },
+        [&](size_t k) { return path + '/' + right_steps[k - trim.prefix]; }, items);
+}
+
+XmlDiffResult Differ::Run(JobContext* job) {
+    result_.cancelled = !RunTreeDiff(
+        XmlCanonicalTree::kDocument, XmlCanonicalTree::kDocument, job,
+        [this](uint32_t left, uint32_t right, const std::string& path, std::vector<TreeDiffItem>& items) {
+            Compare(left, right, path, items);
+        },
+        [this](TreeDiffAction action, uint32_t left, uint32_t right, std::string path) {
+            Report(action == TreeDiffAction::Added ? XmlDiffKind::Added : XmlDiffKind::Removed, left, right,
+                   std::move(path));
+        });
+    return result_;
+}
+
+} // namespace
+
+bool XmlCanonicalTree::Build(std::string_view input, bool ignore_whitespace, std::string& error, JobContext* job) {
+    input_ = input;
+    nodes_.clear();
+    // Typical documents spend 16 or more input bytes per node. Reserving
+    // for that up front avoids regrowing, and copying, a vector of millions
+    // of nodes; pages past the final size are never touched.
+    nodes_.reserve(input.size() / 16 + 16);
+    TreeBuilder builder(nodes_, ignore_whitespace);
+    const XmlFormatResult result = ScanXmlEvents(input, &builder, job);
+    if (!result.ok) {
+        error = result.error;
+        nodes_.clear();
+        return false;
+    }
+    if (builder.canonicalizer().failed()) {
+        error = builder.canonicalizer().error();
+        nodes_.clear();
+        return false;
+    }
+    builder.Finish();
+    return true;
+}
+
+std::string_view XmlCanonicalTree::Name(uint32_t index) const {
+    const Node& node = nodes_[index];
+    if (node.kind != Kind::Element && node.kind != Kind::ProcessingInstruction) {
+        return {};
+    }
+    const size_t start = node.offset + (node.kind == Kind::Element ? 1 : 2);
+    const size_t end = input_.find_first_of(" \t\r\n/>?", start);
+    return input_.substr(start, (end == std::string_view::npos ? input_.size() : end) - start);
+}
+
+std::string_view XmlCanonicalTree::Snippet(uint32_t index, size_t max_chars) const {
+    const Node& node = nodes_[index];
+    std::string_view text = input_.substr(node.offset, max_chars);
+    const size_t stop = text.find_first_of(node.kind == Kind::Text ? "<\n" : ">\n", 1);
+    if (stop != std::string_view::npos) {
+        text = text.substr(0, node.kind == Kind::Text || text[stop] == '\n' ? stop : stop + 1);
+    }
+    return text;
+}
+
+XmlDiffResult DiffXml(const XmlCanonicalTree& left, const XmlCanonicalTree& right, JobContext* job) {
+    if (left.empty() || right.empty()) {
+        return XmlDiffResult{};
+    }
+    return Differ(left, right).Run(job);
+}
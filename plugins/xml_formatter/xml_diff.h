@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JobContext;
+
+// Flat list, in document order, of the nodes of one document as Exclusive
+// C14N sees them: elements, text runs and processing instructions, with
+// comments left out. Every node carries a hash of its canonical bytes, so
+// subtrees that canonicalize the same hash the same whatever their
+// attribute order, quoting, entity spelling, CDATA use or namespace
+// declaration placement. The tree keeps views into the input, which has
+// to outlive it.
+class XmlCanonicalTree {
+public:
+    enum class Kind : uint8_t {
+        Document,
+        Element,
+        Text,
+        ProcessingInstruction
+    };
+
+    struct Node {
+        // Hash of the whole subtree.
+        uint64_t hash = 0;
+        // Hash of the canonical start tag alone, for elements.
+        uint64_t tag_hash = 0;
+        // Offset of the node's markup or text in the input.
+        size_t offset = 0;
+        // Index just past the node's subtree.
+        uint32_t next = 0;
+        Kind kind = Kind::Document;
+    };
+
+    // Scans and canonicalizes `input` in one pass. Text that is only
+    // whitespace, such as indentation, is left out when
+    // `ignore_whitespace` is set. Returns false with `error` filled for
+    // malformed input or when the job was cancelled.
+    bool Build(std::string_view input, bool ignore_whitespace, std::string& error, JobContext* job = nullptr);
+
+    bool empty() const {
+        return nodes_.empty();
+    }
+
+    size_t size() const {
+        return nodes_.size();
+    }
+
+    const Node& operator[](uint32_t index) const {
+        return nodes_[index];
+    }
+
+    // Qualified name of an element or target of a processing instruction.
+    std::string_view Name(uint32_t index) const;
+    // Start of the node's source text, cut at the end of its first tag or
+    // line and at `max_chars`.
+    std::string_view Snippet(uint32_t index, size_t max_chars) const;
+
+    static constexpr uint32_t kDocument = 0;
+
+private:
+    std::string_view input_;
+    std::vector<Node> nodes_;
+};
+
+enum class XmlDiffKind : uint8_t {
+    Added,
+    Removed,
+    Changed
+};
+
+struct XmlDiffEntry {
+    static constexpr uint32_t kNoNode = UINT32_MAX;
+
+    XmlDiffKind kind = XmlDiffKind::Changed;
+    // XPath of the node, the left side's for changes. A change reported on
+    // an element whose children are listed separately concerns its start
+    // tag: its attributes or namespaces.
+    std::string path;
+    uint32_t left = kNoNode;  // Node in the left tree, if any.
+    uint32_t right = kNoNode; // Node in the right tree, if any.
+};
+
+struct XmlDiffResult {
+    // The first few differences in document order; count has the total.
+    std::vector<XmlDiffEntry> entries;
+    size_t count = 0;
+    bool cancelled = false;
+};
+
+// Structural diff of two canonical trees. Subtrees with equal hashes are
+// skipped without being visited, so the cost follows the size of the
+// differences rather than of the documents. Children are matched by
+// position after trimming the common prefix and suffix, and elements are
+// only compared further when their names match.
+XmlDiffResult DiffXml(const XmlCanonicalTree& left, const XmlCanonicalTree& right, JobContext* job = nullptr);
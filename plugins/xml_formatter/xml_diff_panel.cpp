@@ -0,0 +1,164 @@
+#include "xml_diff_panel.h"
+
+#include <imgui.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <utility>
+
+#include "input_text.h"
+#include "parallel_for.h"
+
+namespace {
+
+// Source text longer than this is cut in the result rows.
+constexpr size_t kMaxPreviewChars = 80;
+
+void PreviewCell(const XmlCanonicalTree& tree, uint32_t node) {
+    if (node == XmlDiffEntry::kNoNode) {
+        ImGui::TextDisabled("%s", "-");
+        return;
+    }
+    const std::string_view snippet = tree.Snippet(node, kMaxPreviewChars);
+    ImGui::Text("%.*s", static_cast<int>(snippet.size()), snippet.data());
+}
+
+} // namespace
+
+void XmlDiffPanel::Compare(SharedText input) {
+    const SharedText other = other_file_ ? SharedText::Map(other_file_) : SharedText::Copy(other_text_);
+    const bool ignore_whitespace = ignore_whitespace_;
+    status_.clear();
+    job_.Start(input.view().size() + other.view().size(), [input, other, ignore_whitespace](JobContext& job) {
+        DiffOutput output;
+        const auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<Side> sides[2] = {std::make_shared<Side>(), std::make_shared<Side>()};
+        sides[0]->source = input;
+        sides[1]->source = other;
+        std::string errors[2];
+        bool built[2] = {false, false};
+        ParallelFor(2, [&](size_t side) {
+            built[side] = sides[side]->tree.Build(sides[side]->source.view(), ignore_whitespace, errors[side], &job);
+        });
+        if (job.Cancelled()) {
+            output.error = "cancelled";
+            return output;
+        }
+        if (!built[0] || !built[1]) {
+            output.error = !built[0] ? "input: " + errors[0] : "other document: " + errors[1];
+            return output;
+        }
+        output.result = DiffXml(sides[0]->tree, sides[1]->tree, &job);
+        if (output.result.cancelled) {
+            output.error = "cancelled";
+            return output;
+        }
+        output.milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        output.left = std::move(sides[0]);
+        output.right = std::move(sides[1]);
+        return output;
+    });
+}
+
+void XmlDiffPanel::Clear() {
+    job_.Cancel();
+    result_ = XmlDiffResult{};
+    left_.reset();
+    right_.reset();
+    status_.clear();
+}
+
+bool XmlDiffPanel::Render(const char* id) {
+    if (auto finished = job_.TakeResult()) {
+        if (finished->error.empty()) {
+            result_ = std::move(finished->result);
+            left_ = std::move(finished->left);
+            right_ = std::move(finished->right);
+            char buffer[128];
+            if (result_.count == 0) {
+                std::snprintf(buffer, sizeof(buffer), "Documents are canonically equal (%.1f ms).",
+                              finished->milliseconds);
+            } else {
+                std::snprintf(buffer, sizeof(buffer), "%zu differences in %.1f ms.", result_.count,
+                              finished->milliseconds);
+            }
+            status_ = buffer;
+        } else {
+            Clear();
+            status_ = "Compare failed: " + finished->error;
+        }
+    }
+
+    ImGui::PushID(id);
+    ImGui::SetNextItemWidth(320.0f);
+    ImGui::InputTextWithHint("##OtherPath", "other file path", other_path_, sizeof(other_path_));
+    ImGui::SameLine();
+    if (ImGui::Button("Open other...")) {
+        auto file = std::make_shared<MappedFile>();
+        std::string error;
+        if (file->Open(other_path_, error)) {
+            other_file_ = std::move(file);
+        } else {
+            status_ = "Open failed: " + error;
+        }
+    }
+    if (other_file_) {
+        ImGui::SameLine();
+        if (ImGui::Button("Close other")) {
+            other_file_.reset();
+        }
+        ImGui::TextDisabled("Comparing with %s (%zu bytes).", other_file_->path().string().c_str(),
+                            other_file_->size());
+    } else {
+        InputTextMultilineString("##Other", &other_text_, ImVec2(-1.0f, ImGui::GetContentRegionAvail().y * 0.3f));
+    }
+
+    const bool compare = ImGui::Button("Compare with input");
+    ImGui::SameLine();
+    ImGui::Checkbox("Ignore indentation", &ignore_whitespace_);
+    ImGui::SameLine();
+    if (job_.Running()) {
+        ImGui::TextDisabled("Comparing... %.0f%%", job_.Fraction() * 100.0f);
+    } else if (!status_.empty()) {
+        ImGui::TextWrapped("%s", status_.c_str());
+    }
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+    if (!job_.Running() && left_ && ImGui::BeginTable("Differences", 4, flags, ImVec2(-1.0f, -1.0f))) {
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed, 16.0f);
+        ImGui::TableSetupColumn("Path");
+        ImGui::TableSetupColumn("Input");
+        ImGui::TableSetupColumn("Other");
+        ImGui::TableHeadersRow();
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(result_.entries.size()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                const XmlDiffEntry& entry = result_.entries[static_cast<size_t>(i)];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(entry.kind == XmlDiffKind::Added     ? "+"
+                                       : entry.kind == XmlDiffKind::Removed ? "-"
+                                                                            : "~");
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(entry.path.empty() ? "(document)" : entry.path.c_str());
+                ImGui::TableNextColumn();
+                PreviewCell(left_->tree, entry.left);
+                ImGui::TableNextColumn();
+                PreviewCell(right_->tree, entry.right);
+            }
+        }
+        clipper.End();
+        if (result_.count > result_.entries.size()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TableNextColumn();
+            ImGui::TextDisabled("... and %zu more", result_.count - result_.entries.size());
+        }
+        ImGui::EndTable();
+    }
+    ImGui::PopID();
+    return compare;
+}
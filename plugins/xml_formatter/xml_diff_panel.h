@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "background_job.h"
+#include "mapped_file.h"
+#include "xml_diff.h"
+
+// Compares the input with another XML document, pasted into the panel or
+// opened as a mapped file. One background job builds the canonical tree
+// of each side in parallel, so attribute order, quoting and similar
+// spelling differences do not count, and DiffXml then lists the nodes that
+// were added, removed or changed by XPath, with both sides' source.
+class XmlDiffPanel {
+public:
+    // Draws the panel. True on the frame "Compare with input" was
+    // clicked; the caller then passes the current input to Compare().
+    bool Render(const char* id);
+    void Compare(SharedText input);
+    void Clear();
+
+private:
+    // A tree together with the text its nodes point into.
+    struct Side {
+        SharedText source;
+        XmlCanonicalTree tree;
+    };
+
+    struct DiffOutput {
+        XmlDiffResult result;
+        std::string error;
+        double milliseconds = 0.0;
+        std::shared_ptr<const Side> left;
+        std::shared_ptr<const Side> right;
+    };
+
+    char other_path_[512] = "";
+    std::shared_ptr<MappedFile> other_file_;
+    std::string other_text_ = "<root>\n</root>";
+    bool ignore_whitespace_ = true;
+    BackgroundJob<DiffOutput> job_;
+    std::string status_;
+    XmlDiffResult result_;
+    // Trees the shown result refers to, for the node previews.
+    std::shared_ptr<const Side> left_;
+    std::shared_ptr<const Side> right_;
+};
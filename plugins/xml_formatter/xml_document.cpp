@@ -0,0 +1,32 @@
+#include "xml_document.h"
+
+#include <cstdio>
+#include <cstring>
+
+pugi::xml_parse_result ParseXmlSource(pugi::xml_document& doc, XmlSource& source) {
+    if (source.editor) {
+        return doc.load_buffer_inplace(source.editor->data(), source.editor->size(), kXmlParseOptions);
+    }
+    const std::string_view input = source.mapped.view();
+    void* buffer = input.empty() ? nullptr : pugi::get_memory_allocation_function()(input.size());
+    if (!buffer) {
+        return doc.load_buffer(input.data(), input.size(), kXmlParseOptions);
+    }
+    std::memcpy(buffer, input.data(), input.size());
+    return doc.load_buffer_inplace_own(buffer, input.size(), kXmlParseOptions);
+}
+
+bool XmlDocument::Build(XmlSource source, std::string& error, JobContext& job) {
+    input_size = source.view().size();
+    buffer = source.editor;
+    const pugi::xml_parse_result result = ParseXmlSource(dom, source);
+    if (!result) {
+        char message[192];
+        std::snprintf(message, sizeof(message), "%s at offset %zu", result.description(),
+                      static_cast<size_t>(result.offset));
+        error = message;
+        return false;
+    }
+    job.ReportProgress(input_size);
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <pugixml.hpp>
+
+#include "background_job.h"
+#include "document_loader.h"
+#include "mapped_file.h"
+
+// Parse flags shared by every DOM built from the input. Comments,
+// processing instructions and the prolog are kept so XPath can reach them
+// and formatting from a DOM preserves them.
+constexpr unsigned int kXmlParseOptions =
+    pugi::parse_default | pugi::parse_comments | pugi::parse_pi | pugi::parse_declaration | pugi::parse_doctype;
+
+// Text for a parse. Editor text arrives as the job's own copy and is
+// parsed in place, so the document needs no second copy of it; a mapped
+// file is read-only and is copied once into a buffer the document owns.
+struct XmlSource {
+    std::shared_ptr<std::string> editor;
+    SharedText mapped;
+
+    std::string_view view() const {
+        return editor ? std::string_view(*editor) : mapped.view();
+    }
+};
+
+// Parses `source` into `doc` as described above. Editor text is rewritten
+// by the parse and has to outlive the document.
+pugi::xml_parse_result ParseXmlSource(pugi::xml_document& doc, XmlSource& source);
+
+// A parsed document tagged with the input revision it was built from.
+struct XmlDocument {
+    using Source = XmlSource;
+
+    size_t revision = 0;
+    // Size of the text the document was parsed from.
+    size_t input_size = 0;
+    // Editor text the DOM was parsed in place into; null for a mapped
+    // file, whose copy the DOM owns.
+    std::shared_ptr<std::string> buffer;
+    pugi::xml_document dom;
+
+    bool Build(XmlSource source, std::string& error, JobContext& job);
+};
+
+// Keeps one DOM per input revision, so XPath queries, the tree and the
+// format action share it instead of parsing again on every click.
+using XmlDocumentLoader = DocumentLoader<XmlDocument>;
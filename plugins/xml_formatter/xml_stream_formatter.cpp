@@ -0,0 +1,679 @@
+#include "xml_stream_formatter.h"
+
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "background_job.h"
+#include "output_sink.h"
+
+namespace {
+
+constexpr size_t kJobCheckInterval = 64 * 1024;
+// Longest name quoted in an error message.
+constexpr size_t kMaxQuotedName = 64;
+
+enum CharClass : uint8_t {
+    kNameStart = 1,
+    kName = 2,
+    kSpace = 4
+};
+
+constexpr std::array<uint8_t, 256> MakeCharClasses() {
+    std::array<uint8_t, 256> classes{};
+    for (int c = 0; c < 256; ++c) {
+        const bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        // Multi-byte UTF-8 sequences are accepted as name characters
+        // without checking the exact Unicode ranges.
+        if (letter || c == '_' || c == ':' || c >= 0x80) {
+            classes[c] |= kNameStart | kName;
+        }
+        if ((c >= '0' && c <= '9') || c == '-' || c == '.') {
+            classes[c] |= kName;
+        }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            classes[c] |= kSpace;
+        }
+    }
+    return classes;
+}
+
+constexpr std::array<uint8_t, 256> kCharClasses = MakeCharClasses();
+
+bool Is(char c, CharClass cls) {
+    return (kCharClasses[static_cast<unsigned char>(c)] & cls) != 0;
+}
+
+bool IsWhitespaceOnly(std::string_view text) {
+    for (char c : text) {
+        if (!Is(c, kSpace)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view Trim(std::string_view text) {
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && Is(text[begin], kSpace)) {
+        ++begin;
+    }
+    while (end > begin && Is(text[end - 1], kSpace)) {
+        --end;
+    }
+    return text.substr(begin, end - begin);
+}
+
+// Prefix of a qualified name, or empty when it has none.
+std::string_view Prefix(std::string_view name) {
+    const size_t colon = name.find(':');
+    return colon == std::string_view::npos ? std::string_view() : name.substr(0, colon);
+}
+
+std::string Quoted(std::string_view name) {
+    return std::string(name.substr(0, kMaxQuotedName));
+}
+
+class XmlScanner {
+public:
+    XmlScanner(std::string_view input, XmlEventHandler* handler, JobContext* job)
+        : input_(input), handler_(handler), job_(job) {}
+
+    XmlFormatResult Run();
+    XmlFormatResult RunElement(size_t offset);
+
+private:
+    struct OpenElement {
+        std::string_view name;
+        // Size of prefixes_ before this element's declarations.
+        size_t namespaces = 0;
+    };
+
+    struct ParsedAttribute {
+        std::string_view name;
+        std::string_view value;
+        char quote = '"';
+        size_t offset = 0;
+    };
+
+    bool FailAt(size_t offset, const std::string& message) {
+        char suffix[48];
+        std::snprintf(suffix, sizeof(suffix), " at offset %zu", offset);
+        result_.ok = false;
+        result_.error = message + suffix;
+        result_.error_offset = offset;
+        return false;
+    }
+
+    bool Poll() {
+        if (!job_ || pos_ < next_check_) {
+            return true;
+        }
+        next_check_ = pos_ + kJobCheckInterval;
+        job_->ReportProgress(pos_);
+        if (job_->Cancelled()) {
+            result_.ok = false;
+            result_.cancelled = true;
+            result_.error = "cancelled";
+            return false;
+        }
+        return true;
+    }
+
+    bool StartsWith(size_t at, std::string_view prefix) const {
+        return input_.compare(at, prefix.size(), prefix) == 0;
+    }
+
+    size_t SkipSpace(size_t at) const {
+        while (at < input_.size() && Is(input_[at], kSpace)) {
+            ++at;
+        }
+        return at;
+    }
+
+    std::string_view NameAt(size_t at) const {
+        if (at >= input_.size() || !Is(input_[at], kNameStart)) {
+            return {};
+        }
+        size_t end = at + 1;
+        while (end < input_.size() && Is(input_[end], kName)) {
+            ++end;
+        }
+        return input_.substr(at, end - at);
+    }
+
+    bool Declared(std::string_view prefix) const {
+        if (!check_namespaces_ || prefix.empty() || prefix == "xml") {
+            return true;
+        }
+        for (size_t i = prefixes_.size(); i > 0; --i) {
+            if (prefixes_[i - 1] == prefix) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool CheckReferences(std::string_view text, size_t offset);
+    bool CharData();
+    bool Markup();
+    bool StartTag();
+    bool EndTag();
+    bool ProcessingInstruction();
+    bool Doctype();
+    // Finds `terminator` after `from`, failing with `what` when missing.
+    bool FindEnd(size_t from, std::string_view terminator, const char* what, size_t& end);
+
+    std::string_view input_;
+    XmlEventHandler* handler_;
+    JobContext* job_;
+    size_t pos_ = 0;
+    size_t start_ = 0;
+    size_t next_check_ = 0;
+    bool root_seen_ = false;
+    bool doctype_seen_ = false;
+    bool check_namespaces_ = true;
+    std::vector<OpenElement> stack_;
+    std::vector<std::string_view> prefixes_;
+    std::vector<ParsedAttribute> attributes_;
+    XmlFormatResult result_;
+};
+
+XmlFormatResult XmlScanner::Run() {
+    if (StartsWith(0, "\xEF\xBB\xBF")) {
+        pos_ = 3;
+    } else if (StartsWith(0, "\xFE\xFF") || StartsWith(0, "\xFF\xFE")) {
+        FailAt(0, "UTF-16 input is not supported; convert it to UTF-8");
+        return result_;
+    }
+    start_ = pos_;
+    while (pos_ < input_.size()) {
+        if (!Poll()) {
+            return result_;
+        }
+        const bool ok = input_[pos_] == '<' ? Markup() : CharData();
+        if (!ok) {
+            return result_;
+        }
+    }
+    if (!stack_.empty()) {
+        FailAt(input_.size(), "unexpected end of input inside <" + Quoted(stack_.back().name) + ">");
+    } else if (!root_seen_) {
+        FailAt(input_.size(), "no root element");
+    }
+    if (job_ && result_.ok) {
+        job_->ReportProgress(input_.size());
+    }
+    return result_;
+}
+
+XmlFormatResult XmlScanner::RunElement(size_t offset) {
+    check_namespaces_ = false;
+    pos_ = offset;
+    start_ = offset;
+    if (!StartsWith(pos_, "<") || StartsWith(pos_, "</") || StartsWith(pos_, "<!") || StartsWith(pos_, "<?")) {
+        FailAt(pos_, "expected a start tag");
+        return result_;
+    }
+    while (pos_ < input_.size()) {
+        const bool ok = input_[pos_] == '<' ? Markup() : CharData();
+        if (!ok || stack_.empty()) {
+            return result_;
+        }
+    }
+    FailAt(input_.size(), "unexpected end of input inside <" + Quoted(stack_.back().name) + ">");
+    return result_;
+}
+
+bool XmlScanner::CheckReferences(std::string_view text, size_t offset) {
+    for (size_t amp = text.find('&'); amp != std::string_view::npos; amp = text.find('&', amp + 1)) {
+        size_t i = amp + 1;
+        if (i < text.size() && text[i] == '#') {
+            ++i;
+            const bool hex = i < text.size() && text[i] == 'x';
+            i += hex ? 1 : 0;
+            const size_t digits = i;
+            while (i < text.size() && (hex ? std::isxdigit(static_cast<unsigned char>(text[i])) != 0
+                                           : text[i] >= '0' && text[i] <= '9')) {
+                ++i;
+            }
+            if (i == digits) {
+                return FailAt(offset + amp, "malformed character reference");
+            }
+        } else {
+            const std::string_view name = i < text.size() ? NameAt(offset + i) : std::string_view();
+            if (name.empty()) {
+                return FailAt(offset + amp, "'&' must start an entity reference (use &amp;)");
+            }
+            i += name.size();
+        }
+        if (i >= text.size() || text[i] != ';') {
+            return FailAt(offset + amp, "entity reference is missing its ';'");
+        }
+    }
+    return true;
+}
+
+bool XmlScanner::CharData() {
+    size_t end = input_.find('<', pos_);
+    if (end == std::string_view::npos) {
+        end = input_.size();
+    }
+    const std::string_view text = input_.substr(pos_, end - pos_);
+    if (stack_.empty()) {
+        if (!IsWhitespaceOnly(text)) {
+            size_t first = pos_;
+            while (Is(input_[first], kSpace)) {
+                ++first;
+            }
+            return FailAt(first, root_seen_ ? "text after the root element" : "text before the root element");
+        }
+    } else {
+        if (!CheckReferences(text, pos_)) {
+            return false;
+        }
+        if (handler_) {
+            handler_->Text(text, pos_);
+        }
+    }
+    pos_ = end;
+    return true;
+}
+
+bool XmlScanner::FindEnd(size_t from, std::string_view terminator, const char* what, size_t& end) {
+    end = input_.find(terminator, from);
+    if (end == std::string_view::npos) {
+        return FailAt(pos_, std::string("unterminated ") + what);
+    }
+    return true;
+}
+
+bool XmlScanner::Markup() {
+    if (pos_ + 1 >= input_.size()) {
+        return FailAt(pos_, "unexpected end of input after '<'");
+    }
+    const char next = input_[pos_ + 1];
+    if (next == '?') {
+        return ProcessingInstruction();
+    }
+    if (next == '/') {
+        return EndTag();
+    }
+    if (next != '!') {
+        return StartTag();
+    }
+    size_t end = 0;
+    if (StartsWith(pos_, "<!--")) {
+        if (!FindEnd(pos_ + 4, "-->", "comment", end)) {
+            return false;
+        }
+        if (handler_) {
+            handler_->Comment(input_.substr(pos_ + 4, end - pos_ - 4), pos_);
+        }
+        pos_ = end + 3;
+        return true;
+    }
+    if (StartsWith(pos_, "<![CDATA[")) {
+        if (stack_.empty()) {
+            return FailAt(pos_, "CDATA section outside the root element");
+        }
+        if (!FindEnd(pos_ + 9, "]]>", "CDATA section", end)) {
+            return false;
+        }
+        if (handler_) {
+            handler_->CData(input_.substr(pos_ + 9, end - pos_ - 9), pos_);
+        }
+        pos_ = end + 3;
+        return true;
+    }
+    if (StartsWith(pos_, "<!DOCTYPE")) {
+        return Doctype();
+    }
+    return FailAt(pos_, "unexpected markup declaration");
+}
+
+bool XmlScanner::ProcessingInstruction() {
+    const std::string_view target = NameAt(pos_ + 2);
+    if (target.empty()) {
+        return FailAt(pos_ + 2, "expected a processing instruction target");
+    }
+    const bool declaration = target.size() == 3 && (target[0] | 0x20) == 'x' && (target[1] | 0x20) == 'm' &&
+                             (target[2] | 0x20) == 'l';
+    if (declaration && pos_ != start_) {
+        return FailAt(pos_, "the XML declaration must come first in the document");
+    }
+    size_t end = 0;
+    if (!FindEnd(pos_ + 2 + target.size(), "?>", "processing instruction", end)) {
+        return false;
+    }
+    const size_t content = SkipSpace(pos_ + 2 + target.size());
+    if (handler_) {
+        handler_->ProcessingInstruction(target, input_.substr(content, end > content ? end - content : 0), pos_);
+    }
+    pos_ = end + 2;
+    return true;
+}
+
+bool XmlScanner::Doctype() {
+    if (root_seen_ || doctype_seen_) {
+        return FailAt(pos_, "unexpected DOCTYPE declaration");
+    }
+    doctype_seen_ = true;
+    // Skips quoted literals, comments and the bracketed internal subset,
+    // any of which may hold a '>'.
+    size_t depth = 0;
+    for (size_t i = pos_ + 9; i < input_.size(); ++i) {
+        const char c = input_[i];
+        if (c == '"' || c == '\'') {
+            const size_t close = input_.find(c, i + 1);
+            if (close == std::string_view::npos) {
+                break;
+            }
+            i = close;
+        } else if (c == '<' && StartsWith(i, "<!--")) {
+            const size_t close = input_.find("-->", i + 4);
+            if (close == std::string_view::npos) {
+                break;
+            }
+            i = close + 2;
+        } else if (c == '[') {
+            ++depth;
+        } else if (c == ']' && depth > 0) {
+            --depth;
+        } else if (c == '>' && depth == 0) {
+            if (handler_) {
+                handler_->Doctype(input_.substr(pos_, i + 1 - pos_), pos_);
+            }
+            pos_ = i + 1;
+            return true;
+        }
+    }
+    return FailAt(pos_, "unterminated DOCTYPE declaration");
+}
+
+bool XmlScanner::StartTag() {
+    if (stack_.empty() && root_seen_) {
+        return FailAt(pos_, "more than one root element");
+    }
+    const std::string_view name = NameAt(pos_ + 1);
+    if (name.empty()) {
+        return FailAt(pos_ + 1, "expected an element name after '<'");
+    }
+    attributes_.clear();
+    size_t i = pos_ + 1 + name.size();
+    bool empty = false;
+    while (true) {
+        const size_t before = i;
+        i = SkipSpace(i);
+        if (i >= input_.size()) {
+            return FailAt(pos_, "unterminated start tag <" + Quoted(name) + ">");
+        }
+        if (input_[i] == '>') {
+            ++i;
+            break;
+        }
+        if (input_[i] == '/') {
+            if (i + 1 >= input_.size() || input_[i + 1] != '>') {
+                return FailAt(i, "expected '>' after '/'");
+            }
+            i += 2;
+            empty = true;
+            break;
+        }
+        if (i == before) {
+            return FailAt(i, "expected whitespace, '>' or '/>'");
+        }
+        ParsedAttribute attribute;
+        attribute.offset = i;
+        attribute.name = NameAt(i);
+        if (attribute.name.empty()) {
+            return FailAt(i, "expected an attribute name");
+        }
+        i = SkipSpace(i + attribute.name.size());
+        if (i >= input_.size() || input_[i] != '=') {
+            return FailAt(i, "expected '=' after attribute " + Quoted(attribute.name));
+        }
+        i = SkipSpace(i + 1);
+        if (i >= input_.size() || (input_[i] != '"' && input_[i] != '\'')) {
+            return FailAt(i, "expected a quoted value for attribute " + Quoted(attribute.name));
+        }
+        attribute.quote = input_[i];
+        const size_t close = input_.find(attribute.quote, i + 1);
+        if (close == std::string_view::npos) {
+            return FailAt(i, "unterminated value of attribute " + Quoted(attribute.name));
+        }
+        attribute.value = input_.substr(i + 1, close - i - 1);
+        const size_t lt = attribute.value.find('<');
+        if (lt != std::string_view::npos) {
+            return FailAt(i + 1 + lt, "'<' in the value of attribute " + Quoted(attribute.name));
+        }
+        if (!CheckReferences(attribute.value, i + 1)) {
+            return false;
+        }
+        for (const ParsedAttribute& other : attributes_) {
+            if (other.name == attribute.name) {
+                return FailAt(attribute.offset, "duplicate attribute " + Quoted(attribute.name));
+            }
+        }
+        attributes_.push_back(attribute);
+        i = close + 1;
+    }
+
+    const size_t namespaces = prefixes_.size();
+    for (const ParsedAttribute& attribute : attributes_) {
+        if (attribute.name.size() > 6 && attribute.name.substr(0, 6) == "xmlns:") {
+            prefixes_.push_back(attribute.name.substr(6));
+        }
+    }
+    if (!Declared(Prefix(name))) {
+        return FailAt(pos_ + 1, "undeclared namespace prefix in <" + Quoted(name) + ">");
+    }
+    for (const ParsedAttribute& attribute : attributes_) {
+        const std::string_view prefix = Prefix(attribute.name);
+        if (prefix != "xmlns" && !Declared(prefix)) {
+            return FailAt(attribute.offset, "undeclared namespace prefix in attribute " + Quoted(attribute.name));
+        }
+    }
+
+    if (handler_) {
+        handler_->StartElement(name, pos_);
+        for (const ParsedAttribute& attribute : attributes_) {
+            handler_->Attribute(attribute.name, attribute.value, attribute.quote);
+        }
+        handler_->StartTagEnd(empty);
+    }
+    root_seen_ = true;
+    if (empty) {
+        prefixes_.resize(namespaces);
+    } else {
+        stack_.push_back(OpenElement{name, namespaces});
+    }
+    pos_ = i;
+    return true;
+}
+
+bool XmlScanner::EndTag() {
+    const std::string_view name = NameAt(pos_ + 2);
+    if (name.empty()) {
+        return FailAt(pos_ + 2, "expected an element name after '</'");
+    }
+    const size_t close = SkipSpace(pos_ + 2 + name.size());
+    if (close >= input_.size() || input_[close] != '>') {
+        return FailAt(close, "expected '>' to end </" + Quoted(name) + ">");
+    }
+    if (stack_.empty()) {
+        return FailAt(pos_, "unexpected end tag </" + Quoted(name) + ">");
+    }
+    if (stack_.back().name != name) {
+        return FailAt(pos_, "end tag </" + Quoted(name) + "> does not match <" + Quoted(stack_.back().name) + ">");
+    }
+    prefixes_.resize(stack_.back().namespaces);
+    stack_.pop_back();
+    if (handler_) {
+        handler_->EndElement(name, pos_);
+    }
+    pos_ = close + 1;
+    return true;
+}
+
+// Re-indents the event stream as it arrives. A start tag is left open
+// until the next event shows whether the element is empty, holds only
+// text (kept on one line), or has children.
+class StreamFormatter : public XmlEventHandler {
+public:
+    StreamFormatter(const XmlFormatOptions& options, OutputSink& out)
+        : indent_(options.indent < 0 ? 0 : static_cast<size_t>(options.indent)), out_(out) {}
+
+    void StartElement(std::string_view name, size_t) override {
+        BeginNode();
+        out_.Put('<');
+        out_.Append(name);
+    }
+
+    void Attribute(std::string_view name, std::string_view value, char quote) override {
+        out_.Put(' ');
+        out_.Append(name);
+        const char written = quote == '\'' && value.find('"') != std::string_view::npos ? '\'' : '"';
+        out_.Put('=');
+        out_.Put(written);
+        out_.Append(value);
+        out_.Put(written);
+    }
+
+    void StartTagEnd(bool empty) override {
+        if (empty) {
+            out_.Append(" />");
+            return;
+        }
+        tag_open_ = true;
+        ++depth_;
+    }
+
+    void EndElement(std::string_view name, size_t) override {
+        --depth_;
+        if (tag_open_) {
+            tag_open_ = false;
+            if (pending_text_.empty()) {
+                out_.Append(" />");
+                return;
+            }
+            out_.Put('>');
+            out_.Append(pending_text_);
+            pending_text_ = {};
+        } else {
+            NewLine();
+        }
+        out_.Append("</");
+        out_.Append(name);
+        out_.Put('>');
+    }
+
+    void Text(std::string_view text, size_t) override {
+        if (IsWhitespaceOnly(text)) {
+            return;
+        }
+        if (tag_open_ && pending_text_.empty()) {
+            pending_text_ = text;
+            return;
+        }
+        BeginNode();
+        out_.Append(Trim(text));
+    }
+
+    void CData(std::string_view content, size_t) override {
+        BeginNode();
+        out_.Append("<![CDATA[");
+        out_.Append(content);
+        out_.Append("]]>");
+    }
+
+    void Comment(std::string_view content, size_t) override {
+        BeginNode();
+        out_.Append("<!--");
+        out_.Append(content);
+        out_.Append("-->");
+    }
+
+    void ProcessingInstruction(std::string_view target, std::string_view content, size_t) override {
+        BeginNode();
+        out_.Append("<?");
+        out_.Append(target);
+        if (!content.empty()) {
+            out_.Put(' ');
+            out_.Append(content);
+        }
+        out_.Append("?>");
+    }
+
+    void Doctype(std::string_view declaration, size_t) override {
+        BeginNode();
+        out_.Append(declaration);
+    }
+
+    void Finish() {
+        if (started_) {
+            out_.Put('\n');
+        }
+    }
+
+private:
+    void NewLine() {
+        out_.Put('\n');
+        out_.PutRepeated(' ', indent_ * depth_);
+    }
+
+    // Closes an open start tag, moving text held back for a one-line
+    // element onto its own line, and starts a new line for the next node.
+    void BeginNode() {
+        if (tag_open_) {
+            tag_open_ = false;
+            out_.Put('>');
+            if (!pending_text_.empty()) {
+                NewLine();
+                out_.Append(Trim(pending_text_));
+                pending_text_ = {};
+            }
+        }
+        if (started_) {
+            NewLine();
+        }
+        started_ = true;
+    }
+
+    size_t indent_;
+    OutputSink& out_;
+    size_t depth_ = 0;
+    bool started_ = false;
+    bool tag_open_ = false;
+    std::string_view pending_text_;
+};
+
+} // namespace
+
+XmlFormatResult ScanXmlEvents(std::string_view input, XmlEventHandler* handler, JobContext* job) {
+    return XmlScanner(input, handler, job).Run();
+}
+
+XmlFormatResult ScanXmlElement(std::string_view input, size_t offset, XmlEventHandler* handler) {
+    return XmlScanner(input, handler, nullptr).RunElement(offset);
+}
+
+XmlFormatResult FormatXmlStream(std::string_view input,
+                                const XmlFormatOptions& options,
+                                OutputSink& out,
+                                JobContext* job) {
+    StreamFormatter formatter(options, out);
+    XmlFormatResult result = ScanXmlEvents(input, &formatter, job);
+    if (!result.ok) {
+        return result;
+    }
+    formatter.Finish();
+    if (!out.Finish()) {
+        result.ok = false;
+        result.error = "failed to write output";
+    }
+    return result;
+}
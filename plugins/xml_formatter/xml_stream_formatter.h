@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+class JobContext;
+class OutputSink;
+
+struct XmlFormatOptions {
+    int indent = 2;
+};
+
+struct XmlFormatResult {
+    bool ok = true;
+    bool cancelled = false;
+    std::string error;
+    size_t error_offset = 0;
+};
+
+// Receives the markup of a document in order while ScanXmlEvents checks
+// it. Everything is a view into the input: text and attribute values are
+// passed as written, with entity references left undecoded. Events for a
+// malformed document stop at the error.
+class XmlEventHandler {
+public:
+    virtual ~XmlEventHandler() = default;
+    // A start tag is reported as StartElement, one Attribute per attribute
+    // in source order, then StartTagEnd. `empty` is set for "<a/>", which
+    // gets no EndElement.
+    virtual void StartElement(std::string_view name, size_t offset) = 0;
+    // `value` is the text between the quotes; `quote` is the quote used.
+    virtual void Attribute(std::string_view name, std::string_view value, char quote) = 0;
+    virtual void StartTagEnd(bool empty) = 0;
+    virtual void EndElement(std::string_view name, size_t offset) = 0;
+    // Character data between two pieces of markup, whitespace-only runs
+    // included.
+    virtual void Text(std::string_view text, size_t offset) = 0;
+    // The next three get the content between the delimiters.
+    virtual void CData(std::string_view content, size_t offset) = 0;
+    virtual void Comment(std::string_view content, size_t offset) = 0;
+    virtual void ProcessingInstruction(std::string_view target, std::string_view content, size_t offset) = 0;
+    // The whole "<!DOCTYPE ...>" declaration, internal subset included.
+    virtual void Doctype(std::string_view declaration, size_t offset) = 0;
+};
+
+// Checks that `input` is one well-formed, namespace-well-formed UTF-8 XML
+// document in a single forward pass, reporting its markup to `handler`
+// when one is given. No tree is built: the state kept is the stack of open
+// element names and in-scope namespace prefixes, all views into the input,
+// so memory is bounded by nesting depth rather than document size. Entity
+// references are checked for syntax only, since a DTD may declare more.
+// When `job` is given, progress is reported to it and cancellation is
+// polled every few kilobytes of input.
+XmlFormatResult ScanXmlEvents(std::string_view input, XmlEventHandler* handler, JobContext* job = nullptr);
+
+// Reports the element starting at input[offset] and everything inside it,
+// then stops. Meant for re-reading part of a document ScanXmlEvents has
+// already accepted: namespace prefixes are not checked, since they may be
+// declared on the element's ancestors.
+XmlFormatResult ScanXmlElement(std::string_view input, size_t offset, XmlEventHandler* handler);
+
+// Writes `input` re-indented to `out` as it is scanned, in the layout the
+// DOM path produces for element-only content: one node per line, elements
+// holding only text kept on one line, empty elements as "<a />",
+// whitespace-only text dropped. Mixed content differs: where pugixml
+// writes text interleaved with child elements inline and stops indenting
+// inside that element, this printer still puts each text run, trimmed, and
+// each child on a line of its own. Text, attribute values, comments, CDATA
+// and processing instructions are otherwise copied byte-for-byte, so
+// entities stay as written. Attribute values are double-quoted unless they
+// contain a double quote.
+XmlFormatResult FormatXmlStream(std::string_view input,
+                                const XmlFormatOptions& options,
+                                OutputSink& out,
+                                JobContext* job = nullptr);
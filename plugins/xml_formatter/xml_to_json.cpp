@@ -0,0 +1,560 @@
+#include "xml_to_json.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+#include "background_job.h"
+#include "output_sink.h"
+
+namespace {
+
+bool IsXmlSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool IsWhitespaceOnly(std::string_view text) {
+    for (char c : text) {
+        if (!IsXmlSpace(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// How a run of characters from the input is turned into JSON string
+// content.
+enum class TextMode {
+    // Written as is, as for names and CDATA.
+    Raw,
+    // Entity references decoded and line ends normalized to "\n".
+    Text,
+    // As Text, with tabs and line ends then turned into spaces.
+    Attribute
+};
+
+void PutCodePoint(OutputSink& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.Put(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.Put(static_cast<char>(0xC0 | (cp >> 6)));
+        out.Put(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.Put(static_cast<char>(0xE0 | (cp >> 12)));
+        out.Put(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.Put(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.Put(static_cast<char>(0xF0 | (cp >> 18)));
+        out.Put(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.Put(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.Put(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+void PutEscaped(OutputSink& out, char c) {
+    static const char kHex[] = "0123456789abcdef";
+    switch (c) {
+        case '"':
+            out.Append("\\\"");
+            break;
+        case '\\':
+            out.Append("\\\\");
+            break;
+        case '\n':
+            out.Append("\\n");
+            break;
+        case '\t':
+            out.Append("\\t");
+            break;
+        case '\r':
+            out.Append("\\r");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out.Append("\\u00");
+                out.Put(kHex[(c >> 4) & 0xF]);
+                out.Put(kHex[c & 0xF]);
+            } else {
+                out.Put(c);
+            }
+            break;
+    }
+}
+
+// Decodes the reference starting at text[amp] and returns the index just
+// past it. The scanner has already checked that it ends in ';'.
+size_t PutReference(OutputSink& out, std::string_view text, size_t amp) {
+    const size_t semicolon = text.find(';', amp);
+    const std::string_view name = text.substr(amp + 1, semicolon - amp - 1);
+    if (!name.empty() && name[0] == '#') {
+        const bool hex = name.size() > 1 && name[1] == 'x';
+        const std::string digits(name.substr(hex ? 2 : 1));
+        const uint32_t cp = static_cast<uint32_t>(std::strtoul(digits.c_str(), nullptr, hex ? 16 : 10));
+        if (cp < 0x80) {
+            PutEscaped(out, static_cast<char>(cp));
+        } else if (cp <= 0x10FFFF) {
+            PutCodePoint(out, cp);
+        }
+    } else if (name == "lt") {
+        out.Put('<');
+    } else if (name == "gt") {
+        out.Put('>');
+    } else if (name == "amp") {
+        out.Put('&');
+    } else if (name == "quot") {
+        out.Append("\\\"");
+    } else if (name == "apos") {
+        out.Put('\'');
+    } else {
+        // Declared in a DTD this converter does not read.
+        out.Put('&');
+        for (char c : name) {
+            PutEscaped(out, c);
+        }
+        out.Put(';');
+    }
+    return semicolon + 1;
+}
+
+bool NeedsAttention(char c) {
+    return c == '"' || c == '\\' || c == '&' || static_cast<unsigned char>(c) < 0x20;
+}
+
+void PutStringContent(OutputSink& out, std::string_view text, TextMode mode) {
+    size_t i = 0;
+    while (i < text.size()) {
+        // Copy the run of characters that need neither escaping nor
+        // decoding in one go.
+        size_t end = i;
+        while (end < text.size() && !NeedsAttention(text[end])) {
+            ++end;
+        }
+        if (end > i) {
+            out.Append(text.substr(i, end - i));
+            i = end;
+            continue;
+        }
+        const char c = text[i];
+        if (mode != TextMode::Raw && c == '&') {
+            i = PutReference(out, text, i);
+            continue;
+        }
+        if (mode != TextMode::Raw && c == '\r') {
+            // "\r\n" and a lone "\r" both count as one line end.
+            if (i + 1 < text.size() && text[i + 1] == '\n') {
+                ++i;
+            }
+            out.Append(mode == TextMode::Attribute ? " " : "\\n");
+        } else if (mode == TextMode::Attribute && (c == '\n' || c == '\t')) {
+            out.Put(' ');
+        } else {
+            PutEscaped(out, c);
+        }
+        ++i;
+    }
+}
+
+constexpr size_t kNoOffset = static_cast<size_t>(-1);
+
+// Same-named siblings that are not all adjacent. The first run of them is
+// written in place; `members` are the offsets of the rest, which are read
+// again from there when the run ends.
+struct ScatteredGroup {
+    size_t first = 0;
+    size_t members_begin = 0;
+    size_t members_end = 0;
+};
+
+// What the first pass learns about sibling elements, keyed by the offset
+// of each element's '<'. All vectors are sorted once the pass is done.
+struct SiblingGroups {
+    // Elements that are the first of two or more same-named siblings.
+    std::vector<size_t> run_starts;
+    std::vector<ScatteredGroup> scattered;
+    std::vector<size_t> members;
+    // The members of all scattered groups: skipped where they stand.
+    std::vector<size_t> moved;
+
+    static bool Contains(const std::vector<size_t>& sorted, size_t offset) {
+        return std::binary_search(sorted.begin(), sorted.end(), offset);
+    }
+
+    const ScatteredGroup* Find(size_t first) const {
+        const auto it = std::lower_bound(scattered.begin(), scattered.end(), first,
+                                         [](const ScatteredGroup& group, size_t value) { return group.first < value; });
+        return it != scattered.end() && it->first == first ? &*it : nullptr;
+    }
+};
+
+// First pass: groups each element's children by name. A name is looked up
+// only when it differs from the previous child's, so long runs of one name
+// cost no hashing.
+class GroupFinder : public XmlEventHandler {
+public:
+    explicit GroupFinder(SiblingGroups& groups) : groups_(groups) {
+        frames_.emplace_back();
+    }
+
+    void StartElement(std::string_view name, size_t offset) override {
+        Frame& parent = frames_[open_ - 1];
+        if (parent.last_child != nullptr && parent.last_name == name) {
+            Add(*parent.last_child, offset, true);
+        } else {
+            auto [it, inserted] = parent.names.try_emplace(name);
+            if (inserted) {
+                it->second.first = offset;
+            } else {
+                Add(it->second, offset, false);
+            }
+            parent.last_name = name;
+            parent.last_child = &it->second;
+        }
+        Push();
+    }
+
+    void Attribute(std::string_view, std::string_view, char) override {}
+
+    void StartTagEnd(bool empty) override {
+        if (empty) {
+            Pop();
+        }
+    }
+
+    void EndElement(std::string_view, size_t) override {
+        Pop();
+    }
+
+    void Text(std::string_view, size_t) override {}
+    void CData(std::string_view, size_t) override {}
+    void Comment(std::string_view, size_t) override {}
+    void ProcessingInstruction(std::string_view, std::string_view, size_t) override {}
+    void Doctype(std::string_view, size_t) override {}
+
+    void Finish() {
+        std::sort(groups_.run_starts.begin(), groups_.run_starts.end());
+        std::sort(groups_.scattered.begin(), groups_.scattered.end(),
+                  [](const ScatteredGroup& a, const ScatteredGroup& b) { return a.first < b.first; });
+        std::sort(groups_.moved.begin(), groups_.moved.end());
+    }
+
+private:
+    struct Siblings {
+        size_t first = 0;
+        size_t count = 1;
+        // Offsets of the members after the first break in the run.
+        std::vector<size_t> moved;
+    };
+
+    struct Frame {
+        std::unordered_map<std::string_view, Siblings> names;
+        std::string_view last_name;
+        Siblings* last_child = nullptr;
+    };
+
+    static void Add(Siblings& siblings, size_t offset, bool adjacent) {
+        ++siblings.count;
+        if (!adjacent || !siblings.moved.empty()) {
+            siblings.moved.push_back(offset);
+        }
+    }
+
+    // Frames above the open ones are kept for reuse, as in the converter.
+    void Push() {
+        if (open_ == frames_.size()) {
+            frames_.emplace_back();
+        }
+        ++open_;
+    }
+
+    void Pop() {
+        Frame& frame = frames_[--open_];
+        if (frame.last_child == nullptr) {
+            return;
+        }
+        for (const auto& [name, siblings] : frame.names) {
+            if (siblings.count < 2) {
+                continue;
+            }
+            groups_.run_starts.push_back(siblings.first);
+            if (!siblings.moved.empty()) {
+                const size_t begin = groups_.members.size();
+                groups_.members.insert(groups_.members.end(), siblings.moved.begin(), siblings.moved.end());
+                groups_.moved.insert(groups_.moved.end(), siblings.moved.begin(), siblings.moved.end());
+                groups_.scattered.push_back(ScatteredGroup{siblings.first, begin, groups_.members.size()});
+            }
+        }
+        frame.names.clear();
+        frame.last_name = std::string_view();
+        frame.last_child = nullptr;
+    }
+
+    SiblingGroups& groups_;
+    std::vector<Frame> frames_;
+    size_t open_ = 1;
+};
+
+// Second pass: writes JSON as the markup arrives. An element's object is
+// only opened when its first attribute or child element shows that it
+// needs one; until then its text is held back as views into the input.
+// When a run of same-named siblings ends, the rest of its group is read
+// again from the recorded offsets and written into the same array, and
+// those elements are skipped when the scan reaches them.
+class JsonConverter : public XmlEventHandler {
+public:
+    JsonConverter(std::string_view input,
+                  const XmlToJsonOptions& options,
+                  const SiblingGroups& groups,
+                  OutputSink& out)
+        : input_(input),
+          indent_(options.indent < 0 ? 0 : static_cast<size_t>(options.indent)),
+          groups_(groups),
+          out_(out) {
+        frames_.emplace_back();
+    }
+
+    void StartElement(std::string_view name, size_t offset) override {
+        if (skip_depth_ > 0 || (offset != recalled_ && SiblingGroups::Contains(groups_.moved, offset))) {
+            ++skip_depth_;
+            return;
+        }
+        if (offset == recalled_) {
+            // Its key and separator were written by CloseRun.
+            recalled_ = kNoOffset;
+        } else if (Top().run_open && Top().run_name == name) {
+            out_.Put(',');
+            NewLine();
+        } else {
+            CloseRun();
+            Frame& parent = Top();
+            BeginMember(parent);
+            PutKey(std::string_view(), name);
+            if (SiblingGroups::Contains(groups_.run_starts, offset)) {
+                out_.Put('[');
+                ++depth_;
+                parent.run_open = true;
+                parent.run_name = name;
+                parent.run_first = offset;
+                NewLine();
+            }
+        }
+        Push();
+    }
+
+    void Attribute(std::string_view name, std::string_view value, char) override {
+        if (skip_depth_ > 0) {
+            return;
+        }
+        BeginMember(Top());
+        PutKey("@", name);
+        out_.Put('"');
+        PutStringContent(out_, value, TextMode::Attribute);
+        out_.Put('"');
+    }
+
+    void StartTagEnd(bool empty) override {
+        if (empty) {
+            EndElement(std::string_view(), 0);
+        }
+    }
+
+    void EndElement(std::string_view, size_t) override {
+        if (skip_depth_ > 0) {
+            --skip_depth_;
+            return;
+        }
+        CloseRun();
+        Frame& frame = Top();
+        if (frame.opened) {
+            if (!frame.text.empty()) {
+                BeginMember(frame);
+                PutKey("#", "text");
+                PutText(frame.text);
+            }
+            CloseObject();
+        } else if (frame.text.empty()) {
+            out_.Append("null");
+        } else {
+            PutText(frame.text);
+        }
+        --open_;
+    }
+
+    void Text(std::string_view text, size_t) override {
+        if (skip_depth_ > 0) {
+            return;
+        }
+        Frame& frame = Top();
+        // Text outside the root element is whitespace.
+        if (open_ == 1 || (frame.opened && IsWhitespaceOnly(text))) {
+            return;
+        }
+        frame.text.push_back(Segment{text, false});
+    }
+
+    void CData(std::string_view content, size_t) override {
+        if (skip_depth_ == 0) {
+            Top().text.push_back(Segment{content, true});
+        }
+    }
+
+    void Comment(std::string_view, size_t) override {}
+    void ProcessingInstruction(std::string_view, std::string_view, size_t) override {}
+    void Doctype(std::string_view, size_t) override {}
+
+    void Finish() {
+        CloseRun();
+        Frame& document = frames_.front();
+        if (document.opened) {
+            CloseObject();
+            out_.Put('\n');
+        }
+    }
+
+private:
+    struct Segment {
+        std::string_view text;
+        bool cdata = false;
+    };
+
+    struct Frame {
+        bool opened = false;
+        bool has_members = false;
+        bool run_open = false;
+        std::string_view run_name;
+        size_t run_first = 0;
+        std::vector<Segment> text;
+    };
+
+    // Frames may move when a recalled element pushes past the end, so
+    // none is held across a call that can push.
+    Frame& Top() {
+        return frames_[open_ - 1];
+    }
+
+    // Frames above the open ones are kept, so their text vectors are
+    // reused rather than allocated again for every element.
+    void Push() {
+        if (open_ == frames_.size()) {
+            frames_.emplace_back();
+        } else {
+            Frame& frame = frames_[open_];
+            frame.opened = false;
+            frame.has_members = false;
+            frame.run_open = false;
+            frame.text.clear();
+        }
+        ++open_;
+    }
+
+    void NewLine() {
+        if (indent_ > 0) {
+            out_.Put('\n');
+            out_.PutRepeated(' ', indent_ * depth_);
+        }
+    }
+
+    // Opens the frame's object on its first member, dropping whitespace
+    // that was held back while the element could still be text-only.
+    void BeginMember(Frame& frame) {
+        if (!frame.opened) {
+            frame.opened = true;
+            out_.Put('{');
+            ++depth_;
+            size_t kept = 0;
+            for (const Segment& segment : frame.text) {
+                if (segment.cdata || !IsWhitespaceOnly(segment.text)) {
+                    frame.text[kept++] = segment;
+                }
+            }
+            frame.text.resize(kept);
+        }
+        if (frame.has_members) {
+            out_.Put(',');
+        }
+        frame.has_members = true;
+        NewLine();
+    }
+
+    void CloseObject() {
+        --depth_;
+        NewLine();
+        out_.Put('}');
+    }
+
+    // Ends the open run of the top frame, first writing the members of its
+    // group that stand further on.
+    void CloseRun() {
+        if (!Top().run_open) {
+            return;
+        }
+        Top().run_open = false;
+        if (const ScatteredGroup* group = groups_.Find(Top().run_first)) {
+            for (size_t i = group->members_begin; i < group->members_end; ++i) {
+                out_.Put(',');
+                NewLine();
+                recalled_ = groups_.members[i];
+                // The whole document was accepted by the first pass.
+                ScanXmlElement(input_, recalled_, this);
+            }
+        }
+        --depth_;
+        NewLine();
+        out_.Put(']');
+    }
+
+    void PutKey(std::string_view prefix, std::string_view name) {
+        out_.Put('"');
+        out_.Append(prefix);
+        PutStringContent(out_, name, TextMode::Raw);
+        out_.Append(indent_ > 0 ? "\": " : "\":");
+    }
+
+    void PutText(const std::vector<Segment>& segments) {
+        out_.Put('"');
+        for (const Segment& segment : segments) {
+            PutStringContent(out_, segment.text, segment.cdata ? TextMode::Raw : TextMode::Text);
+        }
+        out_.Put('"');
+    }
+
+    std::string_view input_;
+    size_t indent_;
+    const SiblingGroups& groups_;
+    OutputSink& out_;
+    size_t depth_ = 0;
+    // Nesting inside an element skipped because its group was written
+    // earlier.
+    size_t skip_depth_ = 0;
+    // Offset of the element being read again for its group.
+    size_t recalled_ = kNoOffset;
+    std::vector<Frame> frames_;
+    size_t open_ = 1;
+};
+
+} // namespace
+
+XmlFormatResult ConvertXmlToJson(std::string_view input,
+                                 const XmlToJsonOptions& options,
+                                 OutputSink& out,
+                                 JobContext* job) {
+    SiblingGroups groups;
+    GroupFinder finder(groups);
+    XmlFormatResult result = ScanXmlEvents(input, &finder, job);
+    if (!result.ok) {
+        return result;
+    }
+    finder.Finish();
+    JsonConverter converter(input, options, groups, out);
+    result = ScanXmlEvents(input, &converter, job);
+    if (!result.ok) {
+        return result;
+    }
+    converter.Finish();
+    if (!out.Finish()) {
+        result.ok = false;
+        result.error = "failed to write output";
+    }
+    return result;
+}
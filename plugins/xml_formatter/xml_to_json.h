@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string_view>
+
+#include "xml_stream_formatter.h"
+
+class JobContext;
+class OutputSink;
+
+struct XmlToJsonOptions {
+    // Spaces per nesting level; 0 writes compact JSON on one line.
+    int indent = 2;
+};
+
+// Writes `input` to `out` as JSON while it is scanned, building neither an
+// XML nor a JSON tree. The mapping:
+//   - the document is an object with one member named after the root;
+//   - an element with no attributes and no child elements becomes its
+//     text as a string, or null when it has none;
+//   - any other element becomes an object holding its attributes as
+//     "@name" members, then its child elements in document order, grouped
+//     by name as below, then its text runs concatenated as "#text",
+//     whitespace-only runs dropped;
+//   - sibling elements of the same name become one member, at the place
+//     of the first of them, whose value is an array in document order, so
+//     no object has repeated keys;
+//   - names keep their namespace prefix and xmlns declarations are
+//     ordinary attributes;
+//   - character and predefined entity references are decoded and CDATA
+//     is text; other entity references are kept as written;
+//   - comments, processing instructions and the doctype are dropped;
+//   - every value is a string: no number or boolean is guessed.
+// Which elements have same-named siblings is only known once their parent
+// ends, so `input` is scanned twice. The first pass records the offsets of
+// elements that start a group and of group members that are not adjacent
+// to the first; the second pass writes those members when their group's
+// first run ends, reading each again from its offset. Beyond that, memory
+// is bounded by nesting depth plus the text runs of open elements, all
+// views into `input`.
+XmlFormatResult ConvertXmlToJson(std::string_view input,
+                                 const XmlToJsonOptions& options,
+                                 OutputSink& out,
+                                 JobContext* job = nullptr);
@@ -0,0 +1,198 @@
+#include "xml_tree_view.h"
+
+#include <imgui.h>
+
+#include <string_view>
+
+namespace {
+
+// Text longer than this is cut in the tree labels.
+constexpr int kMaxPreviewChars = 120;
+
+constexpr ImGuiTreeNodeFlags kLeafFlags =
+    ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen | ImGuiTreeNodeFlags_SpanAvailWidth;
+
+int PreviewLength(std::string_view text) {
+    return text.size() > kMaxPreviewChars ? kMaxPreviewChars : static_cast<int>(text.size());
+}
+
+const char* Ellipsis(std::string_view text) {
+    return text.size() > kMaxPreviewChars ? "..." : "";
+}
+
+// An element holding nothing but one run of text is drawn as a single leaf.
+bool IsTextOnly(const pugi::xml_node& node) {
+    const pugi::xml_node child = node.first_child();
+    return !node.first_attribute() && child && !child.next_sibling() &&
+           (child.type() == pugi::node_pcdata || child.type() == pugi::node_cdata);
+}
+
+// Elements with attributes or more than a single text child open into rows.
+bool IsExpandable(const pugi::xml_node& node) {
+    if (node.type() == pugi::node_document) {
+        return true;
+    }
+    return node.type() == pugi::node_element && (node.first_attribute() || node.first_child()) &&
+           !IsTextOnly(node);
+}
+
+void RenderLeaf(const pugi::xml_node& node) {
+    const void* id = node.internal_object();
+    const std::string_view value(node.value());
+    switch (node.type()) {
+        case pugi::node_pcdata:
+            ImGui::TreeNodeEx(id, kLeafFlags, "\"%.*s%s\"", PreviewLength(value), value.data(), Ellipsis(value));
+            break;
+        case pugi::node_cdata:
+            ImGui::TreeNodeEx(id, kLeafFlags, "<![CDATA[%.*s%s]]>", PreviewLength(value), value.data(),
+                              Ellipsis(value));
+            break;
+        case pugi::node_comment:
+            ImGui::TreeNodeEx(id, kLeafFlags, "<!--%.*s%s-->", PreviewLength(value), value.data(), Ellipsis(value));
+            break;
+        case pugi::node_pi:
+        case pugi::node_declaration:
+            ImGui::TreeNodeEx(id, kLeafFlags, "<?%s %.*s%s?>", node.name(), PreviewLength(value), value.data(),
+                              Ellipsis(value));
+            break;
+        case pugi::node_doctype:
+            ImGui::TreeNodeEx(id, kLeafFlags, "<!DOCTYPE %.*s%s>", PreviewLength(value), value.data(),
+                              Ellipsis(value));
+            break;
+        default:
+            ImGui::TreeNodeEx(id, kLeafFlags, "%s", node.name());
+            break;
+    }
+}
+
+} // namespace
+
+void XmlTreeView::Clear() {
+    children_.clear();
+    expanded_.clear();
+    rows_.clear();
+    document_.reset();
+}
+
+const std::vector<pugi::xpath_node>& XmlTreeView::ChildrenOf(const pugi::xml_node& node) {
+    auto it = children_.find(node.internal_object());
+    if (it == children_.end()) {
+        std::vector<pugi::xpath_node> rows;
+        for (pugi::xml_attribute attribute = node.first_attribute(); attribute;
+             attribute = attribute.next_attribute()) {
+            rows.emplace_back(attribute, node);
+        }
+        for (pugi::xml_node child = node.first_child(); child; child = child.next_sibling()) {
+            rows.emplace_back(child);
+        }
+        it = children_.emplace(node.internal_object(), std::move(rows)).first;
+    }
+    return it->second;
+}
+
+void XmlTreeView::BuildRows() {
+    rows_.clear();
+    // Depth first over the open elements. Each child list goes on the
+    // stack back to front, so rows come out in document order.
+    std::vector<Row> stack{Row{pugi::xpath_node(document_->dom), 0}};
+    while (!stack.empty()) {
+        const Row row = stack.back();
+        stack.pop_back();
+        rows_.push_back(row);
+        const pugi::xml_node node = row.item.node();
+        if (row.item.attribute() || !expanded_.count(node.internal_object())) {
+            continue;
+        }
+        const std::vector<pugi::xpath_node>& children = ChildrenOf(node);
+        for (size_t i = children.size(); i-- > 0;) {
+            stack.push_back(Row{children[i], row.depth + 1});
+        }
+    }
+}
+
+bool XmlTreeView::RenderRow(const Row& row) {
+    if (const pugi::xml_attribute attribute = row.item.attribute()) {
+        const std::string_view value(attribute.value());
+        ImGui::TreeNodeEx(attribute.internal_object(), kLeafFlags, "@%s = \"%.*s%s\"", attribute.name(),
+                          PreviewLength(value), value.data(), Ellipsis(value));
+        return false;
+    }
+    const pugi::xml_node node = row.item.node();
+    const pugi::xml_node_type type = node.type();
+    if (type != pugi::node_element && type != pugi::node_document) {
+        RenderLeaf(node);
+        return false;
+    }
+    const void* id = node.internal_object();
+    if (!IsExpandable(node)) {
+        if (IsTextOnly(node)) {
+            const std::string_view text(node.child_value());
+            ImGui::TreeNodeEx(id, kLeafFlags, "<%s> %.*s%s", node.name(), PreviewLength(text), text.data(),
+                              Ellipsis(text));
+        } else {
+            ImGui::TreeNodeEx(id, kLeafFlags, "<%s />", node.name());
+        }
+        return false;
+    }
+
+    constexpr ImGuiTreeNodeFlags kBranchFlags =
+        ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_NoTreePushOnOpen | ImGuiTreeNodeFlags_SpanAvailWidth;
+    const char* name = type == pugi::node_document ? "document" : node.name();
+    const bool expanded = expanded_.count(id) != 0;
+    ImGui::SetNextItemOpen(expanded);
+    auto cached = children_.find(id);
+    bool open = false;
+    if (cached != children_.end()) {
+        open = ImGui::TreeNodeEx(id, kBranchFlags, "<%s> %zu rows", name, cached->second.size());
+    } else {
+        open = ImGui::TreeNodeEx(id, kBranchFlags, "<%s>...", name);
+    }
+    if (open == expanded) {
+        return false;
+    }
+    if (open) {
+        expanded_.insert(id);
+    } else {
+        expanded_.erase(id);
+    }
+    return true;
+}
+
+void XmlTreeView::Render(const char* id, const XmlDocumentLoader& documents) {
+    if (documents.latest() != document_) {
+        children_.clear();
+        expanded_.clear();
+        rows_.clear();
+        document_ = documents.latest();
+        if (document_) {
+            expanded_.insert(document_->dom.internal_object());
+            BuildRows();
+        }
+    }
+
+    ImGui::BeginChild(id, ImVec2(-1.0f, -1.0f), true);
+    if (documents.Loading()) {
+        ImGui::TextDisabled("Parsing... %.0f%%", documents.Fraction() * 100.0f);
+    } else if (!documents.error().empty()) {
+        ImGui::TextWrapped("Cannot build tree: %s", documents.error().c_str());
+    } else if (document_) {
+        const float indent = ImGui::GetStyle().IndentSpacing;
+        const float left = ImGui::GetCursorPosX();
+        bool toggled = false;
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(rows_.size()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                const Row& row = rows_[static_cast<size_t>(i)];
+                ImGui::SetCursorPosX(left + indent * static_cast<float>(row.depth));
+                toggled |= RenderRow(row);
+            }
+        }
+        clipper.End();
+        // Rebuilt after drawing so the clipper never sees the list change.
+        if (toggled) {
+            BuildRows();
+        }
+    }
+    ImGui::EndChild();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <pugixml.hpp>
+
+#include "xml_document.h"
+
+// Browses the DOM of an XmlDocument as nested elements, attributes, text
+// and other nodes. An element's attributes and children are looked up
+// once, on first expansion, and every open element contributes its lines
+// to one flat row list that a single clipper draws.
+class XmlTreeView {
+public:
+    // Draws the newest DOM in `documents`, or a note while it is being
+    // parsed or after parsing failed.
+    void Render(const char* id, const XmlDocumentLoader& documents);
+    void Clear();
+
+private:
+    struct Row {
+        pugi::xpath_node item; // An attribute or a node.
+        uint32_t depth = 0;
+    };
+
+    // Attributes first, then child nodes, in document order.
+    const std::vector<pugi::xpath_node>& ChildrenOf(const pugi::xml_node& node);
+    void BuildRows();
+    // Draws one line of the tree. True when a click opened or closed it.
+    bool RenderRow(const Row& row);
+
+    std::shared_ptr<const XmlDocument> document_;
+    std::unordered_map<const void*, std::vector<pugi::xpath_node>> children_;
+    std::unordered_set<const void*> expanded_;
+    std::vector<Row> rows_;
+};
@@ -0,0 +1,227 @@
+#include "xml_xpath_panel.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+constexpr size_t kMaxCachedQueries = 32;
+// Text longer than this is cut in the result rows.
+constexpr size_t kMaxPreviewChars = 120;
+
+// `text` cut for a result row, with a flag telling whether it was cut.
+std::string_view Preview(const char* text, bool& cut) {
+    std::string_view view(text);
+    cut = view.size() > kMaxPreviewChars;
+    return view.substr(0, kMaxPreviewChars);
+}
+
+void RenderMatch(size_t index, const pugi::xpath_node& match) {
+    bool cut = false;
+    if (const pugi::xml_attribute attribute = match.attribute()) {
+        const std::string_view value = Preview(attribute.value(), cut);
+        ImGui::Text("%zu  <%s> @%s=\"%.*s%s\"", index, match.parent().name(), attribute.name(),
+                    static_cast<int>(value.size()), value.data(), cut ? "..." : "");
+        return;
+    }
+    const pugi::xml_node node = match.node();
+    const long long offset = static_cast<long long>(node.offset_debug());
+    switch (node.type()) {
+        case pugi::node_element: {
+            const std::string_view text = Preview(node.child_value(), cut);
+            ImGui::Text("%zu  @%lld  <%s> %.*s%s", index, offset, node.name(), static_cast<int>(text.size()),
+                        text.data(), cut ? "..." : "");
+            break;
+        }
+        case pugi::node_pcdata:
+        case pugi::node_cdata: {
+            const std::string_view text = Preview(node.value(), cut);
+            ImGui::Text("%zu  @%lld  \"%.*s%s\"", index, offset, static_cast<int>(text.size()), text.data(),
+                        cut ? "..." : "");
+            break;
+        }
+        case pugi::node_comment: {
+            const std::string_view text = Preview(node.value(), cut);
+            ImGui::Text("%zu  @%lld  <!--%.*s%s-->", index, offset, static_cast<int>(text.size()), text.data(),
+                        cut ? "..." : "");
+            break;
+        }
+        case pugi::node_pi: {
+            const std::string_view text = Preview(node.value(), cut);
+            ImGui::Text("%zu  @%lld  <?%s %.*s%s?>", index, offset, node.name(), static_cast<int>(text.size()),
+                        text.data(), cut ? "..." : "");
+            break;
+        }
+        case pugi::node_document:
+            ImGui::Text("%zu  (document)", index);
+            break;
+        default:
+            ImGui::Text("%zu  @%lld  %s", index, offset, node.name());
+            break;
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const pugi::xpath_query> XPathQueryCache::Get(const std::string& text,
+                                                               bool& hit,
+                                                               std::string& error) {
+    const size_t hash = std::hash<std::string>{}(text);
+    ++clock_;
+    for (Entry& entry : entries_) {
+        if (entry.hash == hash && entry.text == text) {
+            entry.last_use = clock_;
+            hit = true;
+            return entry.query;
+        }
+    }
+    hit = false;
+    std::shared_ptr<pugi::xpath_query> query;
+#ifndef PUGIXML_NO_EXCEPTIONS
+    try {
+        query = std::make_shared<pugi::xpath_query>(text.c_str());
+    } catch (const pugi::xpath_exception& e) {
+        char message[192];
+        std::snprintf(message, sizeof(message), "%s at column %lld", e.result().description(),
+                      static_cast<long long>(e.result().offset) + 1);
+        error = message;
+        return nullptr;
+    }
+#else
+    query = std::make_shared<pugi::xpath_query>(text.c_str());
+#endif
+    if (!*query) {
+        char message[192];
+        std::snprintf(message, sizeof(message), "%s at column %lld", query->result().description(),
+                      static_cast<long long>(query->result().offset) + 1);
+        error = message;
+        return nullptr;
+    }
+    if (entries_.size() >= kMaxCachedQueries) {
+        entries_.erase(std::min_element(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+            return a.last_use < b.last_use;
+        }));
+    }
+    entries_.push_back(Entry{hash, text, query, clock_});
+    return query;
+}
+
+void XPathQueryCache::Clear() {
+    entries_.clear();
+}
+
+void XmlXPathPanel::Start(std::shared_ptr<const XmlDocument> document) {
+    std::shared_ptr<const pugi::xpath_query> query = std::move(pending_);
+    queried_ = document;
+    compile_note_ = pending_cached_ ? " (cached query)" : "";
+    query_job_.Start(0, [document, query](JobContext&) {
+        QueryOutput output;
+        const auto start = std::chrono::steady_clock::now();
+        if (query->return_type() == pugi::xpath_type_node_set) {
+            output.nodes = query->evaluate_node_set(document->dom);
+        } else {
+            output.scalar = true;
+            output.value = query->evaluate_string(document->dom);
+        }
+        output.milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return output;
+    });
+}
+
+void XmlXPathPanel::Clear() {
+    query_job_.Cancel();
+    pending_.reset();
+    queried_.reset();
+    document_.reset();
+    nodes_ = pugi::xpath_node_set();
+    scalar_ = false;
+    value_.clear();
+    status_.clear();
+    compile_note_.clear();
+}
+
+bool XmlXPathPanel::Render(const char* id, const XmlDocumentLoader& documents, size_t revision) {
+    if (auto finished = query_job_.TakeResult()) {
+        document_ = queried_;
+        nodes_ = std::move(finished->nodes);
+        scalar_ = finished->scalar;
+        value_ = std::move(finished->value);
+        char buffer[160];
+        if (scalar_) {
+            std::snprintf(buffer, sizeof(buffer), "Evaluated in %.1f ms%s", finished->milliseconds,
+                          compile_note_.c_str());
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "%zu matches in %.1f ms%s", nodes_.size(),
+                          finished->milliseconds, compile_note_.c_str());
+        }
+        status_ = buffer;
+    }
+
+    ImGui::PushID(id);
+    ImGui::SetNextItemWidth(-120.0f);
+    bool run = ImGui::InputTextWithHint("##XPath", "//item[@id]/name", query_, sizeof(query_),
+                                        ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::SameLine();
+    run |= ImGui::Button("Run XPath");
+    if (run) {
+        bool hit = false;
+        std::string error;
+        pending_ = cache_.Get(query_, hit, error);
+        if (pending_) {
+            pending_cached_ = hit;
+            status_.clear();
+        } else {
+            status_ = "XPath error: " + error;
+        }
+    }
+
+    // Evaluation cannot be interrupted, so a query submitted while another
+    // runs waits for it instead of starting a second worker; only the
+    // latest one waits.
+    bool needs_document = false;
+    if (pending_ && !query_job_.Running()) {
+        if (auto document = documents.Get(revision)) {
+            Start(std::move(document));
+        } else if (!documents.Loading() && !documents.Needs(revision)) {
+            pending_.reset();
+            status_ = "Cannot query: " + documents.error();
+        } else {
+            needs_document = true;
+        }
+    }
+
+    if (pending_ && documents.Loading()) {
+        ImGui::TextDisabled("Parsing document...");
+    } else if (query_job_.Running()) {
+        ImGui::TextDisabled("Evaluating...");
+    } else if (!status_.empty()) {
+        ImGui::TextWrapped("%s", status_.c_str());
+    }
+
+    ImGui::BeginChild("Results", ImVec2(-1.0f, -1.0f), true);
+    if (document_ && !query_job_.Running()) {
+        if (scalar_) {
+            ImGui::TextWrapped("%s", value_.c_str());
+        } else {
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(nodes_.size()));
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                    RenderMatch(static_cast<size_t>(i), nodes_[static_cast<size_t>(i)]);
+                }
+            }
+            clipper.End();
+        }
+    }
+    ImGui::EndChild();
+    ImGui::PopID();
+    return needs_document;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pugixml.hpp>
+
+#include "background_job.h"
+#include "xml_document.h"
+
+// Compiled XPath queries keyed by a hash of their text, so running an
+// expression again skips compiling it. Least recently used entries are
+// dropped past a few dozen queries.
+class XPathQueryCache {
+public:
+    // Returns the compiled query for `text`, compiling it on a miss. `hit`
+    // tells whether it came from the cache.
+    std::shared_ptr<const pugi::xpath_query> Get(const std::string& text, bool& hit, std::string& error);
+    void Clear();
+
+private:
+    struct Entry {
+        size_t hash = 0;
+        std::string text;
+        std::shared_ptr<const pugi::xpath_query> query;
+        uint64_t last_use = 0;
+    };
+
+    std::vector<Entry> entries_;
+    uint64_t clock_ = 0;
+};
+
+// XPath bar with a clipped list of matching nodes and attributes. Queries
+// are evaluated on a worker thread against the shared parsed document, so
+// a slow "//" query never holds up a frame and re-running one does not
+// parse the input again.
+class XmlXPathPanel {
+public:
+    // Draws the panel. A submitted expression runs as soon as `documents`
+    // holds the DOM of `revision`; until then the result is true, telling
+    // the caller to Load() one.
+    bool Render(const char* id, const XmlDocumentLoader& documents, size_t revision);
+    void Clear();
+
+private:
+    struct QueryOutput {
+        pugi::xpath_node_set nodes;
+        // Result of an expression yielding a number, string or boolean.
+        bool scalar = false;
+        std::string value;
+        double milliseconds = 0.0;
+    };
+
+    void Start(std::shared_ptr<const XmlDocument> document);
+
+    char query_[512] = "//*";
+    std::string status_;
+    std::string compile_note_;
+    XPathQueryCache cache_;
+    // Submitted query waiting for the document or for the running query.
+    std::shared_ptr<const pugi::xpath_query> pending_;
+    bool pending_cached_ = false;
+    BackgroundJob<QueryOutput> query_job_;
+    // Document the running or last finished query was evaluated on; it
+    // keeps the matched nodes alive.
+    std::shared_ptr<const XmlDocument> queried_;
+    std::shared_ptr<const XmlDocument> document_;
+    pugi::xpath_node_set nodes_;
+    bool scalar_ = false;
+    std::string value_;
+};
@@ -0,0 +1,117 @@
+#include <string>
+
+#include "json_binary.h"
+#include "json_canonical.h"
+#include "output_sink.h"
+#include "random_json.h"
+#include "test_support.h"
+
+namespace {
+
+using namespace std::string_literals;
+
+std::string Encode(const std::string& json, BinaryFormat format, bool& ok) {
+    std::string bytes;
+    StringSink sink(bytes);
+    BinaryConversionStats stats;
+    ok = EncodeJsonBinary(json, format, sink, stats).ok;
+    return bytes;
+}
+
+std::string Decode(const std::string& bytes, BinaryFormat format, bool& ok) {
+    std::string json;
+    StringSink sink(json);
+    BinaryConversionStats stats;
+    ok = DecodeJsonBinary(bytes, format, JsonFormatOptions{}, true, sink, stats).ok;
+    return json;
+}
+
+// Numbers below the smallest subnormal are valid JSON and read as zero;
+// only overflow is an error.
+void Underflow() {
+    bool ok = false;
+    Check(Encode("4.9e-3240", BinaryFormat::Cbor, ok) == std::string("\xFA\x00\x00\x00\x00", 5) && ok,
+          "CBOR underflow encodes +0.0");
+    Check(Encode("-1e-400", BinaryFormat::MessagePack, ok) == std::string("\xCA\x80\x00\x00\x00", 5) && ok,
+          "MessagePack underflow encodes -0.0");
+    Check(Decode(Encode("[0.000001e-330]", BinaryFormat::Cbor, ok), BinaryFormat::Cbor, ok) == "[0]" && ok,
+          "underflow decodes as zero");
+    Encode("1e400", BinaryFormat::Cbor, ok);
+    Check(!ok, "overflow is rejected");
+    Encode("-123456789e305", BinaryFormat::MessagePack, ok);
+    Check(!ok, "negative overflow is rejected");
+}
+
+std::string Canonical(const std::string& json, bool& ok) {
+    std::string out;
+    StringSink sink(out);
+    ok = CanonicalizeJson(json, sink).ok;
+    return out;
+}
+
+// Decoding an encoded document gives the same JSON data model: equal
+// canonical forms. The bytes of a second encoding may differ, since a
+// float holding an integer decodes without a fraction and is then
+// encoded as an integer.
+void RoundTrip(BinaryFormat format) {
+    const char* const name = format == BinaryFormat::Cbor ? "CBOR" : "MessagePack";
+    RandomJson random(format == BinaryFormat::Cbor ? 17 : 18);
+    int compared = 0;
+    for (int i = 0; i < 20000; ++i) {
+        const std::string input = random.Document();
+        bool encoded = false;
+        bool decoded = false;
+        const std::string json = Decode(Encode(input, format, encoded), format, decoded);
+        if (!encoded || !decoded) {
+            Check(false, (std::string(name) + " document " + std::to_string(i) + " converts both ways").c_str());
+            return;
+        }
+        // Generated objects may repeat a key, which has no canonical form.
+        bool canonical = false;
+        const std::string expected = Canonical(input, canonical);
+        if (!canonical) {
+            continue;
+        }
+        if (Canonical(json, canonical) != expected || !canonical) {
+            Check(false, (std::string(name) + " document " + std::to_string(i) + " keeps its values").c_str());
+            return;
+        }
+        ++compared;
+    }
+    Check(compared > 10000, "most generated documents have a canonical form");
+}
+
+// Encodings from RFC 8949 appendix A that the encoder never produces.
+void CborVectors() {
+    const std::string cases[][2] = {
+        {"\x19\x03\xe8", "1000"},
+        {"\x3b\xff\xff\xff\xff\xff\xff\xff\xff", "-18446744073709551616"},
+        {"\xf9\x3e\x00"s, "1.5"},
+        {"\xf9\x7c\x00"s, "null"},
+        {"\xfa\x47\xc3\x50\x00"s, "1e+05"},
+        {"\xc1\x1a\x51\x4b\x67\xb0", "1363896240"},
+        {"\x44\x01\x02\x03\x04", "\"AQIDBA==\""},
+        {"\x62\xc3\xbc", "\"\xc3\xbc\""},
+        {"\x9f\x01\x82\x02\x03\x9f\x04\x05\xff\xff", "[1,[2,3],[4,5]]"},
+        {"\xbf\x61\x61\x01\x61\x62\x9f\x02\x03\xff\xff", "{\"a\":1,\"b\":[2,3]}"},
+        {"\x7f\x65\x73\x74\x72\x65\x61\x64\x6d\x69\x6e\x67\xff", "\"streaming\""},
+        {"\xa2\x01\x02\x03\x04", "{\"1\":2,\"3\":4}"},
+    };
+    for (const auto& pair : cases) {
+        bool ok = false;
+        const std::string got = Decode(pair[0], BinaryFormat::Cbor, ok);
+        if (!ok || got != pair[1]) {
+            Check(false, ("CBOR vector decodes to " + pair[1] + ", got " + got).c_str());
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    Underflow();
+    RoundTrip(BinaryFormat::Cbor);
+    RoundTrip(BinaryFormat::MessagePack);
+    CborVectors();
+    return FinishTest("json_binary_test");
+}
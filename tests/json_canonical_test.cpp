@@ -0,0 +1,126 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "json_canonical.h"
+#include "output_sink.h"
+#include "test_support.h"
+
+namespace {
+
+// Appendix B of RFC 8785: IEEE 754 bit patterns and their canonical text.
+// The two non-finite entries of the appendix have no JSON token to start
+// from and are left out.
+struct NumberVector {
+    uint64_t bits;
+    const char* canonical;
+};
+
+const NumberVector kNumberVectors[] = {
+    {0x0000000000000000, "0"},
+    {0x8000000000000000, "0"},
+    {0x0000000000000001, "5e-324"},
+    {0x8000000000000001, "-5e-324"},
+    {0x7fefffffffffffff, "1.7976931348623157e+308"},
+    {0xffefffffffffffff, "-1.7976931348623157e+308"},
+    {0x4340000000000000, "9007199254740992"},
+    {0xc340000000000000, "-9007199254740992"},
+    {0x4430000000000000, "295147905179352830000"},
+    {0x44b52d02c7e14af5, "9.999999999999997e+22"},
+    {0x44b52d02c7e14af6, "1e+23"},
+    {0x44b52d02c7e14af7, "1.0000000000000001e+23"},
+    {0x444b1ae4d6e2ef4e, "999999999999999700000"},
+    {0x444b1ae4d6e2ef4f, "999999999999999900000"},
+    {0x444b1ae4d6e2ef50, "1e+21"},
+    {0x3eb0c6f7a0b5ed8c, "9.999999999999997e-7"},
+    {0x3eb0c6f7a0b5ed8d, "0.000001"},
+    {0x41b3de4355555553, "333333333.3333332"},
+    {0x41b3de4355555554, "333333333.33333325"},
+    {0x41b3de4355555555, "333333333.3333333"},
+    {0x41b3de4355555556, "333333333.3333334"},
+    {0x41b3de4355555557, "333333333.33333343"},
+    {0xbecbf647612f3696, "-0.0000033333333333333333"},
+    {0x43143ff3c1cb0959, "1424953923781206.2"},
+};
+
+std::string CanonicalNumber(const std::string& token, bool& ok) {
+    std::string out;
+    ok = AppendCanonicalNumber(token, out);
+    return out;
+}
+
+void NumberVectors() {
+    for (const NumberVector& vector : kNumberVectors) {
+        double value = 0.0;
+        std::memcpy(&value, &vector.bits, sizeof(value));
+        // 17 significant digits read back to the same double.
+        char token[40];
+        std::snprintf(token, sizeof(token), "%.17g", value);
+        bool ok = false;
+        const std::string got = CanonicalNumber(token, ok);
+        if (!ok || got != vector.canonical) {
+            Check(false, (std::string(token) + " canonicalizes to " + vector.canonical + ", got " + got).c_str());
+        }
+    }
+}
+
+void NumberSpellings() {
+    const char* const cases[][2] = {
+        {"1E2", "100"},    {"-0", "0"},       {"-0.0e5", "0"},  {"0.1e-400", "0"}, {"1.0", "1"},
+        {"4.50", "4.5"},   {"2e-3", "0.002"}, {"1E30", "1e+30"}, {"1e21", "1e+21"}, {"1e20", "100000000000000000000"},
+        {"0.000001", "0.000001"}, {"1e-7", "1e-7"}, {"123456789012345678901234567890", "1.2345678901234568e+29"},
+    };
+    for (const auto& pair : cases) {
+        bool ok = false;
+        const std::string got = CanonicalNumber(pair[0], ok);
+        if (!ok || got != pair[1]) {
+            Check(false, (std::string(pair[0]) + " canonicalizes to " + pair[1] + ", got " + got).c_str());
+        }
+    }
+    bool ok = true;
+    CanonicalNumber("1e400", ok);
+    Check(!ok, "overflow has no canonical form");
+    CanonicalNumber("-1e400", ok);
+    Check(!ok, "negative overflow has no canonical form");
+}
+
+std::string Canonicalize(const std::string& input, JsonFormatResult& result) {
+    std::string out;
+    StringSink sink(out);
+    result = CanonicalizeJson(input, sink);
+    return out;
+}
+
+void Documents() {
+    JsonFormatResult result;
+    // RFC 8785, section 3.2.2.
+    const std::string example = Canonicalize(
+        R"({"numbers": [333333333.33333329, 1E30, 4.50, 2e-3, 0.000000000000000000000000001],)"
+        R"( "string": "\u20ac$\u000F\u000aA'\u0042\u0022\u005c\\\"\/", "literals": [null, true, false]})",
+        result);
+    Check(result.ok && example == "{\"literals\":[null,true,false],"
+                                  "\"numbers\":[333333333.3333333,1e+30,4.5,0.002,1e-27],"
+                                  "\"string\":\"\xE2\x82\xAC$\\u000f\\nA'B\\\"\\\\\\\\\\\"/\"}",
+          "RFC 8785 section 3.2.2 example");
+    // RFC 8785, section 3.2.3: members sort by UTF-16 code units, so the
+    // emoji's surrogate pair comes before U+FB33.
+    const std::string sorted = Canonicalize(
+        R"({"\u20ac": 1, "\r": 2, "\ufb33": 3, "1": 4, "\ud83d\ude00": 5, "\u0080": 6, "\u00f6": 7})", result);
+    Check(result.ok && sorted == "{\"\\r\":2,\"1\":4,\"\xC2\x80\":6,\"\xC3\xB6\":7,\"\xE2\x82\xAC\":1,"
+                                 "\"\xF0\x9F\x98\x80\":5,\"\xEF\xAC\xB3\":3}",
+          "RFC 8785 section 3.2.3 member order");
+    Canonicalize(R"({"a": 1, "\u0061": 2})", result);
+    Check(!result.ok, "duplicate member names are rejected");
+    Canonicalize(R"(["\ud800"])", result);
+    Check(!result.ok, "lone surrogates are rejected");
+}
+
+} // namespace
+
+int main() {
+    NumberVectors();
+    NumberSpellings();
+    Documents();
+    return FinishTest("json_canonical_test");
+}
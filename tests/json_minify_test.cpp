@@ -0,0 +1,77 @@
+#include <string>
+
+#include "json_structural_index.h"
+#include "output_sink.h"
+#include "random_json.h"
+#include "test_support.h"
+
+namespace {
+
+// Byte-at-a-time reference: drops whitespace outside strings.
+std::string ReferenceMinify(const std::string& input) {
+    std::string out;
+    bool in_string = false;
+    bool escaped = false;
+    for (const char c : input) {
+        if (in_string) {
+            out.push_back(c);
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+            }
+        } else if (c == '"') {
+            in_string = true;
+            out.push_back(c);
+        } else if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+std::string Minify(const std::string& input) {
+    std::string out;
+    StringSink sink(out);
+    Check(MinifyJson(input, sink), "minify is not cancelled");
+    sink.Finish();
+    return out;
+}
+
+void RandomDocuments() {
+    RandomJson random(7);
+    for (int i = 0; i < 20000; ++i) {
+        const std::string input = random.Document();
+        if (Minify(input) != ReferenceMinify(input)) {
+            Check(false, ("random document " + std::to_string(i) + " minifies like the reference").c_str());
+            return;
+        }
+    }
+}
+
+// Quotes and backslash runs placed on every position around the
+// classifier's 64-byte block boundaries.
+void BlockBoundaries() {
+    for (size_t pad = 0; pad < 130; ++pad) {
+        for (size_t run = 0; run <= 5; ++run) {
+            std::string input = "[" + std::string(pad, ' ') + "\"" + std::string(pad % 7, 'x');
+            input += std::string(2 * run, '\\') + "\\\" , \"" + std::string(run, ' ') + "\" ,\t1 ]";
+            if (Minify(input) != ReferenceMinify(input)) {
+                Check(false, ("block boundary case pad " + std::to_string(pad) + " run " + std::to_string(run) +
+                              " minifies like the reference")
+                                 .c_str());
+                return;
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    RandomDocuments();
+    BlockBoundaries();
+    return FinishTest("json_minify_test");
+}
@@ -0,0 +1,57 @@
+#include <string>
+
+#include "json_stream_formatter.h"
+#include "output_sink.h"
+#include "parallel_for.h"
+#include "random_json.h"
+#include "test_support.h"
+
+namespace {
+
+std::string Format(const std::string& input, bool parallel, JsonFormatResult& result) {
+    std::string out;
+    StringSink sink(out);
+    result = parallel ? FormatJsonParallel(input, JsonFormatOptions{}, sink)
+                      : FormatJsonStream(input, JsonFormatOptions{}, sink);
+    return out;
+}
+
+// Roots of about 12 MB, so the input is cut into a dozen slices that
+// several waves of workers format.
+void MatchesStream() {
+    RandomJson random(12);
+    for (int round = 0; round < 4; ++round) {
+        const std::string input = random.LargeContainer(round % 2 == 0, (12 << 20) + random.Below(1 << 20), 4);
+        JsonFormatResult streamed;
+        JsonFormatResult parallel;
+        const std::string expected = Format(input, false, streamed);
+        const std::string got = Format(input, true, parallel);
+        Check(streamed.ok && parallel.ok, "large root formats");
+        Check(got == expected, "parallel output matches FormatJsonStream byte for byte");
+    }
+}
+
+// An error inside a slice past the first is reported exactly as the
+// sequential formatter reports it.
+void ErrorInLaterSlice() {
+    RandomJson random(13);
+    std::string input = random.LargeContainer(false, 12 << 20, 4);
+    const size_t comma = input.find(",", input.size() - input.size() / 4);
+    input.insert(comma, ",");
+    JsonFormatResult streamed;
+    JsonFormatResult parallel;
+    Format(input, false, streamed);
+    Format(input, true, parallel);
+    Check(!streamed.ok && !parallel.ok, "doubled comma is rejected");
+    Check(parallel.error == streamed.error && parallel.error_offset == streamed.error_offset,
+          "parallel error matches the sequential one");
+}
+
+} // namespace
+
+int main() {
+    WorkerCountOverride() = 3;
+    MatchesStream();
+    ErrorInLaterSlice();
+    return FinishTest("json_parallel_test");
+}
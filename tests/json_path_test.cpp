@@ -0,0 +1,168 @@
+#include <string>
+#include <vector>
+
+#include "json_path.h"
+#include "json_tape.h"
+#include "test_support.h"
+
+namespace {
+
+// The example document of RFC 9535, section 1.5.
+const char* const kStore = R"({ "store": {
+    "book": [
+      { "category": "reference",
+        "author": "Nigel Rees",
+        "title": "Sayings of the Century",
+        "price": 8.95
+      },
+      { "category": "fiction",
+        "author": "Evelyn Waugh",
+        "title": "Sword of Honour",
+        "price": 12.99
+      },
+      { "category": "fiction",
+        "author": "Herman Melville",
+        "title": "Moby Dick",
+        "isbn": "0-553-21311-3",
+        "price": 8.99
+      },
+      { "category": "fiction",
+        "author": "J. R. R. Tolkien",
+        "title": "The Lord of the Rings",
+        "isbn": "0-395-19395-8",
+        "price": 22.99
+      }
+    ],
+    "bicycle": {
+      "color": "red",
+      "price": 399
+    }
+  },
+  "limit": 10
+})";
+
+// Compact text of the value at `entry`.
+void Render(const JsonTape& tape, uint32_t entry, std::string& out) {
+    const JsonKind kind = tape.kind(entry);
+    if (kind != JsonKind::Object && kind != JsonKind::Array) {
+        out += tape.Token(entry);
+        return;
+    }
+    out.push_back(kind == JsonKind::Object ? '{' : '[');
+    bool first = true;
+    for (const uint32_t child : tape.Children(entry)) {
+        if (!first) {
+            out.push_back(',');
+        }
+        first = false;
+        Render(tape, child, out);
+        if (kind == JsonKind::Object) {
+            out.push_back(':');
+            Render(tape, child + 1, out);
+        }
+    }
+    out.push_back(kind == JsonKind::Object ? '}' : ']');
+}
+
+// Runs `expression` over `document` and returns the matches, each
+// rendered compactly and followed by a space.
+std::string Query(const std::string& document, const char* expression) {
+    JsonTape tape;
+    std::string error;
+    if (!tape.Build(document, error)) {
+        return "document error: " + error;
+    }
+    JsonPath path;
+    if (!path.Compile(expression, error)) {
+        return "error";
+    }
+    std::vector<uint32_t> matches;
+    path.Evaluate(tape, matches);
+    std::string out;
+    for (const uint32_t entry : matches) {
+        Render(tape, entry, out);
+        out.push_back(' ');
+    }
+    return out;
+}
+
+void Expect(const std::string& document, const char* expression, const std::string& expected) {
+    const std::string got = Query(document, expression);
+    if (got != expected) {
+        Check(false, (std::string(expression) + " gives [" + expected + "], got [" + got + "]").c_str());
+    }
+}
+
+void Bookstore() {
+    Expect(kStore, "$.store.book[*].author",
+           R"("Nigel Rees" "Evelyn Waugh" "Herman Melville" "J. R. R. Tolkien" )");
+    Expect(kStore, "$..author", R"("Nigel Rees" "Evelyn Waugh" "Herman Melville" "J. R. R. Tolkien" )");
+    Expect(kStore, "$.store.*..price", "8.95 12.99 8.99 22.99 399 ");
+    Expect(kStore, "$..book[2].title", R"("Moby Dick" )");
+    Expect(kStore, "$..book[-1].title", R"("The Lord of the Rings" )");
+    Expect(kStore, "$..book[0,1].title", R"("Sayings of the Century" "Sword of Honour" )");
+    Expect(kStore, "$..book[:2].title", R"("Sayings of the Century" "Sword of Honour" )");
+    Expect(kStore, "$..book[?@.isbn].title", R"("Moby Dick" "The Lord of the Rings" )");
+    Expect(kStore, "$..book[?@.price<10].title", R"("Sayings of the Century" "Moby Dick" )");
+    Expect(kStore, "$..book[?(@.price < $.limit)].price", "8.95 8.99 ");
+    Expect(kStore, "$['store']['bicycle']['color']", R"("red" )");
+    Expect(kStore, "$.store.bicycle", R"({"color":"red","price":399} )");
+}
+
+void Selectors() {
+    const std::string array = "[0, 1, 2, 3, 4, 5, 6, 7, 8, 9]";
+    Expect(array, "$[1:3]", "1 2 ");
+    Expect(array, "$[5:]", "5 6 7 8 9 ");
+    Expect(array, "$[::3]", "0 3 6 9 ");
+    Expect(array, "$[::-4]", "9 5 1 ");
+    Expect(array, "$[-2:]", "8 9 ");
+    Expect(array, "$[3:1]", "");
+    Expect(array, "$[0:10:0]", "");
+    Expect(array, "$[12]", "");
+    Expect(array, "$[-1, 0, -1]", "9 0 9 ");
+    Expect(R"({"a": {"b": 1}, "c": [{"b": 2}]})", "$..b", "1 2 ");
+    Expect(R"({"a b": 1, "é": 2})", "$['a b', 'é']", "1 2 ");
+    Expect(R"({"o": {"j": 1, "k": 2}})", "$.o.*", "1 2 ");
+    Expect("7", "$", "7 ");
+}
+
+void Filters() {
+    const std::string items = R"([{"a": 1}, {"a": 2, "b": "x"}, {"a": "1"}, {"b": null}, {"a": [1]}, {"a": true}])";
+    Expect(items, "$[?@.a == 1]", R"({"a":1} )");
+    Expect(items, "$[?@.a != 1]", R"({"a":2,"b":"x"} {"a":"1"} {"b":null} {"a":[1]} {"a":true} )");
+    Expect(items, "$[?@.a >= 2]", R"({"a":2,"b":"x"} )");
+    Expect(items, "$[?@.a <= 1]", R"({"a":1} )");
+    Expect(items, "$[?@.a < '2']", R"({"a":"1"} )");
+    Expect(items, "$[?@.b == null]", R"({"b":null} )");
+    Expect(items, "$[?@.a && @.b]", R"({"a":2,"b":"x"} )");
+    Expect(items, "$[?@.a == 1 || @.b == 'x']", R"({"a":1} {"a":2,"b":"x"} )");
+    Expect(items, "$[?!@.a]", R"({"b":null} )");
+    Expect(items, "$[?@.a == true]", R"({"a":true} )");
+    // A missing operand equals nothing, so <= and >= cannot hold either.
+    Expect(items, "$[?@.missing <= 1]", "");
+    Expect(items, "$[?@.missing >= 1]", "");
+    Expect(items, "$[?@.missing == @.other]", R"({"a":1} {"a":2,"b":"x"} {"a":"1"} {"b":null} {"a":[1]} {"a":true} )");
+    Expect(items, "$[?@.missing <= @.other]", R"({"a":1} {"a":2,"b":"x"} {"a":"1"} {"b":null} {"a":[1]} {"a":true} )");
+    Expect(items, "$[?@.a == $[0].a]", R"({"a":1} )");
+}
+
+void Syntax() {
+    const char* const bad[] = {"", "store", "$.", "$[", "$[1", "$['a]", "$[?@.a ==]", "$[?@.a <> 1]", "$[1:2:3:4]"};
+    for (const char* expression : bad) {
+        JsonPath path;
+        std::string error;
+        if (path.Compile(expression, error) || error.empty()) {
+            Check(false, (std::string("'") + expression + "' is rejected with a message").c_str());
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    Bookstore();
+    Selectors();
+    Filters();
+    Syntax();
+    return FinishTest("json_path_test");
+}
@@ -0,0 +1,70 @@
+#include <string>
+
+#include "json_pattern.h"
+#include "json_schema.h"
+#include "test_support.h"
+
+namespace {
+
+std::string Quoted(std::string text) {
+    return "\"" + text + "\"";
+}
+
+// Strings of 100 KB and more used to overflow the stack inside
+// std::regex_search, which recurses once per character.
+void LongStringPattern() {
+    JsonSchema schema;
+    std::string error;
+    Check(schema.Compile(R"({"type": "string", "pattern": "^[a-z]*$"})", error), "compile pattern schema");
+    for (const size_t length : {size_t{100000}, size_t{1000000}}) {
+        Check(schema.Validate(Quoted(std::string(length, 'a'))).valid(), "long matching string is valid");
+        const JsonSchemaResult result = schema.Validate(Quoted(std::string(length, 'a') + "1"));
+        Check(!result.valid() && result.error_count == 1, "long mismatching string is invalid");
+    }
+}
+
+void EnumMemberOrder() {
+    JsonSchema schema;
+    std::string error;
+    Check(schema.Compile(R"({"enum": [{"a": 1, "b": {"x": [1, {"q": 2, "p": 3}], "y": 2}}]})", error),
+          "compile enum schema");
+    Check(schema.Validate(R"({"b": {"y": 2, "x": [1, {"p": 3, "q": 2}]}, "a": 1})").valid(),
+          "enum object matches in any member order");
+    Check(!schema.Validate(R"({"b": {"y": 2, "x": [{"p": 3, "q": 2}, 1]}, "a": 1})").valid(),
+          "enum array order still matters");
+}
+
+void FallbackPatternLimit() {
+    JsonPattern pattern;
+    std::string error;
+    Check(pattern.Compile("(a)\\1", error), "compile backreference pattern");
+    bool too_long = false;
+    Check(pattern.Search("xaa", too_long) && !too_long, "backreference matches short string");
+    Check(!pattern.Search(std::string(JsonPattern::kMaxFallbackInput + 1, 'a'), too_long) && too_long,
+          "backreference pattern refuses long string");
+}
+
+void PatternSyntax() {
+    JsonPattern pattern;
+    std::string error;
+    bool too_long = false;
+    Check(pattern.Compile("^[\\w.-]+@\\w+\\.(com|org)$", error), "compile email pattern");
+    Check(pattern.Search("jane.doe@mail.org", too_long), "email matches");
+    Check(!pattern.Search("jane@mail.net", too_long), "email with other domain does not match");
+    Check(pattern.Compile("\\bcat\\b", error), "compile word boundary pattern");
+    Check(pattern.Search("a cat sat", too_long) && !pattern.Search("concatenate", too_long), "word boundary");
+    Check(pattern.Compile("^.{2}$", error), "compile counted any");
+    Check(pattern.Search("\xC3\xA9\xC3\xA9", too_long), "dot matches code points");
+    Check(!pattern.Compile("(ab", error), "unclosed group is rejected");
+    Check(!pattern.Compile("a{3,1}", error), "reversed count is rejected");
+}
+
+} // namespace
+
+int main() {
+    LongStringPattern();
+    EnumMemberOrder();
+    FallbackPatternLimit();
+    PatternSyntax();
+    return FinishTest("json_schema_test");
+}
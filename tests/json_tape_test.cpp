@@ -0,0 +1,73 @@
+#include <string>
+
+#include "json_stream_formatter.h"
+#include "json_tape.h"
+#include "output_sink.h"
+#include "random_json.h"
+#include "test_support.h"
+
+namespace {
+
+std::string FormatStream(const std::string& input, int indent, JsonFormatResult& result) {
+    std::string out;
+    StringSink sink(out);
+    result = FormatJsonStream(input, JsonFormatOptions{indent}, sink);
+    return out;
+}
+
+// FormatJsonTape has to reproduce FormatJsonStream byte for byte.
+void TapeMatchesStream() {
+    RandomJson random(10);
+    for (int i = 0; i < 100000; ++i) {
+        const std::string input = random.Document();
+        const int indent = static_cast<int>(random.Below(3)) * 2;
+        JsonFormatResult streamed;
+        const std::string expected = FormatStream(input, indent, streamed);
+        JsonTape tape;
+        std::string error;
+        if (!streamed.ok || !tape.Build(input, error)) {
+            Check(false, ("generated document " + std::to_string(i) + " is accepted").c_str());
+            return;
+        }
+        std::string out;
+        StringSink sink(out);
+        if (!FormatJsonTape(tape, JsonFormatOptions{indent}, sink).ok || out != expected) {
+            Check(false, ("document " + std::to_string(i) + " formats the same from the tape").c_str());
+            return;
+        }
+    }
+}
+
+// A broken document fails to build a tape with the validator's message.
+void TapeRejectsLikeValidator() {
+    RandomJson random(11);
+    int rejected = 0;
+    for (int i = 0; i < 20000; ++i) {
+        std::string input = random.Document();
+        const size_t at = random.Below(static_cast<uint32_t>(input.size()));
+        static const char kNoise[] = {'"', ',', ':', '}', ']', '\\', '\x01', '-', 'e'};
+        if (random.Below(2) == 0) {
+            input.erase(at, 1);
+        } else {
+            input.insert(input.begin() + static_cast<std::ptrdiff_t>(at), kNoise[random.Below(sizeof(kNoise))]);
+        }
+        const JsonFormatResult validated = ValidateJson(input);
+        JsonTape tape;
+        std::string error;
+        const bool built = tape.Build(input, error);
+        if (built != validated.ok || (!built && error != validated.error)) {
+            Check(false, ("mutated document " + std::to_string(i) + " is judged like ValidateJson").c_str());
+            return;
+        }
+        rejected += built ? 0 : 1;
+    }
+    Check(rejected > 10000, "most mutations are rejected");
+}
+
+} // namespace
+
+int main() {
+    TapeMatchesStream();
+    TapeRejectsLikeValidator();
+    return FinishTest("json_tape_test");
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+// Random JSON documents for the equivalence tests: nested containers,
+// strings with escapes, runs of backslashes and multi-byte UTF-8, numbers
+// in every lexical form, and random whitespace wherever the grammar
+// allows it.
+class RandomJson {
+public:
+    explicit RandomJson(uint32_t seed) : rng_(seed) {}
+
+    // Mostly containers; one document in ten is a bare scalar.
+    std::string Document(int max_depth = 5) {
+        std::string out;
+        Space(out);
+        if (Below(10) == 0) {
+            Value(out, 0);
+        } else {
+            Container(out, Below(2) == 0, max_depth);
+        }
+        Space(out);
+        return out;
+    }
+
+    // A container root of at least `min_bytes`, for inputs large enough to
+    // be split.
+    std::string LargeContainer(bool object, size_t min_bytes, int max_depth = 3) {
+        std::string out(1, object ? '{' : '[');
+        for (size_t i = 0; out.size() < min_bytes; ++i) {
+            if (i > 0) {
+                out.push_back(',');
+            }
+            Space(out);
+            if (object) {
+                String(out);
+                Space(out);
+                out.push_back(':');
+                Space(out);
+            }
+            Value(out, max_depth);
+            Space(out);
+        }
+        out.push_back(object ? '}' : ']');
+        return out;
+    }
+
+    uint32_t Below(uint32_t n) {
+        return static_cast<uint32_t>(rng_() % n);
+    }
+
+    void Value(std::string& out, int depth) {
+        const uint32_t pick = depth <= 0 ? 2 + Below(5) : Below(8);
+        switch (pick) {
+            case 0:
+            case 1:
+            case 7:
+                Container(out, pick == 0, depth);
+                break;
+            case 2:
+            case 3:
+                String(out);
+                break;
+            case 4:
+            case 5:
+                Number(out);
+                break;
+            default: {
+                static const char* const kLiterals[] = {"true", "false", "null"};
+                out += kLiterals[Below(3)];
+                break;
+            }
+        }
+    }
+
+    void Container(std::string& out, bool object, int depth) {
+        out.push_back(object ? '{' : '[');
+        const uint32_t count = Below(7);
+        Space(out);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (i > 0) {
+                out.push_back(',');
+                Space(out);
+            }
+            if (object) {
+                String(out);
+                Space(out);
+                out.push_back(':');
+                Space(out);
+            }
+            Value(out, depth - 1);
+            Space(out);
+        }
+        out.push_back(object ? '}' : ']');
+    }
+
+    void String(std::string& out) {
+        static const char* const kPieces[] = {"a",      "key",    " ",      "\\\"", "\\\\", "\\n",  "\\t",
+                                              "\\/",    "\\u00e9", "\\u20AC", "\xC3\xA9", "\xE2\x82\xAC",
+                                              "\xF0\x9F\x98\x80", "\\ud83d\\ude00", "{", "]", ",", ":"};
+        out.push_back('"');
+        const uint32_t count = Below(4) == 0 ? Below(80) : Below(6);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (Below(16) == 0) {
+                // Runs of escaped backslashes, so odd and even runs land on
+                // every position of the scanner's 64-byte blocks.
+                out.append(2 * (1 + Below(8)), '\\');
+            } else {
+                out += kPieces[Below(sizeof(kPieces) / sizeof(kPieces[0]))];
+            }
+        }
+        out.push_back('"');
+    }
+
+    void Number(std::string& out) {
+        if (Below(2) == 0) {
+            out.push_back('-');
+        }
+        if (Below(6) == 0) {
+            out.push_back('0');
+        } else {
+            out.push_back(static_cast<char>('1' + Below(9)));
+            const uint32_t digits = Below(4) == 0 ? Below(22) : Below(5);
+            for (uint32_t i = 0; i < digits; ++i) {
+                out.push_back(static_cast<char>('0' + Below(10)));
+            }
+        }
+        if (Below(3) == 0) {
+            out.push_back('.');
+            const uint32_t digits = 1 + Below(8);
+            for (uint32_t i = 0; i < digits; ++i) {
+                out.push_back(static_cast<char>('0' + Below(10)));
+            }
+        }
+        if (Below(4) == 0) {
+            out.push_back(Below(2) == 0 ? 'e' : 'E');
+            const uint32_t sign = Below(3);
+            if (sign < 2) {
+                out.push_back(sign == 0 ? '+' : '-');
+            }
+            out += std::to_string(Below(280));
+        }
+    }
+
+    void Space(std::string& out) {
+        static const char kSpace[] = {' ', '\n', '\t', '\r'};
+        if (Below(3) == 0) {
+            const uint32_t count = Below(4) == 0 ? Below(70) : 1 + Below(3);
+            for (uint32_t i = 0; i < count; ++i) {
+                out.push_back(kSpace[Below(4)]);
+            }
+        }
+    }
+
+private:
+    std::mt19937 rng_;
+};
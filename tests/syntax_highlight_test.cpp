@@ -0,0 +1,135 @@
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "line_index.h"
+#include "syntax_highlight.h"
+#include "test_support.h"
+
+namespace {
+
+// Fragments that open and close the tokens carried across lines, so edits
+// often change the state of every later line and then restore it.
+const char* const kJsonPieces[] = {
+    "{", "}", "[", "]", ",", ":", "\n", "\n  ", "\"", "\"key\": ", "\"value\"",
+    "\\\"", "\\", "12", "-0.5e3", "true", "null", " ", "\r\n",
+};
+
+const char* const kXmlPieces[] = {
+    "<a>", "</a>", "<b x=\"1\"", "/>", ">", "<", "\n", "\n  ", "<!--", "-->",
+    "<![CDATA[", "]]>", "&amp;", "<?pi ", "?>", "<!DOCTYPE r>", "text", "'", "\"", " ",
+};
+
+template <size_t N>
+std::string RandomText(std::mt19937& rng, const char* const (&pieces)[N], size_t count) {
+    std::string text;
+    for (size_t i = 0; i < count; ++i) {
+        text += pieces[rng() % N];
+    }
+    return text;
+}
+
+bool SameSpans(const SyntaxIndex& updated, const SyntaxIndex& built, std::string_view text, const LineIndex& lines) {
+    std::vector<SyntaxSpan> a;
+    std::vector<SyntaxSpan> b;
+    for (size_t line = 0; line < lines.line_count(); ++line) {
+        const std::string_view content = lines.Line(text, line);
+        updated.LexLine(line, content, a);
+        built.LexLine(line, content, b);
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].begin != b[i].begin || a[i].end != b[i].end || a[i].token != b[i].token) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Applies a chain of random inserts, deletes and replacements, updating
+// one index incrementally and checking it against a fresh Build after
+// every edit.
+template <size_t N>
+void RandomEdits(SyntaxLanguage language, const char* const (&pieces)[N], unsigned seed) {
+    const char* const name = language == SyntaxLanguage::Json ? "JSON" : "XML";
+    std::mt19937 rng(seed);
+    for (int round = 0; round < 200; ++round) {
+        std::string text = RandomText(rng, pieces, 20 + rng() % 200);
+        LineIndex lines;
+        lines.Build(text);
+        SyntaxIndex index;
+        index.Build(language, text, lines);
+        for (int edit = 0; edit < 40; ++edit) {
+            std::string edited = text;
+            const size_t at = edited.empty() ? 0 : rng() % (edited.size() + 1);
+            const size_t erase = rng() % 3 == 0 ? 0 : rng() % 12;
+            edited.erase(at, erase);
+            if (rng() % 4 != 0) {
+                edited.insert(at, RandomText(rng, pieces, 1 + rng() % 4));
+            }
+            LineIndex edited_lines;
+            edited_lines.Build(edited);
+            index.Update(text, lines, edited, edited_lines);
+
+            SyntaxIndex built;
+            built.Build(language, edited, edited_lines);
+            if (!SameSpans(index, built, edited, edited_lines)) {
+                Check(false, (std::string(name) + " update matches a rebuild, round " + std::to_string(round) +
+                              " edit " + std::to_string(edit))
+                                 .c_str());
+                return;
+            }
+            text = std::move(edited);
+            lines = std::move(edited_lines);
+        }
+    }
+}
+
+// An edit that leaves the state of the next line unchanged lexes just the
+// edited line, however long the buffer.
+void LocalEdit() {
+    std::string text = "[\n";
+    for (int i = 0; i < 10000; ++i) {
+        text += "  {\"id\": " + std::to_string(i) + ", \"name\": \"item\"},\n";
+    }
+    text += "  {}\n]\n";
+    LineIndex lines;
+    lines.Build(text);
+    SyntaxIndex index;
+    index.Build(SyntaxLanguage::Json, text, lines);
+
+    std::string edited = text;
+    edited.replace(edited.find("\"item\"", text.size() / 2), 6, "\"renamed\"");
+    LineIndex edited_lines;
+    edited_lines.Build(edited);
+    Check(index.Update(text, lines, edited, edited_lines) <= 2, "a local edit lexes only its own lines");
+
+    // An XML comment left open changes the state of every later line.
+    std::string xml = "<r>\n";
+    for (int i = 0; i < 1000; ++i) {
+        xml += "  <item n=\"" + std::to_string(i) + "\"/>\n";
+    }
+    xml += "</r>\n";
+    LineIndex xml_lines;
+    xml_lines.Build(xml);
+    SyntaxIndex xml_index;
+    xml_index.Build(SyntaxLanguage::Xml, xml, xml_lines);
+    std::string commented = xml;
+    commented.insert(xml_lines.LineStart(10), "<!--");
+    LineIndex commented_lines;
+    commented_lines.Build(commented);
+    Check(xml_index.Update(xml, xml_lines, commented, commented_lines) > 900,
+          "an unclosed XML comment relexes every later line");
+}
+
+} // namespace
+
+int main() {
+    RandomEdits(SyntaxLanguage::Json, kJsonPieces, 31);
+    RandomEdits(SyntaxLanguage::Xml, kXmlPieces, 32);
+    LocalEdit();
+    return FinishTest("syntax_highlight_test");
+}
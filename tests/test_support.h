@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal check-and-count harness shared by the test executables: each
+// failed Check() prints what was expected and the process exits nonzero.
+
+inline int& TestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void Check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        ++TestFailures();
+    }
+}
+
+// Prints the summary line; returns the exit code for main().
+inline int FinishTest(const char* name) {
+    if (TestFailures() == 0) {
+        std::printf("%s: all checks passed\n", name);
+        return 0;
+    }
+    std::fprintf(stderr, "%s: %d checks failed\n", name, TestFailures());
+    return 1;
+}
@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test_support.h"
+#include "text_search.h"
+
+namespace {
+
+char Fold(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Left-to-right scan that restarts after each match, so matches do not
+// overlap.
+std::vector<size_t> ReferenceFind(const std::string& text, const std::string& needle, bool match_case) {
+    std::vector<size_t> found;
+    if (needle.empty()) {
+        return found;
+    }
+    for (size_t i = 0; i + needle.size() <= text.size();) {
+        size_t k = 0;
+        while (k < needle.size() &&
+               (match_case ? text[i + k] == needle[k] : Fold(text[i + k]) == Fold(needle[k]))) {
+            ++k;
+        }
+        if (k == needle.size()) {
+            found.push_back(i);
+            i += needle.size();
+        } else {
+            ++i;
+        }
+    }
+    return found;
+}
+
+// Small alphabets, so matches, near misses and overlaps are common;
+// includes both cases and bytes that only differ from letters in bit 5.
+void RandomTexts() {
+    std::mt19937 rng(13);
+    static const char kAlphabet[] = {'a', 'A', 'b', 'B', '@', '`', '[', '{', '\xC3', '\xA9', '\n', ' '};
+    for (int i = 0; i < 20000; ++i) {
+        const size_t alphabet = 2 + rng() % sizeof(kAlphabet);
+        std::string text(rng() % 300, ' ');
+        for (char& c : text) {
+            c = kAlphabet[rng() % alphabet];
+        }
+        std::string needle(1 + rng() % (rng() % 4 == 0 ? 40 : 4), ' ');
+        for (char& c : needle) {
+            c = kAlphabet[rng() % alphabet];
+        }
+        const bool match_case = rng() % 2 == 0;
+        const TextSearchResult result = FindText(text, needle, match_case);
+        const std::vector<size_t> expected = ReferenceFind(text, needle, match_case);
+        if (result.matches != expected || result.count != expected.size()) {
+            Check(false, ("random search " + std::to_string(i) + " matches the reference").c_str());
+            return;
+        }
+    }
+}
+
+void Basics() {
+    Check(FindText("aaaa", "aa", true).matches == std::vector<size_t>{0, 2}, "matches do not overlap");
+    Check(FindText("Hello HELLO hello", "hello", false).count == 3, "case-insensitive search folds ASCII");
+    Check(FindText("Hello HELLO hello", "hello", true).matches == std::vector<size_t>{12}, "case-sensitive search");
+    Check(FindText("\xC3\xA9", "\xC3\x89", false).count == 0, "non-ASCII bytes are not folded");
+    Check(FindText("abc", "", true).count == 0, "empty needle finds nothing");
+    Check(FindText("ab", "abc", true).count == 0, "needle longer than the text");
+}
+
+// Past kMaxStoredMatches only the count grows.
+void StoredLimit() {
+    const std::string text(kMaxStoredMatches + 100, 'x');
+    const TextSearchResult result = FindText(text, "x", true);
+    Check(result.count == text.size(), "every match is counted");
+    Check(result.matches.size() == kMaxStoredMatches, "stored matches stop at the limit");
+}
+
+} // namespace
+
+int main() {
+    Basics();
+    RandomTexts();
+    StoredLimit();
+    return FinishTest("text_search_test");
+}
@@ -0,0 +1,101 @@
+#include <string>
+
+#include "output_sink.h"
+#include "test_support.h"
+#include "xml_canonical.h"
+#include "xml_diff.h"
+
+namespace {
+
+std::string Canonical(const std::string& xml, bool with_comments, bool& ok) {
+    std::string out;
+    StringSink sink(out);
+    XmlCanonicalOptions options;
+    options.with_comments = with_comments;
+    ok = CanonicalizeXml(xml, options, sink).ok;
+    return out;
+}
+
+// One case per rule documented in xml_canonical.h, following the
+// examples of Canonical XML 1.0 section 3 and Exclusive C14N section 3.
+void Rules() {
+    const char* const cases[][2] = {
+        // Declaration, doctype and whitespace outside the root.
+        {"<?xml version=\"1.0\"?>\n<!DOCTYPE doc>\n<doc/>\n", "<doc></doc>"},
+        // Empty elements and start tag whitespace and quoting.
+        {"<a   b = 'v' ><c/></a >", "<a b=\"v\"><c></c></a>"},
+        // Attributes sorted by namespace URI then local name, after the
+        // declarations sorted by prefix.
+        {"<e b=\"2\" a=\"1\" xmlns:y=\"urn:y\" y:c=\"3\"/>", "<e xmlns:y=\"urn:y\" a=\"1\" b=\"2\" y:c=\"3\"></e>"},
+        {"<e xmlns:b=\"urn:a\" xmlns:a=\"urn:b\" a:x=\"1\" b:x=\"2\"/>",
+         "<e xmlns:a=\"urn:b\" xmlns:b=\"urn:a\" b:x=\"2\" a:x=\"1\"></e>"},
+        // Declarations go to the first element that uses them, once per URI.
+        {"<a xmlns:u=\"urn:u\"><b/></a>", "<a><b></b></a>"},
+        {"<a xmlns:p=\"urn:p\"><p:b><p:c/></p:b></a>", "<a><p:b xmlns:p=\"urn:p\"><p:c></p:c></p:b></a>"},
+        {"<p:a xmlns:p=\"urn:1\"><p:b xmlns:p=\"urn:1\"/><p:c xmlns:p=\"urn:2\"/></p:a>",
+         "<p:a xmlns:p=\"urn:1\"><p:b></p:b><p:c xmlns:p=\"urn:2\"></p:c></p:a>"},
+        {"<a xmlns=\"urn:d\"><b/></a>", "<a xmlns=\"urn:d\"><b></b></a>"},
+        {"<a xmlns:p=\"urn:p\"><b p:x=\"1\"/></a>", "<a><b xmlns:p=\"urn:p\" p:x=\"1\"></b></a>"},
+        // Attribute values: whitespace normalized, references expanded and
+        // escaped again the canonical way.
+        {"<a x=\"  1\n\t2 \" y=\"&#9;&#10;&#13;\" z='&lt;&gt;&amp;\"'/>",
+         "<a x=\"  1  2 \" y=\"&#x9;&#xA;&#xD;\" z=\"&lt;>&amp;&quot;\"></a>"},
+        // Text: references expanded, CDATA replaced, line ends normalized.
+        {"<a>&lt;&gt;&amp;&quot;&apos;&#65;&#x42;&#13;</a>", "<a>&lt;&gt;&amp;\"'AB&#xD;</a>"},
+        {"<a><![CDATA[x < y & z > 1]]></a>", "<a>x &lt; y &amp; z &gt; 1</a>"},
+        {"<a>1\r\n2\r3</a>", "<a>1\n2\n3</a>"},
+        // Comments dropped, processing instructions kept.
+        {"<?pi a?>\n<!-- c -->\n<r><!-- d --><?t x?></r>\n<?pi b?>\n", "<?pi a?>\n<r><?t x?></r>\n<?pi b?>"},
+    };
+    for (const auto& pair : cases) {
+        bool ok = false;
+        const std::string got = Canonical(pair[0], false, ok);
+        if (!ok || got != pair[1]) {
+            Check(false, (std::string(pair[0]) + " canonicalizes to " + pair[1] + ", got " + got).c_str());
+        }
+    }
+
+    bool ok = false;
+    Check(Canonical("<!-- a -->\n<r><!--b--></r>\n<!-- c -->", true, ok) == "<!-- a -->\n<r><!--b--></r>\n<!-- c -->" &&
+              ok,
+          "comments are kept when asked for");
+    Canonical("<!DOCTYPE r [<!ENTITY e \"x\">]><r>&e;</r>", false, ok);
+    Check(!ok, "entities declared in a DTD are rejected");
+    Canonical("<a><b></a>", false, ok);
+    Check(!ok, "malformed input is rejected");
+}
+
+XmlDiffResult Diff(const std::string& left, const std::string& right) {
+    XmlCanonicalTree a;
+    XmlCanonicalTree b;
+    std::string error;
+    const bool built = a.Build(left, true, error) && b.Build(right, true, error);
+    Check(built, "diff inputs parse");
+    return built ? DiffXml(a, b) : XmlDiffResult{};
+}
+
+// Documents differing only in what C14N normalizes away compare equal;
+// real differences are reported at their node.
+void Diffs() {
+    Check(Diff("<r b='2' a=\"1\"><x>&amp;</x>\n  <y/></r>", "<r a=\"1\" b=\"2\"><x><![CDATA[&]]></x><y></y></r>").count == 0,
+          "equivalent documents have no differences");
+    Check(Diff("<p:r xmlns:p=\"urn:p\"><p:x/></p:r>", "<q:r xmlns:q=\"urn:p\"><q:x/></q:r>").count != 0,
+          "prefixes are significant");
+
+    XmlDiffResult result = Diff("<r><a x=\"1\"/><b>t</b></r>", "<r><a x=\"2\"/><b>t</b><c/></r>");
+    Check(result.count == 2 && result.entries.size() == 2, "two differences");
+    if (result.entries.size() == 2) {
+        Check(result.entries[0].kind == XmlDiffKind::Changed && result.entries[0].path == "/r/a",
+              "changed attribute reported on its element");
+        Check(result.entries[1].kind == XmlDiffKind::Added && result.entries[1].path == "/r/c",
+              "added element reported");
+    }
+}
+
+} // namespace
+
+int main() {
+    Rules();
+    Diffs();
+    return FinishTest("xml_canonical_test");
+}
@@ -0,0 +1,109 @@
+#include <string>
+
+#include "output_sink.h"
+#include "test_support.h"
+#include "xml_to_json.h"
+
+namespace {
+
+std::string Convert(const std::string& xml, int indent, bool& ok) {
+    std::string json;
+    StringSink sink(json);
+    ok = ConvertXmlToJson(xml, XmlToJsonOptions{indent}, sink).ok;
+    return json;
+}
+
+// One case per rule of the mapping documented in xml_to_json.h, written
+// compact; the output ends with a newline either way.
+void Rules() {
+    const char* const cases[][2] = {
+        // Text-only and empty elements.
+        {"<a>hi</a>", "{\"a\":\"hi\"}"},
+        {"<a/>", "{\"a\":null}"},
+        {"<a></a>", "{\"a\":null}"},
+        // Attributes, then children, then text.
+        {"<a x=\"1\" y='2'/>", "{\"a\":{\"@x\":\"1\",\"@y\":\"2\"}}"},
+        {"<a x=\"1\">t</a>", "{\"a\":{\"@x\":\"1\",\"#text\":\"t\"}}"},
+        {"<a><b>1</b><c/></a>", "{\"a\":{\"b\":\"1\",\"c\":null}}"},
+        {"<a>one<b/>two</a>", "{\"a\":{\"b\":null,\"#text\":\"onetwo\"}}"},
+        {"<a>\n  <b>1</b>\n</a>", "{\"a\":{\"b\":\"1\"}}"},
+        // Same-named siblings, adjacent or not, become one array at the
+        // place of the first.
+        {"<a><b>1</b><b>2</b></a>", "{\"a\":{\"b\":[\"1\",\"2\"]}}"},
+        {"<a><b>1</b><c>x</c><b>2</b><d/><b>3</b></a>",
+         "{\"a\":{\"b\":[\"1\",\"2\",\"3\"],\"c\":\"x\",\"d\":null}}"},
+        {"<a><c/><b>1</b><c/><b><i>2</i></b></a>",
+         "{\"a\":{\"c\":[null,null],\"b\":[\"1\",{\"i\":\"2\"}]}}"},
+        {"<a><b><b>1</b></b><b>2</b></a>", "{\"a\":{\"b\":[{\"b\":\"1\"},\"2\"]}}"},
+        // Prefixes are kept and xmlns is an attribute.
+        {"<p:a xmlns:p=\"urn:p\"><p:b>1</p:b></p:a>", "{\"p:a\":{\"@xmlns:p\":\"urn:p\",\"p:b\":\"1\"}}"},
+        // Entities and CDATA are decoded; unknown entities stay as written.
+        {"<a x=\"&lt;&#65;\">&amp;&#x42;&quot;</a>", "{\"a\":{\"@x\":\"<A\",\"#text\":\"&B\\\"\"}}"},
+        {"<a><![CDATA[<b>]]>c</a>", "{\"a\":\"<b>c\"}"},
+        {"<!DOCTYPE a [<!ENTITY e \"x\">]><a>&e;</a>", "{\"a\":\"&e;\"}"},
+        // Comments, processing instructions and the declaration vanish.
+        {"<?xml version=\"1.0\"?><!-- c --><a><?pi x?>t<!-- d --></a>", "{\"a\":\"t\"}"},
+        // Values stay strings; control characters and quotes are escaped.
+        {"<a><n>12</n><t>true</t></a>", "{\"a\":{\"n\":\"12\",\"t\":\"true\"}}"},
+        {"<a>\"\\\t</a>", "{\"a\":\"\\\"\\\\\\t\"}"},
+    };
+    for (const auto& pair : cases) {
+        bool ok = false;
+        const std::string got = Convert(pair[0], 0, ok);
+        if (!ok || got != std::string(pair[1]) + "\n") {
+            Check(false, (std::string(pair[0]) + " converts to " + pair[1] + ", got " + got).c_str());
+        }
+    }
+}
+
+void Indented() {
+    bool ok = false;
+    const std::string got = Convert("<a x=\"1\"><b>1</b><b/></a>", 2, ok);
+    Check(ok && got == "{\n"
+                       "  \"a\": {\n"
+                       "    \"@x\": \"1\",\n"
+                       "    \"b\": [\n"
+                       "      \"1\",\n"
+                       "      null\n"
+                       "    ]\n"
+                       "  }\n"
+                       "}\n",
+          "indented output");
+}
+
+// A large group split by other elements is written in order, as one
+// member, whatever its size.
+void LargeGroups() {
+    std::string xml = "<r>";
+    std::string expected_b = "\"b\":[";
+    std::string expected_c = "\"c\":[";
+    for (int i = 0; i < 5000; ++i) {
+        xml += "<b>" + std::to_string(i) + "</b><c>" + std::to_string(i) + "</c>";
+        expected_b += (i ? ",\"" : "\"") + std::to_string(i) + "\"";
+        expected_c += (i ? ",\"" : "\"") + std::to_string(i) + "\"";
+    }
+    xml += "</r>";
+    bool ok = false;
+    Check(Convert(xml, 0, ok) == "{\"r\":{" + expected_b + "]," + expected_c + "]}}\n" && ok,
+          "interleaved groups keep document order");
+}
+
+void Errors() {
+    bool ok = true;
+    Convert("<a><b></a>", 0, ok);
+    Check(!ok, "mismatched tags are rejected");
+    Convert("<a/><b/>", 0, ok);
+    Check(!ok, "a second root is rejected");
+    Convert("", 0, ok);
+    Check(!ok, "an empty document is rejected");
+}
+
+} // namespace
+
+int main() {
+    Rules();
+    Indented();
+    LargeGroups();
+    Errors();
+    return FinishTest("xml_to_json_test");
+}